@@ -0,0 +1,154 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        alloctracker.cpp
+// Purpose:     Counting heap allocations per thread in a benchmark build
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+#include "alloctracker.h"
+
+#if WXOPENCVCAMERAS_TRACK_ALLOCATIONS
+
+#include <cstdlib>
+#include <new>
+
+#include <opencv2/core.hpp>
+
+#include "camerathread.h"
+
+// the access flags became an enum in OpenCV 4.3
+#if CHECK_OPENCV_VERSION(4,3,0)
+typedef cv::AccessFlag MatAccessFlag;
+#else
+typedef int MatAccessFlag;
+#endif
+
+namespace
+{
+
+// plain integers, so that using them does not require any
+// dynamic initialization which could itself allocate
+thread_local wxUint64 threadAllocationCount = 0;
+thread_local wxUint64 threadAllocationBytes = 0;
+
+void* CountedAllocate(std::size_t size)
+{
+    for ( ;; )
+    {
+        void* p = std::malloc(size > 0 ? size : 1);
+
+        // counted only when allocated, a failed attempt is not an allocation
+        if ( p )
+        {
+            threadAllocationCount++;
+            threadAllocationBytes += size;
+            return p;
+        }
+
+        std::new_handler handler = std::get_new_handler();
+
+        if ( !handler )
+            throw std::bad_alloc();
+
+        handler();
+    }
+}
+
+void* CountedAllocateNoThrow(std::size_t size) noexcept
+{
+    try
+    {
+        return CountedAllocate(size);
+    }
+    catch ( ... )
+    {
+        return nullptr;
+    }
+}
+
+/***********************************************************************************************
+
+    CountingMatAllocator: cv::Mat buffers are allocated by OpenCV with cv::fastMalloc(),
+                          bypassing operator new, so they are counted by
+                          cv::Mat's default allocator, which delegates to OpenCV's own.
+
+***********************************************************************************************/
+
+class CountingMatAllocator : public cv::MatAllocator
+{
+public:
+    CountingMatAllocator() : m_stdAllocator(cv::Mat::getStdAllocator()) {}
+
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           MatAccessFlag flags, cv::UMatUsageFlags usageFlags) const override
+    {
+        cv::UMatData* u = m_stdAllocator->allocate(dims, sizes, type, data, step, flags, usageFlags);
+
+        // data is not null when the cv::Mat uses an external buffer
+        if ( u && !data )
+        {
+            threadAllocationCount++;
+            threadAllocationBytes += u->size;
+        }
+
+        return u;
+    }
+
+    bool allocate(cv::UMatData* data, MatAccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const override
+    {
+        return m_stdAllocator->allocate(data, accessFlags, usageFlags);
+    }
+
+    // not called for the data allocated above, which has m_stdAllocator as its currAllocator
+    void deallocate(cv::UMatData* data) const override
+    {
+        m_stdAllocator->deallocate(data);
+    }
+private:
+    cv::MatAllocator* m_stdAllocator;
+};
+
+// installed before main() is called, never destroyed, so that
+// cv::Mats destroyed during the program exit can still use it
+struct CountingMatAllocatorInstaller
+{
+    CountingMatAllocatorInstaller()
+    {
+        cv::Mat::setDefaultAllocator(new CountingMatAllocator);
+    }
+} countingMatAllocatorInstaller;
+
+} // unnamed namespace
+
+void* operator new(std::size_t size)                                  { return CountedAllocate(size); }
+void* operator new[](std::size_t size)                                { return CountedAllocate(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept   { return CountedAllocateNoThrow(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return CountedAllocateNoThrow(size); }
+
+void operator delete(void* p) noexcept                          { std::free(p); }
+void operator delete[](void* p) noexcept                        { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept   { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept             { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept           { std::free(p); }
+
+AllocationCounts GetCurrentThreadAllocationCounts()
+{
+    AllocationCounts counts;
+
+    counts.count = threadAllocationCount;
+    counts.bytes = threadAllocationBytes;
+
+    return counts;
+}
+
+#else // #if WXOPENCVCAMERAS_TRACK_ALLOCATIONS
+
+AllocationCounts GetCurrentThreadAllocationCounts()
+{
+    return AllocationCounts();
+}
+
+#endif // #if WXOPENCVCAMERAS_TRACK_ALLOCATIONS
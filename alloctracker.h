@@ -0,0 +1,35 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        alloctracker.h
+// Purpose:     Counting heap allocations per thread in a benchmark build
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef ALLOCTRACKER_H
+#define ALLOCTRACKER_H
+
+#include <wx/defs.h>
+
+// When WXOPENCVCAMERAS_TRACK_ALLOCATIONS is 1 (see CMake option of the same name),
+// global operator new and operator delete are replaced with versions counting
+// allocations made by each thread, and so is cv::Mat's default allocator.
+// Other allocations are not counted, e.g., GdkPixbuf data allocated by GLib
+// or cv::Mat buffers allocated by a custom allocator.
+#ifndef WXOPENCVCAMERAS_TRACK_ALLOCATIONS
+    #define WXOPENCVCAMERAS_TRACK_ALLOCATIONS 0
+#endif
+
+struct AllocationCounts
+{
+    wxUint64 count{0};
+    wxUint64 bytes{0};
+};
+
+// Returns the number of allocations and bytes allocated by the calling thread
+// since it started; always returns zeros when allocation tracking is not enabled.
+AllocationCounts GetCurrentThreadAllocationCounts();
+
+#endif // #ifndef ALLOCTRACKER_H
@@ -0,0 +1,104 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        bitmappool.cpp
+// Purpose:     Native pixel buffers made by camera threads and pooled wxBitmaps for them
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+#include <wx/wx.h>
+#include <wx/rawbmp.h>
+
+#include <cstring>
+
+#include "bitmappool.h"
+
+/***********************************************************************************************
+
+    NativeImage
+
+***********************************************************************************************/
+
+NativeImage::NativeImage(int width, int height)
+    : m_width(width), m_height(height)
+{
+    wxASSERT(m_width > 0 && m_height > 0);
+
+    m_pixels.reset(new unsigned char[GetBytes()]);
+}
+
+int NativeImage::GetPixelSize()
+{
+    return wxNativePixelFormat::SizePixel;
+}
+
+/***********************************************************************************************
+
+    BitmapPool
+
+***********************************************************************************************/
+
+BitmapPool::BitmapPool(size_t capacity)
+    : m_capacity(capacity)
+{
+    wxASSERT(m_capacity > 0);
+}
+
+wxBitmap BitmapPool::GetBitmap(const NativeImage& image)
+{
+    wxBitmap* bitmap = nullptr;
+
+    for ( auto& pooledBitmap : m_bitmaps )
+    {
+        // only the pool references it, so nothing displays it anymore
+        if ( pooledBitmap.IsOk() && pooledBitmap.GetSize() == image.GetSize()
+             && pooledBitmap.GetRefData()->GetRefCount() == 1 )
+        {
+            bitmap = &pooledBitmap;
+            break;
+        }
+    }
+
+    if ( !bitmap )
+    {
+        const wxBitmap newBitmap(image.GetSize(), 24);
+
+        if ( m_bitmaps.size() < m_capacity )
+        {
+            m_bitmaps.push_back(newBitmap);
+            bitmap = &m_bitmaps.back();
+        }
+        else
+        {
+            // the replaced bitmap lives on as long as it is referenced elsewhere
+            m_bitmaps[m_nextReplaced] = newBitmap;
+            bitmap = &m_bitmaps[m_nextReplaced];
+            m_nextReplaced = (m_nextReplaced + 1) % m_capacity;
+        }
+        m_bitmapsCreated++;
+    }
+
+    wxNativePixelData pixelData(*bitmap);
+
+    wxCHECK(pixelData, wxBitmap());
+
+    // the layouts are the same, so the rows are just copied,
+    // MoveTo() takes care of the bitmaps stored bottom-up (MSW)
+    wxNativePixelData::Iterator pixelDataIt(pixelData);
+    const size_t                rowBytes = image.GetRowStride();
+
+    for ( int row = 0; row < image.GetHeight(); ++row )
+    {
+        pixelDataIt.MoveTo(pixelData, 0, row);
+        memcpy(pixelDataIt.m_ptr, image.GetRow(row), rowBytes);
+    }
+
+    return *bitmap;
+}
+
+void BitmapPool::Clear()
+{
+    m_bitmaps.clear();
+    m_nextReplaced = 0;
+}
@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        bitmappool.h
+// Purpose:     Native pixel buffers made by camera threads and pooled wxBitmaps for them
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef BITMAPPOOL_H
+#define BITMAPPOOL_H
+
+#include <wx/wx.h>
+
+#include <memory>
+#include <vector>
+
+/***********************************************************************************************
+
+    NativeImage: pixels in the layout of the platform's 24-bit wxBitmap, i.e. of
+                 wxNativePixelData (e.g., RGB on wxGTK, BGR on MSW, xRGB on macOS),
+                 rows top-down without padding. A camera thread converts a frame into it
+                 without touching any wxBitmap (see ConvertMatToNativeImage()), the GUI
+                 thread just copies it into a pooled bitmap (see BitmapPool).
+                 It is not modified after being passed on, so it can be shared
+                 by several threads via NativeImagePtr.
+
+***********************************************************************************************/
+
+class NativeImage
+{
+public:
+    // the pixels are not initialized
+    NativeImage(int width, int height);
+
+    int    GetWidth() const     { return m_width; }
+    int    GetHeight() const    { return m_height; }
+    wxSize GetSize() const      { return wxSize(m_width, m_height); }
+    size_t GetRowStride() const { return static_cast<size_t>(m_width) * GetPixelSize(); }
+    size_t GetBytes() const     { return GetRowStride() * m_height; }
+
+    unsigned char*       GetRow(int row)       { return m_pixels.get() + GetRowStride() * row; }
+    const unsigned char* GetRow(int row) const { return m_pixels.get() + GetRowStride() * row; }
+
+    // bytes per pixel of the native layout, 3 or 4
+    static int GetPixelSize();
+private:
+    const int                        m_width;
+    const int                        m_height;
+    std::unique_ptr<unsigned char[]> m_pixels;
+
+    wxDECLARE_NO_COPY_CLASS(NativeImage);
+};
+
+typedef std::shared_ptr<const NativeImage> NativeImagePtr;
+
+
+/***********************************************************************************************
+
+    BitmapPool: a few wxBitmaps of a camera reused for displaying its NativeImages
+                in the GUI thread, so that no bitmap is created per frame. A bitmap is
+                reused only when nothing outside the pool references it anymore
+                (e.g., CameraPanel has been given a newer one), otherwise a new one
+                is created, replacing the pooled ones in turn when the pool is full.
+                It must be used only in the GUI thread.
+
+***********************************************************************************************/
+
+class BitmapPool
+{
+public:
+    explicit BitmapPool(size_t capacity = 3);
+
+    // Returns a bitmap of image's size with image's pixels copied into it.
+    wxBitmap GetBitmap(const NativeImage& image);
+
+    // how many bitmaps were created, i.e. how often no pooled one could be reused
+    wxUint64 GetBitmapsCreated() const { return m_bitmapsCreated; }
+
+    // releases the pool's references to its bitmaps
+    void Clear();
+private:
+    size_t                m_capacity;
+    std::vector<wxBitmap> m_bitmaps;
+    size_t                m_nextReplaced{0}; // when the pool is full
+    wxUint64              m_bitmapsCreated{0};
+};
+
+#endif // #ifndef BITMAPPOOL_H
@@ -0,0 +1,153 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        cameracpudialog.cpp
+// Purpose:     Displays cameras sorted by CPU time consumed by their threads
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+#include <wx/wx.h>
+#include <wx/wupdlock.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "cameracpudialog.h"
+#include "cputime.h"
+
+CameraCPUDialog::CameraCPUDialog(wxWindow* parent, const MetricsRegistry& metricsRegistry)
+    : wxDialog(parent, wxID_ANY, "Top Cameras by CPU", wxDefaultPosition, wxDefaultSize,
+               wxDEFAULT_DIALOG_STYLE | wxRESIZE_BORDER),
+      m_metricsRegistry(metricsRegistry)
+{
+    static const char* const columnNames[ColumnCount] =
+        { "Camera", "CPU %", "Retrieve %", "Convert %", "Thumbnail %", "Record %", "Other %", "Total CPU (s)" };
+
+    wxBoxSizer* mainSizer = new wxBoxSizer(wxVERTICAL);
+
+    m_listView = new wxListView(this, wxID_ANY, wxDefaultPosition, wxSize(800, 400), wxLC_REPORT | wxLC_SINGLE_SEL);
+    for ( int i = 0; i < ColumnCount; ++i )
+        m_listView->AppendColumn(columnNames[i], i == ColumnCamera ? wxLIST_FORMAT_LEFT : wxLIST_FORMAT_RIGHT);
+    mainSizer->Add(m_listView, wxSizerFlags(1).Expand().Border());
+
+    mainSizer->Add(new wxStaticText(this, wxID_ANY,
+        ThreadCPUStopWatch().IsAvailable()
+            ? "CPU usage of camera and recorder threads in the last second, in percent of one CPU core. Click a column to sort."
+            : "Thread CPU time is not available on this platform."),
+        wxSizerFlags().Border(wxLEFT | wxRIGHT | wxBOTTOM));
+
+    SetSizerAndFit(mainSizer);
+
+    m_listView->Bind(wxEVT_LIST_COL_CLICK, &CameraCPUDialog::OnColumnClick, this);
+
+    m_refreshTimer.Bind(wxEVT_TIMER, &CameraCPUDialog::OnRefreshCameras, this);
+    m_refreshTimer.Start(1000);
+
+    RefreshCameras();
+}
+
+CameraCPUDialog::CPUTimes CameraCPUDialog::GetCPUTimes(const CameraMetrics& metrics)
+{
+    CPUTimes times;
+
+    times.retrieve  = CameraMetrics::Get(metrics.cpuRetrieveUs);
+    times.convert   = CameraMetrics::Get(metrics.cpuConvertUs);
+    times.thumbnail = CameraMetrics::Get(metrics.cpuThumbnailUs);
+    times.record    = CameraMetrics::Get(metrics.recordingCpuUs);
+    times.other     = CameraMetrics::Get(metrics.cpuSleepUs) + CameraMetrics::Get(metrics.cpuOtherUs);
+    times.total     = times.retrieve + times.convert + times.thumbnail + times.record + times.other;
+
+    return times;
+}
+
+void CameraCPUDialog::RefreshCameras()
+{
+    const std::vector<CameraMetricsPtr> cameras = m_metricsRegistry.GetCameras();
+    const wxLongLong                    now = wxGetUTCTimeMillis();
+    const double                        elapsedUs = m_prevTime > 0 ? (now - m_prevTime).ToDouble() * 1000. : 0.;
+
+    std::map<const CameraMetrics*, CPUTimes> times;
+    std::vector<CameraRow>                   rows;
+
+    for ( const auto& c : cameras )
+    {
+        const CPUTimes current = GetCPUTimes(*c);
+        CPUTimes       previous;
+        CameraRow      row;
+
+        auto it = m_prevTimes.find(c.get());
+
+        // the counters only grow, unless the pointer was reused for a new camera
+        if ( it != m_prevTimes.end() && it->second.total <= current.total )
+            previous = it->second;
+
+        times[c.get()] = current;
+
+        row.name = c->cameraName;
+        if ( elapsedUs > 0 )
+        {
+            row.values[ColumnTotal]     = (current.total - previous.total) * 100. / elapsedUs;
+            row.values[ColumnRetrieve]  = (current.retrieve - previous.retrieve) * 100. / elapsedUs;
+            row.values[ColumnConvert]   = (current.convert - previous.convert) * 100. / elapsedUs;
+            row.values[ColumnThumbnail] = (current.thumbnail - previous.thumbnail) * 100. / elapsedUs;
+            row.values[ColumnRecord]    = (current.record - previous.record) * 100. / elapsedUs;
+            row.values[ColumnOther]     = (current.other - previous.other) * 100. / elapsedUs;
+        }
+        row.values[ColumnTotalTime] = current.total / 1000000.;
+
+        rows.push_back(row);
+    }
+
+    m_prevTimes = times;
+    m_prevTime  = now;
+
+    const int  sortColumn    = m_sortColumn;
+    const bool sortAscending = m_sortAscending;
+
+    std::stable_sort(rows.begin(), rows.end(),
+        [sortColumn, sortAscending](const CameraRow& r1, const CameraRow& r2)
+        {
+            if ( sortColumn == ColumnCamera )
+                return sortAscending ? r1.name.CmpNoCase(r2.name) < 0 : r1.name.CmpNoCase(r2.name) > 0;
+
+            return sortAscending ? r1.values[sortColumn] < r2.values[sortColumn]
+                                 : r1.values[sortColumn] > r2.values[sortColumn];
+        });
+
+    wxWindowUpdateLocker locker(m_listView);
+
+    m_listView->DeleteAllItems();
+    for ( size_t i = 0; i < rows.size(); ++i )
+    {
+        const long item = m_listView->InsertItem(i, rows[i].name);
+
+        for ( int col = ColumnTotal; col < ColumnTotalTime; ++col )
+            m_listView->SetItem(item, col, wxString::Format("%.1f", rows[i].values[col]));
+        m_listView->SetItem(item, ColumnTotalTime, wxString::Format("%.2f", rows[i].values[ColumnTotalTime]));
+    }
+}
+
+void CameraCPUDialog::OnColumnClick(wxListEvent& evt)
+{
+    const int column = evt.GetColumn();
+
+    if ( column < 0 || column >= ColumnCount )
+        return;
+
+    if ( column == m_sortColumn )
+    {
+        m_sortAscending = !m_sortAscending;
+    }
+    else
+    {
+        m_sortColumn = column;
+        // names are sorted A-Z by default, CPU usage from the highest
+        m_sortAscending = column == ColumnCamera;
+    }
+
+#if wxCHECK_VERSION(3, 1, 6)
+    m_listView->ShowSortIndicator(m_sortColumn, m_sortAscending);
+#endif
+    RefreshCameras();
+}
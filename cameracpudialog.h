@@ -0,0 +1,84 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        cameracpudialog.h
+// Purpose:     Displays cameras sorted by CPU time consumed by their threads
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef CAMERACPUDIALOG_H
+#define CAMERACPUDIALOG_H
+
+#include <wx/wx.h>
+#include <wx/listctrl.h>
+
+#include <map>
+
+#include "metrics.h"
+
+/***********************************************************************************************
+
+    CameraCPUDialog: a modeless dialog listing cameras with the CPU usage
+                     of their threads in the last second, split by stage.
+                     The recorder thread (see CameraRecorder) is included,
+                     so that recording with and without decoding can be compared.
+                     The list is refreshed once a second and can be sorted
+                     by clicking a column header.
+
+***********************************************************************************************/
+
+class CameraCPUDialog : public wxDialog
+{
+public:
+    CameraCPUDialog(wxWindow* parent, const MetricsRegistry& metricsRegistry);
+private:
+    enum Columns
+    {
+        ColumnCamera = 0,
+        ColumnTotal,
+        ColumnRetrieve,
+        ColumnConvert,
+        ColumnThumbnail,
+        ColumnRecord,
+        ColumnOther,
+        ColumnTotalTime,
+        ColumnCount
+    };
+
+    // CPU times in microseconds
+    struct CPUTimes
+    {
+        wxUint64 retrieve{0};
+        wxUint64 convert{0};
+        wxUint64 thumbnail{0};
+        wxUint64 record{0}; // the recorder thread
+        wxUint64 other{0};  // includes sleep
+        wxUint64 total{0};
+    };
+
+    // CPU usage in percent of one CPU core
+    struct CameraRow
+    {
+        wxString name;
+        double   values[ColumnCount]{};
+    };
+
+    const MetricsRegistry&                   m_metricsRegistry;
+    wxListView*                              m_listView{nullptr};
+    wxTimer                                  m_refreshTimer;
+    int                                      m_sortColumn{ColumnTotal};
+    bool                                     m_sortAscending{false};
+    std::map<const CameraMetrics*, CPUTimes> m_prevTimes; // times at the last refresh
+    wxLongLong                               m_prevTime{0};
+
+    static CPUTimes GetCPUTimes(const CameraMetrics& metrics);
+
+    void RefreshCameras();
+
+    void OnRefreshCameras(wxTimerEvent&) { RefreshCameras(); }
+    void OnColumnClick(wxListEvent& evt);
+};
+
+#endif // #ifndef CAMERACPUDIALOG_H
@@ -9,27 +9,33 @@
 
 #include <wx/wx.h>
 #include <wx/choicdlg.h>
+#include <wx/dirdlg.h>
+#include <wx/filedlg.h>
+#include <wx/filename.h>
 #include <wx/numdlg.h>
+#include <wx/textfile.h>
 #include <wx/thread.h>
 #include <wx/utils.h>
 #include <wx/wrapsizer.h>
 #include <wx/wupdlock.h>
 
+#include <algorithm>
+
+#include <opencv2/core.hpp>
 #include <opencv2/videoio/registry.hpp>
 
+#include "alloctracker.h"
+#include "cameracpudialog.h"
 #include "cameragridframe.h"
 #include "camerapanel.h"
 #include "camerathread.h"
+#include "camerathreadreaper.h"
 #include "convertmattowxbmp.h"
+#include "cputime.h"
+#include "mjpegserver.h"
+#include "objectdetector.h"
 #include "onecameraframe.h"
 
-// based on wxCHECK_VERSION
-#define CHECK_OPENCV_VERSION(major,minor,revision) \
-    (CV_VERSION_MAJOR >  (major) || \
-    (CV_VERSION_MAJOR == (major) && CV_VERSION_MINOR >  (minor)) || \
-    (CV_VERSION_MAJOR == (major) && CV_VERSION_MINOR == (minor) && CV_VERSION_REVISION >= (revision)))
-
-
 // some/most are time-limited
 const char* const knownCameraAdresses[] =
 {
@@ -78,14 +84,48 @@ CameraGridFrame::CameraGridFrame(wxWindow* parent) : wxFrame(parent, wxID_ANY, "
     defaultCameraSettingsMenu->Append(ID_CAMERA_SET_DEFAULTS_RESOLUTION, "Resolution...");
     defaultCameraSettingsMenu->Append(ID_CAMERA_SET_DEFAULTS_FPS, "FPS...");
     defaultCameraSettingsMenu->AppendCheckItem(ID_CAMERA_SET_DEFAULTS_USE_MJPEG_FOURCC, "Use MJPEG FourCC");
+    defaultCameraSettingsMenu->Append(ID_CAMERA_SET_DEFAULTS_OPEN_TIMEOUT, "Open Timeout...");
+    defaultCameraSettingsMenu->Append(ID_CAMERA_SET_DEFAULTS_READ_TIMEOUT, "Read Timeout...");
+    defaultCameraSettingsMenu->AppendCheckItem(ID_CAMERA_SET_DEFAULTS_RECONNECT, "Reconnect When Connection Lost");
+    defaultCameraSettingsMenu->Check(ID_CAMERA_SET_DEFAULTS_RECONNECT, m_defaultReconnect);
+    defaultCameraSettingsMenu->Append(ID_CAMERA_SET_DEFAULTS_RECONNECT_DELAY, "Reconnect Delay...");
+    defaultCameraSettingsMenu->AppendCheckItem(ID_CAMERA_SET_DEFAULTS_PASSTHROUGH, "Pass Through Compressed Frames (Record Only)");
+    defaultCameraSettingsMenu->AppendCheckItem(ID_CAMERA_SET_DEFAULTS_RAW_FRAMES, "Display Raw Gray/YUV Frames (No RGB Conversion)");
+    defaultCameraSettingsMenu->Append(ID_CAMERA_SET_DEFAULTS_GRAY16_WINDOW, "16-bit Gray Window...");
+    defaultCameraSettingsMenu->AppendCheckItem(ID_CAMERA_SET_DEFAULTS_NATIVE_IMAGES, "Create Bitmaps in GUI Thread (Pooled)");
+    defaultCameraSettingsMenu->Append(ID_CAMERA_SET_DEFAULTS_REPLAY_BUFFER, "Replay Buffer...");
+    defaultCameraSettingsMenu->Append(ID_CAMERA_SET_DEFAULTS_QUIET_FRAME_STRIDE, "Reduce Frame Rate of Quiet Cameras...");
+    defaultCameraSettingsMenu->Append(ID_CAMERA_SET_DEFAULTS_THREAD_SCHEDULING, "Thread Priority and CPU Affinity...");
     defaultCameraSettingsMenu->AppendSeparator();
     defaultCameraSettingsMenu->Append(ID_CAMERA_SET_DEFAULTS_RESET, "&Reset");
 
     menuBar->Append(defaultCameraSettingsMenu, "&Defaults for New Cameras");
 
+    wxMenu* diagnosticsMenu = new wxMenu;
+
+    diagnosticsMenu->Append(ID_METRICS_SET_FILE, "Write Metrics to &File...");
+    diagnosticsMenu->Append(ID_METRICS_SET_FILE_WRITE_INTERVAL, "Metrics File Write Interval...");
+    diagnosticsMenu->Append(ID_METRICS_SET_HTTP_PORT, "Serve Metrics via &HTTP...");
+    diagnosticsMenu->Append(ID_MJPEG_SET_HTTP_PORT, "Stream Cameras as &MJPEG via HTTP...");
+    diagnosticsMenu->Append(ID_OBJECT_DETECTION, "Detect &Objects (DNN)...");
+    diagnosticsMenu->Append(ID_CPU_GOVERNOR, "CPU &Governor...");
+    diagnosticsMenu->Append(ID_GUI_THREAD_AFFINITY, "GUI Thread CPU &Affinity...");
+    diagnosticsMenu->Append(ID_FRAME_MEMORY_BUDGET, "Frame Memory &Budget...");
+    diagnosticsMenu->AppendSeparator();
+    diagnosticsMenu->Append(ID_SHOW_CAMERA_CPU, "Top Cameras by &CPU...");
+    diagnosticsMenu->Append(ID_BENCHMARK_BITMAP_CONVERSION, "Benchmark &Bitmap Conversion");
+    diagnosticsMenu->AppendSeparator();
+    diagnosticsMenu->AppendCheckItem(ID_LOCKS_INSTRUMENT, "&Instrument Locks");
+    diagnosticsMenu->Append(ID_LOCKS_SHOW_STATS, "Show &Lock Statistics");
+    diagnosticsMenu->Append(ID_LOCKS_RESET_STATS, "Reset Lock Statistics");
+    diagnosticsMenu->AppendSeparator();
+    diagnosticsMenu->AppendCheckItem(ID_STALLS_RECONNECT, "&Reconnect Stalled Cameras");
+
+    menuBar->Append(diagnosticsMenu, "D&iagnostics");
+
     SetMenuBar(menuBar);
 
-    CreateStatusBar(2);
+    CreateStatusBar(WXOPENCVCAMERAS_TRACK_ALLOCATIONS ? 4 : 3);
 
     SetClientSize(900, 700);
 
@@ -114,22 +154,75 @@ CameraGridFrame::CameraGridFrame(wxWindow* parent) : wxFrame(parent, wxID_ANY, "
     Bind(wxEVT_MENU, &CameraGridFrame::OnSetCameraDefaultResolution, this, ID_CAMERA_SET_DEFAULTS_RESOLUTION);
     Bind(wxEVT_MENU, &CameraGridFrame::OnSetCameraDefaultFPS, this, ID_CAMERA_SET_DEFAULTS_FPS);
     Bind(wxEVT_MENU, &CameraGridFrame::OnSetCameraDefaultUseMJPGFourCC, this, ID_CAMERA_SET_DEFAULTS_USE_MJPEG_FOURCC);
+    Bind(wxEVT_MENU, &CameraGridFrame::OnSetCameraDefaultOpenTimeout, this, ID_CAMERA_SET_DEFAULTS_OPEN_TIMEOUT);
+    Bind(wxEVT_MENU, &CameraGridFrame::OnSetCameraDefaultReadTimeout, this, ID_CAMERA_SET_DEFAULTS_READ_TIMEOUT);
+    Bind(wxEVT_MENU, &CameraGridFrame::OnSetCameraDefaultReconnect, this, ID_CAMERA_SET_DEFAULTS_RECONNECT);
+    Bind(wxEVT_MENU, &CameraGridFrame::OnSetCameraDefaultReconnectDelay, this, ID_CAMERA_SET_DEFAULTS_RECONNECT_DELAY);
+    Bind(wxEVT_MENU, &CameraGridFrame::OnSetCameraDefaultPassthrough, this, ID_CAMERA_SET_DEFAULTS_PASSTHROUGH);
+    Bind(wxEVT_MENU, &CameraGridFrame::OnSetCameraDefaultRawFrames, this, ID_CAMERA_SET_DEFAULTS_RAW_FRAMES);
+    Bind(wxEVT_MENU, &CameraGridFrame::OnSetCameraDefaultGray16Window, this, ID_CAMERA_SET_DEFAULTS_GRAY16_WINDOW);
+    Bind(wxEVT_MENU, &CameraGridFrame::OnSetCameraDefaultNativeImages, this, ID_CAMERA_SET_DEFAULTS_NATIVE_IMAGES);
+    Bind(wxEVT_MENU, &CameraGridFrame::OnSetCameraDefaultReplayBuffer, this, ID_CAMERA_SET_DEFAULTS_REPLAY_BUFFER);
+    Bind(wxEVT_MENU, &CameraGridFrame::OnSetCameraDefaultQuietFrameStride, this, ID_CAMERA_SET_DEFAULTS_QUIET_FRAME_STRIDE);
+    Bind(wxEVT_MENU, &CameraGridFrame::OnSetCameraDefaultThreadScheduling, this, ID_CAMERA_SET_DEFAULTS_THREAD_SCHEDULING);
 
     Bind(wxEVT_MENU, &CameraGridFrame::OnCameraDefaultsReset, this, ID_CAMERA_SET_DEFAULTS_RESET);
 
+    Bind(wxEVT_MENU, &CameraGridFrame::OnSetMetricsFile, this, ID_METRICS_SET_FILE);
+    Bind(wxEVT_MENU, &CameraGridFrame::OnSetMetricsFileWriteInterval, this, ID_METRICS_SET_FILE_WRITE_INTERVAL);
+    Bind(wxEVT_MENU, &CameraGridFrame::OnSetMetricsHTTPPort, this, ID_METRICS_SET_HTTP_PORT);
+    Bind(wxEVT_MENU, &CameraGridFrame::OnSetMJPEGServerPort, this, ID_MJPEG_SET_HTTP_PORT);
+    Bind(wxEVT_MENU, &CameraGridFrame::OnObjectDetection, this, ID_OBJECT_DETECTION);
+    Bind(wxEVT_MENU, &CameraGridFrame::OnSetCPUGovernor, this, ID_CPU_GOVERNOR);
+    Bind(wxEVT_MENU, &CameraGridFrame::OnSetGUIThreadAffinity, this, ID_GUI_THREAD_AFFINITY);
+    Bind(wxEVT_MENU, &CameraGridFrame::OnSetFrameMemoryBudget, this, ID_FRAME_MEMORY_BUDGET);
+    Bind(wxEVT_MENU, &CameraGridFrame::OnShowCameraCPU, this, ID_SHOW_CAMERA_CPU);
+    Bind(wxEVT_MENU, &CameraGridFrame::OnBenchmarkBitmapConversion, this, ID_BENCHMARK_BITMAP_CONVERSION);
+    Bind(wxEVT_MENU, &CameraGridFrame::OnInstrumentLocks, this, ID_LOCKS_INSTRUMENT);
+    Bind(wxEVT_MENU, &CameraGridFrame::OnShowLockStats, this, ID_LOCKS_SHOW_STATS);
+    Bind(wxEVT_MENU, &CameraGridFrame::OnResetLockStats, this, ID_LOCKS_RESET_STATS);
+    Bind(wxEVT_MENU, [this](wxCommandEvent& evt) { m_reconnectStalledCameras = evt.IsChecked(); }, ID_STALLS_RECONNECT);
 
     m_processNewCameraFrameDataTimer.Start(m_processNewCameraFrameDataInterval);
     m_processNewCameraFrameDataTimer.Bind(wxEVT_TIMER, &CameraGridFrame::OnProcessNewCameraFrameData, this);
 
     Bind(EVT_CAMERA_CAPTURE_STARTED, &CameraGridFrame::OnCameraCaptureStarted, this);
     Bind(EVT_CAMERA_COMMAND_RESULT, &CameraGridFrame::OnCameraCommandResult, this);
+    Bind(EVT_CAMERA_RECONNECTING, &CameraGridFrame::OnCameraReconnecting, this);
+    Bind(EVT_CAMERA_RECONNECTED, &CameraGridFrame::OnCameraReconnected, this);
     Bind(EVT_CAMERA_ERROR_OPEN, &CameraGridFrame::OnCameraErrorOpen, this);
     Bind(EVT_CAMERA_ERROR_EMPTY, &CameraGridFrame::OnCameraErrorEmpty, this);
+    Bind(EVT_CAMERA_ERROR_PASSTHROUGH, &CameraGridFrame::OnCameraErrorPassthrough, this);
     Bind(EVT_CAMERA_ERROR_EXCEPTION, &CameraGridFrame::OnCameraErrorException, this);
+    Bind(EVT_CAMERA_RECORDING_ERROR, &CameraGridFrame::OnCameraRecordingError, this);
+
+    Bind(EVT_OBJECT_DETECTIONS, &CameraGridFrame::OnObjectDetections, this);
+    Bind(EVT_SHARED_MEMORY_EXPORT_STARTED, &CameraGridFrame::OnSharedMemoryExportStarted, this);
+    Bind(EVT_SHARED_MEMORY_EXPORT_ERROR, &CameraGridFrame::OnSharedMemoryExportError, this);
 
     m_updateInfoTimer.Bind(wxEVT_TIMER, &CameraGridFrame::OnUpdateInfo, this);
     m_updateInfoTimer.Start(1000); // once a second
 
+    m_stallWatchdogTimer.Bind(wxEVT_TIMER, &CameraGridFrame::OnCheckStalledCameras, this);
+    m_stallWatchdogTimer.Start(ms_stallWatchdogInterval);
+
+    m_metricsFileTimer.Bind(wxEVT_TIMER, &CameraGridFrame::OnWriteMetricsFile, this);
+
+    m_governorTimer.Bind(wxEVT_TIMER, &CameraGridFrame::OnGovernCPU, this);
+
+    LockStats::SetCurrentThreadName("GUI");
+    m_metricsRegistry.AddLockStats(&m_newCameraFrameDataCS.GetStats());
+    m_metricsRegistry.SetFrameBus(&m_frameBus);
+    m_metricsRegistry.SetFrameMemoryBudget(m_frameMemoryBudget.get());
+
+    m_cameraThreadReaper = new CameraThreadReaper(m_metricsRegistry.GetApplicationMetrics());
+    if ( m_cameraThreadReaper->Run() != wxTHREAD_NO_ERROR )
+    {
+        wxLogError("Could not create the worker thread for removing cameras, removing a camera will block the application.");
+        delete m_cameraThreadReaper;
+        m_cameraThreadReaper = nullptr;
+    }
+
     wxLog::AddTraceMask(TRACE_WXOPENCVCAMERAS);
 
     CallAfter([] { wxMessageBox("When a camera thumbnail shows it is receiving, you can:\n (1) Double click it to show the full frame.\n (2) Right click it to communicate with the camera."); } );
@@ -137,7 +230,20 @@ CameraGridFrame::CameraGridFrame(wxWindow* parent) : wxFrame(parent, wxID_ANY, "
 
 CameraGridFrame::~CameraGridFrame()
 {
+    m_metricsFileTimer.Stop();
+    m_stallWatchdogTimer.Stop();
+    m_governorTimer.Stop();
+    m_metricsHTTPServer.Stop();
+    StopMJPEGServer();
+    StopObjectDetection();
     RemoveAllCameras();
+
+    // the camera threads use this frame, so they must exit before it is destroyed
+    if ( m_cameraThreadReaper )
+    {
+        m_cameraThreadReaper->Stop();
+        delete m_cameraThreadReaper;
+    }
 }
 
 void CameraGridFrame::OnAddCamera(wxCommandEvent&)
@@ -164,17 +270,24 @@ void CameraGridFrame::OnAddAllIPCamerasAbove(wxCommandEvent&)
 
 void CameraGridFrame::OnRemoveCamera(wxCommandEvent&)
 {
-    if ( m_cameras.empty() )
+    if ( m_cameraCount == 0 )
     {
         wxLogMessage("No cameras to remove.");
         return;
     }
 
     wxArrayString cameras;
+    wxArrayInt    cameraIds;
     wxArrayInt    camerasToRemove;
 
-    for ( auto& camera : m_cameras )
-        cameras.push_back(camera.second.thread->GetCameraName());
+    for ( size_t i = 0; i < m_cameras.size(); ++i )
+    {
+        if ( !m_cameras[i].source )
+            continue;
+
+        cameras.push_back(m_cameras[i].name);
+        cameraIds.push_back(static_cast<int>(i));
+    }
 
     if ( wxGetSelectedChoices(camerasToRemove, "Remove camera(s)",
                               "Select camera(s) to remove", cameras, this) == - 1
@@ -184,7 +297,7 @@ void CameraGridFrame::OnRemoveCamera(wxCommandEvent&)
     }
 
     for ( const auto& cr : camerasToRemove )
-        RemoveCamera(cameras[cr]);
+        RemoveCamera(cameraIds[cr]);
 }
 
 void CameraGridFrame::OnRemoveAllCameras(wxCommandEvent&)
@@ -334,6 +447,151 @@ void CameraGridFrame::OnSetCameraDefaultUseMJPGFourCC(wxCommandEvent& evt)
     m_defaultUseMJPGFourCC = evt.IsChecked();
 }
 
+void CameraGridFrame::OnSetCameraDefaultOpenTimeout(wxCommandEvent&)
+{
+    long timeout = wxGetNumberFromUser("Open timeout in ms (0 = backend default)", "Number between 0 and 600000",
+                                       "Select default camera open timeout",
+                                       m_defaultCameraOpenTimeout,
+                                       0, 600000, this);
+
+    if ( timeout == -1 )
+        return;
+
+    m_defaultCameraOpenTimeout = timeout;
+}
+
+void CameraGridFrame::OnSetCameraDefaultReadTimeout(wxCommandEvent&)
+{
+    long timeout = wxGetNumberFromUser("Read timeout in ms (0 = backend default)", "Number between 0 and 600000",
+                                       "Select default camera read timeout",
+                                       m_defaultCameraReadTimeout,
+                                       0, 600000, this);
+
+    if ( timeout == -1 )
+        return;
+
+    m_defaultCameraReadTimeout = timeout;
+}
+
+void CameraGridFrame::OnSetCameraDefaultReconnect(wxCommandEvent& evt)
+{
+    m_defaultReconnect = evt.IsChecked();
+}
+
+void CameraGridFrame::OnSetCameraDefaultReconnectDelay(wxCommandEvent&)
+{
+    long delayInitial = wxGetNumberFromUser("Delay before the first reconnect attempt in ms", "Number between 100 and 600000",
+                                            "Select default initial reconnect delay",
+                                            m_defaultReconnectDelayInitial,
+                                            100, 600000, this);
+
+    if ( delayInitial == -1 )
+        return;
+
+    long delayMax = wxGetNumberFromUser("The delay is doubled after every failed attempt up to (ms)", wxString::Format("Number between %ld and 600000", delayInitial),
+                                        "Select default maximum reconnect delay",
+                                        std::max(m_defaultReconnectDelayMax, delayInitial),
+                                        delayInitial, 600000, this);
+
+    if ( delayMax == -1 )
+        return;
+
+    long jitter = wxGetNumberFromUser("Randomize the delay by (percent)", "Number between 0 and 100",
+                                      "Select default reconnect delay jitter",
+                                      m_defaultReconnectJitter,
+                                      0, 100, this);
+
+    if ( jitter == -1 )
+        return;
+
+    m_defaultReconnectDelayInitial = delayInitial;
+    m_defaultReconnectDelayMax = delayMax;
+    m_defaultReconnectJitter = jitter;
+}
+
+void CameraGridFrame::OnSetCameraDefaultPassthrough(wxCommandEvent& evt)
+{
+    m_defaultPassthrough = evt.IsChecked();
+}
+
+void CameraGridFrame::OnSetCameraDefaultRawFrames(wxCommandEvent& evt)
+{
+    m_defaultConvertRGB = !evt.IsChecked();
+}
+
+void CameraGridFrame::OnSetCameraDefaultGray16Window(wxCommandEvent&)
+{
+    long level = wxGetNumberFromUser("16-bit gray values are mapped to 8 bits from level - width / 2 (black)\n"
+                                     "to level + width / 2 (white), the center of the window is", "Number between 0 and 65535",
+                                     "Select default 16-bit gray window level",
+                                     m_defaultRawConversion.windowLevel,
+                                     0, 65535, this);
+
+    if ( level == -1 )
+        return;
+
+    long width = wxGetNumberFromUser("Width of the window (65536 = the full range)", "Number between 1 and 65536",
+                                     "Select default 16-bit gray window width",
+                                     m_defaultRawConversion.windowWidth,
+                                     1, 65536, this);
+
+    if ( width == -1 )
+        return;
+
+    m_defaultRawConversion.windowLevel = level;
+    m_defaultRawConversion.windowWidth = width;
+}
+
+void CameraGridFrame::OnSetCameraDefaultNativeImages(wxCommandEvent& evt)
+{
+    m_defaultNativeImages = evt.IsChecked();
+}
+
+void CameraGridFrame::OnSetCameraDefaultReplayBuffer(wxCommandEvent&)
+{
+    long duration = wxGetNumberFromUser("Keep the last seconds of frames in memory for replay (0 = off)", "Number between 0 and 300",
+                                        "Select default replay buffer duration",
+                                        m_defaultReplayDuration,
+                                        0, 300, this);
+
+    if ( duration == -1 )
+        return;
+
+    if ( duration == 0 )
+    {
+        m_defaultReplayDuration = 0;
+        return;
+    }
+
+    long maxMB = wxGetNumberFromUser("Memory budget of a camera's replay buffer in MB", "Number between 1 and 4096",
+                                     "Select default replay buffer size",
+                                     m_defaultReplayMaxMB,
+                                     1, 4096, this);
+
+    if ( maxMB == -1 )
+        return;
+
+    m_defaultReplayDuration = duration;
+    m_defaultReplayMaxMB = maxMB;
+}
+
+void CameraGridFrame::OnSetCameraDefaultQuietFrameStride(wxCommandEvent&)
+{
+    long stride = wxGetNumberFromUser("When a camera shows no motion for a while, process only every N-th frame\n"
+                                      "until it does (1 = always process all frames)", "Number between 1 and 100",
+                                      "Select default frame stride for quiet cameras",
+                                      m_defaultQuietFrameStride,
+                                      1, 100, this);
+
+    if ( stride != -1 )
+        m_defaultQuietFrameStride = stride;
+}
+
+void CameraGridFrame::OnSetCameraDefaultThreadScheduling(wxCommandEvent&)
+{
+    SelectThreadScheduling("Select default camera thread scheduling", m_defaultPriorityClass, m_defaultCPUAffinityMask);
+}
+
 void CameraGridFrame::OnCameraDefaultsReset(wxCommandEvent&)
 {
     wxMenuBar* menuBar = GetMenuBar();
@@ -346,6 +604,28 @@ void CameraGridFrame::OnCameraDefaultsReset(wxCommandEvent&)
     m_defaultCameraFPS = 0;
     m_defaultUseMJPGFourCC = false;
     menuBar->FindItem(ID_CAMERA_SET_DEFAULTS_USE_MJPEG_FOURCC)->Check(false);
+    m_defaultCameraOpenTimeout = ms_defaultCameraOpenTimeout;
+    m_defaultCameraReadTimeout = ms_defaultCameraReadTimeout;
+
+    const CameraSetupData defaultSetupData;
+
+    m_defaultReconnect = defaultSetupData.reconnect;
+    menuBar->FindItem(ID_CAMERA_SET_DEFAULTS_RECONNECT)->Check(m_defaultReconnect);
+    m_defaultReconnectDelayInitial = defaultSetupData.reconnectDelayInitial;
+    m_defaultReconnectDelayMax = defaultSetupData.reconnectDelayMax;
+    m_defaultReconnectJitter = defaultSetupData.reconnectJitter;
+    m_defaultPassthrough = defaultSetupData.passthrough;
+    menuBar->FindItem(ID_CAMERA_SET_DEFAULTS_PASSTHROUGH)->Check(m_defaultPassthrough);
+    m_defaultConvertRGB = defaultSetupData.convertRGB;
+    menuBar->FindItem(ID_CAMERA_SET_DEFAULTS_RAW_FRAMES)->Check(!m_defaultConvertRGB);
+    m_defaultRawConversion = defaultSetupData.rawConversion;
+    m_defaultNativeImages = defaultSetupData.nativeImages;
+    menuBar->FindItem(ID_CAMERA_SET_DEFAULTS_NATIVE_IMAGES)->Check(m_defaultNativeImages);
+    m_defaultReplayDuration = 0;
+    m_defaultReplayMaxMB = 64;
+    m_defaultQuietFrameStride = defaultSetupData.quietFrameStride;
+    m_defaultPriorityClass = defaultSetupData.priorityClass;
+    m_defaultCPUAffinityMask = defaultSetupData.cpuAffinityMask;
 }
 
 // if a camera thumbnail is doubleclicked, show the camera output
@@ -358,24 +638,41 @@ void CameraGridFrame::OnShowOneCameraFrame(wxMouseEvent& evt)
 
     wxCHECK_RET(cameraPanel, "in CameraGridFrame::OnShowOneCameraFrame() but event object is not CameraPanel");
 
-    const wxString cameraName = cameraPanel->GetCameraName();
+    CameraView* cameraView = GetCameraView(cameraPanel->GetCameraId());
 
-    OneCameraFrame* ocFrame = FindOneCameraFrameForCamera(cameraName);
+    wxCHECK_RET(cameraView, "in CameraGridFrame::OnShowOneCameraFrame() but camera not found");
 
-    if ( ocFrame )
+    if ( cameraView->oneCameraFrame )
     {
-        ocFrame->Raise();
+        cameraView->oneCameraFrame->Raise();
         return;
     }
 
     if ( cameraPanel->GetStatus() == CameraPanel::Error )
     {
-        wxLogMessage("Camera '%s' is in error state.", cameraName);
+        wxLogMessage("Camera '%s' is in error state.", cameraPanel->GetCameraName());
+        return;
+    }
+
+    if ( cameraView->source->passthrough )
+    {
+        wxLogMessage("Camera '%s' passes through compressed frames, enable decoding them in its popup menu first.", cameraPanel->GetCameraName());
         return;
     }
 
-    ocFrame = new OneCameraFrame(this, cameraPanel->GetCameraName());
-    ocFrame->Show();
+    // the highest degradation level sends only the thumbnails
+    if ( cameraView->source->degradationLevel > ms_governorMaxLevelShown )
+        SetCaptureSourceDegradationLevel(cameraView->source, ms_governorMaxLevelShown);
+
+    // a static scene would not send any frame to display
+    CameraCommandData commandData;
+
+    commandData.command = CameraCommandData::NeedFullFrame;
+    cameraView->source->commandDatas->Post(commandData);
+
+    cameraView->oneCameraFrame = new OneCameraFrame(this, cameraPanel->GetCameraId(), cameraPanel->GetCameraName(),
+                                                    cameraView->replayBuffer);
+    cameraView->oneCameraFrame->Show();
 }
 
 wxString GetCVPropName(cv::VideoCaptureProperties prop)
@@ -471,6 +768,27 @@ wxString GetCVPropName(cv::VideoCaptureProperties prop)
     return name;
 }
 
+// Returns the camera name usable as the start of a file name on all platforms.
+// Names such as "CAM #1" are not nice in file names, so spaces and '#' are removed.
+wxString GetFileNamePrefix(const wxString& cameraName)
+{
+    const wxString invalidChars("<>:\"/\\|?*");
+    wxString       prefix;
+
+    for ( const auto& c : cameraName )
+    {
+        if ( c == ' ' || c == '#' )
+            continue;
+
+        if ( c.GetValue() < 32 || invalidChars.Find(c) != wxNOT_FOUND )
+            prefix += '_';
+        else
+            prefix += c;
+    }
+
+    return prefix;
+}
+
 void CameraGridFrame::OnCameraContextMenu(wxContextMenuEvent& evt)
 {
     CameraPanel* cameraPanel = dynamic_cast<CameraPanel*>(evt.GetEventObject());
@@ -480,9 +798,9 @@ void CameraGridFrame::OnCameraContextMenu(wxContextMenuEvent& evt)
 
     wxCHECK_RET(cameraPanel, "in CameraGridFrame::OnCameraContextMenu() but could not determine the thumbnail panel");
 
-    auto  it = m_cameras.find(cameraPanel->GetCameraName());
+    CameraView* cameraView = GetCameraView(cameraPanel->GetCameraId());
 
-    if ( it == m_cameras.end() || !it->second.thread->IsCapturing() )
+    if ( !cameraView || !cameraView->source->thread->IsCapturing() )
         return;
 
 
@@ -491,33 +809,71 @@ void CameraGridFrame::OnCameraContextMenu(wxContextMenuEvent& evt)
 
     menu.Append(ID_CAMERA_GET_INFO, "Get Camera Information");
     menu.Append(ID_CAMERA_SET_THREAD_SLEEP_DURATION, "Set Thread Sleep duration...");
+    menu.Append(ID_CAMERA_SET_THREAD_SCHEDULING, "Set Thread Priority and CPU Affinity...");
     menu.Append(ID_CAMERA_GET_VCPROP, "Get VideoCapture Property...");
     menu.Append(ID_CAMERA_SET_VCPROP, "Set VideoCapture Property...");
+    menu.AppendSeparator();
+    menu.AppendCheckItem(ID_CAMERA_DECODE_FRAMES, "Decode Frames");
+    menu.Check(ID_CAMERA_DECODE_FRAMES, !cameraView->source->passthrough);
+    if ( cameraView->recording )
+        menu.Append(ID_CAMERA_STOP_RECORDING, "Stop Recording");
+    else
+        menu.Append(ID_CAMERA_START_RECORDING, "Start Recording...");
+    if ( cameraView->source->journaling )
+        menu.Append(ID_CAMERA_STOP_JOURNAL, "Stop Raw Frame Journal");
+    else
+        menu.Append(ID_CAMERA_START_JOURNAL, "Start Raw Frame Journal...");
+    menu.AppendCheckItem(ID_CAMERA_EXPORT_SHARED_MEMORY, "Export Frames to Shared Memory");
+    menu.Check(ID_CAMERA_EXPORT_SHARED_MEMORY, cameraView->sharedMemoryExporter != nullptr);
+    // compressed frames are not exported
+    menu.Enable(ID_CAMERA_EXPORT_SHARED_MEMORY, cameraView->sharedMemoryExporter || !cameraView->source->passthrough);
 
     id = cameraPanel->GetPopupMenuSelectionFromUser(menu);
     if ( id == wxID_NONE )
         return;
 
     CameraCommandData commandData;
+    // the thread settings apply to all the cameras sharing the source
+    const size_t      sourceCameraCount = cameraView->source->cameraIds.size();
+    const wxString    sharedSourceNote = sourceCameraCount > 1
+                                         ? wxString::Format(" (capture shared by %zu cameras)", sourceCameraCount) : wxString();
 
     if ( id == ID_CAMERA_GET_INFO )
     {
         commandData.command = CameraCommandData::GetCameraInfo;
-        it->second.commandDatas->Post(commandData);
+        cameraView->source->commandDatas->Post(commandData);
     }
     else if ( id == ID_CAMERA_SET_THREAD_SLEEP_DURATION )
     {
-        long duration = wxGetNumberFromUser("Sleep duration in ms", "Number between 0 (no sleep) and 1000",
-                                            "Select default CameraThread sleep duration",
-                                            m_defaultCameraThreadSleepDurationInMs,
-                                            0, 1000, this);
+        const long currentDuration = cameraView->source->sleepDuration >= 0
+                                     ? cameraView->source->sleepDuration : m_defaultCameraThreadSleepDurationInMs;
+        long       duration = wxGetNumberFromUser("Sleep duration in ms", "Number between 0 (no sleep) and 1000",
+                                                  "Select CameraThread sleep duration" + sharedSourceNote,
+                                                  currentDuration, 0, 1000, this);
 
         if ( duration == -1 )
             return;
 
         commandData.command = CameraCommandData::SetThreadSleepDuration;
         commandData.parameter = duration;
-        it->second.commandDatas->Post(commandData);
+        cameraView->source->commandDatas->Post(commandData);
+    }
+    else if ( id == ID_CAMERA_SET_THREAD_SCHEDULING )
+    {
+        CameraCommandData::ThreadSchedulingParameter parameter;
+
+        parameter.priorityClass   = cameraView->source->priorityClass;
+        parameter.cpuAffinityMask = cameraView->source->cpuAffinityMask;
+
+        if ( !SelectThreadScheduling(wxString::Format("Select thread scheduling of camera '%s'", cameraView->name) + sharedSourceNote,
+                                     parameter.priorityClass, parameter.cpuAffinityMask) )
+        {
+            return;
+        }
+
+        commandData.command = CameraCommandData::SetThreadScheduling;
+        commandData.parameter = parameter;
+        cameraView->source->commandDatas->Post(commandData);
     }
     else if ( id == ID_CAMERA_GET_VCPROP )
     {
@@ -535,7 +891,7 @@ void CameraGridFrame::OnCameraContextMenu(wxContextMenuEvent& evt)
         params.push_back(param);
         commandData.parameter = params;
 
-        it->second.commandDatas->Post(commandData);
+        cameraView->source->commandDatas->Post(commandData);
     }
     else if ( id == ID_CAMERA_SET_VCPROP )
     {
@@ -568,7 +924,103 @@ void CameraGridFrame::OnCameraContextMenu(wxContextMenuEvent& evt)
         params.push_back(param);
         commandData.parameter = params;
 
-        it->second.commandDatas->Post(commandData);
+        cameraView->source->commandDatas->Post(commandData);
+    }
+    else if ( id == ID_CAMERA_START_RECORDING )
+    {
+        const wxString directory = wxDirSelector("Select Directory for Recordings", m_recordingDirectory,
+                                                 wxDD_DEFAULT_STYLE, wxDefaultPosition, this);
+
+        if ( directory.empty() )
+            return;
+
+        const long duration = wxGetNumberFromUser("Segment duration in minutes", "Number between 0 (unlimited) and 1440",
+                                                  "Start Recording", m_recordingSegmentDuration, 0, 1440, this);
+
+        if ( duration == -1 )
+            return;
+
+        CameraCommandData::RecordingParameter parameter;
+
+        m_recordingDirectory       = directory;
+        m_recordingSegmentDuration = duration;
+
+        parameter.cameraId        = cameraPanel->GetCameraId();
+        parameter.directory       = directory;
+        parameter.fileNamePrefix  = GetFileNamePrefix(cameraView->name);
+        parameter.segmentDuration = duration * 60;
+
+        commandData.command = CameraCommandData::StartRecording;
+        commandData.parameter = parameter;
+        cameraView->source->commandDatas->Post(commandData);
+    }
+    else if ( id == ID_CAMERA_DECODE_FRAMES )
+    {
+        SetCaptureSourcePassthrough(cameraView->source, !cameraView->source->passthrough);
+    }
+    else if ( id == ID_CAMERA_STOP_RECORDING )
+    {
+        commandData.command = CameraCommandData::StopRecording;
+        commandData.parameter = cameraPanel->GetCameraId();
+        cameraView->source->commandDatas->Post(commandData);
+    }
+    else if ( id == ID_CAMERA_START_JOURNAL )
+    {
+        const wxString fileName = wxFileSelector("Select Raw Frame Journal File", m_journalDirectory,
+                                                 GetFileNamePrefix(cameraView->name) + ".journal", "journal",
+                                                 "Frame journals (*.journal)|*.journal",
+                                                 wxFD_SAVE | wxFD_OVERWRITE_PROMPT, this);
+
+        if ( fileName.empty() )
+            return;
+
+        const long sizeMB = wxGetNumberFromUser("Journal file size in MB, preallocated on disk\n(a 1080p frame takes about 6 MB)",
+                                                "Number between 16 and 65536",
+                                                "Start Raw Frame Journal", m_journalSizeMB, 16, 65536, this);
+
+        if ( sizeMB == -1 )
+            return;
+
+        CameraCommandData::JournalParameter parameter;
+
+        m_journalDirectory = wxFileName(fileName).GetPath();
+        m_journalSizeMB    = sizeMB;
+
+        parameter.fileName = fileName;
+        parameter.size     = wxULongLong(sizeMB) * 1024 * 1024;
+
+        commandData.command = CameraCommandData::StartJournal;
+        commandData.parameter = parameter;
+        cameraView->source->commandDatas->Post(commandData);
+    }
+    else if ( id == ID_CAMERA_STOP_JOURNAL )
+    {
+        commandData.command = CameraCommandData::StopJournal;
+        cameraView->source->commandDatas->Post(commandData);
+    }
+    else if ( id == ID_CAMERA_EXPORT_SHARED_MEMORY )
+    {
+        if ( cameraView->sharedMemoryExporter )
+        {
+            cameraView->sharedMemoryExporter->RequestStop();
+            ReapWorkerThread(cameraView->sharedMemoryExporter,
+                wxString::Format("Shared memory exporter for camera '%s'", cameraView->name));
+            cameraView->sharedMemoryExporter = nullptr;
+            wxLogMessage("Stopped exporting frames of camera '%s' to shared memory.", cameraView->name);
+            return;
+        }
+
+        // success is reported when the shared memory is created with the first frame,
+        // see OnSharedMemoryExportStarted() and OnSharedMemoryExportError()
+        cameraView->sharedMemoryExporter = new SharedMemoryExporter(m_frameBus, this, cameraPanel->GetCameraId(),
+                                                                    cameraView->name, cameraView->metrics);
+        if ( cameraView->sharedMemoryExporter->Run() != wxTHREAD_NO_ERROR )
+        {
+            wxLogError("Could not create the worker thread exporting frames of camera '%s' to shared memory.", cameraView->name);
+            delete cameraView->sharedMemoryExporter;
+            cameraView->sharedMemoryExporter = nullptr;
+            return;
+        }
     }
     else
     {
@@ -579,183 +1031,1017 @@ void CameraGridFrame::OnCameraContextMenu(wxContextMenuEvent& evt)
 void CameraGridFrame::OnUpdateInfo(wxTimerEvent&)
 {
     static wxULongLong prevFramesProcessed{0};
+    static wxUint64    prevGUIFrames{0}, prevGUIProcessTimeUs{0};
 
+    const ApplicationMetrics& applicationMetrics = m_metricsRegistry.GetApplicationMetrics();
     size_t camerasCapturing{0};
 
     for ( const auto& c : m_cameras )
     {
-        if ( c.second.thread->IsCapturing() )
+        if ( c.source && c.source->thread->IsCapturing() )
             camerasCapturing++;
     }
 
     SetStatusText(wxString::Format("%zu cameras (%zu capturing)",
-        m_cameras.size(), camerasCapturing), 0);
+        m_cameraCount, camerasCapturing), 0);
+
+    // The frames processed by the GUI thread in the last second and its average cost per frame.
+    // The former is not indicative of the maximum possible performance, it depends on how many
+    // cameras are there, on their fps and time to sleep in the thread and last but not least
+    // on the interval and resolution of m_processNewCameraFrameDataTimer. The latter allows
+    // comparing cameras with and without CameraSetupData::nativeImages.
+    const wxUint64 GUIFrames = CameraMetrics::Get(applicationMetrics.guiFramesProcessed);
+    const wxUint64 GUIProcessTimeUs = CameraMetrics::Get(applicationMetrics.guiProcessTimeUs);
+
+    SetStatusText(wxString::Format("%s frames processed by GUI in the last second (%.0f us per frame)",
+        (m_framesProcessed - prevFramesProcessed).ToString(),
+        GUIFrames > prevGUIFrames ? static_cast<double>(GUIProcessTimeUs - prevGUIProcessTimeUs) / (GUIFrames - prevGUIFrames) : 0.), 1);
+    prevGUIFrames        = GUIFrames;
+    prevGUIProcessTimeUs = GUIProcessTimeUs;
+
+    const wxUint64 frameMemoryBudget = m_frameMemoryBudget->GetBudget();
+
+    SetStatusText(wxString::Format("Frames in flight: %s (peak %s) of %s, %s dropped",
+        wxFileName::GetHumanReadableSize(wxULongLong(m_frameMemoryBudget->GetUsed()), "0 B"),
+        wxFileName::GetHumanReadableSize(wxULongLong(m_frameMemoryBudget->GetPeak()), "0 B"),
+        frameMemoryBudget > 0 ? wxFileName::GetHumanReadableSize(wxULongLong(frameMemoryBudget)) : wxString("unlimited"),
+        wxULongLong(m_frameMemoryBudget->GetFramesDropped()).ToString()), 2);
+
+#if WXOPENCVCAMERAS_TRACK_ALLOCATIONS
+    static wxUint64 prevCameraFrames{0}, prevCameraAllocations{0}, prevCameraAllocationBytes{0};
+    static wxUint64 prevGUIAllocations{0};
+
+    wxUint64 cameraFrames{0}, cameraAllocations{0}, cameraAllocationBytes{0};
+
+    // only cameras still present are included, so the numbers
+    // are not accurate in the second a camera is removed
+    for ( const auto& m : m_metricsRegistry.GetCameras() )
+    {
+        cameraFrames          += CameraMetrics::Get(m->framesCaptured);
+        cameraAllocations     += CameraMetrics::Get(m->allocationCount);
+        cameraAllocationBytes += CameraMetrics::Get(m->allocationBytes);
+    }
 
-    // This number is not indicative of the maximum possible performance.
-    // It depends on how many cameras are there, on their fps and time to sleep in the thread
-    // and last but not least on the interval and resolution of m_processNewCameraFrameDataTimer.
-    SetStatusText(wxString::Format("%s frames processed by GUI in the last second",
-        (m_framesProcessed - prevFramesProcessed).ToString()), 1);
+    const wxUint64 GUIAllocations = CameraMetrics::Get(applicationMetrics.guiAllocationCount);
+    const wxUint64 framesInLastSecond = cameraFrames - prevCameraFrames;
+    const wxUint64 processedInLastSecond = (m_framesProcessed - prevFramesProcessed).GetValue();
+
+    if ( framesInLastSecond > 0 && cameraFrames >= prevCameraFrames && cameraAllocations >= prevCameraAllocations )
+    {
+        SetStatusText(wxString::Format("Allocations per frame: camera threads %.1f (%.0f bytes), GUI %.1f",
+            static_cast<double>(cameraAllocations - prevCameraAllocations) / framesInLastSecond,
+            static_cast<double>(cameraAllocationBytes - prevCameraAllocationBytes) / framesInLastSecond,
+            processedInLastSecond > 0 ? static_cast<double>(GUIAllocations - prevGUIAllocations) / processedInLastSecond : 0.), 3);
+    }
+    else
+    {
+        SetStatusText("Allocations per frame: n/a", 3);
+    }
+
+    prevCameraFrames          = cameraFrames;
+    prevCameraAllocations     = cameraAllocations;
+    prevCameraAllocationBytes = cameraAllocationBytes;
+    prevGUIAllocations        = GUIAllocations;
+#endif // #if WXOPENCVCAMERAS_TRACK_ALLOCATIONS
 
     prevFramesProcessed = m_framesProcessed;
 }
 
-void CameraGridFrame::AddCamera(const wxString& address)
+void CameraGridFrame::OnSetMetricsFile(wxCommandEvent&)
 {
-    const wxSize thumbnailSize = wxSize(320, 180);
+    const wxString fileName = wxFileSelector("Select file to write metrics to (cancel to stop writing)",
+                                             wxEmptyString, m_metricsFileName, "prom",
+                                             "Prometheus text files (*.prom)|*.prom|All files|*",
+                                             wxFD_SAVE, this);
 
-    static int newCameraId = 0;
+    m_metricsFileName = fileName;
 
-    CameraView      cameraView;
-    wxString        cameraName = wxString::Format("CAM #%d", newCameraId++);
-    CameraSetupData cameraInitData;
+    if ( m_metricsFileName.empty() )
+    {
+        m_metricsFileTimer.Stop();
+        wxLogMessage("Metrics are no longer written to a file.");
+        return;
+    }
 
-    cameraInitData.name          = cameraName;
-    cameraInitData.address       = address;
-    cameraInitData.apiPreference = m_defaultCameraBackend;
-    cameraInitData.sleepDuration = m_defaultCameraThreadSleepDuration;
-    cameraInitData.frameSize     = m_defaultCameraResolution;
-    cameraInitData.FPS           = m_defaultCameraFPS;
-    cameraInitData.useMJPGFourCC = m_defaultUseMJPGFourCC;
+    m_metricsFileTimer.Start(m_metricsFileWriteInterval * 1000);
+    wxLogMessage("Metrics will be written every %ld seconds to '%s'.", m_metricsFileWriteInterval, m_metricsFileName);
+}
 
-    cameraInitData.eventSink     = this;
-    cameraInitData.frames        = &m_newCameraFrameData;
-    cameraInitData.framesCS      = &m_newCameraFrameDataCS;
-    cameraInitData.thumbnailSize = thumbnailSize;
+void CameraGridFrame::OnSetMetricsFileWriteInterval(wxCommandEvent&)
+{
+    long interval = wxGetNumberFromUser("Interval in seconds", "Number between 1 and 3600",
+                                        "Select metrics file write interval",
+                                        m_metricsFileWriteInterval,
+                                        1, 3600, this);
 
-    cameraInitData.commands      = new CameraCommandDatas;
+    if ( interval == -1 )
+        return;
 
-    cameraView.thread = new CameraThread(cameraInitData);
+    m_metricsFileWriteInterval = interval;
 
-    cameraView.thumbnailPanel = new CameraPanel(this, cameraName);
-    cameraView.thumbnailPanel->SetMinSize(thumbnailSize);
-    cameraView.thumbnailPanel->SetMaxSize(thumbnailSize);
-    cameraView.thumbnailPanel->Bind(wxEVT_LEFT_DCLICK, &CameraGridFrame::OnShowOneCameraFrame, this);
-    cameraView.thumbnailPanel->Bind(wxEVT_CONTEXT_MENU, &CameraGridFrame::OnCameraContextMenu, this);
-    GetSizer()->Add(cameraView.thumbnailPanel, wxSizerFlags().Border());
-    Layout();
+    if ( m_metricsFileTimer.IsRunning() )
+        m_metricsFileTimer.Start(m_metricsFileWriteInterval * 1000);
+}
 
-    cameraView.commandDatas = cameraInitData.commands;
+void CameraGridFrame::OnSetMetricsHTTPPort(wxCommandEvent&)
+{
+    long port = wxGetNumberFromUser("Port on localhost (0 = stop serving)", "Number between 0 and 65535",
+                                    "Serve metrics via HTTP",
+                                    m_metricsHTTPServer.IsRunning() ? m_metricsHTTPServer.GetPort() : 9101,
+                                    0, 65535, this);
 
-    m_cameras[cameraName] = cameraView;
+    if ( port == -1 )
+        return;
 
-    if ( cameraView.thread->Run() != wxTHREAD_NO_ERROR )
-        wxLogError("Could not create the worker thread needed to retrieve the images from camera '%s'.", cameraName);
+    if ( port == 0 )
+    {
+        m_metricsHTTPServer.Stop();
+        wxLogMessage("Metrics are no longer served via HTTP.");
+        return;
+    }
+
+    if ( m_metricsHTTPServer.Start(static_cast<unsigned short>(port)) )
+        wxLogMessage("Metrics are served at http://localhost:%ld/metrics.", port);
+    else
+        wxLogError("Could not serve metrics on port %ld.", port);
 }
 
-void CameraGridFrame::RemoveCamera(const wxString& cameraName)
+void CameraGridFrame::OnSetMJPEGServerPort(wxCommandEvent&)
 {
-    auto it = m_cameras.find(cameraName);
+    long port = wxGetNumberFromUser("Port (0 = stop streaming)", "Number between 0 and 65535",
+                                    "Stream cameras as MJPEG via HTTP",
+                                    m_mjpegServer ? m_mjpegServer->GetPort() : 8080,
+                                    0, 65535, this);
+
+    if ( port == -1 )
+        return;
 
-    wxCHECK_RET(it != m_cameras.end(), wxString::Format("Camera '%s' not found, could not be deleted.", cameraName));
+    StopMJPEGServer();
 
-    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Removing camera '%s'...", cameraName);
-    it->second.thread->Delete(nullptr, wxTHREAD_WAIT_BLOCK);
-    delete it->second.thread;
+    if ( port == 0 )
+    {
+        wxLogMessage("Cameras are no longer streamed via HTTP.");
+        return;
+    }
 
-    GetSizer()->Detach(it->second.thumbnailPanel);
-    it->second.thumbnailPanel->Destroy();
+    const bool localOnly = wxMessageBox("Accept connections only from this computer?\n"
+                                        "Choose No to allow viewing the cameras from other computers on the network.",
+                                        "Stream cameras as MJPEG via HTTP", wxYES_NO | wxICON_QUESTION, this) == wxYES;
+    wxString   errorMessage;
 
-    OneCameraFrame* ocFrame = FindOneCameraFrameForCamera(cameraName);
+    m_mjpegServer = new MJPEGServer(m_frameBus, static_cast<unsigned short>(port), localOnly);
 
-    if ( ocFrame )
+    if ( !m_mjpegServer->Listen(errorMessage) )
     {
-        ocFrame->Destroy();
-        wxLogTrace(TRACE_WXOPENCVCAMERAS, "Closed OneCameraFrame for camera '%s'.", cameraName);
+        wxLogError("Could not stream cameras on port %ld: %s", port, errorMessage);
+        delete m_mjpegServer;
+        m_mjpegServer = nullptr;
+        return;
     }
 
-    delete it->second.commandDatas;
+    for ( size_t i = 0; i < m_cameras.size(); ++i )
+    {
+        if ( m_cameras[i].source )
+            m_mjpegServer->AddCamera(static_cast<int>(i), m_cameras[i].name, m_cameras[i].metrics);
+    }
 
-    m_cameras.erase(it);
-    Layout();
-    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Removed camera '%s'.", cameraName);
+    if ( m_mjpegServer->Run() != wxTHREAD_NO_ERROR )
+    {
+        wxLogError("Could not create the worker thread for streaming cameras.");
+        delete m_mjpegServer;
+        m_mjpegServer = nullptr;
+        return;
+    }
+
+    wxLogMessage("Cameras are streamed at http://%s:%ld/.", localOnly ? wxString("localhost") : wxGetFullHostName(), port);
 }
 
-void CameraGridFrame::RemoveAllCameras()
+void CameraGridFrame::StopMJPEGServer()
 {
-    wxWindowUpdateLocker locker;
-
-    while ( !m_cameras.empty() )
-        RemoveCamera(wxString(m_cameras.begin()->first));
+    if ( !m_mjpegServer )
+        return;
 
-    m_cameras.clear();
-    Layout();
+    // the server closes its connections and stops its encoders before exiting,
+    // the camera thread reaper waits for it instead of the GUI thread
+    m_mjpegServer->RequestStop();
+    ReapWorkerThread(m_mjpegServer, wxString::Format("MJPEG server on port %hu", m_mjpegServer->GetPort()));
+    m_mjpegServer = nullptr;
 }
 
-void CameraGridFrame::OnProcessNewCameraFrameData(wxTimerEvent&)
+void CameraGridFrame::OnObjectDetection(wxCommandEvent&)
 {
-    CameraFrameDataPtrs frameData;
-    wxStopWatch         stopWatch;
+    if ( m_objectDetector )
+    {
+        StopObjectDetection();
+        wxLogMessage("Objects are no longer detected.");
+        return;
+    }
 
-    stopWatch.Start();
+    ObjectDetectorSettings settings;
+
+    settings.modelFile = wxFileSelector("Select the network model (e.g., MobileNet-SSD)", "", "", "",
+                                        "Network models (*.caffemodel;*.pb;*.onnx;*.weights)|*.caffemodel;*.pb;*.onnx;*.weights|All files|*",
+                                        wxFD_OPEN | wxFD_FILE_MUST_EXIST, this);
+    if ( settings.modelFile.empty() )
+        return;
+
+    // not needed for all model formats, so cancelling means none
+    settings.configFile = wxFileSelector("Select the network configuration, cancel if none", wxPathOnly(settings.modelFile), "", "",
+                                         "Network configurations (*.prototxt;*.pbtxt;*.cfg)|*.prototxt;*.pbtxt;*.cfg|All files|*",
+                                         wxFD_OPEN | wxFD_FILE_MUST_EXIST, this);
+
+    const wxString classNamesFile = wxFileSelector("Select a text file with class names (one per line), cancel if none",
+                                                   wxPathOnly(settings.modelFile), "", "",
+                                                   "Text files (*.txt;*.names)|*.txt;*.names|All files|*",
+                                                   wxFD_OPEN | wxFD_FILE_MUST_EXIST, this);
+
+    if ( !classNamesFile.empty() )
     {
-        wxCriticalSectionLocker locker(m_newCameraFrameDataCS);
+        wxTextFile textFile;
 
-        if ( m_newCameraFrameData.empty() )
+        if ( !textFile.Open(classNamesFile) )
             return;
 
-        frameData = std::move(m_newCameraFrameData);
+        for ( size_t i = 0; i < textFile.GetLineCount(); ++i )
+            settings.classNames.push_back(textFile[i].Strip(wxString::both));
     }
 
-    for ( const auto& fd : frameData )
-    {
-        const wxString   cameraName = fd->GetCameraName();
-        auto             it = m_cameras.find(cameraName);
+    const long interval = wxGetNumberFromUser("Interval between batches in ms", "Number between 10 and 10000",
+                                              "Detect objects", settings.interval, 10, 10000, this);
 
-        if ( it == m_cameras.end() || !it->second.thread->IsCapturing() )
-            continue; // ignore yet-unprocessed frames from removed or errored cameras
+    if ( interval == -1 )
+        return;
 
-        CameraPanel*     cameraThumbnailPanel = FindThumbnailPanelForCamera(cameraName);
-        const wxBitmap*  cameraFrame = fd->GetFrame();
-        const wxBitmap*  cameraFrameThumbnail = fd->GetThumbnail();
-        // capturedToProcessTime obviously depends on timer interval and resolution
-        const wxLongLong capturedToProcessTime = wxGetUTCTimeMillis() - fd->GetCapturedTime();
+    const long maxBatchSize = wxGetNumberFromUser("Maximum number of cameras in a batch", "Number between 1 and 256",
+                                                  "Detect objects", static_cast<long>(settings.maxBatchSize), 1, 256, this);
 
-        if ( !cameraFrame || !cameraFrame->IsOk() )
-        {
-            wxLogTrace(TRACE_WXOPENCVCAMERAS, "Frame with a null or invalid frame (camera '%s', frame #%s)!",
-                cameraName, fd->GetFrameNumber().ToString());
-            continue;
-        }
+    if ( maxBatchSize == -1 )
+        return;
 
-        if ( cameraThumbnailPanel )
-        {
-            if ( cameraFrameThumbnail && cameraFrameThumbnail->IsOk() )
-                cameraThumbnailPanel->SetBitmap(*cameraFrameThumbnail);
-            else
-                cameraThumbnailPanel->SetBitmap(wxBitmap(), CameraPanel::Error);
-        }
+    settings.interval     = interval;
+    settings.maxBatchSize = static_cast<size_t>(maxBatchSize);
 
-        OneCameraFrame* ocFrame = FindOneCameraFrameForCamera(cameraName);
+    wxString errorMessage;
 
-        if ( ocFrame )
-            ocFrame->SetCameraBitmap(*cameraFrame);
+    m_objectDetector = new ObjectDetector(m_frameBus, this, settings, m_metricsRegistry.GetApplicationMetrics());
 
-        m_framesProcessed++;
+    if ( !m_objectDetector->LoadModel(errorMessage) )
+    {
+        wxLogError("Could not load the network for detecting objects: %s", errorMessage);
+        delete m_objectDetector;
+        m_objectDetector = nullptr;
+        return;
+    }
 
-#if 0
-        wxLogTrace(TRACE_WXOPENCVCAMERAS, "Frame from camera '%s' for frame #%s with resolution %dx%d took %ld ms from capture to process"
-            " (OpenCV times: retrieve %ld ms, convert %ld ms, thumbnail %s ms).",
-            cameraName,
-            fd->GetFrameNumber().ToString(),
-            cameraFrame->GetWidth(), cameraFrame->GetHeight(),
+    if ( m_objectDetector->Run() != wxTHREAD_NO_ERROR )
+    {
+        wxLogError("Could not create the worker thread for detecting objects.");
+        delete m_objectDetector;
+        m_objectDetector = nullptr;
+        return;
+    }
+
+    wxLogMessage("Detecting objects every %ld ms in batches of up to %ld cameras.", interval, maxBatchSize);
+}
+
+void CameraGridFrame::StopObjectDetection()
+{
+    if ( !m_objectDetector )
+        return;
+
+    // the detector exits after the batch it is processing,
+    // the camera thread reaper waits for it instead of the GUI thread
+    m_objectDetector->RequestStop();
+    ReapWorkerThread(m_objectDetector, "Object detector");
+    m_objectDetector = nullptr;
+
+    // results from the last batch still queued are ignored, see OnObjectDetections()
+    for ( auto& camera : m_cameras )
+    {
+        if ( camera.thumbnailPanel )
+            camera.thumbnailPanel->SetOverlays(std::vector<CameraPanel::Overlay>());
+    }
+}
+
+void CameraGridFrame::OnObjectDetections(wxThreadEvent& evt)
+{
+    // the detector was stopped after sending the event
+    if ( !m_objectDetector )
+        return;
+
+    const ObjectDetectionResults  results = evt.GetPayload<ObjectDetectionResults>();
+    const ObjectDetectorSettings& settings = m_objectDetector->GetSettings();
+
+    for ( const auto& result : results )
+    {
+        CameraView* cameraView = GetCameraView(result.cameraId);
+
+        if ( !cameraView || !cameraView->thumbnailPanel )
+            continue;
+
+        std::vector<CameraPanel::Overlay> overlays;
+
+        for ( const auto& detection : result.detections )
+        {
+            CameraPanel::Overlay overlay;
+
+            overlay.x      = detection.box.x;
+            overlay.y      = detection.box.y;
+            overlay.width  = detection.box.width;
+            overlay.height = detection.box.height;
+            overlay.label.Printf("%s %.0f%%", ObjectDetector::GetClassName(settings, detection.classId), detection.confidence * 100);
+            overlays.push_back(overlay);
+        }
+
+        cameraView->thumbnailPanel->SetOverlays(overlays);
+    }
+}
+
+void CameraGridFrame::OnWriteMetricsFile(wxTimerEvent&)
+{
+    if ( m_metricsRegistry.WriteToFile(m_metricsFileName) )
+        return;
+
+    m_metricsFileTimer.Stop();
+    wxLogError("Could not write metrics to '%s', writing metrics stopped.", m_metricsFileName);
+}
+
+void CameraGridFrame::OnShowCameraCPU(wxCommandEvent&)
+{
+    if ( !m_cameraCPUDialog )
+        m_cameraCPUDialog = new CameraCPUDialog(this, m_metricsRegistry);
+
+    m_cameraCPUDialog->Show();
+    m_cameraCPUDialog->Raise();
+}
+
+// Compares the ways a camera thread can get a cv::Mat into a wxBitmap, with the frame
+// sizes cameras commonly have. The bitmap is only filled, the cost of drawing it
+// (e.g., creating a cairo surface from the GdkPixbuf on wxGTK 3) is not included.
+void CameraGridFrame::OnBenchmarkBitmapConversion(wxCommandEvent&)
+{
+    const wxSize sizes[] = { wxSize(640, 480), wxSize(1280, 720), wxSize(1920, 1080), wxSize(3840, 2160) };
+    const int    iterations = 20;
+
+    wxBusyCursor busyCursor;
+    wxString     results;
+
+    results.Printf("Time to convert a BGR frame to wxBitmap in ms (average of %d):\n\n", iterations);
+    results += "Size: pixel by pixel / in bulk / new bitmap + in bulk / created from Mat\n";
+
+    for ( const auto& size : sizes )
+    {
+        cv::Mat              matBitmap(size.GetHeight(), size.GetWidth(), CV_8UC3);
+        wxBitmap             bitmap(size, 24);
+        MatConversionOptions portableOptions;
+        double               times[4];
+
+        cv::randu(matBitmap, cv::Scalar::all(0), cv::Scalar::all(256));
+        portableOptions.portableOnly = true;
+
+        for ( size_t method = 0; method < WXSIZEOF(times); ++method )
+        {
+            wxStopWatch stopWatch;
+
+            // the first iteration only warms up
+            for ( int i = 0; i <= iterations; ++i )
+            {
+                if ( i == 1 )
+                    stopWatch.Start();
+
+                switch ( method )
+                {
+                    case 0:
+                        ConvertMatBitmapTowxBitmap(matBitmap, bitmap, portableOptions);
+                        break;
+                    case 1:
+                        ConvertMatBitmapTowxBitmap(matBitmap, bitmap);
+                        break;
+                    case 2:
+                    {
+                        wxBitmap newBitmap(size, 24);
+
+                        ConvertMatBitmapTowxBitmap(matBitmap, newBitmap);
+                        break;
+                    }
+                    case 3:
+                    {
+                        wxBitmap newBitmap;
+
+                        CreatewxBitmapFromMat(matBitmap, newBitmap);
+                        break;
+                    }
+                }
+            }
+            times[method] = stopWatch.TimeInMicro().ToDouble() / 1000. / iterations;
+        }
+
+        results += wxString::Format("%dx%d: %.2f / %.2f / %.2f / %.2f\n", size.GetWidth(), size.GetHeight(),
+                                    times[0], times[1], times[2], times[3]);
+    }
+
+    wxLogMessage(results);
+}
+
+void CameraGridFrame::OnInstrumentLocks(wxCommandEvent& evt)
+{
+    LockStats::Enable(evt.IsChecked());
+}
+
+void CameraGridFrame::OnShowLockStats(wxCommandEvent&)
+{
+    wxString summary = m_metricsRegistry.FormatLockStatsSummary();
+
+    if ( !LockStats::IsEnabled() )
+        summary.Prepend("Lock instrumentation is off, the statistics may be outdated.\n\n");
+
+    wxLogMessage(summary);
+}
+
+void CameraGridFrame::OnResetLockStats(wxCommandEvent&)
+{
+    m_metricsRegistry.ResetLockStats();
+}
+
+// Only the times updated by the camera threads are compared here,
+// so watching the cameras costs the threads nothing but an atomic store per frame.
+void CameraGridFrame::OnCheckStalledCameras(wxTimerEvent&)
+{
+    const wxLongLong now = wxGetUTCTimeMillis();
+
+    for ( auto& camera : m_cameras )
+    {
+        if ( !camera.source )
+            continue;
+
+        CameraMetrics& metrics = *camera.metrics;
+        const wxInt64  sinceLastFrame = now.GetValue() - CameraMetrics::Get(metrics.lastFrameTimeMs);
+        const wxInt64  stallTimeout = std::max(static_cast<wxInt64>(ms_stallMinTimeout),
+                                          ms_stallFrameIntervals * CameraMetrics::Get(metrics.expectedFrameIntervalMs));
+        // a reconnecting or failed camera is not stalled
+        const bool     stalled = camera.source->thread->IsCapturing() && sinceLastFrame > stallTimeout;
+
+        if ( stalled == camera.stalled )
+            continue;
+
+        camera.stalled = stalled;
+        CameraMetrics::Set(metrics.stalled, stalled ? 1 : 0);
+
+        if ( !stalled )
+        {
+            // the panels are set to Receiving by the frame which arrived,
+            // but no frames arrive from a camera passing them through
+            if ( camera.source->passthrough )
+                camera.thumbnailPanel->SetStatus(CameraPanel::Passthrough);
+            wxLogTrace(TRACE_WXOPENCVCAMERAS, "Camera '%s' is no longer stalled.", camera.name);
+            continue;
+        }
+
+        CameraMetrics::Add(metrics.stalls);
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "Camera '%s' stalled, no frame for %" wxLongLongFmtSpec "d ms.",
+            camera.name, sinceLastFrame);
+
+        camera.thumbnailPanel->SetStatus(CameraPanel::Stalled);
+        if ( camera.oneCameraFrame )
+            camera.oneCameraFrame->SetCameraStatus(CameraPanel::Stalled);
+
+        if ( m_reconnectStalledCameras )
+            camera.source->thread->RequestReconnect();
+    }
+}
+
+void CameraGridFrame::OnSetCPUGovernor(wxCommandEvent&)
+{
+    if ( GetProcessCPUTimeUs() < 0 )
+    {
+        wxLogError("The CPU time of the process cannot be obtained on this platform.");
+        return;
+    }
+
+    const long maxCPUPercent = wxGetNumberFromUser("Degrade the cameras when the application uses more CPU than (% of all CPUs, 0 = off)",
+                                                   "Number between 0 and 100", "CPU Governor",
+                                                   m_governorMaxCPUPercent, 0, 100, this);
+
+    if ( maxCPUPercent == -1 )
+        return;
+
+    m_governorMaxCPUPercent = maxCPUPercent;
+
+    if ( m_governorMaxCPUPercent > 0 )
+    {
+        wxTimerEvent timerEvent;
+
+        // the first check only takes the initial CPU times
+        m_governorLastProcessCPUUs = -1;
+        OnGovernCPU(timerEvent);
+        m_governorTimer.Start(ms_governorInterval);
+        return;
+    }
+
+    m_governorTimer.Stop();
+
+    for ( auto& camera : m_cameras )
+    {
+        if ( camera.source && camera.source->degradationLevel > 0 )
+            SetCaptureSourceDegradationLevel(camera.source, 0);
+    }
+}
+
+void CameraGridFrame::OnGovernCPU(wxTimerEvent&)
+{
+    const wxInt64    processCPUUs = GetProcessCPUTimeUs();
+    const wxLongLong now = wxGetUTCTimeMillis();
+    const wxInt64    previousProcessCPUUs = m_governorLastProcessCPUUs;
+    const wxInt64    elapsedUs = (now - m_governorLastTime).GetValue() * 1000;
+
+    m_governorLastProcessCPUUs = processCPUUs;
+    m_governorLastTime = now;
+
+    // the capture sources with what the governor needs to know about them
+    struct SourceLoad
+    {
+        CaptureSourcePtr source;
+        int              priority{0};
+        int              maxLevel{0};
+        wxUint64         cpuUs{0}; // consumed by the camera thread since the last check, without sleeping
+    };
+
+    std::vector<SourceLoad> loads;
+
+    for ( const auto& camera : m_cameras )
+    {
+        const CaptureSourcePtr& source = camera.source;
+
+        if ( !source
+             || std::find_if(loads.begin(), loads.end(), [&source](const SourceLoad& l) { return l.source == source; }) != loads.end() )
+        {
+            continue;
+        }
+
+        const CameraMetrics& metrics = *source->metrics;
+        const wxUint64       cpuUs = metrics.GetCPUTotalUs() - CameraMetrics::Get(metrics.cpuSleepUs);
+        SourceLoad           load;
+
+        load.source   = source;
+        load.priority = GetCaptureSourcePriority(*source, load.maxLevel);
+        load.cpuUs    = cpuUs - std::min(cpuUs, source->governorLastCPUUs);
+        source->governorLastCPUUs = cpuUs;
+
+        // passed through packets are not processed, so there is nothing to save
+        if ( source->thread->IsCapturing() && !source->passthrough )
+            loads.push_back(load);
+    }
+
+    if ( previousProcessCPUUs < 0 || processCPUUs < 0 || elapsedUs <= 0 )
+        return;
+
+    const long cpuPercent = static_cast<long>(100 * (processCPUUs - previousProcessCPUUs) / (elapsedUs * std::max(1, wxThread::GetCPUCount())));
+
+    CameraMetrics::Set(m_metricsRegistry.GetApplicationMetrics().processCpuPercent, cpuPercent);
+
+    if ( cpuPercent > m_governorMaxCPUPercent )
+    {
+        // The least important source is degraded first, and of those the least degraded one,
+        // so that all sources of the same importance are degraded evenly; from sources
+        // at the same level, the one consuming the most CPU is degraded.
+        auto degradeIt = loads.end();
+
+        for ( auto it = loads.begin(); it != loads.end(); ++it )
+        {
+            if ( it->source->degradationLevel >= it->maxLevel )
+                continue;
+
+            if ( degradeIt == loads.end()
+                 || it->priority < degradeIt->priority
+                 || (it->priority == degradeIt->priority && it->source->degradationLevel < degradeIt->source->degradationLevel)
+                 || (it->priority == degradeIt->priority && it->source->degradationLevel == degradeIt->source->degradationLevel
+                     && it->cpuUs > degradeIt->cpuUs) )
+            {
+                degradeIt = it;
+            }
+        }
+
+        if ( degradeIt == loads.end() )
+            return;
+
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "CPU governor: the application uses %ld%% of CPU, degrading camera '%s'.",
+                   cpuPercent, degradeIt->source->thread->GetCameraName());
+        SetCaptureSourceDegradationLevel(degradeIt->source, degradeIt->source->degradationLevel + 1);
+        CameraMetrics::Add(m_metricsRegistry.GetApplicationMetrics().governorDegradations);
+    }
+    else if ( cpuPercent < m_governorMaxCPUPercent * ms_governorRestorePercent / 100 )
+    {
+        // in the reverse order: the most important and the most degraded source first
+        auto restoreIt = loads.end();
+
+        for ( auto it = loads.begin(); it != loads.end(); ++it )
+        {
+            if ( it->source->degradationLevel == 0 )
+                continue;
+
+            if ( restoreIt == loads.end()
+                 || it->priority > restoreIt->priority
+                 || (it->priority == restoreIt->priority && it->source->degradationLevel > restoreIt->source->degradationLevel) )
+            {
+                restoreIt = it;
+            }
+        }
+
+        if ( restoreIt == loads.end() )
+            return;
+
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "CPU governor: the application uses %ld%% of CPU, restoring camera '%s'.",
+                   cpuPercent, restoreIt->source->thread->GetCameraName());
+        SetCaptureSourceDegradationLevel(restoreIt->source, restoreIt->source->degradationLevel - 1);
+        CameraMetrics::Add(m_metricsRegistry.GetApplicationMetrics().governorRestorations);
+    }
+}
+
+void CameraGridFrame::AddCamera(const wxString& address)
+{
+    const wxSize thumbnailSize = wxSize(320, 180);
+
+    const int       cameraId = static_cast<int>(m_cameras.size());
+    CameraView      cameraView;
+    wxString        cameraName = wxString::Format("CAM #%d", cameraId);
+    CameraSetupData cameraInitData;
+
+    cameraInitData.id            = cameraId;
+    cameraInitData.name          = cameraName;
+    cameraInitData.address       = address;
+    cameraInitData.apiPreference = m_defaultCameraBackend;
+    cameraInitData.sleepDuration = m_defaultCameraThreadSleepDuration;
+    cameraInitData.frameSize     = m_defaultCameraResolution;
+    cameraInitData.FPS           = m_defaultCameraFPS;
+    cameraInitData.useMJPGFourCC = m_defaultUseMJPGFourCC;
+    cameraInitData.openTimeout   = m_defaultCameraOpenTimeout;
+    cameraInitData.readTimeout   = m_defaultCameraReadTimeout;
+    cameraInitData.reconnect     = m_defaultReconnect;
+    cameraInitData.reconnectDelayInitial = m_defaultReconnectDelayInitial;
+    cameraInitData.reconnectDelayMax     = m_defaultReconnectDelayMax;
+    cameraInitData.reconnectJitter       = m_defaultReconnectJitter;
+    cameraInitData.passthrough           = m_defaultPassthrough;
+    cameraInitData.convertRGB            = m_defaultConvertRGB;
+    cameraInitData.rawConversion         = m_defaultRawConversion;
+    cameraInitData.nativeImages          = m_defaultNativeImages;
+    cameraInitData.quietFrameStride      = m_defaultQuietFrameStride;
+    cameraInitData.priorityClass         = m_defaultPriorityClass;
+    cameraInitData.cpuAffinityMask       = m_defaultCPUAffinityMask;
+
+    cameraInitData.eventSink     = this;
+    cameraInitData.frames        = &m_newCameraFrameData;
+    cameraInitData.framesCS      = &m_newCameraFrameDataCS;
+    cameraInitData.frameBus      = &m_frameBus;
+    cameraInitData.frameMemoryBudget = m_frameMemoryBudget;
+    cameraInitData.thumbnailSize = thumbnailSize;
+
+    cameraInitData.metrics       = m_metricsRegistry.AddCamera(cameraName, address);
+
+    CaptureSourcePtr sharedSource = FindCaptureSource(cameraInitData);
+    bool             runThread = false;
+
+    if ( sharedSource )
+    {
+        // the address is already open with the same settings,
+        // just start sending its frames to the new camera too
+        CameraCommandData commandData;
+        CameraOutput      output;
+
+        output.id            = cameraId;
+        output.name          = cameraName;
+        output.thumbnailSize = thumbnailSize;
+        output.metrics       = cameraInitData.metrics;
+
+        commandData.command   = CameraCommandData::AddOutput;
+        commandData.parameter = output;
+        sharedSource->commandDatas->Post(commandData);
+
+        cameraView.source = sharedSource;
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "Camera '%s' shares the capture source of camera '%s'.",
+            cameraName, cameraView.source->thread->GetCameraName());
+    }
+    else
+    {
+        cameraInitData.commands = new CameraCommandDatas;
+
+        cameraView.source.reset(new CaptureSource);
+        cameraView.source->id           = cameraId;
+        cameraView.source->key          = GetCaptureSourceKey(cameraInitData);
+        cameraView.source->thread       = new CameraThread(cameraInitData);
+        cameraView.source->commandDatas = cameraInitData.commands;
+        cameraView.source->metrics      = cameraInitData.metrics;
+        cameraView.source->passthrough  = cameraInitData.passthrough;
+        cameraView.source->sleepDuration   = cameraInitData.sleepDuration;
+        cameraView.source->priorityClass   = cameraInitData.priorityClass;
+        cameraView.source->cpuAffinityMask = cameraInitData.cpuAffinityMask;
+        m_captureSources[cameraId] = cameraView.source;
+        runThread = true;
+    }
+
+    cameraView.source->cameraIds.push_back(cameraId);
+    cameraView.name = cameraName;
+
+    cameraView.thumbnailPanel = new CameraPanel(this, cameraId, cameraName);
+    cameraView.thumbnailPanel->SetMinSize(thumbnailSize);
+    cameraView.thumbnailPanel->SetMaxSize(thumbnailSize);
+    cameraView.thumbnailPanel->SetDegradationLevel(cameraView.source->degradationLevel);
+    cameraView.thumbnailPanel->Bind(wxEVT_LEFT_DCLICK, &CameraGridFrame::OnShowOneCameraFrame, this);
+    cameraView.thumbnailPanel->Bind(wxEVT_CONTEXT_MENU, &CameraGridFrame::OnCameraContextMenu, this);
+    GetSizer()->Add(cameraView.thumbnailPanel, wxSizerFlags().Border());
+    Layout();
+
+    cameraView.metrics = cameraInitData.metrics;
+
+    if ( m_defaultReplayDuration > 0 )
+    {
+        cameraView.replayBuffer.reset(new ReplayBuffer(m_defaultReplayDuration * 1000,
+                                                       static_cast<size_t>(m_defaultReplayMaxMB) * 1024 * 1024,
+                                                       cameraView.metrics));
+        cameraView.replayEncoder = new ReplayEncoder(m_frameBus, cameraId, cameraName,
+                                                     cameraView.replayBuffer, cameraView.metrics);
+        if ( cameraView.replayEncoder->Run() != wxTHREAD_NO_ERROR )
+        {
+            wxLogError("Could not create the worker thread for the replay buffer of camera '%s'.", cameraName);
+            delete cameraView.replayEncoder;
+            cameraView.replayEncoder = nullptr;
+            cameraView.replayBuffer.reset();
+        }
+    }
+
+    m_cameras.push_back(cameraView);
+    m_cameraCount++;
+
+    if ( m_mjpegServer )
+        m_mjpegServer->AddCamera(cameraId, cameraName, cameraView.metrics);
+
+    if ( runThread && cameraView.source->thread->Run() != wxTHREAD_NO_ERROR )
+        wxLogError("Could not create the worker thread needed to retrieve the images from camera '%s'.", cameraName);
+}
+
+void CameraGridFrame::RemoveCamera(int cameraId)
+{
+    CameraView* cameraView = GetCameraView(cameraId);
+
+    wxCHECK_RET(cameraView, wxString::Format("Camera with id %d not found, could not be deleted.", cameraId));
+
+    const wxString   cameraName = cameraView->name;
+    CaptureSourcePtr source = cameraView->source;
+
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Removing camera '%s'...", cameraName);
+
+    source->cameraIds.erase(std::remove(source->cameraIds.begin(), source->cameraIds.end(), cameraId),
+                            source->cameraIds.end());
+
+    if ( !source->cameraIds.empty() )
+    {
+        // other cameras still use the source
+        CameraCommandData commandData;
+
+        commandData.command   = CameraCommandData::RemoveOutput;
+        commandData.parameter = cameraId;
+        source->commandDatas->Post(commandData);
+    }
+    else
+    {
+        // the thread may be blocked in OpenCV for as long as the read timeout,
+        // so do not wait for it here
+        source->thread->RequestStop();
+        if ( m_cameraThreadReaper )
+        {
+            m_cameraThreadReaper->Reap(source->thread, source->commandDatas);
+        }
+        else
+        {
+            source->thread->Wait(wxTHREAD_WAIT_BLOCK);
+            delete source->thread;
+            delete source->commandDatas;
+        }
+
+        m_captureSources.erase(source->id);
+        m_metricsRegistry.RemoveCamera(source->metrics);
+    }
+
+    if ( cameraView->replayEncoder )
+    {
+        // the encoder exits after the frame it is compressing,
+        // the buffer itself lives while OneCameraFrame uses it
+        cameraView->replayEncoder->RequestStop();
+        ReapWorkerThread(cameraView->replayEncoder, wxString::Format("Replay encoder for camera '%s'", cameraName));
+    }
+
+    if ( cameraView->sharedMemoryExporter )
+    {
+        cameraView->sharedMemoryExporter->RequestStop();
+        ReapWorkerThread(cameraView->sharedMemoryExporter, wxString::Format("Shared memory exporter for camera '%s'", cameraName));
+    }
+
+    if ( m_mjpegServer )
+        m_mjpegServer->RemoveCamera(cameraId);
+
+    cameraView->framePool.Clear();
+    cameraView->thumbnailPool.Clear();
+
+    GetSizer()->Detach(cameraView->thumbnailPanel);
+    cameraView->thumbnailPanel->Destroy();
+
+    if ( cameraView->oneCameraFrame )
+    {
+        cameraView->oneCameraFrame->Destroy();
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "Closed OneCameraFrame for camera '%s'.", cameraName);
+    }
+
+    // the metrics of the camera which opened the source
+    // are kept while the source is open
+    if ( cameraView->metrics != source->metrics )
+        m_metricsRegistry.RemoveCamera(cameraView->metrics);
+
+    // the id stays reserved, so that frames still queued
+    // from the removed camera are recognized as such
+    *cameraView = CameraView();
+    m_cameraCount--;
+
+    Layout();
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Removed camera '%s'.", cameraName);
+}
+
+void CameraGridFrame::RemoveAllCameras()
+{
+    wxWindowUpdateLocker locker;
+
+    // ask all the threads to stop first, so that they can
+    // finish at the same time instead of one after another
+    for ( auto& source : m_captureSources )
+        source.second->thread->RequestStop();
+    for ( auto& camera : m_cameras )
+    {
+        if ( camera.replayEncoder )
+            camera.replayEncoder->RequestStop();
+        if ( camera.sharedMemoryExporter )
+            camera.sharedMemoryExporter->RequestStop();
+    }
+
+    for ( size_t i = 0; i < m_cameras.size(); ++i )
+    {
+        if ( m_cameras[i].source )
+            RemoveCamera(static_cast<int>(i));
+    }
+
+    Layout();
+}
+
+void CameraGridFrame::OnProcessNewCameraFrameData(wxTimerEvent&)
+{
+    CameraFrameDataPtrs    frameData;
+    wxStopWatch            stopWatch;
+    const AllocationCounts allocationsAtStart = GetCurrentThreadAllocationCounts();
+
+    stopWatch.Start();
+    {
+        InstrumentedCriticalSectionLocker locker(m_newCameraFrameDataCS);
+
+        if ( m_newCameraFrameData.empty() )
+            return;
+
+        frameData = std::move(m_newCameraFrameData);
+    }
+
+    ApplicationMetrics& applicationMetrics = m_metricsRegistry.GetApplicationMetrics();
+
+    CameraMetrics::Set(applicationMetrics.guiQueueDepth, frameData.size());
+
+    for ( const auto& fd : frameData )
+    {
+        CameraView* cameraView = GetCameraView(fd->GetCameraId());
+
+        if ( !cameraView )
+        {
+            CameraMetrics::Add(applicationMetrics.guiFramesDiscarded);
+            continue; // ignore yet-unprocessed frames from removed cameras
+        }
+
+        CameraMetrics& metrics = *cameraView->metrics;
+
+        CameraMetrics::Add(metrics.framesPending, -1);
+
+        if ( !cameraView->source->thread->IsCapturing() )
+        {
+            CameraMetrics::Add(metrics.framesDropped);
+            continue; // ignore yet-unprocessed frames from errored cameras
+        }
+
+        CameraPanel*     cameraThumbnailPanel = cameraView->thumbnailPanel;
+        const wxBitmap*  cameraFrame = fd->GetFrame();
+        const wxBitmap*  cameraFrameThumbnail = fd->GetThumbnail();
+        // capturedToProcessTime obviously depends on timer interval and resolution
+        const wxLongLong capturedToProcessTime = wxGetUTCTimeMillis() - fd->GetCapturedTime();
+        // with CameraSetupData::nativeImages, from the camera's pools
+        wxBitmap         pooledFrame, pooledThumbnail;
+
+        if ( fd->GetThumbnailImage() )
+        {
+            pooledThumbnail = GetPooledBitmap(cameraView->thumbnailPool, *fd->GetThumbnailImage());
+            cameraFrameThumbnail = &pooledThumbnail;
+        }
+        // the full frame is copied only when shown
+        if ( fd->GetFrameImage() && cameraView->oneCameraFrame )
+        {
+            pooledFrame = GetPooledBitmap(cameraView->framePool, *fd->GetFrameImage());
+            cameraFrame = &pooledFrame;
+        }
+
+        // at the highest degradation level, only the thumbnail is sent
+        const bool       hasFrame = (cameraFrame && cameraFrame->IsOk()) || fd->GetFrameImage();
+
+        if ( !hasFrame && (!cameraFrameThumbnail || !cameraFrameThumbnail->IsOk()) )
+        {
+            wxLogTrace(TRACE_WXOPENCVCAMERAS, "Frame with a null or invalid frame (camera '%s', frame #%s)!",
+                cameraView->name, fd->GetFrameNumber().ToString());
+            CameraMetrics::Add(metrics.framesDropped);
+            continue;
+        }
+
+        cameraView->motion = fd->GetMotionScore() >= 0 && !fd->IsQuiet();
+
+        if ( cameraThumbnailPanel )
+        {
+            cameraThumbnailPanel->SetMotion(cameraView->motion);
+
+            if ( cameraFrameThumbnail && cameraFrameThumbnail->IsOk() )
+                cameraThumbnailPanel->SetBitmap(*cameraFrameThumbnail);
+            else
+                cameraThumbnailPanel->SetBitmap(wxBitmap(), CameraPanel::Error);
+        }
+
+        if ( cameraView->oneCameraFrame && cameraFrame && cameraFrame->IsOk() )
+            cameraView->oneCameraFrame->SetCameraBitmap(*cameraFrame);
+
+        m_framesProcessed++;
+        CameraMetrics::Add(metrics.framesDisplayed);
+
+#if 0
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "Frame from camera '%s' for frame #%s with resolution %dx%d took %ld ms from capture to process"
+            " (OpenCV times: retrieve %ld ms, convert %ld ms, thumbnail %s ms).",
+            cameraView->name,
+            fd->GetFrameNumber().ToString(),
+            cameraFrame->GetWidth(), cameraFrame->GetHeight(),
             capturedToProcessTime.ToLong(),
             fd->GetTimeToRetrieve(), fd->GetTimeToConvert(),
             cameraFrameThumbnail ? wxString::Format("%ld", fd->GetTimeToCreateThumbnail()) : "n/a");
 #endif
     }
 
-    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Processed %zu new camera frames in %ld ms.", frameData.size(), stopWatch.Time());
+    const size_t framesProcessed = frameData.size();
 
+    // releasing the frames' bitmaps is a part of the cost too
     frameData.clear();
+
+    const wxLongLong       processTimeUs = stopWatch.TimeInMicro();
+    const AllocationCounts allocationsAtEnd = GetCurrentThreadAllocationCounts();
+
+    CameraMetrics::Add(applicationMetrics.guiFramesProcessed, framesProcessed);
+    CameraMetrics::Add(applicationMetrics.guiProcessTimeUs, processTimeUs.GetValue());
+    CameraMetrics::Add(applicationMetrics.guiAllocationCount, allocationsAtEnd.count - allocationsAtStart.count);
+    CameraMetrics::Add(applicationMetrics.guiAllocationBytes, allocationsAtEnd.bytes - allocationsAtStart.bytes);
+
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Processed %zu new camera frames in %s us.", framesProcessed, processTimeUs.ToString());
 }
 
 void CameraGridFrame::OnCameraCaptureStarted(CameraEvent& evt)
 {
-    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Started capturing from camera '%s' (fps: %s, backend: %s)'.",
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Started capturing from camera '%s' (fps: %s, backend: %s%s)'.",
         evt.GetCameraName(),
         evt.GetInt() ? wxString::Format("%d", evt.GetInt()) : "n/a",
-        evt.GetString());
+        evt.GetString(), evt.GetExtraLong() ? ", passthrough" : "");
+
+    // no frames come to display
+    if ( evt.GetExtraLong() )
+    {
+        for ( auto cameraView : GetCameraViewsForSource(evt.GetCameraId()) )
+        {
+            cameraView->thumbnailPanel->SetBitmap(wxBitmap(), CameraPanel::Passthrough);
+            if ( cameraView->oneCameraFrame )
+                cameraView->oneCameraFrame->Close();
+        }
+    }
+}
+
+void CameraGridFrame::OnCameraReconnecting(CameraEvent& evt)
+{
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Connection to camera '%s' lost, reconnecting...", evt.GetCameraName());
+
+    for ( auto cameraView : GetCameraViewsForSource(evt.GetCameraId()) )
+    {
+        cameraView->thumbnailPanel->SetStatus(CameraPanel::Reconnecting);
+
+        if ( cameraView->oneCameraFrame )
+            cameraView->oneCameraFrame->SetCameraStatus(CameraPanel::Reconnecting);
+    }
+}
+
+void CameraGridFrame::OnCameraReconnected(CameraEvent& evt)
+{
+    // the panels switch to Receiving with the next frame
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Reconnected to camera '%s' in %ld ms.", evt.GetCameraName(), evt.GetExtraLong());
 }
 
 void CameraGridFrame::OnCameraCommandResult(CameraEvent& evt)
@@ -789,6 +2075,25 @@ void CameraGridFrame::OnCameraCommandResult(CameraEvent& evt)
         infoMessage += "  Frames captured: " + cameraInfo.framesCapturedCount.ToString()  + "\n";;
         infoMessage += "  Backend name: " + cameraInfo.cameraCaptureBackendName + "\n";
         infoMessage += "  Address: " + cameraInfo.cameraAddress + "\n";
+
+        if ( cameraInfo.allocationsTracked && cameraInfo.framesCapturedCount > 0 )
+        {
+            infoMessage += wxString::Format("  Allocations per frame: %.1f (%.0f bytes)\n",
+                cameraInfo.allocationCount.ToDouble() / cameraInfo.framesCapturedCount.ToDouble(),
+                cameraInfo.allocationBytes.ToDouble() / cameraInfo.framesCapturedCount.ToDouble());
+        }
+
+        infoMessage += wxString::Format("  Thread priority: %s, CPUs: %s\n",
+            GetThreadPriorityClassName(cameraInfo.priorityClass),
+            cameraInfo.cpuAffinityMask ? FormatCPUList(cameraInfo.cpuAffinityMask) : std::string("any"));
+
+        if ( cameraInfo.cpuTimeAvailable )
+        {
+            infoMessage += wxString::Format("  Thread CPU time (ms): retrieve %.0f, convert %.0f, thumbnail %.0f, sleep %.0f, other %.0f\n",
+                cameraInfo.cpuTimeRetrieveUs.ToDouble() / 1000., cameraInfo.cpuTimeConvertUs.ToDouble() / 1000.,
+                cameraInfo.cpuTimeThumbnailUs.ToDouble() / 1000., cameraInfo.cpuTimeSleepUs.ToDouble() / 1000.,
+                cameraInfo.cpuTimeOtherUs.ToDouble() / 1000.);
+        }
     }
     else if ( commandData.command == CameraCommandData::SetThreadSleepDuration )
     {
@@ -796,8 +2101,100 @@ void CameraGridFrame::OnCameraCommandResult(CameraEvent& evt)
 
         commandData.parameter.GetAs(&duration);
 
+        const auto sourceIt = m_captureSources.find(evt.GetCameraId());
+
+        // new cameras share the source only with the same settings
+        if ( sourceIt != m_captureSources.end() )
+            sourceIt->second->sleepDuration = duration;
+
         infoMessage.Printf("Thread sleep duration for camera '%s' was set to %ld:\n.", evt.GetCameraName(), duration);
     }
+    else if ( commandData.command == CameraCommandData::SetThreadScheduling )
+    {
+        CameraCommandData::ThreadSchedulingParameter parameter;
+
+        commandData.parameter.GetAs(&parameter);
+
+        if ( !parameter.succeeded )
+        {
+            wxLogError("Could not set the priority and CPU affinity of the thread of camera '%s': %s",
+                       evt.GetCameraName(), parameter.errorMessage);
+            return;
+        }
+
+        const auto sourceIt = m_captureSources.find(evt.GetCameraId());
+
+        if ( sourceIt != m_captureSources.end() )
+        {
+            sourceIt->second->priorityClass   = parameter.priorityClass;
+            sourceIt->second->cpuAffinityMask = parameter.cpuAffinityMask;
+        }
+
+        infoMessage.Printf("Thread of camera '%s' now has %s priority and runs on CPUs: %s.", evt.GetCameraName(),
+                           GetThreadPriorityClassName(parameter.priorityClass),
+                           parameter.cpuAffinityMask ? FormatCPUList(parameter.cpuAffinityMask) : std::string("any"));
+    }
+    else if ( commandData.command == CameraCommandData::StartRecording )
+    {
+        CameraCommandData::RecordingParameter parameter;
+
+        commandData.parameter.GetAs(&parameter);
+
+        CameraView* cameraView = GetCameraView(parameter.cameraId);
+
+        if ( !cameraView )
+            return;
+
+        if ( parameter.succeeded )
+        {
+            cameraView->recording = true;
+            infoMessage.Printf("Camera '%s' is being recorded to '%s'.", cameraView->name, parameter.directory);
+        }
+        else
+        {
+            wxLogError("Could not start recording camera '%s': %s", cameraView->name, parameter.errorMessage);
+            return;
+        }
+    }
+    else if ( commandData.command == CameraCommandData::StopRecording )
+    {
+        CameraView* cameraView = GetCameraView(commandData.parameter.As<int>());
+
+        if ( !cameraView )
+            return;
+
+        cameraView->recording = false;
+        infoMessage.Printf("Stopped recording camera '%s'.", cameraView->name);
+    }
+    else if ( commandData.command == CameraCommandData::StartJournal || commandData.command == CameraCommandData::StopJournal )
+    {
+        const std::vector<CameraView*> cameraViews = GetCameraViewsForSource(evt.GetCameraId());
+
+        if ( cameraViews.empty() )
+            return;
+
+        if ( commandData.command == CameraCommandData::StartJournal )
+        {
+            CameraCommandData::JournalParameter parameter;
+
+            commandData.parameter.GetAs(&parameter);
+
+            if ( !parameter.succeeded )
+            {
+                wxLogError("Could not start the raw frame journal for camera '%s': %s", evt.GetCameraName(), parameter.errorMessage);
+                return;
+            }
+
+            cameraViews[0]->source->journaling = true;
+            infoMessage.Printf("Raw frames of camera '%s' are being written to '%s'.", evt.GetCameraName(), parameter.fileName);
+        }
+        else
+        {
+            cameraViews[0]->source->journaling = false;
+            infoMessage.Printf("Stopped the raw frame journal '%s' of camera '%s'.",
+                               commandData.parameter.As<wxString>(), evt.GetCameraName());
+        }
+    }
     else if ( commandData.command == CameraCommandData::GetVCProp )
     {
         CameraCommandData::VCPropCommandParameters params;
@@ -855,64 +2252,322 @@ void CameraGridFrame::OnCameraErrorOpen(CameraEvent& evt)
 {
     const wxString cameraName = evt.GetCameraName();
 
-    ShowErrorForCamera(cameraName, wxString::Format("Could not open camera '%s'.",  cameraName));
+    ShowErrorForCamera(evt.GetCameraId(), wxString::Format("Could not open camera '%s'.",  cameraName));
 }
 
 void CameraGridFrame::OnCameraErrorEmpty(CameraEvent& evt)
 {
     const wxString cameraName = evt.GetCameraName();
 
-    ShowErrorForCamera(cameraName, wxString::Format("Connection to camera '%s' lost.", cameraName));
+    ShowErrorForCamera(evt.GetCameraId(), wxString::Format("Connection to camera '%s' lost.", cameraName));
+}
+
+void CameraGridFrame::OnCameraErrorPassthrough(CameraEvent& evt)
+{
+    const std::vector<CameraView*> cameraViews = GetCameraViewsForSource(evt.GetCameraId());
+
+    // the cameras were removed before the event was processed
+    if ( cameraViews.empty() )
+        return;
+
+    // the camera thread decodes the frames, they are displayed when they start coming
+    SetCaptureSourcePassthroughKey(cameraViews[0]->source, false);
+    for ( auto cameraView : cameraViews )
+        cameraView->thumbnailPanel->SetStatus(CameraPanel::Connecting);
+
+    wxLogError("Backend '%s' of camera '%s' cannot pass through compressed frames, they are decoded instead.",
+        evt.GetString(), evt.GetCameraName());
 }
 
 void CameraGridFrame::OnCameraErrorException(CameraEvent& evt)
 {
     const wxString cameraName = evt.GetCameraName();
 
-    ShowErrorForCamera(cameraName, wxString::Format("Exception in camera '%s': %s", cameraName, evt.GetString()));
+    ShowErrorForCamera(evt.GetCameraId(), wxString::Format("Exception in camera '%s': %s", cameraName, evt.GetString()));
 }
 
-void CameraGridFrame::ShowErrorForCamera(const wxString& cameraName, const wxString& message)
+void CameraGridFrame::OnCameraRecordingError(CameraEvent& evt)
 {
-    CameraPanel* cameraPanel = FindThumbnailPanelForCamera(cameraName);
+    CameraView* cameraView = GetCameraView(evt.GetCameraId());
+
+    if ( cameraView )
+        cameraView->recording = false;
+
+    wxLogError("Recording camera '%s' failed: %s", evt.GetCameraName(), evt.GetString());
+}
 
-    if ( cameraPanel )
-        cameraPanel->SetBitmap(wxBitmap(), CameraPanel::Error);
+void CameraGridFrame::OnSharedMemoryExportStarted(wxThreadEvent& evt)
+{
+    const CameraView* cameraView = GetCameraView(evt.GetInt());
 
-    OneCameraFrame* ocFrame = FindOneCameraFrameForCamera(cameraName);
+    // the export was stopped before the event was processed
+    if ( !cameraView || cameraView->sharedMemoryExporter != evt.GetPayload<SharedMemoryExporter*>() )
+        return;
 
-    if ( ocFrame )
-        ocFrame->SetCameraBitmap(wxBitmap(), CameraPanel::Error);
+    wxLogMessage("Exporting frames of camera '%s' to shared memory '%s'.", cameraView->name, evt.GetString());
+}
+
+void CameraGridFrame::OnSharedMemoryExportError(wxThreadEvent& evt)
+{
+    CameraView* cameraView = GetCameraView(evt.GetInt());
+
+    if ( !cameraView || cameraView->sharedMemoryExporter != evt.GetPayload<SharedMemoryExporter*>() )
+        return;
+
+    // the thread is exiting on its own, so unchecking the menu item needs only joining it
+    ReapWorkerThread(cameraView->sharedMemoryExporter,
+        wxString::Format("Shared memory exporter for camera '%s'", cameraView->name));
+    cameraView->sharedMemoryExporter = nullptr;
+
+    wxLogError("Could not export frames of camera '%s' to shared memory: %s", cameraView->name, evt.GetString());
+}
+
+void CameraGridFrame::ShowErrorForCamera(int sourceCameraId, const wxString& message)
+{
+    const std::vector<CameraView*> cameraViews = GetCameraViewsForSource(sourceCameraId);
+
+    // the cameras were removed before the event was processed
+    if ( cameraViews.empty() )
+        return;
+
+    for ( auto cameraView : cameraViews )
+    {
+        cameraView->thumbnailPanel->SetBitmap(wxBitmap(), CameraPanel::Error);
+
+        if ( cameraView->oneCameraFrame )
+            cameraView->oneCameraFrame->SetCameraBitmap(wxBitmap(), CameraPanel::Error);
+    }
 
     wxLogError(message);
 }
 
-CameraPanel* CameraGridFrame::FindThumbnailPanelForCamera(const wxString& cameraName) const
+CameraGridFrame::CameraView* CameraGridFrame::GetCameraView(int cameraId)
 {
-    auto it = m_cameras.find(cameraName);
+    if ( cameraId < 0 || static_cast<size_t>(cameraId) >= m_cameras.size() )
+        return nullptr;
+
+    CameraView& cameraView = m_cameras[cameraId];
 
-    if ( it == m_cameras.end() )
+    if ( !cameraView.source )
         return nullptr;
 
-    return it->second.thumbnailPanel;
+    return &cameraView;
+}
+
+wxBitmap CameraGridFrame::GetPooledBitmap(BitmapPool& pool, const NativeImage& image)
+{
+    const wxUint64 bitmapsCreated = pool.GetBitmapsCreated();
+    const wxBitmap bitmap = pool.GetBitmap(image);
+
+    CameraMetrics::Add(m_metricsRegistry.GetApplicationMetrics().guiBitmapsCreated, pool.GetBitmapsCreated() - bitmapsCreated);
+
+    return bitmap;
+}
+
+wxString CameraGridFrame::GetCaptureSourceKey(const CameraSetupData& cameraSetupData)
+{
+    // passthrough must be the last part, see SetCaptureSourcePassthrough()
+    return wxString::Format("%s|%d|%dx%d|%d|%d|%d|%d|%d|%d|%d|%d|%d|%d|%d",
+        cameraSetupData.address, cameraSetupData.apiPreference,
+        cameraSetupData.frameSize.GetWidth(), cameraSetupData.frameSize.GetHeight(),
+        cameraSetupData.FPS, cameraSetupData.useMJPGFourCC ? 1 : 0,
+        cameraSetupData.openTimeout, cameraSetupData.readTimeout,
+        cameraSetupData.quietFrameStride,
+        cameraSetupData.convertRGB ? 1 : 0, static_cast<int>(cameraSetupData.rawConversion.format),
+        cameraSetupData.rawConversion.windowLevel, cameraSetupData.rawConversion.windowWidth,
+        cameraSetupData.nativeImages ? 1 : 0,
+        cameraSetupData.passthrough ? 1 : 0);
+}
+
+CameraGridFrame::CaptureSourcePtr CameraGridFrame::FindCaptureSource(const CameraSetupData& cameraSetupData)
+{
+    const wxString key = GetCaptureSourceKey(cameraSetupData);
+
+    for ( const auto& source : m_captureSources )
+    {
+        const CaptureSource& s = *source.second;
+
+        if ( s.key == key && s.sleepDuration == cameraSetupData.sleepDuration
+             && s.priorityClass == cameraSetupData.priorityClass
+             && s.cpuAffinityMask == cameraSetupData.cpuAffinityMask )
+        {
+            return source.second;
+        }
+    }
+
+    return nullptr;
+}
+
+void CameraGridFrame::SetCaptureSourcePassthrough(const CaptureSourcePtr& source, bool passthrough)
+{
+    CameraCommandData commandData;
+
+    commandData.command   = CameraCommandData::SetPassthrough;
+    commandData.parameter = passthrough;
+    source->commandDatas->Post(commandData);
+
+    // the degradation levels save only the decoding work
+    if ( passthrough && source->degradationLevel > 0 )
+        SetCaptureSourceDegradationLevel(source, 0);
+
+    SetCaptureSourcePassthroughKey(source, passthrough);
+
+    // the frames are displayed when they start coming,
+    // see also OnCameraCaptureStarted()
+    for ( auto cameraId : source->cameraIds )
+        m_cameras[cameraId].thumbnailPanel->SetStatus(CameraPanel::Connecting);
+}
+
+void CameraGridFrame::SetCaptureSourcePassthroughKey(const CaptureSourcePtr& source, bool passthrough)
+{
+    // the address may already be open with the same settings by another source,
+    // then FindCaptureSource() returns either of them
+    source->passthrough = passthrough;
+    source->key = wxString::Format("%s|%d", source->key.BeforeLast('|'), passthrough ? 1 : 0);
+}
+
+void CameraGridFrame::SetCaptureSourceDegradationLevel(const CaptureSourcePtr& source, int level)
+{
+    wxCHECK_RET(level >= 0 && level <= ms_governorMaxLevel, "Invalid degradation level");
+
+    CameraCommandData commandData;
+
+    commandData.command   = CameraCommandData::SetDegradationLevel;
+    commandData.parameter = level;
+    source->commandDatas->Post(commandData);
+
+    source->degradationLevel = level;
+
+    for ( auto cameraId : source->cameraIds )
+        m_cameras[cameraId].thumbnailPanel->SetDegradationLevel(level);
 }
 
-OneCameraFrame* CameraGridFrame::FindOneCameraFrameForCamera(const wxString& cameraName) const
+int CameraGridFrame::GetCaptureSourcePriority(const CaptureSource& source, int& maxLevel)
 {
-    const auto& children = GetChildren();
+    int priority = 0;
+
+    maxLevel = ms_governorMaxLevel;
 
-    for ( const auto child : children )
+    for ( auto cameraId : source.cameraIds )
     {
-        OneCameraFrame* ocFrame = dynamic_cast<OneCameraFrame*>(child);
+        const CameraView* cameraView = GetCameraView(cameraId);
 
-        if ( !ocFrame )
+        if ( !cameraView )
             continue;
 
-        if ( ocFrame->GetCameraName().IsSameAs(cameraName) )
-            return ocFrame;
+        if ( cameraView->oneCameraFrame )
+        {
+            maxLevel = ms_governorMaxLevelShown;
+            if ( cameraView->oneCameraFrame->IsActive() )
+                priority = 2;
+        }
+
+        if ( cameraView->motion )
+            priority = std::max(priority, 1);
     }
 
-    return nullptr;
+    return priority;
+}
+
+void CameraGridFrame::ReapWorkerThread(wxThread* thread, const wxString& threadName)
+{
+    if ( m_cameraThreadReaper )
+    {
+        m_cameraThreadReaper->Reap(thread, threadName);
+        return;
+    }
+
+    thread->Wait(wxTHREAD_WAIT_BLOCK);
+    delete thread;
+}
+
+std::vector<CameraGridFrame::CameraView*> CameraGridFrame::GetCameraViewsForSource(int sourceCameraId)
+{
+    std::vector<CameraView*> cameraViews;
+    const auto               sourceIt = m_captureSources.find(sourceCameraId);
+
+    if ( sourceIt == m_captureSources.end() )
+        return cameraViews;
+
+    for ( const auto cameraId : sourceIt->second->cameraIds )
+    {
+        CameraView* cameraView = GetCameraView(cameraId);
+
+        if ( cameraView )
+            cameraViews.push_back(cameraView);
+    }
+
+    return cameraViews;
+}
+
+bool CameraGridFrame::SelectThreadScheduling(const wxString& caption, int& priorityClass, CPUAffinityMask& cpuAffinityMask)
+{
+    const wxString priorityClasses[] = { "Low", "Normal", "High (may require privileges)" };
+
+    const int selection = wxGetSingleChoiceIndex("Thread priority class", caption,
+                                                 WXSIZEOF(priorityClasses), priorityClasses,
+                                                 priorityClass - ThreadPriorityLow, this);
+
+    if ( selection == -1 )
+        return false;
+
+    CPUAffinityMask mask = cpuAffinityMask;
+
+    if ( !SelectCPUAffinity("CPUs the thread may run on, e.g. \"2-3,6\" (empty = any CPU)", caption, mask) )
+        return false;
+
+    priorityClass   = ThreadPriorityLow + selection;
+    cpuAffinityMask = mask;
+    return true;
+}
+
+bool CameraGridFrame::SelectCPUAffinity(const wxString& message, const wxString& caption, CPUAffinityMask& cpuAffinityMask)
+{
+    // unlike wxGetTextFromUser(), allows telling an empty list from cancelling
+    wxTextEntryDialog dlg(this, message, caption, FormatCPUList(cpuAffinityMask));
+
+    for ( ;; )
+    {
+        if ( dlg.ShowModal() != wxID_OK )
+            return false;
+
+        if ( ParseCPUList(dlg.GetValue().ToStdString(), cpuAffinityMask) )
+            return true;
+
+        wxLogError("Invalid CPU list '%s', expected CPU numbers 0-63 and ranges separated with commas.", dlg.GetValue());
+    }
+}
+
+void CameraGridFrame::OnSetGUIThreadAffinity(wxCommandEvent&)
+{
+    CPUAffinityMask mask = m_guiThreadCPUAffinityMask;
+    std::string     errorMessage;
+
+    if ( !SelectCPUAffinity("CPUs the GUI thread may run on, e.g. \"0\" (empty = any CPU)", "GUI Thread CPU Affinity", mask) )
+        return;
+
+    if ( !SetCurrentThreadAffinity(mask, errorMessage) )
+    {
+        wxLogError("Could not set the CPU affinity of the GUI thread: %s", errorMessage);
+        return;
+    }
+
+    m_guiThreadCPUAffinityMask = mask;
+}
+
+void CameraGridFrame::OnSetFrameMemoryBudget(wxCommandEvent&)
+{
+    const long budgetMB = wxGetNumberFromUser("Memory the frames waiting for the GUI and the frame bus consumers may use,\n"
+                                              "new frames are dropped when it is reached (in MB, 0 = unlimited)",
+                                              "Number between 0 and 65536", "Frame Memory Budget",
+                                              static_cast<long>(m_frameMemoryBudget->GetBudget() / (1024 * 1024)), 0, 65536, this);
+
+    if ( budgetMB == -1 )
+        return;
+
+    m_frameMemoryBudget->SetBudget(static_cast<wxUint64>(budgetMB) * 1024 * 1024);
+    // so that the peak shows how the new budget is doing
+    m_frameMemoryBudget->ResetPeak();
 }
 
 int CameraGridFrame::SelectCaptureProperty(const wxString& message)
@@ -11,13 +11,26 @@
 #define CAMERAGRIDFRAME_H
 
 #include <wx/wx.h>
+#include <wx/weakref.h>
 
 #include <map>
+#include <memory>
+#include <vector>
 
+#include "bitmappool.h"
 #include "camerathread.h"
+#include "framebus.h"
+#include "framememorybudget.h"
+#include "metrics.h"
+#include "replaybuffer.h"
+#include "sharedmemoryexporter.h"
 
 // forward declarations
+class CameraCPUDialog;
 class CameraPanel;
+class CameraThreadReaper;
+class MJPEGServer;
+class ObjectDetector;
 class OneCameraFrame;
 
 class CameraGridFrame : public wxFrame
@@ -46,31 +59,125 @@ private:
         ID_CAMERA_SET_DEFAULTS_RESOLUTION,
         ID_CAMERA_SET_DEFAULTS_FPS,
         ID_CAMERA_SET_DEFAULTS_USE_MJPEG_FOURCC,
+        ID_CAMERA_SET_DEFAULTS_OPEN_TIMEOUT,
+        ID_CAMERA_SET_DEFAULTS_READ_TIMEOUT,
+        ID_CAMERA_SET_DEFAULTS_RECONNECT,
+        ID_CAMERA_SET_DEFAULTS_RECONNECT_DELAY,
+        ID_CAMERA_SET_DEFAULTS_PASSTHROUGH,
+        ID_CAMERA_SET_DEFAULTS_RAW_FRAMES,
+        ID_CAMERA_SET_DEFAULTS_GRAY16_WINDOW,
+        ID_CAMERA_SET_DEFAULTS_NATIVE_IMAGES,
+        ID_CAMERA_SET_DEFAULTS_REPLAY_BUFFER,
+        ID_CAMERA_SET_DEFAULTS_QUIET_FRAME_STRIDE,
+        ID_CAMERA_SET_DEFAULTS_THREAD_SCHEDULING,
         ID_CAMERA_SET_DEFAULTS_RESET,
 
         ID_CAMERA_GET_INFO,
         ID_CAMERA_SET_THREAD_SLEEP_DURATION,
+        ID_CAMERA_SET_THREAD_SCHEDULING,
         ID_CAMERA_GET_VCPROP,
         ID_CAMERA_SET_VCPROP,
+        ID_CAMERA_START_RECORDING,
+        ID_CAMERA_STOP_RECORDING,
+        ID_CAMERA_DECODE_FRAMES,
+        ID_CAMERA_START_JOURNAL,
+        ID_CAMERA_STOP_JOURNAL,
+        ID_CAMERA_EXPORT_SHARED_MEMORY,
+
+        ID_METRICS_SET_FILE,
+        ID_METRICS_SET_FILE_WRITE_INTERVAL,
+        ID_METRICS_SET_HTTP_PORT,
+        ID_MJPEG_SET_HTTP_PORT,
+        ID_OBJECT_DETECTION,
+        ID_CPU_GOVERNOR,
+        ID_GUI_THREAD_AFFINITY,
+        ID_FRAME_MEMORY_BUDGET,
+        ID_SHOW_CAMERA_CPU,
+        ID_BENCHMARK_BITMAP_CONVERSION,
+        ID_LOCKS_INSTRUMENT,
+        ID_LOCKS_SHOW_STATS,
+        ID_LOCKS_RESET_STATS,
+        ID_STALLS_RECONNECT,
     };
 
-    struct CameraView
+    // A CameraThread capturing from an address, shared by all cameras added
+    // with the same address and capture settings, each camera is a CameraOutput
+    // of the thread. Events from the thread carry the id of the camera which
+    // opened the source, even when the camera was removed since.
+    struct CaptureSource
     {
+        int                 id{-1}; // id of the camera which opened the source
+        wxString            key; // see GetCaptureSourceKey(), several sources may have the same key
         CameraThread*       thread{nullptr};
-        CameraPanel*        thumbnailPanel{nullptr};
         CameraCommandDatas* commandDatas{nullptr};
+        CameraMetricsPtr    metrics;   // CameraSetupData::metrics
+        std::vector<int>    cameraIds; // cameras fed by the source
+        bool                passthrough{false}; // see CameraSetupData::passthrough
+        // the settings which can be changed while capturing, so they are not a part
+        // of the key; updated when the thread reports they were changed
+        long                sleepDuration{CameraSetupData::SleepFromFPS};
+        int                 priorityClass{ThreadPriorityNormal};
+        CPUAffinityMask     cpuAffinityMask{0};
+        bool                journaling{false};  // see CameraCommandData::StartJournal
+        // see CameraCommandData::SetDegradationLevel and OnGovernCPU()
+        int                 degradationLevel{0};
+        wxUint64            governorLastCPUUs{0}; // CameraMetrics::GetCPUTotalUs() without sleeping
+    };
+    typedef std::shared_ptr<CaptureSource> CaptureSourcePtr;
+
+    struct CameraView
+    {
+        CaptureSourcePtr          source; // nullptr when the camera was removed
+        wxString                  name;
+        CameraPanel*              thumbnailPanel{nullptr};
+        wxWeakRef<OneCameraFrame> oneCameraFrame; // null when not shown
+        CameraMetricsPtr          metrics; // CameraOutput::metrics
+        bool                      stalled{false}; // see OnCheckStalledCameras()
+        bool                      recording{false};
+        bool                      motion{false}; // in the last frame, see CameraFrameData::GetMotionScore()
+        // null when the replay buffer is disabled
+        ReplayBufferPtr           replayBuffer;
+        ReplayEncoder*            replayEncoder{nullptr};
+        // null when not exporting frames to shared memory
+        SharedMemoryExporter*     sharedMemoryExporter{nullptr};
+        // for the NativeImages of the camera, see CameraSetupData::nativeImages
+        BitmapPool                framePool;
+        BitmapPool                thumbnailPool;
     };
 
     // default timer interval in ms for processing new camera frame data from worker threads
     // see m_processNewCameraFrameDataInterval
     static const long ms_defaultProcessNewCameraFrameDataInterval = 30;
 
-    // camera name to CameraView
-    std::map<wxString, CameraView> m_cameras;
+    // default capture timeouts in ms, see CameraSetupData::openTimeout and readTimeout
+    static const long ms_defaultCameraOpenTimeout = 10000;
+    static const long ms_defaultCameraReadTimeout = 5000;
+
+    // A capturing camera is considered stalled when it has not delivered a frame
+    // for ms_stallFrameIntervals expected frame intervals, but at least ms_stallMinTimeout ms.
+    static const long ms_stallWatchdogInterval = 1000;
+    static const long ms_stallFrameIntervals = 10;
+    static const long ms_stallMinTimeout = 5000;
+
+    // The CPU governor checks the process CPU usage every ms_governorInterval ms. Above
+    // m_governorMaxCPUPercent, it degrades one capture source by one level, below
+    // ms_governorRestorePercent of m_governorMaxCPUPercent, it restores one by one level.
+    // Sources with an open OneCameraFrame are not degraded above ms_governorMaxLevelShown,
+    // so that the frame keeps receiving full-size frames.
+    static const long ms_governorInterval = 1000;
+    static const long ms_governorRestorePercent = 75;
+    static const int  ms_governorMaxLevel = 3;
+    static const int  ms_governorMaxLevelShown = 2;
+
+    // CameraView indexed by camera id, ids are not reused,
+    // so the views of removed cameras are left empty
+    std::vector<CameraView>        m_cameras;
+    size_t                         m_cameraCount{0}; // cameras not removed
+    std::map<int, CaptureSourcePtr> m_captureSources; // key is CaptureSource::id
     long                           m_processNewCameraFrameDataInterval{ms_defaultProcessNewCameraFrameDataInterval};
     wxTimer                        m_processNewCameraFrameDataTimer;
     CameraFrameDataPtrs            m_newCameraFrameData;
-    wxCriticalSection              m_newCameraFrameDataCS;
+    InstrumentedCriticalSection    m_newCameraFrameDataCS{"new_camera_frame_data"};
 
     long                           m_defaultCameraBackend{0};
     long                           m_defaultCameraThreadSleepDuration{CameraSetupData::SleepFromFPS};
@@ -78,10 +185,64 @@ private:
     wxSize                         m_defaultCameraResolution;
     int                            m_defaultCameraFPS{0};
     bool                           m_defaultUseMJPGFourCC{false};
+    long                           m_defaultCameraOpenTimeout{ms_defaultCameraOpenTimeout};
+    long                           m_defaultCameraReadTimeout{ms_defaultCameraReadTimeout};
+    bool                           m_defaultReconnect{true};
+    long                           m_defaultReconnectDelayInitial{1000}; // see CameraSetupData::reconnect
+    long                           m_defaultReconnectDelayMax{30000};
+    long                           m_defaultReconnectJitter{20};
+    bool                           m_defaultPassthrough{false};
+    bool                           m_defaultConvertRGB{true}; // see CameraSetupData::convertRGB
+    MatConversionOptions           m_defaultRawConversion;
+    bool                           m_defaultNativeImages{false}; // see CameraSetupData::nativeImages
+    long                           m_defaultReplayDuration{0}; // in seconds, 0 = no replay buffer
+    long                           m_defaultReplayMaxMB{64};   // memory budget of a camera's replay buffer
+    long                           m_defaultQuietFrameStride{1}; // see CameraSetupData::quietFrameStride
+    int                            m_defaultPriorityClass{ThreadPriorityNormal}; // see CameraSetupData::priorityClass
+    CPUAffinityMask                m_defaultCPUAffinityMask{0};
+
+    CPUAffinityMask                m_guiThreadCPUAffinityMask{0}; // 0 = any CPU
+
+    // captured frames for consumers other than the GUI, see CameraSetupData::frameBus
+    FrameBus                       m_frameBus;
+
+    // bytes of the frames in flight, shared with the camera threads, see CameraSetupData::frameMemoryBudget
+    FrameMemoryBudgetPtr           m_frameMemoryBudget{std::make_shared<FrameMemoryBudget>()};
+
+    // joins and deletes the threads of removed cameras
+    CameraThreadReaper*            m_cameraThreadReaper{nullptr};
 
     wxTimer                        m_updateInfoTimer;
     wxULongLong                    m_framesProcessed{0};
 
+    MetricsRegistry                m_metricsRegistry;
+    MetricsHTTPServer              m_metricsHTTPServer{m_metricsRegistry};
+    wxString                       m_metricsFileName; // if empty, metrics are not written to a file
+    long                           m_metricsFileWriteInterval{15}; // in seconds
+    wxTimer                        m_metricsFileTimer;
+
+    // null when the cameras are not streamed
+    MJPEGServer*                   m_mjpegServer{nullptr};
+
+    // null when objects are not detected
+    ObjectDetector*                m_objectDetector{nullptr};
+
+    wxWeakRef<CameraCPUDialog>     m_cameraCPUDialog;
+
+    wxString                       m_recordingDirectory;
+    long                           m_recordingSegmentDuration{10}; // in minutes, see CameraCommandData::RecordingParameter
+
+    wxString                       m_journalDirectory;
+    long                           m_journalSizeMB{1024}; // see CameraCommandData::JournalParameter
+
+    wxTimer                        m_stallWatchdogTimer;
+    bool                           m_reconnectStalledCameras{false};
+
+    wxTimer                        m_governorTimer;
+    long                           m_governorMaxCPUPercent{0}; // 0 = the governor is off
+    wxInt64                        m_governorLastProcessCPUUs{-1};
+    wxLongLong                     m_governorLastTime;
+
     void OnAddCamera(wxCommandEvent&);
     void OnAddAllIPCamerasAbove(wxCommandEvent&);
     void OnRemoveCamera(wxCommandEvent&);
@@ -95,6 +256,17 @@ private:
     void OnSetCameraDefaultResolution(wxCommandEvent&);
     void OnSetCameraDefaultFPS(wxCommandEvent&);
     void OnSetCameraDefaultUseMJPGFourCC(wxCommandEvent& evt);
+    void OnSetCameraDefaultOpenTimeout(wxCommandEvent&);
+    void OnSetCameraDefaultReadTimeout(wxCommandEvent&);
+    void OnSetCameraDefaultReconnect(wxCommandEvent& evt);
+    void OnSetCameraDefaultReconnectDelay(wxCommandEvent&);
+    void OnSetCameraDefaultPassthrough(wxCommandEvent& evt);
+    void OnSetCameraDefaultRawFrames(wxCommandEvent& evt);
+    void OnSetCameraDefaultGray16Window(wxCommandEvent&);
+    void OnSetCameraDefaultNativeImages(wxCommandEvent& evt);
+    void OnSetCameraDefaultReplayBuffer(wxCommandEvent&);
+    void OnSetCameraDefaultQuietFrameStride(wxCommandEvent&);
+    void OnSetCameraDefaultThreadScheduling(wxCommandEvent&);
     void OnCameraDefaultsReset(wxCommandEvent&);
 
     void OnShowOneCameraFrame(wxMouseEvent& evt);
@@ -103,26 +275,92 @@ private:
 
     void OnUpdateInfo(wxTimerEvent&);
 
+    void OnSetMetricsFile(wxCommandEvent&);
+    void OnSetMetricsFileWriteInterval(wxCommandEvent&);
+    void OnSetMetricsHTTPPort(wxCommandEvent&);
+    void OnSetMJPEGServerPort(wxCommandEvent&);
+    void StopMJPEGServer();
+    void OnObjectDetection(wxCommandEvent&);
+    void StopObjectDetection();
+    void OnObjectDetections(wxThreadEvent& evt);
+    void OnWriteMetricsFile(wxTimerEvent&);
+    void OnShowCameraCPU(wxCommandEvent&);
+    void OnBenchmarkBitmapConversion(wxCommandEvent&);
+    void OnInstrumentLocks(wxCommandEvent& evt);
+    void OnShowLockStats(wxCommandEvent&);
+    void OnResetLockStats(wxCommandEvent&);
+
+    void OnCheckStalledCameras(wxTimerEvent&);
+
+    void OnSetCPUGovernor(wxCommandEvent&);
+    void OnSetGUIThreadAffinity(wxCommandEvent&);
+    void OnSetFrameMemoryBudget(wxCommandEvent&);
+    void OnGovernCPU(wxTimerEvent&);
+
     void AddCamera(const wxString& address);
-    void RemoveCamera(const wxString& cameraName);
+    void RemoveCamera(int cameraId);
     void RemoveAllCameras();
 
     void OnProcessNewCameraFrameData(wxTimerEvent&);
 
     void OnCameraCaptureStarted(CameraEvent& evt);
 
+    void OnCameraReconnecting(CameraEvent& evt);
+    void OnCameraReconnected(CameraEvent& evt);
+
     void OnCameraCommandResult(CameraEvent& evt);
 
     void OnCameraErrorOpen(CameraEvent& evt);
     void OnCameraErrorEmpty(CameraEvent& evt);
+    void OnCameraErrorPassthrough(CameraEvent& evt);
     void OnCameraErrorException(CameraEvent& evt);
 
-    void ShowErrorForCamera(const wxString& cameraName, const wxString& message);
+    void OnCameraRecordingError(CameraEvent& evt);
+
+    void OnSharedMemoryExportStarted(wxThreadEvent& evt);
+    void OnSharedMemoryExportError(wxThreadEvent& evt);
 
-    CameraPanel*    FindThumbnailPanelForCamera(const wxString& cameraName) const;
-    OneCameraFrame* FindOneCameraFrameForCamera(const wxString& cameraName) const;
+    // sourceCameraId is CameraEvent::GetCameraId()
+    void ShowErrorForCamera(int sourceCameraId, const wxString& message);
+
+    // returns nullptr for an invalid id or a removed camera
+    CameraView* GetCameraView(int cameraId);
+
+    // returns pool's bitmap with image, counting the bitmaps created in ApplicationMetrics
+    wxBitmap GetPooledBitmap(BitmapPool& pool, const NativeImage& image);
+
+    // cameras sharing a capture source differ only in name, thumbnail size and metrics,
+    // the key does not include the settings stored in CaptureSource
+    static wxString GetCaptureSourceKey(const CameraSetupData& cameraSetupData);
+    // returns a source with the same settings which a new camera can share or nullptr
+    CaptureSourcePtr FindCaptureSource(const CameraSetupData& cameraSetupData);
+
+    // switches the source between decoding and passing through the frames,
+    // see CameraCommandData::SetPassthrough
+    void SetCaptureSourcePassthrough(const CaptureSourcePtr& source, bool passthrough);
+    // updates only the source's passthrough and its key
+    void SetCaptureSourcePassthroughKey(const CaptureSourcePtr& source, bool passthrough);
+
+    // see CameraCommandData::SetDegradationLevel
+    void SetCaptureSourceDegradationLevel(const CaptureSourcePtr& source, int level);
+    // Returns the importance of the source for the CPU governor: 2 when a camera
+    // fed by it is shown in the focused OneCameraFrame, 1 when a camera has motion
+    // and 0 otherwise. maxLevel is set to the highest level the source can be degraded to.
+    int GetCaptureSourcePriority(const CaptureSource& source, int& maxLevel);
+
+    // returns the views of all cameras fed by the source opened
+    // by the camera with sourceCameraId, see CaptureSource
+    std::vector<CameraView*> GetCameraViewsForSource(int sourceCameraId);
+
+    // joins and deletes a joinable thread asked to stop, in m_cameraThreadReaper when possible
+    void ReapWorkerThread(wxThread* thread, const wxString& threadName);
 
     int SelectCaptureProperty(const wxString& message);
+
+    // asks for the priority class and the CPUs of a camera thread, returns false when cancelled
+    bool SelectThreadScheduling(const wxString& caption, int& priorityClass, CPUAffinityMask& cpuAffinityMask);
+    // asks for a CPU list (see ParseCPUList()), returns false when cancelled
+    bool SelectCPUAffinity(const wxString& message, const wxString& caption, CPUAffinityMask& cpuAffinityMask);
 };
 
 #endif // #ifndef CAMERAGRIDFRAME_H
\ No newline at end of file
@@ -10,13 +10,14 @@
 
 #include <wx/wx.h>
 #include <wx/dcbuffer.h>
+#include <wx/math.h>
 
 #include "camerapanel.h"
 
-CameraPanel::CameraPanel(wxWindow* parent, const wxString& cameraName,
+CameraPanel::CameraPanel(wxWindow* parent, int cameraId, const wxString& cameraName,
                         bool drawPaintTime, Status status)
     : wxPanel(parent, wxID_ANY, wxDefaultPosition, wxDefaultSize, wxFULL_REPAINT_ON_RESIZE | wxBORDER_RAISED),
-      m_cameraName(cameraName), m_drawPaintTime(drawPaintTime), m_status(status)
+      m_cameraId(cameraId), m_cameraName(cameraName), m_drawPaintTime(drawPaintTime), m_status(status)
 {
     SetBackgroundStyle(wxBG_STYLE_PAINT);
     Bind(wxEVT_PAINT, &CameraPanel::OnPaint, this);
@@ -30,6 +31,33 @@ void CameraPanel::SetBitmap(const wxBitmap& bitmap, Status status)
     Refresh(); Update();
 }
 
+void CameraPanel::SetStatus(Status status)
+{
+    m_status = status;
+
+    Refresh(); Update();
+}
+
+void CameraPanel::SetDegradationLevel(int level)
+{
+    if ( level == m_degradationLevel )
+        return;
+
+    m_degradationLevel = level;
+
+    Refresh(); Update();
+}
+
+void CameraPanel::SetOverlays(const std::vector<Overlay>& overlays)
+{
+    if ( overlays.empty() && m_overlays.empty() )
+        return;
+
+    m_overlays = overlays;
+
+    Refresh(); Update();
+}
+
 // On MSW, displaying 4k bitmaps from 60 fps camera with
 // wx(Auto)BufferedPaintDC in some scenarios meant the application
 // after while started for some reason lagging very badly,
@@ -71,8 +99,29 @@ void CameraPanel::OnPaint(wxPaintEvent&)
     paintDC->Clear();
 
     if ( m_bitmap.IsOk() )
+    {
         paintDC->DrawBitmap(m_bitmap, 0, 0, false);
 
+        if ( !m_overlays.empty() )
+        {
+            const wxSize bitmapSize(m_bitmap.GetSize());
+
+            wxDCPenChanger        penChanger(*paintDC, wxPen(*wxGREEN, 2));
+            wxDCBrushChanger      brushChanger(*paintDC, *wxTRANSPARENT_BRUSH);
+            wxDCTextColourChanger textColourChanger(*paintDC, *wxGREEN);
+
+            for ( const auto& overlay : m_overlays )
+            {
+                const wxRect rect(wxRound(overlay.x * bitmapSize.GetWidth()), wxRound(overlay.y * bitmapSize.GetHeight()),
+                                  wxRound(overlay.width * bitmapSize.GetWidth()), wxRound(overlay.height * bitmapSize.GetHeight()));
+
+                paintDC->DrawRectangle(rect);
+                if ( !overlay.label.empty() )
+                    paintDC->DrawText(overlay.label, rect.GetLeft() + 2, rect.GetBottom() - paintDC->GetCharHeight());
+            }
+        }
+    }
+
     switch ( m_status )
     {
         case Connecting:
@@ -82,6 +131,27 @@ void CameraPanel::OnPaint(wxPaintEvent&)
         case Receiving:
             statusString = "Receiving";
             statusColor  = *wxGREEN;
+            if ( m_degradationLevel > 0 )
+            {
+                statusString.Printf("Receiving (degraded %d)", m_degradationLevel);
+                statusColor  = wxColour(173, 255, 47); // green-yellow
+            }
+            break;
+        case Reconnecting:
+            statusString = "Reconnecting";
+            statusColor  = wxColour(255, 165, 0); // orange
+            break;
+        case Stalled:
+            statusString = "Stalled";
+            statusColor  = *wxYELLOW;
+            break;
+        case Passthrough:
+            statusString = "Passthrough (not decoded)";
+            statusColor  = *wxCYAN;
+            break;
+        case Replay:
+            statusString = "Replay";
+            statusColor  = wxColour(255, 0, 255); // magenta
             break;
         case Error:
             statusString = "ERROR";
@@ -89,6 +159,14 @@ void CameraPanel::OnPaint(wxPaintEvent&)
             break;
     }
 
+    if ( m_motion && m_status == Receiving )
+    {
+        wxDCPenChanger   penChanger(*paintDC, wxPen(wxColour(255, 165, 0), 3)); // orange
+        wxDCBrushChanger brushChanger(*paintDC, *wxTRANSPARENT_BRUSH);
+
+        paintDC->DrawRectangle(wxRect(paintDC->GetSize()).Deflate(1));
+    }
+
     wxDCTextColourChanger tcChanger(*paintDC, statusColor);
     wxString              infoText(wxString::Format("%s: %s", m_cameraName, statusString));
 
@@ -13,23 +13,46 @@
 
 #include <wx/wx.h>
 
+#include <vector>
+
 class CameraPanel : public wxPanel
 {
 public:
-    enum Status { Connecting, Receiving, Error };
+    enum Status { Connecting, Receiving, Reconnecting, Stalled, Passthrough, Replay, Error };
+
+    // a labelled rectangle drawn over the bitmap, e.g. an object detected in the frame;
+    // the coordinates are relative to the bitmap size, i.e. in range 0..1
+    struct Overlay
+    {
+        double   x{0}, y{0}, width{0}, height{0};
+        wxString label;
+    };
 
-    CameraPanel(wxWindow* parent, const wxString& cameraName,
+    CameraPanel(wxWindow* parent, int cameraId, const wxString& cameraName,
                 bool drawPaintTime = false, Status status = Connecting);
 
     void SetBitmap(const wxBitmap& bitmap, Status status = Receiving);
-
+    // keeps the current bitmap displayed
+    void SetStatus(Status status);
+    // highlights the panel of a camera with motion, drawn with the next SetBitmap()
+    void SetMotion(bool motion) { m_motion = motion; }
+    // shown in the status while the camera is degraded, see CameraCommandData::SetDegradationLevel
+    void SetDegradationLevel(int level);
+    // kept until replaced, also when the bitmap changes
+    void SetOverlays(const std::vector<Overlay>& overlays);
+
+    int      GetCameraId() const   { return m_cameraId; }
     wxString GetCameraName() const { return m_cameraName; }
     Status   GetStatus() const     { return m_status; }
 private:
-    wxBitmap m_bitmap;
-    wxString m_cameraName;
-    bool     m_drawPaintTime;
-    Status   m_status{Connecting};
+    wxBitmap             m_bitmap;
+    int                  m_cameraId;
+    wxString             m_cameraName;
+    bool                 m_drawPaintTime;
+    Status               m_status{Connecting};
+    bool                 m_motion{false};
+    int                  m_degradationLevel{0};
+    std::vector<Overlay> m_overlays;
 
     void OnPaint(wxPaintEvent&);
 };
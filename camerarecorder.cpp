@@ -0,0 +1,335 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        camerarecorder.cpp
+// Purpose:     Thread writing frames from a camera to video files on disk
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+#include <wx/datetime.h>
+#include <wx/filename.h>
+
+#include <opencv2/opencv.hpp>
+
+#include "camerarecorder.h"
+#include "camerathread.h"
+#include "cputime.h"
+
+namespace
+{
+
+// the extension for a raw elementary stream of the codec
+wxString GetEncodedFileExtension(int fourCC)
+{
+    const char fourCCStr[] = { (char)(fourCC & 0XFF), (char)((fourCC & 0XFF00) >> 8),
+                               (char)((fourCC & 0XFF0000) >> 16), (char)((fourCC & 0XFF000000) >> 24), 0 };
+    const wxString codec = wxString(fourCCStr).Lower();
+
+    if ( codec == "h264" || codec == "avc1" || codec == "x264" )
+        return "h264";
+    if ( codec == "hevc" || codec == "h265" || codec == "hev1" || codec == "hvc1" )
+        return "h265";
+    if ( codec == "mjpg" )
+        return "mjpeg";
+
+    return "raw";
+}
+
+} // unnamed namespace
+
+/***********************************************************************************************
+
+    CameraRecorder
+
+***********************************************************************************************/
+
+bool CameraRecorder::Setup::IsOk() const
+{
+    return cameraId >= 0
+           && !cameraName.empty()
+           && wxFileName::DirExists(directory)
+           && !fileNamePrefix.empty()
+           && FPS > 0.
+           && segmentDuration >= 0
+           && queueCapacity > 0
+           && frameBus
+           && eventSink
+           && metrics;
+}
+
+CameraRecorder::CameraRecorder(const Setup& setup)
+    : wxThread(wxTHREAD_JOINABLE),
+      m_setup(setup)
+{
+    wxCHECK_RET(m_setup.IsOk(), "Invalid recorder setup data");
+
+    m_subscriber = m_setup.frameBus->Subscribe(wxString::Format("recorder %s", m_setup.cameraName),
+                                               m_setup.cameraId, m_setup.queueCapacity,
+                                               FrameSubscriber::DropOldest);
+}
+
+CameraRecorder::~CameraRecorder()
+{
+    RequestStop();
+}
+
+wxString CameraRecorder::GetFileName() const
+{
+    wxCriticalSectionLocker locker(m_fileNameCS);
+
+    return m_fileName;
+}
+
+void CameraRecorder::RequestStop()
+{
+    if ( m_subscriber && !m_subscriber->IsClosed() )
+        m_setup.frameBus->Unsubscribe(m_subscriber);
+}
+
+wxThread::ExitCode CameraRecorder::Entry()
+{
+#if wxCHECK_VERSION(3, 1, 6)
+    SetName(wxString::Format("CameraRecorder %s", m_setup.cameraName));
+#endif
+
+    // long enough not to wake up needlessly, short enough not to
+    // delay the exit when the frames stopped coming
+    static const long receiveTimeout = 250;
+
+    CameraMetrics&     metrics = *m_setup.metrics;
+    ThreadCPUStopWatch cpuStopWatch;
+
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Entered CameraRecorder for camera '%s'.", m_setup.cameraName);
+    CameraMetrics::Set(metrics.recording, 1);
+
+    try
+    {
+        for ( ;; )
+        {
+            BusFramePtr frame;
+
+            CameraMetrics::Add(metrics.recordingCpuUs, cpuStopWatch.Lap());
+
+            if ( !m_subscriber->Receive(frame, receiveTimeout) )
+            {
+                if ( m_subscriber->IsClosed() )
+                    break; // stopped and all queued frames were written
+                continue;
+            }
+
+            if ( NeedsNewSegment(*frame) )
+            {
+                CloseSegment();
+
+                // a compressed segment must start with a key frame
+                if ( frame->encoded && !frame->keyFrame )
+                    continue;
+
+                if ( !OpenSegment(*frame) )
+                    break;
+            }
+
+            wxStopWatch stopWatch;
+
+            if ( !WriteFrame(*frame) )
+                break;
+
+            const wxInt64 writeTime = stopWatch.TimeInMicro().GetValue();
+
+            CameraMetrics::Add(metrics.recordingFramesWritten);
+            CameraMetrics::Add(metrics.recordingWriteTimeUs, writeTime);
+            if ( writeTime > CameraMetrics::Get(metrics.recordingMaxWriteTimeUs) )
+                CameraMetrics::Set(metrics.recordingMaxWriteTimeUs, writeTime);
+        }
+    }
+    catch ( const std::exception& e )
+    {
+        ReportError(e.what());
+    }
+    catch ( ... )
+    {
+        ReportError("Unknown exception");
+    }
+
+    CloseSegment();
+    // when exiting because of an error
+    RequestStop();
+
+    CameraMetrics::Add(metrics.recordingCpuUs, cpuStopWatch.Lap());
+    CameraMetrics::Set(metrics.recording, 0);
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Exiting CameraRecorder for camera '%s'...", m_setup.cameraName);
+
+    m_finished = true;
+    return static_cast<wxThread::ExitCode>(nullptr);
+}
+
+bool CameraRecorder::IsSegmentFull()
+{
+    // checking the file size requires a system call, so it is not done for every frame
+    static const long sizeCheckInterval = 1000;
+
+    const wxLongLong now = wxGetUTCTimeMillis();
+
+    if ( m_setup.segmentDuration > 0
+         && (now - m_segmentStartedTime).GetValue() >= m_setup.segmentDuration * 1000 )
+    {
+        return true;
+    }
+
+    if ( m_setup.segmentMaxBytes > 0 && m_segmentEncoded )
+        return m_segmentBytes >= m_setup.segmentMaxBytes;
+
+    if ( m_setup.segmentMaxBytes > 0
+         && (now - m_segmentSizeCheckedTime).GetValue() >= sizeCheckInterval )
+    {
+        m_segmentSizeCheckedTime = now;
+
+        // the size is approximate, cv::VideoWriter buffers the data
+        const wxULongLong size = wxFileName::GetSize(GetFileName());
+
+        if ( size != wxInvalidSize && size >= m_setup.segmentMaxBytes )
+            return true;
+    }
+
+    return false;
+}
+
+bool CameraRecorder::NeedsNewSegment(const BusFrame& frame)
+{
+    if ( !IsSegmentOpen() || frame.encoded != m_segmentEncoded )
+        return true;
+
+    // a compressed segment can be split only before a key frame
+    if ( frame.encoded )
+        return frame.keyFrame && IsSegmentFull();
+
+    // a reconnected camera may deliver frames of a different size
+    return wxSize(frame.image.cols, frame.image.rows) != m_segmentFrameSize || IsSegmentFull();
+}
+
+bool CameraRecorder::OpenSegment(const BusFrame& frame)
+{
+    const wxSize   frameSize(frame.image.cols, frame.image.rows);
+    const wxString baseName = wxString::Format("%s_%s", m_setup.fileNamePrefix, wxDateTime::UNow().Format("%Y%m%d-%H%M%S-%l"));
+    const wxString extension = frame.encoded ? GetEncodedFileExtension(frame.fourCC) : wxString("avi");
+    wxString       fileName = wxFileName(m_setup.directory, baseName, extension).GetFullPath();
+
+    // segments can be rotated in the same millisecond, e.g. when the frame size
+    // changes right after opening one, and an existing file is never overwritten
+    for ( int i = 2; wxFileName::Exists(fileName); ++i )
+    {
+        if ( i > 99 )
+        {
+            ReportError(wxString::Format("Could not find a name for a new file, '%s' already exists.", fileName));
+            return false;
+        }
+        fileName = wxFileName(m_setup.directory, wxString::Format("%s_%d", baseName, i), extension).GetFullPath();
+    }
+
+    if ( frame.encoded )
+    {
+        if ( !m_file.Open(fileName, "wb") )
+        {
+            ReportError(wxString::Format("Could not open '%s' for writing.", fileName));
+            return false;
+        }
+
+        m_segmentBytes = 0;
+
+        // the stream may not repeat the parameter sets before the key frames
+        if ( !frame.codecExtraData.empty() )
+        {
+            const size_t extraDataSize = frame.codecExtraData.total() * frame.codecExtraData.elemSize();
+
+            if ( m_file.Write(frame.codecExtraData.data, extraDataSize) != extraDataSize )
+            {
+                ReportError(wxString::Format("Could not write to '%s'.", fileName));
+                return false;
+            }
+            m_segmentBytes += extraDataSize;
+        }
+    }
+    else
+    {
+        const int fourCC = m_setup.fourCC != 0 ? m_setup.fourCC : cv::VideoWriter::fourcc('M', 'J', 'P', 'G');
+
+        m_writer.reset(new cv::VideoWriter(fileName.ToStdString(), fourCC, m_setup.FPS,
+                                           cv::Size(frameSize.GetWidth(), frameSize.GetHeight())));
+
+        if ( !m_writer->isOpened() )
+        {
+            m_writer.reset();
+            ReportError(wxString::Format("Could not open '%s' for writing.", fileName));
+            return false;
+        }
+    }
+
+    {
+        wxCriticalSectionLocker locker(m_fileNameCS);
+
+        m_fileName = fileName;
+    }
+
+    m_segmentEncoded         = frame.encoded;
+    m_segmentStartedTime     = wxGetUTCTimeMillis();
+    m_segmentSizeCheckedTime = m_segmentStartedTime;
+    m_segmentFrameSize       = frameSize;
+    CameraMetrics::Add(m_setup.metrics->recordingSegments);
+
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Camera '%s' is being recorded to '%s'.", m_setup.cameraName, fileName);
+    return true;
+}
+
+bool CameraRecorder::WriteFrame(const BusFrame& frame)
+{
+    if ( !frame.encoded )
+    {
+        m_writer->write(frame.image);
+        return true;
+    }
+
+    const size_t size = frame.image.total() * frame.image.elemSize();
+
+    if ( m_file.Write(frame.image.data, size) != size )
+    {
+        ReportError(wxString::Format("Could not write to '%s'.", GetFileName()));
+        return false;
+    }
+
+    m_segmentBytes += size;
+    return true;
+}
+
+void CameraRecorder::CloseSegment()
+{
+    if ( !IsSegmentOpen() )
+        return;
+
+    if ( m_writer )
+    {
+        // writes the rest of the data and the file trailer
+        m_writer->release();
+        m_writer.reset();
+    }
+    else
+    {
+        m_file.Close();
+    }
+
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Finished recording segment '%s' for camera '%s'.", GetFileName(), m_setup.cameraName);
+
+    wxCriticalSectionLocker locker(m_fileNameCS);
+
+    m_fileName.clear();
+}
+
+void CameraRecorder::ReportError(const wxString& message)
+{
+    CameraEvent* evt = new CameraEvent(EVT_CAMERA_RECORDING_ERROR, m_setup.cameraId, m_setup.cameraName);
+
+    CameraMetrics::Add(m_setup.metrics->recordingErrors);
+
+    evt->SetString(message);
+    m_setup.eventSink->QueueEvent(evt);
+}
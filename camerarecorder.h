@@ -0,0 +1,114 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        camerarecorder.h
+// Purpose:     Thread writing frames from a camera to video files on disk
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef CAMERARECORDER_H
+#define CAMERARECORDER_H
+
+#include <wx/wx.h>
+#include <wx/ffile.h>
+#include <wx/thread.h>
+
+#include <atomic>
+#include <memory>
+
+#include "framebus.h"
+#include "metrics.h"
+
+namespace cv { class VideoWriter; }
+
+/***********************************************************************************************
+
+    CameraRecorder: a worker wxThread which receives frames of a single camera
+                    from FrameBus and writes them with cv::VideoWriter,
+                    starting a new file (segment) when the current one is too
+                    long or too large.
+
+                    Compressed packets from cameras with CameraSetupData::passthrough
+                    are written to the file as they are, without decoding and
+                    re-encoding, as a raw elementary stream (e.g. Annex B H.264),
+                    which can be played or remuxed losslessly with FFmpeg tools.
+                    Such segments always start with a key frame.
+
+                    Writing to disk may be slow or stall, so the camera thread
+                    only adds frames to the recorder's bounded FrameSubscriber
+                    queue, when the queue is full the oldest frame is dropped.
+
+                    It is owned by CameraThread, which starts and stops it
+                    when it receives CameraCommandData::StartRecording
+                    and CameraCommandData::StopRecording.
+
+***********************************************************************************************/
+
+class CameraRecorder : public wxThread
+{
+public:
+    struct Setup
+    {
+        int              cameraId{-1}; // see CameraOutput::id
+        wxString         cameraName;
+        wxString         directory;
+        wxString         fileNamePrefix;
+        int              fourCC{0};
+        double           FPS{0.};
+        long             segmentDuration{0}; // in seconds, 0 = unlimited
+        wxULongLong      segmentMaxBytes{0}; // 0 = unlimited
+        size_t           queueCapacity{0};
+
+        FrameBus*        frameBus{nullptr};
+        // where to send EVT_CAMERA_RECORDING_ERROR
+        wxEvtHandler*    eventSink{nullptr};
+        CameraMetricsPtr metrics; // CameraOutput::metrics
+
+        bool IsOk() const;
+    };
+
+    explicit CameraRecorder(const Setup& setup);
+    ~CameraRecorder();
+
+    int      GetCameraId() const { return m_setup.cameraId; }
+    // the file currently being written, empty if none
+    wxString GetFileName() const;
+
+    // Stops receiving new frames, the thread then writes the frames already
+    // queued, closes the file and exits. It must be joined with Wait().
+    void RequestStop();
+
+    // true when Entry() has returned or is about to, so that Wait() does not block
+    bool IsFinished() const { return m_finished; }
+protected:
+    const Setup                      m_setup;
+    FrameSubscriberPtr               m_subscriber;
+    std::atomic_bool                 m_finished{false};
+
+    // used only by the recorder thread
+    std::unique_ptr<cv::VideoWriter> m_writer; // for decoded frames
+    wxFFile                          m_file;   // for compressed frames
+    bool                             m_segmentEncoded{false};
+    wxULongLong                      m_segmentBytes{0}; // only for compressed frames
+    wxLongLong                       m_segmentStartedTime{0}; // obtained with wxGetUTCTimeMillis()
+    wxLongLong                       m_segmentSizeCheckedTime{0};
+    wxSize                           m_segmentFrameSize;
+
+    mutable wxCriticalSection        m_fileNameCS;
+    wxString                         m_fileName;
+
+    ExitCode Entry() override;
+
+    bool IsSegmentOpen() const { return m_writer || m_file.IsOpened(); }
+    bool IsSegmentFull();
+    bool NeedsNewSegment(const BusFrame& frame);
+    bool OpenSegment(const BusFrame& frame);
+    void CloseSegment();
+    bool WriteFrame(const BusFrame& frame);
+
+    void ReportError(const wxString& message);
+};
+
+#endif // #ifndef CAMERARECORDER_H
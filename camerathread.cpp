@@ -7,12 +7,22 @@
 // Licence:     wxWindows licence
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+#include <chrono>
 #include <memory>
+#include <random>
 
 #include <opencv2/opencv.hpp>
 
+#include "alloctracker.h"
+#include "camerarecorder.h"
 #include "camerathread.h"
 #include "convertmattowxbmp.h"
+#include "cputime.h"
+#include "framebus.h"
+#include "framehash.h"
+#include "framejournal.h"
+#include "motiondetector.h"
 
 
 /***********************************************************************************************
@@ -24,9 +34,13 @@
 // see the header for description
 wxDEFINE_EVENT(EVT_CAMERA_CAPTURE_STARTED, CameraEvent);
 wxDEFINE_EVENT(EVT_CAMERA_COMMAND_RESULT, CameraEvent);
+wxDEFINE_EVENT(EVT_CAMERA_RECONNECTING, CameraEvent);
+wxDEFINE_EVENT(EVT_CAMERA_RECONNECTED, CameraEvent);
 wxDEFINE_EVENT(EVT_CAMERA_ERROR_OPEN, CameraEvent);
 wxDEFINE_EVENT(EVT_CAMERA_ERROR_EMPTY, CameraEvent);
+wxDEFINE_EVENT(EVT_CAMERA_ERROR_PASSTHROUGH, CameraEvent);
 wxDEFINE_EVENT(EVT_CAMERA_ERROR_EXCEPTION, CameraEvent);
+wxDEFINE_EVENT(EVT_CAMERA_RECORDING_ERROR, CameraEvent);
 
 
 /***********************************************************************************************
@@ -35,17 +49,23 @@ wxDEFINE_EVENT(EVT_CAMERA_ERROR_EXCEPTION, CameraEvent);
 
 ***********************************************************************************************/
 
-CameraFrameData::CameraFrameData(const wxString& cameraName,
+CameraFrameData::CameraFrameData(const int cameraId,
                                  const wxULongLong frameNumber)
-    : m_cameraName(cameraName), m_frameNumber(frameNumber)
+    : m_cameraId(cameraId), m_frameNumber(frameNumber)
 {}
 
-CameraFrameData::~CameraFrameData()
+/***********************************************************************************************
+
+    CameraOutput
+
+***********************************************************************************************/
+
+bool CameraOutput::IsOk() const
 {
-    if ( m_frame )
-        delete m_frame;
-    if ( m_thumbnail )
-        delete m_thumbnail;
+    return id >= 0
+           && !name.empty()
+           && thumbnailSize.GetWidth() >= 0 && thumbnailSize.GetHeight() >= 0
+           && metrics;
 }
 
 /***********************************************************************************************
@@ -57,13 +77,21 @@ CameraFrameData::~CameraFrameData()
 
 bool CameraSetupData::IsOk() const
 {
-    return  !name.empty()
+    return  id >= 0
+            && !name.empty()
             && !address.empty()
             && defaultFPS > 0
+            && openTimeout >= 0 && readTimeout >= 0
+            && reconnectDelayInitial > 0 && reconnectDelayMax >= reconnectDelayInitial
+            && reconnectJitter >= 0 && reconnectJitter <= 100
+            && reconnectMaxAttempts >= 0
+            && quietFrameStride >= 1 && motionThreshold >= 0 && motionQuietDelay >= 0
+            && priorityClass >= ThreadPriorityLow && priorityClass <= ThreadPriorityHigh
             && eventSink
             && frames && framesCS
             && frameSize.GetWidth() >= 0 && frameSize.GetHeight() >= 0
-            && commands;
+            && commands
+            && metrics;
 }
 
 /***********************************************************************************************
@@ -74,9 +102,29 @@ bool CameraSetupData::IsOk() const
 
 CameraThread::CameraThread(const CameraSetupData& cameraSetupData)
     : wxThread(wxTHREAD_JOINABLE),
-      m_cameraSetupData(cameraSetupData)
+      m_cameraSetupData(cameraSetupData),
+      m_requestedFPS(cameraSetupData.FPS)
 {
     wxCHECK_RET(m_cameraSetupData.IsOk(), "Invalid camera initialization data");
+
+    CameraOutput output;
+
+    output.id            = m_cameraSetupData.id;
+    output.name          = m_cameraSetupData.name;
+    output.thumbnailSize = m_cameraSetupData.thumbnailSize;
+    output.metrics       = m_cameraSetupData.metrics;
+    m_outputs.push_back(output);
+
+    if ( m_cameraSetupData.quietFrameStride > 1 )
+        m_motionDetector.reset(new MotionDetector());
+
+    m_bgrFrame.reset(new cv::Mat());
+}
+
+CameraThread::~CameraThread()
+{
+    // in case Entry() did not run
+    ReapRecorders(true);
 }
 
 wxThread::ExitCode CameraThread::Entry()
@@ -85,114 +133,288 @@ wxThread::ExitCode CameraThread::Entry()
     SetName(wxString::Format("CameraThread %s", GetCameraName()));
 #endif
 
+    LockStats::SetCurrentThreadName(GetCameraName());
+
     wxLogTrace(TRACE_WXOPENCVCAMERAS, "Entered CameraThread for camera '%s', attempting to start capture...", GetCameraName());
 
+    // also with the defaults, as on Linux the thread inherits the affinity
+    // of the GUI thread, see CameraGridFrame::OnSetGUIThreadAffinity()
+    {
+        CameraCommandData::ThreadSchedulingParameter parameter;
+
+        parameter.priorityClass   = m_cameraSetupData.priorityClass;
+        parameter.cpuAffinityMask = m_cameraSetupData.cpuAffinityMask;
+
+        if ( !SetThreadScheduling(parameter) )
+        {
+            CameraEvent*      evt = new CameraEvent(EVT_CAMERA_COMMAND_RESULT, GetCameraId(), GetCameraName());
+            CameraCommandData evtCommandData;
+
+            evtCommandData.command   = CameraCommandData::SetThreadScheduling;
+            evtCommandData.parameter = parameter;
+            evt->SetPayload(evtCommandData);
+            m_cameraSetupData.eventSink->QueueEvent(evt);
+        }
+    }
+
     if ( !InitCapture() )
     {
         wxLogTrace(TRACE_WXOPENCVCAMERAS, "Failed to start capture for camera '%s'", GetCameraName());
-        m_cameraSetupData.eventSink->QueueEvent(new CameraEvent(EVT_CAMERA_ERROR_OPEN, GetCameraName()));
+        if ( !IsStopRequested() )
+            m_cameraSetupData.eventSink->QueueEvent(new CameraEvent(EVT_CAMERA_ERROR_OPEN, GetCameraId(), GetCameraName()));
         return static_cast<wxThread::ExitCode>(nullptr);
     }
 
-    const bool createThumbnail = m_cameraSetupData.thumbnailSize.GetWidth() > 0 && m_cameraSetupData.thumbnailSize.GetHeight() > 0;
-
-    CameraEvent* evt{nullptr};
-    cv::Mat      matFrame;
-    wxStopWatch  stopWatch;
-    long         msPerFrame;
+    CameraEvent*       evt{nullptr};
+    cv::Mat            matFrame;
+    wxStopWatch        stopWatch;
+    ThreadCPUStopWatch cpuStopWatch;
+    ThreadCPUStopWatch frameCpuStopWatch; // CPU time of a whole frame, except sleeping
+    long               msPerFrame;
+    CameraMetrics&     metrics = *m_cameraSetupData.metrics;
 
-    m_captureStartedTime = wxGetUTCTimeMillis();
-    m_isCapturing = true;
-
-    if ( m_cameraSetupData.frameSize.GetWidth() > 0 )
-        SetCameraResolution(m_cameraSetupData.frameSize);
-    if ( m_cameraSetupData.useMJPGFourCC )
-        SetCameraUseMJPEG();
-    if ( m_cameraSetupData.FPS > 0 )
-        SetCameraFPS(m_cameraSetupData.FPS);
+    // when was the connection lost, 0 if not reconnecting
+    wxLongLong         connectionLostTime{0};
+    int                reconnectAttempts{0};
+    long               reconnectDelay{m_cameraSetupData.reconnectDelayInitial};
 
-    m_cameraSetupData.FPS = m_cameraCapture->get(static_cast<int>(cv::CAP_PROP_FPS));
+    m_random.seed(static_cast<unsigned>(wxGetUTCTimeMillis().GetLo()) + static_cast<unsigned>(GetCameraId()));
 
-    evt = new CameraEvent(EVT_CAMERA_CAPTURE_STARTED, GetCameraName());
-    evt->SetString(wxString(m_cameraCapture->getBackendName()));
-    evt->SetInt(m_cameraSetupData.FPS);
-    m_cameraSetupData.eventSink->QueueEvent(evt);
+    StartCapture();
 
 
-    while ( !TestDestroy() )
+    while ( !TestDestroy() && !IsStopRequested() )
     {
         try
         {
-            CameraFrameDataPtr frameData(new CameraFrameData(GetCameraName(), m_framesCapturedCount++));
+            const AllocationCounts allocationsAtFrameStart = GetCurrentThreadAllocationCounts();
+
+            // times common to all outputs, copied to their frames in CreateOutputFrames()
+            CameraFrameDataPtr frameData(new CameraFrameData(-1, m_framesCapturedCount++));
             wxLongLong         frameCaptureStartedTime;
             CameraCommandData  commandData;
 
             frameCaptureStartedTime = wxGetUTCTimeMillis();
 
-            if ( m_cameraSetupData.commands->ReceiveTimeout(0, commandData) == wxMSGQUEUE_NO_ERROR )
+            if ( ReceiveCameraCommand(commandData) )
                 ProcessCameraCommand(commandData);
+            ReapRecorders(false);
 
             if ( m_cameraSetupData.FPS > 0 )
                 msPerFrame = 1000 / m_cameraSetupData.FPS;
             else
                 msPerFrame = 1000 / m_cameraSetupData.defaultFPS;
 
+            CameraMetrics::Add(metrics.cpuOtherUs, cpuStopWatch.Lap());
+
+            const bool           skipFrame = SkipFrame();
+            bool                 frameRetrieved = false;
+            FrameMemoryChargePtr frameMemoryCharge;
+
+            frameCpuStopWatch.Lap();
             stopWatch.Start();
-            (*m_cameraCapture) >> matFrame;
+            if ( skipFrame )
+            {
+                // neither retrieved nor converted, that is where the CPU is saved
+                frameRetrieved = m_cameraCapture->grab();
+            }
+            else
+            {
+                (*m_cameraCapture) >> matFrame;
+                frameRetrieved = !matFrame.empty();
+            }
             frameData->SetTimeToRetrieve(stopWatch.Time());
             frameData->SetCapturedTime(wxGetUTCTimeMillis());
+            CameraMetrics::Add(metrics.cpuRetrieveUs, cpuStopWatch.Lap());
 
-            if ( !matFrame.empty() )
+            if ( m_reconnectRequested.load(std::memory_order_relaxed) )
             {
-                stopWatch.Start();
-                frameData->SetFrame(new wxBitmap(matFrame.cols, matFrame.rows, 24));
-                ConvertMatBitmapTowxBitmap(matFrame, *frameData->GetFrame());
-                frameData->SetTimeToConvert(stopWatch.Time());
-
-                if ( createThumbnail )
+                m_reconnectRequested = false;
+                if ( m_cameraSetupData.reconnect )
                 {
-                    cv::Mat matThumbnail;
-
-                    stopWatch.Start();
-                    cv::resize(matFrame, matThumbnail, cv::Size(m_cameraSetupData.thumbnailSize.GetWidth(), m_cameraSetupData.thumbnailSize.GetHeight()));
-                    frameData->SetThumbnail(new wxBitmap(m_cameraSetupData.thumbnailSize, 24));
-                    ConvertMatBitmapTowxBitmap(matThumbnail, *frameData->GetThumbnail());
-                    frameData->SetTimeToCreateThumbnail(stopWatch.Time());
+                    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Reconnect requested for camera '%s'.", GetCameraName());
+                    matFrame.release(); // handled as a lost connection below
+                    frameRetrieved = false;
                 }
+            }
 
+            if ( frameRetrieved )
+            {
+                if ( connectionLostTime != 0 )
                 {
-                    wxCriticalSectionLocker locker(*m_cameraSetupData.framesCS);
+                    const wxLongLong timeToRecover = wxGetUTCTimeMillis() - connectionLostTime;
+
+                    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Camera '%s' recovered in %s ms after %d attempt(s).",
+                        GetCameraName(), timeToRecover.ToString(), reconnectAttempts);
 
-                    m_cameraSetupData.frames->push_back(std::move(frameData));
+                    CameraMetrics::Add(metrics.reconnects);
+                    CameraMetrics::Set(metrics.reconnecting, 0);
+                    CameraMetrics::Set(metrics.lastTimeToRecoverMs, timeToRecover.GetValue());
+
+                    evt = new CameraEvent(EVT_CAMERA_RECONNECTED, GetCameraId(), GetCameraName());
+                    evt->SetExtraLong(timeToRecover.ToLong());
+                    m_cameraSetupData.eventSink->QueueEvent(evt);
+
+                    connectionLostTime = 0;
+                    reconnectAttempts  = 0;
+                    reconnectDelay     = m_cameraSetupData.reconnectDelayInitial;
                 }
 
-                if ( m_cameraSetupData.sleepDuration == CameraSetupData::SleepFromFPS )
+                CameraMetrics::Add(metrics.framesCaptured);
+                CameraMetrics::Add(metrics.timeToRetrieveMs, frameData->GetTimeToRetrieve());
+
+                if ( skipFrame )
                 {
-                    const wxLongLong timeSinceFrameCaptureStarted = wxGetUTCTimeMillis() - frameCaptureStartedTime;
-                    const long       timeToSleep = msPerFrame - timeSinceFrameCaptureStarted.GetLo();
+                    const wxInt64 frameCpuUs = frameCpuStopWatch.Lap();
+
+                    // the camera is not stalled, only quiet
+                    for ( const auto& output : m_outputs )
+                        CameraMetrics::Set(output.metrics->lastFrameTimeMs, frameData->GetCapturedTime().GetValue());
 
-                    // exact time slept depends among else on the resolution of the system clock
-                    // for example, for MSW see Remarks in the ::Sleep() documentation at https://docs.microsoft.com/en-us/windows/win32/api/synchapi/nf-synchapi-sleep
-                    if ( timeToSleep > 0 )
-                        Sleep(timeToSleep);
+                    // a quiet degraded camera is counted as quiet
+                    CameraMetrics::Add(m_quiet ? metrics.framesSkippedQuiet : metrics.framesSkippedDegraded);
+                    if ( m_retrievedFrameCpuUs > frameCpuUs )
+                        CameraMetrics::Add(m_quiet ? metrics.motionCpuSavedUs : metrics.degradationCpuSavedUs,
+                                           m_retrievedFrameCpuUs - frameCpuUs);
                 }
-                else if ( m_cameraSetupData.sleepDuration == CameraSetupData::SleepNone )
+                else if ( m_cameraSetupData.passthrough )
                 {
-                    continue;
+                    // the packet is not decoded, so there is nothing to display,
+                    // it is only passed to the subscribers such as CameraRecorder
+                    for ( const auto& output : m_outputs )
+                        CameraMetrics::Set(output.metrics->lastFrameTimeMs, frameData->GetCapturedTime().GetValue());
+
+                    if ( PublishFrame(matFrame, *frameData) )
+                        matFrame.release();
+                    CameraMetrics::Add(metrics.cpuOtherUs, cpuStopWatch.Lap());
                 }
-                else if ( m_cameraSetupData.sleepDuration > 0 )
+                else if ( !m_cameraSetupData.convertRGB && !PrepareRawFrame(matFrame) )
                 {
-                    Sleep(m_cameraSetupData.sleepDuration);
+                    // the capture converts the following frames to BGR
+                    for ( const auto& output : m_outputs )
+                        CameraMetrics::Set(output.metrics->lastFrameTimeMs, frameData->GetCapturedTime().GetValue());
+                    CameraMetrics::Add(metrics.cpuConvertUs, cpuStopWatch.Lap());
+                }
+                else if ( IsDuplicateFrame(matFrame) )
+                {
+                    // the same image as the previous frame, so there is nothing
+                    // new to convert or repaint, but the subscribers and the journal
+                    // still get it, so that recordings keep their timing
+                    for ( const auto& output : m_outputs )
+                        CameraMetrics::Set(output.metrics->lastFrameTimeMs, frameData->GetCapturedTime().GetValue());
+
+                    CameraMetrics::Add(metrics.framesDuplicate);
+                    CameraMetrics::Add(metrics.cpuConvertUs, cpuStopWatch.Lap());
+
+                    WriteJournal(matFrame, *frameData);
+                    if ( PublishFrame(matFrame, *frameData) )
+                        matFrame.release();
+                    CameraMetrics::Add(metrics.cpuOtherUs, cpuStopWatch.Lap());
+                }
+                else if ( !ChargeFrameMemory(GetOutputFramesBytes(matFrame), frameMemoryCharge) )
+                {
+                    // the frames in flight already hold all the memory the budget allows,
+                    // so no bitmaps are created; the subscribers and the journal have their own
+                    m_lastFrameHashValid = false; // not displayed, so the next one is not a duplicate
+                    for ( const auto& output : m_outputs )
+                        CameraMetrics::Set(output.metrics->lastFrameTimeMs, frameData->GetCapturedTime().GetValue());
+
+                    WriteJournal(matFrame, *frameData);
+                    if ( PublishFrame(matFrame, *frameData) )
+                        matFrame.release();
+                    CameraMetrics::Add(metrics.cpuOtherUs, cpuStopWatch.Lap());
                 }
                 else
                 {
-                    wxLogDebug("Invalid sleep duration %d", m_cameraSetupData.sleepDuration);
+                    // held only by the frames, so that it is released with the last of them
+                    frameData->SetMemoryCharge(std::move(frameMemoryCharge));
+
+                    // at the highest degradation level only the thumbnails are shown
+                    if ( m_degradationLevel < 3 )
+                    {
+                        int width = 0, height = 0;
+
+                        stopWatch.Start();
+                        GetMatBitmapSize(matFrame, m_frameConversion.format, width, height);
+                        if ( m_cameraSetupData.nativeImages )
+                        {
+                            std::shared_ptr<NativeImage> image = std::make_shared<NativeImage>(width, height);
+
+                            ConvertMatToNativeImage(matFrame, *image, m_frameConversion);
+                            frameData->SetFrameImage(image);
+                        }
+                        else
+                        {
+                            frameData->SetFrame(std::make_shared<wxBitmap>());
+                            CreatewxBitmapFromMat(matFrame, *frameData->GetFrame(), m_frameConversion);
+                        }
+                        frameData->SetTimeToConvert(stopWatch.Time());
+                        CameraMetrics::Add(metrics.framesConverted);
+                        CameraMetrics::Add(metrics.timeToConvertMs, frameData->GetTimeToConvert());
+                        CameraMetrics::Add(metrics.bytesAllocated, static_cast<size_t>(width) * height * GetPixelBytes());
+                    }
+                    CameraMetrics::Add(metrics.cpuConvertUs, cpuStopWatch.Lap());
+
+                    CameraFrameDataPtrs outputFrames;
+
+                    CreateOutputFrames(matFrame, *frameData, outputFrames, cpuStopWatch);
+                    WriteJournal(matFrame, *frameData);
+
+                    // the capture would otherwise retrieve the next frame
+                    // into the buffer now shared with the subscribers
+                    if ( PublishFrame(matFrame, *frameData) )
+                        matFrame.release();
+
+                    // wxBitmap reference counting is not thread-safe, so the bitmaps
+                    // must be referenced only by the frames passed to the GUI thread
+                    frameData.reset();
+                    {
+                        InstrumentedCriticalSectionLocker locker(*m_cameraSetupData.framesCS);
+
+                        for ( auto& outputFrame : outputFrames )
+                            m_cameraSetupData.frames->push_back(std::move(outputFrame));
+                    }
+                    CameraMetrics::Add(metrics.cpuOtherUs, cpuStopWatch.Lap());
+
+                    // for estimating the CPU time saved by the skipped frames
+                    const wxInt64 frameCpuUs = frameCpuStopWatch.Lap();
+
+                    m_retrievedFrameCpuUs = m_retrievedFrameCpuUs > 0 ? (7 * m_retrievedFrameCpuUs + frameCpuUs) / 8 : frameCpuUs;
                 }
+
+                const AllocationCounts allocationsAtFrameEnd = GetCurrentThreadAllocationCounts();
+
+                CameraMetrics::Add(metrics.allocationCount, allocationsAtFrameEnd.count - allocationsAtFrameStart.count);
+                CameraMetrics::Add(metrics.allocationBytes, allocationsAtFrameEnd.bytes - allocationsAtFrameStart.bytes);
+
+                SleepAfterFrame(frameCaptureStartedTime, msPerFrame);
+                CameraMetrics::Add(metrics.cpuSleepUs, cpuStopWatch.Lap());
             }
-            else // connection to camera lost
+            else // connection to camera lost or read timed out
             {
                 m_isCapturing = false;
-                m_cameraSetupData.eventSink->QueueEvent(new CameraEvent(EVT_CAMERA_ERROR_EMPTY, GetCameraName()));
+
+                if ( IsStopRequested() )
+                    break;
+
+                if ( m_cameraSetupData.reconnect )
+                {
+                    if ( connectionLostTime == 0 )
+                    {
+                        connectionLostTime = frameData->GetCapturedTime();
+                        CameraMetrics::Set(metrics.reconnecting, 1);
+                        m_cameraSetupData.eventSink->QueueEvent(new CameraEvent(EVT_CAMERA_RECONNECTING, GetCameraId(), GetCameraName()));
+                    }
+
+                    if ( Reconnect(reconnectAttempts, reconnectDelay) )
+                        continue;
+
+                    CameraMetrics::Set(metrics.reconnecting, 0);
+                    if ( IsStopRequested() || TestDestroy() )
+                        break;
+                }
+
+                m_cameraSetupData.eventSink->QueueEvent(new CameraEvent(EVT_CAMERA_ERROR_EMPTY, GetCameraId(), GetCameraName()));
                 break;
             }
         }
@@ -200,7 +422,7 @@ wxThread::ExitCode CameraThread::Entry()
         {
             m_isCapturing = false;
 
-            evt = new CameraEvent(EVT_CAMERA_ERROR_EXCEPTION, GetCameraName());
+            evt = new CameraEvent(EVT_CAMERA_ERROR_EXCEPTION, GetCameraId(), GetCameraName());
             evt->SetString(e.what());
             m_cameraSetupData.eventSink->QueueEvent(evt);
 
@@ -210,7 +432,7 @@ wxThread::ExitCode CameraThread::Entry()
         {
             m_isCapturing = false;
 
-            evt = new CameraEvent(EVT_CAMERA_ERROR_EXCEPTION, GetCameraName());
+            evt = new CameraEvent(EVT_CAMERA_ERROR_EXCEPTION, GetCameraId(), GetCameraName());
             evt->SetString("Unknown exception");
             m_cameraSetupData.eventSink->QueueEvent(evt);
 
@@ -218,21 +440,836 @@ wxThread::ExitCode CameraThread::Entry()
         }
     }
 
+    ReapRecorders(true);
+    if ( m_journal )
+    {
+        m_journal.reset();
+        CameraMetrics::Set(metrics.journaling, 0);
+    }
+
     wxLogTrace(TRACE_WXOPENCVCAMERAS, "Exiting CameraThread for camera '%s'...", GetCameraName());
     return static_cast<wxThread::ExitCode>(nullptr);
 }
 
 
+void CameraThread::StartCapture()
+{
+    CameraEvent* evt{nullptr};
+
+    m_captureStartedTime = wxGetUTCTimeMillis();
+    m_isCapturing = true;
+
+    if ( m_cameraSetupData.frameSize.GetWidth() > 0 )
+        SetCameraResolution(m_cameraSetupData.frameSize);
+    if ( m_cameraSetupData.useMJPGFourCC )
+        SetCameraUseMJPEG();
+    if ( m_requestedFPS > 0 )
+        SetCameraFPS(m_requestedFPS);
+    if ( !m_cameraSetupData.passthrough && !m_cameraSetupData.convertRGB )
+    {
+        if ( !m_cameraCapture->set(cv::CAP_PROP_CONVERT_RGB, 0) )
+            wxLogTrace(TRACE_WXOPENCVCAMERAS, "Could not turn off the conversion to RGB for camera '%s'.", GetCameraName());
+    }
+    m_frameConversion = MatConversionOptions();
+
+    m_cameraSetupData.FPS = m_cameraCapture->get(static_cast<int>(cv::CAP_PROP_FPS));
+
+    // give the camera the whole stall timeout to deliver the first frame
+    for ( const auto& output : m_outputs )
+        CameraMetrics::Set(output.metrics->lastFrameTimeMs, m_captureStartedTime.GetValue());
+    UpdateExpectedFrameInterval();
+
+    // a frame from the reopened capture must not be considered a duplicate
+    m_lastFrameHashValid = false;
+
+    // the scene may have changed while the camera was disconnected
+    if ( m_motionDetector )
+    {
+        m_motionDetector->Reset();
+        m_quiet = false;
+        m_lastMotionTime = m_captureStartedTime;
+        CameraMetrics::Set(m_cameraSetupData.metrics->motionQuiet, 0);
+    }
+
+    evt = new CameraEvent(EVT_CAMERA_CAPTURE_STARTED, GetCameraId(), GetCameraName());
+    evt->SetString(wxString(m_cameraCapture->getBackendName()));
+    evt->SetInt(m_cameraSetupData.FPS);
+    evt->SetExtraLong(m_cameraSetupData.passthrough ? 1 : 0);
+    m_cameraSetupData.eventSink->QueueEvent(evt);
+}
+
+void CameraThread::UpdateExpectedFrameInterval()
+{
+    long interval = 1000 / (m_cameraSetupData.FPS > 0 ? m_cameraSetupData.FPS : m_cameraSetupData.defaultFPS);
+
+    if ( m_cameraSetupData.sleepDuration > 0 )
+        interval += m_cameraSetupData.sleepDuration;
+
+    for ( const auto& output : m_outputs )
+        CameraMetrics::Set(output.metrics->expectedFrameIntervalMs, interval);
+}
+
+void CameraThread::SleepAfterFrame(wxLongLong frameCaptureStartedTime, long msPerFrame)
+{
+    if ( m_cameraSetupData.sleepDuration == CameraSetupData::SleepFromFPS )
+    {
+        const wxLongLong timeSinceFrameCaptureStarted = wxGetUTCTimeMillis() - frameCaptureStartedTime;
+        const long       timeToSleep = msPerFrame - timeSinceFrameCaptureStarted.GetLo();
+
+        // exact time slept depends among else on the resolution of the system clock
+        // for example, for MSW see Remarks in the ::Sleep() documentation at https://docs.microsoft.com/en-us/windows/win32/api/synchapi/nf-synchapi-sleep
+        if ( timeToSleep > 0 )
+            Sleep(timeToSleep);
+    }
+    else if ( m_cameraSetupData.sleepDuration > 0 )
+    {
+        Sleep(m_cameraSetupData.sleepDuration);
+    }
+    else if ( m_cameraSetupData.sleepDuration != CameraSetupData::SleepNone )
+    {
+        wxLogDebug("Invalid sleep duration %d", m_cameraSetupData.sleepDuration);
+    }
+}
+
+bool CameraThread::IsDuplicateFrame(const cv::Mat& matFrame)
+{
+    wxStopWatch    stopWatch;
+    const wxUint64 hash = ComputeFrameHash(matFrame);
+    const bool     duplicate = m_lastFrameHashValid && hash == m_lastFrameHash;
+
+    CameraMetrics::Add(m_cameraSetupData.metrics->frameHashTimeUs, stopWatch.TimeInMicro().GetValue());
+
+    m_lastFrameHash = hash;
+    m_lastFrameHashValid = true;
+
+    return duplicate;
+}
+
+bool CameraThread::SkipFrame()
+{
+    // the recorders and the journal need all the frames
+    if ( !m_recorders.empty() || m_journal )
+        return false;
+
+    // a quiet degraded camera is not slowed down twice
+    const int degradedStride = m_degradationLevel >= 2 ? 4 : m_degradationLevel + 1;
+    const int frameStride = std::max(m_quiet ? m_cameraSetupData.quietFrameStride : 1, degradedStride);
+
+    if ( ++m_framesGrabbed < frameStride )
+        return true;
+
+    m_framesGrabbed = 0;
+    return false;
+}
+
+bool CameraThread::ChargeFrameMemory(size_t bytes, FrameMemoryChargePtr& charge)
+{
+    charge.reset();
+
+    if ( !m_cameraSetupData.frameMemoryBudget || bytes == 0 )
+        return true;
+
+    charge = m_cameraSetupData.frameMemoryBudget->Charge(bytes, m_cameraSetupData.metrics);
+    return charge != nullptr;
+}
+
+bool CameraThread::PrepareRawFrame(cv::Mat& matFrame)
+{
+    const int width  = static_cast<int>(m_cameraCapture->get(cv::CAP_PROP_FRAME_WIDTH));
+    const int height = static_cast<int>(m_cameraCapture->get(cv::CAP_PROP_FRAME_HEIGHT));
+
+    // some backends return the raw buffer as a single row,
+    // its size tells the format, given the frame dimensions
+    if ( matFrame.rows == 1 && matFrame.isContinuous() )
+    {
+        const size_t pixels = static_cast<size_t>(width) * height;
+        const size_t bytes  = matFrame.total() * matFrame.elemSize();
+
+        if ( width > 0 && height > 0 && matFrame.depth() == CV_8U )
+        {
+            if ( bytes == pixels * 2 )
+                matFrame = matFrame.reshape(2, height);
+            else if ( bytes == pixels * 3 / 2 && height % 2 == 0 )
+                matFrame = matFrame.reshape(1, height * 3 / 2);
+            else if ( bytes == pixels )
+                matFrame = matFrame.reshape(1, height);
+        }
+        else if ( width > 0 && height > 0 && matFrame.type() == CV_16UC1 && matFrame.total() == pixels )
+        {
+            matFrame = matFrame.reshape(1, height);
+        }
+    }
+
+    // NV12 cannot be told from gray by the type
+    MatPixelFormat format = m_cameraSetupData.rawConversion.format;
+
+    if ( format == MatPixelFormatAuto && matFrame.type() == CV_8UC1
+         && matFrame.rows % 3 == 0 && matFrame.rows / 3 * 2 == height )
+    {
+        format = MatPixelFormatNV12;
+    }
+    format = GetMatPixelFormat(matFrame, format);
+
+    if ( format == MatPixelFormatAuto )
+    {
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "Unknown format of raw frames (type %d, %dx%d) of camera '%s', turning the conversion to RGB back on.",
+                   matFrame.type(), matFrame.cols, matFrame.rows, GetCameraName());
+        m_cameraSetupData.convertRGB = true;
+        m_cameraCapture->set(cv::CAP_PROP_CONVERT_RGB, 1);
+        m_frameConversion = MatConversionOptions();
+        return false;
+    }
+
+    if ( format != m_frameConversion.format )
+    {
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "Camera '%s' delivers raw frames in format %d.", GetCameraName(), static_cast<int>(format));
+        m_frameConversion = m_cameraSetupData.rawConversion;
+        m_frameConversion.format = format;
+    }
+
+    m_bgrFrameValid = false;
+    return true;
+}
+
+const cv::Mat& CameraThread::GetBGRFrame(const cv::Mat& matFrame)
+{
+    if ( m_frameConversion.format == MatPixelFormatAuto || m_frameConversion.format == MatPixelFormatBGR )
+        return matFrame;
+
+    if ( !m_bgrFrameValid )
+    {
+        ConvertMatToBGR(matFrame, *m_bgrFrame, m_frameConversion);
+        m_bgrFrameValid = true;
+    }
+
+    return *m_bgrFrame;
+}
+
+size_t CameraThread::GetOutputFramesBytes(const cv::Mat& matFrame) const
+{
+    // as in CreateOutputFrames(), outputs with the same thumbnail size share it
+    std::vector<wxSize> thumbnailSizes;
+    size_t              bytes = 0;
+    int                 width = 0, height = 0;
+
+    if ( m_degradationLevel < 3 && GetMatBitmapSize(matFrame, m_frameConversion.format, width, height) )
+        bytes = static_cast<size_t>(width) * height * GetPixelBytes();
+
+    for ( const auto& output : m_outputs )
+    {
+        const wxSize& size = output.thumbnailSize;
+
+        if ( size.GetWidth() <= 0 || size.GetHeight() <= 0
+             || std::find(thumbnailSizes.begin(), thumbnailSizes.end(), size) != thumbnailSizes.end() )
+        {
+            continue;
+        }
+
+        thumbnailSizes.push_back(size);
+        bytes += static_cast<size_t>(size.GetWidth()) * size.GetHeight() * GetPixelBytes();
+    }
+
+    return bytes;
+}
+
+void CameraThread::SetDegradationLevel(int level)
+{
+    wxCHECK_RET(level >= 0 && level <= 3, "Invalid degradation level");
+
+    if ( level == m_degradationLevel )
+        return;
+
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Degradation level of camera '%s' changed from %d to %d.",
+               GetCameraName(), m_degradationLevel, level);
+
+    m_degradationLevel = level;
+    CameraMetrics::Set(m_cameraSetupData.metrics->degradationLevel, level);
+
+    // e.g., the full frame not sent at level 3 must be sent even for a static scene
+    m_lastFrameHashValid = false;
+}
+
+bool CameraThread::SetThreadScheduling(CameraCommandData::ThreadSchedulingParameter& parameter)
+{
+    std::string errorMessage;
+
+    // an unprivileged thread on Linux may not be able to set even
+    // the normal priority it already has, so it is set only when changed
+    if ( parameter.priorityClass != m_threadPriorityClass )
+    {
+        if ( SetCurrentThreadPriorityClass(parameter.priorityClass, errorMessage) )
+        {
+            m_threadPriorityClass = parameter.priorityClass;
+            CameraMetrics::Set(m_cameraSetupData.metrics->threadPriorityClass, m_threadPriorityClass);
+        }
+    }
+
+    if ( !errorMessage.empty() || !SetCurrentThreadAffinity(parameter.cpuAffinityMask, errorMessage) )
+    {
+        parameter.errorMessage = errorMessage;
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "Could not set the scheduling of the thread of camera '%s': %s",
+                   GetCameraName(), parameter.errorMessage);
+        return false;
+    }
+
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Thread of camera '%s' has %s priority, CPUs: %s.", GetCameraName(),
+               GetThreadPriorityClassName(parameter.priorityClass),
+               parameter.cpuAffinityMask ? FormatCPUList(parameter.cpuAffinityMask) : std::string("any"));
+
+    m_cameraSetupData.priorityClass   = parameter.priorityClass;
+    m_cameraSetupData.cpuAffinityMask = parameter.cpuAffinityMask;
+
+    return true;
+}
+
+void CameraThread::UpdateMotion(const cv::Mat& thumbnail, wxLongLong capturedTime)
+{
+    CameraMetrics& metrics = *m_cameraSetupData.metrics;
+
+    m_lastMotionScore = m_motionDetector->Update(thumbnail);
+    CameraMetrics::Set(metrics.motionScore, m_lastMotionScore);
+
+    if ( m_lastMotionScore >= m_cameraSetupData.motionThreshold )
+    {
+        if ( m_quiet )
+        {
+            // the motion may have started anytime since the previous
+            // scored frame, so this is the longest it could go unnoticed
+            const wxLongLong reactionTime = capturedTime - m_lastAnalysedTime;
+
+            m_quiet = false;
+            CameraMetrics::Set(metrics.motionQuiet, 0);
+            CameraMetrics::Add(metrics.motionReactions);
+            CameraMetrics::Add(metrics.motionReactionTimeMs, reactionTime.GetValue());
+            CameraMetrics::Set(metrics.motionLastReactionTimeMs, reactionTime.GetValue());
+            wxLogTrace(TRACE_WXOPENCVCAMERAS, "Motion in quiet camera '%s' (score %d), restored the full frame rate in %s ms.",
+                       GetCameraName(), m_lastMotionScore, reactionTime.ToString());
+        }
+        m_lastMotionTime = capturedTime;
+    }
+    else if ( !m_quiet && capturedTime - m_lastMotionTime >= m_cameraSetupData.motionQuietDelay )
+    {
+        m_quiet = true;
+        m_framesGrabbed = 0;
+        CameraMetrics::Set(metrics.motionQuiet, 1);
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "Camera '%s' is quiet, retrieving only every %d. frame.",
+                   GetCameraName(), m_cameraSetupData.quietFrameStride);
+    }
+
+    m_lastAnalysedTime = capturedTime;
+}
+
+void CameraThread::CreateOutputFrames(const cv::Mat& matFrame, const CameraFrameData& frameData,
+                                      CameraFrameDataPtrs& outputFrames, ThreadCPUStopWatch& cpuStopWatch)
+{
+    struct Thumbnail
+    {
+        wxSize                    size;
+        std::shared_ptr<wxBitmap> bitmap;
+        NativeImagePtr            image; // instead of bitmap with CameraSetupData::nativeImages
+        long                      timeToCreate{0};
+        cv::Mat                   mat;
+        cv::Mat                   bgr;   // only when needed, see GetBGR() below
+    };
+
+    // outputs requesting a thumbnail of the same size share it
+    std::vector<Thumbnail> thumbnails;
+    CameraMetrics&         sourceMetrics = *m_cameraSetupData.metrics;
+    wxStopWatch            stopWatch;
+    // YUV cannot be resized as it is, the other formats are resized before converting
+    const bool             resizeBGR = m_frameConversion.format == MatPixelFormatYUYV
+                                       || m_frameConversion.format == MatPixelFormatNV12;
+    MatConversionOptions   thumbnailConversion = m_frameConversion;
+
+    // determined by the resized image
+    thumbnailConversion.format = MatPixelFormatAuto;
+
+    // MotionDetector and the thumbnail subscribers on frameBus need BGR
+    auto GetBGR = [&thumbnailConversion](Thumbnail& thumbnail) -> const cv::Mat&
+    {
+        if ( thumbnail.bgr.empty() )
+            ConvertMatToBGR(thumbnail.mat, thumbnail.bgr, thumbnailConversion);
+        return thumbnail.bgr;
+    };
+
+    for ( const auto& output : m_outputs )
+    {
+        CameraFrameDataPtr outputFrame(new CameraFrameData(frameData));
+        CameraMetrics&     outputMetrics = *output.metrics;
+
+        outputFrame->SetCameraId(output.id);
+
+        if ( output.thumbnailSize.GetWidth() > 0 && output.thumbnailSize.GetHeight() > 0 )
+        {
+            auto thumbnailIt = std::find_if(thumbnails.begin(), thumbnails.end(),
+                                            [&output](const Thumbnail& t) { return t.size == output.thumbnailSize; });
+
+            if ( thumbnailIt == thumbnails.end() )
+            {
+                Thumbnail thumbnail;
+                cv::Mat   matThumbnail;
+
+                stopWatch.Start();
+                cv::resize(resizeBGR ? GetBGRFrame(matFrame) : matFrame, matThumbnail,
+                           cv::Size(output.thumbnailSize.GetWidth(), output.thumbnailSize.GetHeight()));
+                thumbnail.size = output.thumbnailSize;
+                if ( m_cameraSetupData.nativeImages )
+                {
+                    std::shared_ptr<NativeImage> image = std::make_shared<NativeImage>(matThumbnail.cols, matThumbnail.rows);
+
+                    ConvertMatToNativeImage(matThumbnail, *image, thumbnailConversion);
+                    thumbnail.image = image;
+                }
+                else
+                {
+                    thumbnail.bitmap = std::make_shared<wxBitmap>();
+                    CreatewxBitmapFromMat(matThumbnail, *thumbnail.bitmap, thumbnailConversion);
+                }
+                thumbnail.timeToCreate = stopWatch.Time();
+                thumbnail.mat = matThumbnail;
+
+                CameraMetrics::Add(outputMetrics.timeToCreateThumbnailMs, thumbnail.timeToCreate);
+                CameraMetrics::Add(sourceMetrics.bytesAllocated, matThumbnail.total() * GetPixelBytes());
+                CameraMetrics::Add(outputMetrics.cpuThumbnailUs, cpuStopWatch.Lap());
+
+                thumbnailIt = thumbnails.insert(thumbnails.end(), thumbnail);
+            }
+
+            outputFrame->SetThumbnail(thumbnailIt->bitmap);
+            outputFrame->SetThumbnailImage(thumbnailIt->image);
+            outputFrame->SetTimeToCreateThumbnail(thumbnailIt->timeToCreate);
+
+            if ( m_cameraSetupData.frameBus && m_cameraSetupData.frameBus->HasSubscribers(output.id, true) )
+            {
+                PublishThumbnail(GetBGR(*thumbnailIt), output.id, frameData);
+                CameraMetrics::Add(outputMetrics.cpuThumbnailUs, cpuStopWatch.Lap());
+            }
+        }
+
+        CameraMetrics::Set(outputMetrics.lastFrameTimeMs, frameData.GetCapturedTime().GetValue());
+        CameraMetrics::Add(outputMetrics.framesPending, 1);
+        outputFrames.push_back(std::move(outputFrame));
+    }
+
+    // the first thumbnail created
+    if ( m_motionDetector && !thumbnails.empty() && !GetBGR(thumbnails.front()).empty() )
+    {
+        UpdateMotion(thumbnails.front().bgr, frameData.GetCapturedTime());
+        CameraMetrics::Add(sourceMetrics.cpuThumbnailUs, cpuStopWatch.Lap());
+
+        for ( auto& outputFrame : outputFrames )
+            outputFrame->SetMotion(m_lastMotionScore, m_quiet);
+    }
+}
+
+void CameraThread::PublishThumbnail(const cv::Mat& bgrThumbnail, int outputId, const CameraFrameData& frameData)
+{
+    if ( bgrThumbnail.empty() )
+        return;
+
+    // thumbnails are small, so they are not charged to the frame memory budget
+    std::shared_ptr<BusFrame> busFrame = std::make_shared<BusFrame>();
+
+    busFrame->cameraId     = outputId;
+    busFrame->frameNumber  = frameData.GetFrameNumber();
+    busFrame->capturedTime = frameData.GetCapturedTime();
+    busFrame->image        = bgrThumbnail; // no copy, just a reference
+    busFrame->thumbnail    = true;
+
+    m_cameraSetupData.frameBus->Publish(busFrame);
+}
+
+bool CameraThread::PublishFrame(const cv::Mat& matFrame, const CameraFrameData& frameData)
+{
+    if ( !m_cameraSetupData.frameBus )
+        return false;
+
+    bool                 published = false;
+    bool                 charged = false;
+    FrameMemoryChargePtr memoryCharge;
+    const cv::Mat*       image = &matFrame; // the subscribers get BGR, unless the packets are passed through
+
+    for ( const auto& output : m_outputs )
+    {
+        if ( !m_cameraSetupData.frameBus->HasSubscribers(output.id) )
+            continue;
+
+        // the image is shared by the frames for all outputs, so it is charged only once;
+        // not publishing it means the capture can reuse its buffer instead of allocating a new one
+        if ( !charged )
+        {
+            if ( !m_cameraSetupData.passthrough )
+                image = &GetBGRFrame(matFrame);
+            if ( !ChargeFrameMemory(image->total() * image->elemSize(), memoryCharge) )
+                return false;
+            charged = true;
+        }
+
+        std::shared_ptr<BusFrame> busFrame = std::make_shared<BusFrame>();
+
+        busFrame->cameraId     = output.id;
+        busFrame->frameNumber  = frameData.GetFrameNumber();
+        busFrame->capturedTime = frameData.GetCapturedTime();
+        busFrame->image        = *image; // no copy, just a reference
+        busFrame->memoryCharge = memoryCharge;
+
+        if ( m_cameraSetupData.passthrough )
+        {
+            busFrame->encoded  = true;
+            busFrame->fourCC   = m_passthroughFourCC;
+#if CHECK_OPENCV_VERSION(4,5,2)
+            busFrame->keyFrame = m_cameraCapture->get(cv::CAP_PROP_LRF_HAS_KEY_FRAME) != 0.;
+#endif
+            if ( m_codecExtraData )
+                busFrame->codecExtraData = *m_codecExtraData;
+        }
+
+        if ( m_cameraSetupData.frameBus->Publish(busFrame) > 0 )
+        {
+            CameraMetrics::Add(output.metrics->framesPublished);
+            published = true;
+        }
+    }
+
+    // the converted frame is now shared too, the next one is converted into a new buffer
+    if ( published && image != &matFrame )
+    {
+        m_bgrFrame->release();
+        m_bgrFrameValid = false;
+        return false;
+    }
+
+    return published;
+}
+
+void CameraThread::AddOutput(const CameraOutput& output)
+{
+    wxCHECK_RET(output.IsOk(), "Invalid camera output");
+
+    m_outputs.push_back(output);
+
+    // the new output needs its first thumbnail even for a static scene
+    m_lastFrameHashValid = false;
+
+    CameraMetrics::Set(output.metrics->lastFrameTimeMs, wxGetUTCTimeMillis().GetValue());
+    UpdateExpectedFrameInterval();
+
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Added output '%s' to camera '%s'.", output.name, GetCameraName());
+}
+
+void CameraThread::RemoveOutput(int id)
+{
+    auto it = std::find_if(m_outputs.begin(), m_outputs.end(),
+                           [id](const CameraOutput& o) { return o.id == id; });
+
+    wxCHECK_RET(it != m_outputs.end(), "Camera output to remove not found");
+
+    StopRecording(id);
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Removed output '%s' from camera '%s'.", it->name, GetCameraName());
+    m_outputs.erase(it);
+}
+
+bool CameraThread::StartRecording(CameraCommandData::RecordingParameter& parameter)
+{
+    auto outputIt = std::find_if(m_outputs.begin(), m_outputs.end(),
+                                 [&parameter](const CameraOutput& o) { return o.id == parameter.cameraId; });
+
+    if ( outputIt == m_outputs.end() )
+    {
+        parameter.errorMessage = "Unknown camera.";
+        return false;
+    }
+
+    if ( !m_cameraSetupData.frameBus )
+    {
+        parameter.errorMessage = "Recording requires a frame bus.";
+        return false;
+    }
+
+    if ( std::any_of(m_recorders.begin(), m_recorders.end(),
+                     [&parameter](const CameraRecorder* r) { return r->GetCameraId() == parameter.cameraId; }) )
+    {
+        parameter.errorMessage = "The camera is already being recorded.";
+        return false;
+    }
+
+    CameraRecorder::Setup setup;
+
+    setup.cameraId        = outputIt->id;
+    setup.cameraName      = outputIt->name;
+    setup.directory       = parameter.directory;
+    setup.fileNamePrefix  = parameter.fileNamePrefix;
+    setup.fourCC          = parameter.fourCC;
+    setup.FPS             = m_cameraSetupData.FPS > 0 ? m_cameraSetupData.FPS : m_cameraSetupData.defaultFPS;
+    setup.segmentDuration = parameter.segmentDuration;
+    setup.segmentMaxBytes = parameter.segmentMaxBytes;
+    setup.queueCapacity   = parameter.queueCapacity;
+    setup.frameBus        = m_cameraSetupData.frameBus;
+    setup.eventSink       = m_cameraSetupData.eventSink;
+    setup.metrics         = outputIt->metrics;
+
+    if ( !setup.IsOk() )
+    {
+        parameter.errorMessage = "Invalid recording parameters.";
+        return false;
+    }
+
+    std::unique_ptr<CameraRecorder> recorder(new CameraRecorder(setup));
+
+    if ( recorder->Run() != wxTHREAD_NO_ERROR )
+    {
+        parameter.errorMessage = "Could not create the recorder thread.";
+        return false;
+    }
+
+    m_recorders.push_back(recorder.release());
+    return true;
+}
+
+bool CameraThread::StopRecording(int id)
+{
+    auto it = std::find_if(m_recorders.begin(), m_recorders.end(),
+                           [id](const CameraRecorder* r) { return r->GetCameraId() == id; });
+
+    if ( it == m_recorders.end() )
+        return false;
+
+    // the recorder may still be writing the queued frames,
+    // so it is joined later, without blocking the capture
+    (*it)->RequestStop();
+    m_stoppingRecorders.push_back(*it);
+    m_recorders.erase(it);
+
+    return true;
+}
+
+void CameraThread::ReapRecorders(bool stopAll)
+{
+    for ( auto it = m_recorders.begin(); it != m_recorders.end(); )
+    {
+        // a recorder exits on its own after an error
+        if ( stopAll || (*it)->IsFinished() )
+        {
+            (*it)->RequestStop();
+            m_stoppingRecorders.push_back(*it);
+            it = m_recorders.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    for ( auto it = m_stoppingRecorders.begin(); it != m_stoppingRecorders.end(); )
+    {
+        if ( stopAll || (*it)->IsFinished() )
+        {
+            (*it)->Wait(wxTHREAD_WAIT_BLOCK);
+            delete *it;
+            it = m_stoppingRecorders.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+bool CameraThread::StartJournal(CameraCommandData::JournalParameter& parameter)
+{
+    if ( m_journal )
+    {
+        parameter.errorMessage.Printf("The camera is already being journaled to '%s'.", m_journal->GetFileName());
+        return false;
+    }
+
+    if ( m_cameraSetupData.passthrough )
+    {
+        parameter.errorMessage = "Compressed frames cannot be journaled, enable decoding them first.";
+        return false;
+    }
+
+    std::unique_ptr<FrameJournal> journal(new FrameJournal);
+
+    if ( !journal->Open(parameter.fileName, parameter.size, GetCameraName(), GetCameraAddress(), parameter.errorMessage) )
+        return false;
+
+    m_journal = std::move(journal);
+    CameraMetrics::Set(m_cameraSetupData.metrics->journaling, 1);
+    return true;
+}
+
+void CameraThread::WriteJournal(const cv::Mat& matFrame, const CameraFrameData& frameData)
+{
+    if ( !m_journal )
+        return;
+
+    CameraMetrics& metrics = *m_cameraSetupData.metrics;
+    wxStopWatch    stopWatch;
+
+    if ( m_journal->Write(matFrame, m_frameConversion.format, frameData) )
+    {
+        CameraMetrics::Add(metrics.journalFramesWritten);
+        CameraMetrics::Add(metrics.journalWriteTimeUs, stopWatch.TimeInMicro().GetValue());
+    }
+    else
+    {
+        CameraMetrics::Add(metrics.journalFramesSkipped);
+    }
+}
+
+bool CameraThread::Reconnect(int& attempts, long& delay)
+{
+    CameraMetrics& metrics = *m_cameraSetupData.metrics;
+
+    while ( m_cameraSetupData.reconnectMaxAttempts == 0 || attempts < m_cameraSetupData.reconnectMaxAttempts )
+    {
+        const long jitter = delay * m_cameraSetupData.reconnectJitter / 100;
+        long       delayWithJitter = delay;
+
+        if ( jitter > 0 )
+            delayWithJitter += std::uniform_int_distribution<long>(-jitter, jitter)(m_random);
+
+        attempts++;
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "Reconnecting to camera '%s' in %ld ms (attempt %d)...",
+            GetCameraName(), delayWithJitter, attempts);
+
+        if ( !InterruptibleSleep(delayWithJitter) )
+            return false;
+
+        delay = std::min(delay * 2, m_cameraSetupData.reconnectDelayMax);
+        CameraMetrics::Add(metrics.reconnectAttempts);
+
+        // the old capture must be released first, e.g. for a local camera
+        m_cameraCapture.reset();
+
+        if ( InitCapture() )
+        {
+            StartCapture();
+            return true;
+        }
+
+        if ( IsStopRequested() || TestDestroy() )
+            return false;
+    }
+
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Giving up reconnecting to camera '%s' after %d attempt(s).", GetCameraName(), attempts);
+    return false;
+}
+
+bool CameraThread::InterruptibleSleep(long milliseconds)
+{
+    // short enough not to delay stopping the thread noticeably
+    static const long sliceDuration = 50;
+
+    wxStopWatch stopWatch;
+
+    while ( !IsStopRequested() && !TestDestroy() )
+    {
+        const long remaining = milliseconds - stopWatch.Time();
+
+        if ( remaining <= 0 )
+            return true;
+
+        Sleep(std::min(remaining, sliceDuration));
+    }
+
+    return false;
+}
+
 bool CameraThread::InitCapture()
 {
     unsigned long cameraIndex = 0;
 
+#if CHECK_OPENCV_VERSION(4,5,4)
+    // the timeouts must be passed when opening the capture
+    // for the open timeout to be applied
+    std::vector<int> params;
+
+    if ( m_cameraSetupData.openTimeout > 0 )
+    {
+        params.push_back(cv::CAP_PROP_OPEN_TIMEOUT_MSEC);
+        params.push_back(m_cameraSetupData.openTimeout);
+    }
+    if ( m_cameraSetupData.readTimeout > 0 )
+    {
+        params.push_back(cv::CAP_PROP_READ_TIMEOUT_MSEC);
+        params.push_back(m_cameraSetupData.readTimeout);
+    }
+
+    if ( m_cameraSetupData.address.ToCULong(&cameraIndex) )
+        m_cameraCapture.reset(new cv::VideoCapture(cameraIndex, m_cameraSetupData.apiPreference, params));
+    else
+        m_cameraCapture.reset(new cv::VideoCapture(m_cameraSetupData.address.ToStdString(), m_cameraSetupData.apiPreference, params));
+#else
+    if ( m_cameraSetupData.openTimeout > 0 || m_cameraSetupData.readTimeout > 0 )
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "Capture timeouts for camera '%s' ignored, they require OpenCV 4.5.4 or newer.", GetCameraName());
+
     if ( m_cameraSetupData.address.ToCULong(&cameraIndex) )
         m_cameraCapture.reset(new cv::VideoCapture(cameraIndex, m_cameraSetupData.apiPreference));
     else
         m_cameraCapture.reset(new cv::VideoCapture(m_cameraSetupData.address.ToStdString(), m_cameraSetupData.apiPreference));
+#endif
+
+    if ( !m_cameraCapture->isOpened() )
+        return false;
+
+    if ( m_cameraSetupData.passthrough && !InitPassthrough() )
+    {
+        // the backend's capability, reopening the capture would fail the same way
+        CameraEvent* evt = new CameraEvent(EVT_CAMERA_ERROR_PASSTHROUGH, GetCameraId(), GetCameraName());
+
+        evt->SetString(wxString(m_cameraCapture->getBackendName()));
+        m_cameraSetupData.eventSink->QueueEvent(evt);
+
+        m_cameraSetupData.passthrough = false;
+    }
 
-    return m_cameraCapture->isOpened();
+    return true;
+}
+
+bool CameraThread::InitPassthrough()
+{
+    // only the FFmpeg backend supports the raw stream mode
+    if ( !m_cameraCapture->set(cv::CAP_PROP_FORMAT, -1) )
+    {
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "Backend '%s' of camera '%s' cannot pass through compressed frames.",
+            wxString(m_cameraCapture->getBackendName()), GetCameraName());
+        return false;
+    }
+
+    m_passthroughFourCC = static_cast<int>(m_cameraCapture->get(cv::CAP_PROP_FOURCC));
+    m_codecExtraData.reset();
+
+#if CHECK_OPENCV_VERSION(4,5,2)
+    // e.g. H.264 SPS and PPS which may not be repeated in the stream,
+    // but are needed at the start of every recorded file
+    const int extraDataIndex = static_cast<int>(m_cameraCapture->get(cv::CAP_PROP_CODEC_EXTRADATA_INDEX));
+    cv::Mat   extraData;
+
+    if ( m_cameraCapture->retrieve(extraData, extraDataIndex) && !extraData.empty() )
+        m_codecExtraData.reset(new cv::Mat(extraData));
+#endif
+
+    return true;
+}
+
+void CameraThread::SetPassthrough(bool passthrough)
+{
+    if ( passthrough == m_cameraSetupData.passthrough )
+        return;
+
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Camera '%s' switches to %s frames.",
+        GetCameraName(), passthrough ? "passing through compressed" : "decoding");
+
+    m_cameraSetupData.passthrough = passthrough;
+
+    // the raw stream mode can be set only before the first frame is retrieved
+    m_cameraCapture.reset();
+    if ( InitCapture() )
+        StartCapture();
+    else
+        m_isCapturing = false; // the next read fails and is handled as a lost connection
 }
 
 void CameraThread::SetCameraResolution(const wxSize& resolution)
@@ -265,9 +1302,54 @@ void CameraThread::SetCameraFPS(const int FPS)
 }
 
 
+bool CameraThread::ReceiveCameraCommand(CameraCommandData& commandData)
+{
+    if ( !LockStats::IsEnabled() )
+        return m_cameraSetupData.commands->ReceiveTimeout(0, commandData) == wxMSGQUEUE_NO_ERROR;
+
+    typedef std::chrono::steady_clock Clock;
+
+    // wxMessageQueue's mutex cannot be instrumented directly, so the whole call,
+    // i.e., locking, checking for a message and unlocking, is recorded as waiting
+    const Clock::time_point startedTime = Clock::now();
+    const bool              received = m_cameraSetupData.commands->ReceiveTimeout(0, commandData) == wxMSGQUEUE_NO_ERROR;
+
+    m_cameraSetupData.metrics->commandQueueStats.Record(
+        std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - startedTime).count(), 0);
+
+    return received;
+}
+
 void CameraThread::ProcessCameraCommand(const CameraCommandData& commandData)
 {
-    CameraEvent*      evt = new CameraEvent(EVT_CAMERA_COMMAND_RESULT, GetCameraName());
+    // commands without a result
+    if ( commandData.command == CameraCommandData::SetPassthrough )
+    {
+        SetPassthrough(commandData.parameter.As<bool>());
+        return;
+    }
+    if ( commandData.command == CameraCommandData::AddOutput )
+    {
+        AddOutput(commandData.parameter.As<CameraOutput>());
+        return;
+    }
+    if ( commandData.command == CameraCommandData::RemoveOutput )
+    {
+        RemoveOutput(commandData.parameter.As<int>());
+        return;
+    }
+    if ( commandData.command == CameraCommandData::SetDegradationLevel )
+    {
+        SetDegradationLevel(commandData.parameter.As<int>());
+        return;
+    }
+    if ( commandData.command == CameraCommandData::NeedFullFrame )
+    {
+        m_lastFrameHashValid = false;
+        return;
+    }
+
+    CameraEvent*      evt = new CameraEvent(EVT_CAMERA_COMMAND_RESULT, GetCameraId(), GetCameraName());
     CameraCommandData evtCommandData;
 
     evtCommandData.command = commandData.command;
@@ -282,14 +1364,72 @@ void CameraThread::ProcessCameraCommand(const CameraCommandData& commandData)
         cameraInfo.cameraCaptureBackendName = m_cameraCapture->getBackendName();
         cameraInfo.cameraAddress            = m_cameraSetupData.address;
 
+        const CameraMetrics& metrics = *m_cameraSetupData.metrics;
+
+        cameraInfo.cpuTimeAvailable   = ThreadCPUStopWatch().IsAvailable();
+        cameraInfo.cpuTimeRetrieveUs  = CameraMetrics::Get(metrics.cpuRetrieveUs);
+        cameraInfo.cpuTimeConvertUs   = CameraMetrics::Get(metrics.cpuConvertUs);
+        cameraInfo.cpuTimeThumbnailUs = CameraMetrics::Get(metrics.cpuThumbnailUs);
+        cameraInfo.cpuTimeSleepUs     = CameraMetrics::Get(metrics.cpuSleepUs);
+        cameraInfo.cpuTimeOtherUs     = CameraMetrics::Get(metrics.cpuOtherUs);
+
+        cameraInfo.allocationsTracked = WXOPENCVCAMERAS_TRACK_ALLOCATIONS != 0;
+        cameraInfo.allocationCount    = CameraMetrics::Get(metrics.allocationCount);
+        cameraInfo.allocationBytes    = CameraMetrics::Get(metrics.allocationBytes);
+
+        cameraInfo.priorityClass   = m_cameraSetupData.priorityClass;
+        cameraInfo.cpuAffinityMask = m_cameraSetupData.cpuAffinityMask;
+
         evtCommandData.parameter = cameraInfo;
     }
     else if ( commandData.command == CameraCommandData::SetThreadSleepDuration )
     {
         m_cameraSetupData.sleepDuration = commandData.parameter.As<long>();
+        UpdateExpectedFrameInterval();
 
         evtCommandData.parameter = m_cameraSetupData.sleepDuration;
     }
+    else if ( commandData.command == CameraCommandData::StartRecording )
+    {
+        CameraCommandData::RecordingParameter parameter = commandData.parameter.As<CameraCommandData::RecordingParameter>();
+
+        parameter.succeeded = StartRecording(parameter);
+        evtCommandData.parameter = parameter;
+    }
+    else if ( commandData.command == CameraCommandData::StopRecording )
+    {
+        const int id = commandData.parameter.As<int>();
+
+        if ( !StopRecording(id) )
+            wxLogTrace(TRACE_WXOPENCVCAMERAS, "Camera id %d to stop recording is not being recorded.", id);
+        evtCommandData.parameter = id;
+    }
+    else if ( commandData.command == CameraCommandData::StartJournal )
+    {
+        CameraCommandData::JournalParameter parameter = commandData.parameter.As<CameraCommandData::JournalParameter>();
+
+        parameter.succeeded = StartJournal(parameter);
+        evtCommandData.parameter = parameter;
+    }
+    else if ( commandData.command == CameraCommandData::StopJournal )
+    {
+        wxString fileName;
+
+        if ( m_journal )
+        {
+            fileName = m_journal->GetFileName();
+            m_journal.reset();
+            CameraMetrics::Set(m_cameraSetupData.metrics->journaling, 0);
+        }
+        evtCommandData.parameter = fileName;
+    }
+    else if ( commandData.command == CameraCommandData::SetThreadScheduling )
+    {
+        CameraCommandData::ThreadSchedulingParameter parameter = commandData.parameter.As<CameraCommandData::ThreadSchedulingParameter>();
+
+        parameter.succeeded = SetThreadScheduling(parameter);
+        evtCommandData.parameter = parameter;
+    }
     else if ( commandData.command == CameraCommandData::GetVCProp )
     {
         const CameraCommandData::VCPropCommandParameters params = commandData.parameter.As<CameraCommandData::VCPropCommandParameters>();
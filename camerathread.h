@@ -18,12 +18,45 @@
 
 #include <atomic>
 #include <memory>
+#include <random>
 #include <vector>
 
+#include "bitmappool.h"
+#include "convertmattowxbmp.h"
+#include "framememorybudget.h"
+#include "lockstats.h"
+#include "metrics.h"
+#include "threadscheduling.h"
 
 // for wxLogTrace
 #define TRACE_WXOPENCVCAMERAS "WXOPENCVCAMERAS"
 
+// OpenCV headers must be included before using this macro
+#define CHECK_OPENCV_VERSION(major,minor,revision) \
+    (CV_VERSION_MAJOR >  (major) || \
+    (CV_VERSION_MAJOR == (major) && CV_VERSION_MINOR >  (minor)) || \
+    (CV_VERSION_MAJOR == (major) && CV_VERSION_MINOR == (minor) && CV_VERSION_REVISION >= (revision)))
+
+/***********************************************************************************************
+
+    CameraOutput: a logical camera fed by CameraThread. All outputs of a thread share
+                  the captured frame, each has its own thumbnail size and metrics.
+
+***********************************************************************************************/
+
+struct CameraOutput
+{
+    int              id{-1};  // see CameraSetupData::id
+    wxString         name;
+    wxSize           thumbnailSize; // no thumbnail when width or height is 0
+    // counters and gauges specific to this output, i.e. thumbnails and frames
+    // processed by the GUI; the capture related ones are in CameraSetupData::metrics
+    CameraMetricsPtr metrics;
+
+    bool IsOk() const;
+};
+
+
 /***********************************************************************************************
 
     CameraCommandData: a struct used by the main thread to communicate with CameraThread.
@@ -50,6 +83,61 @@ struct CameraCommandData
         wxULongLong framesCapturedCount{0};
         wxString    cameraCaptureBackendName;
         wxString    cameraAddress;
+
+        // CPU time consumed by the camera thread in microseconds
+        bool        cpuTimeAvailable{false};
+        wxULongLong cpuTimeRetrieveUs{0};  // grabbing and decoding the frame
+        wxULongLong cpuTimeConvertUs{0};   // converting the frame to wxBitmap
+        wxULongLong cpuTimeThumbnailUs{0}; // resizing the frame and converting it to wxBitmap
+        wxULongLong cpuTimeSleepUs{0};
+        wxULongLong cpuTimeOtherUs{0};
+
+        // operator new calls and cv::Mat allocations for captured frames, see alloctracker.h
+        bool        allocationsTracked{false};
+        wxULongLong allocationCount{0};
+        wxULongLong allocationBytes{0};
+
+        // see CameraSetupData::priorityClass
+        int             priorityClass{ThreadPriorityNormal};
+        CPUAffinityMask cpuAffinityMask{0};
+    };
+
+    // see CameraRecorder
+    struct RecordingParameter
+    {
+        int         cameraId{-1}; // CameraOutput::id
+        wxString    directory;
+        wxString    fileNamePrefix; // a segment file name is prefix_YYYYMMDD-HHMMSS-mmm.avi
+        int         fourCC{0}; // 0 = 'MJPG'
+        long        segmentDuration{600}; // in seconds, 0 = no time-based rotation
+        wxULongLong segmentMaxBytes{0};   // 0 = no size-based rotation
+        size_t      queueCapacity{30};    // frames waiting to be written
+
+        // only in the result
+        bool        succeeded{false};
+        wxString    errorMessage;
+    };
+
+    // see FrameJournal
+    struct JournalParameter
+    {
+        wxString    fileName;
+        wxULongLong size{0}; // of the file in bytes, determines how many frames it holds
+
+        // only in the result
+        bool        succeeded{false};
+        wxString    errorMessage;
+    };
+
+    // see CameraSetupData::priorityClass and cpuAffinityMask
+    struct ThreadSchedulingParameter
+    {
+        int             priorityClass{ThreadPriorityNormal};
+        CPUAffinityMask cpuAffinityMask{0};
+
+        // only in the result
+        bool            succeeded{false};
+        wxString        errorMessage;
     };
 
     enum Commands
@@ -63,6 +151,43 @@ struct CameraCommandData
         // parameter is VCPropCommandParameters
         GetVCProp,
         SetVCProp,
+
+        // start sending frames to another logical camera, parameter is CameraOutput;
+        // no EVT_CAMERA_COMMAND_RESULT is sent
+        AddOutput,
+        // stop sending frames to a logical camera, parameter is int with CameraOutput::id;
+        // no EVT_CAMERA_COMMAND_RESULT is sent
+        RemoveOutput,
+
+        // start recording a logical camera to disk, parameter is RecordingParameter
+        StartRecording,
+        // stop recording, parameter is int with CameraOutput::id
+        StopRecording,
+
+        // switch between decoding frames and passing through compressed ones, parameter
+        // is bool, see CameraSetupData::passthrough; the capture is reopened and instead
+        // of EVT_CAMERA_COMMAND_RESULT, EVT_CAMERA_CAPTURE_STARTED is sent on success,
+        // preceded by EVT_CAMERA_ERROR_PASSTHROUGH when the frames are decoded instead
+        SetPassthrough,
+
+        // start writing the raw frames to a memory-mapped journal file, parameter is JournalParameter
+        StartJournal,
+        // stop writing the journal, no parameter; the result parameter is the file name (wxString)
+        StopJournal,
+
+        // reduce the work done for the frames when the application is overloaded, parameter is int:
+        // 0 = full, 1 = every 2nd frame, 2 = every 4th frame, 3 = as 2 but the full-size wxBitmap
+        // is not created, only the thumbnails; no EVT_CAMERA_COMMAND_RESULT is sent,
+        // see CameraGridFrame::OnGovernCPU()
+        SetDegradationLevel,
+
+        // change the priority and CPU affinity of the camera thread, parameter is ThreadSchedulingParameter
+        SetThreadScheduling,
+
+        // convert and send the next frame even if it is the same as the previous one
+        // (see CameraThread::IsDuplicateFrame()), e.g., because OneCameraFrame was opened;
+        // no parameter, no EVT_CAMERA_COMMAND_RESULT is sent
+        NeedFullFrame,
     };
 
     Commands command;
@@ -83,10 +208,11 @@ class CameraEvent : public wxThreadEvent
 {
 public:
     // eventType is one of EVT_CAMERA_xxx types declared below
-    CameraEvent(wxEventType eventType, const wxString& cameraName)
-        : wxThreadEvent(eventType), m_cameraName(cameraName)
+    CameraEvent(wxEventType eventType, int cameraId, const wxString& cameraName)
+        : wxThreadEvent(eventType), m_cameraId(cameraId), m_cameraName(cameraName)
     {}
 
+    int      GetCameraId() const    { return m_cameraId; }
     wxString GetCameraName() const  { return m_cameraName; }
 
     // only for EVT_CAMERA_COMMAND_RESULT
@@ -94,22 +220,38 @@ public:
 
     wxEvent* Clone() const override { return new CameraEvent(*this); }
 protected:
+    int      m_cameraId;
     wxString m_cameraName;
 };
 
 // Camera capture started
 // VideoCapture's backend can be retrieved via event's GetString(),
-// camera fps can be retrieved via event's GetInt(), if it returns non-zero
+// camera fps can be retrieved via event's GetInt(), if it returns non-zero,
+// event's GetExtraLong() returns 1 when the frames are not decoded, see CameraSetupData::passthrough
 wxDECLARE_EVENT(EVT_CAMERA_CAPTURE_STARTED, CameraEvent);
 // Result of the CameraCommandData's command sent to camera, use GetCommandResult()
 wxDECLARE_EVENT(EVT_CAMERA_COMMAND_RESULT, CameraEvent);
+// Connection to the camera was lost, the thread is attempting to reconnect,
+// see CameraSetupData::reconnect
+wxDECLARE_EVENT(EVT_CAMERA_RECONNECTING, CameraEvent);
+// The camera delivers frames again after it was reconnected,
+// the time to recover in milliseconds is in the event's GetExtraLong()
+wxDECLARE_EVENT(EVT_CAMERA_RECONNECTED, CameraEvent);
 // Could not open OpenCV camera capture
 wxDECLARE_EVENT(EVT_CAMERA_ERROR_OPEN, CameraEvent);
-// Could not retrieve a frame, consider connection to the camera lost.
+// Could not retrieve a frame and reconnecting is disabled or failed,
+// consider connection to the camera lost.
 wxDECLARE_EVENT(EVT_CAMERA_ERROR_EMPTY, CameraEvent);
+// The capture's backend cannot pass through compressed frames, so the camera thread
+// decodes them instead (see CameraSetupData::passthrough), the backend name
+// can be retrieved via event's GetString()
+wxDECLARE_EVENT(EVT_CAMERA_ERROR_PASSTHROUGH, CameraEvent);
 // An exception was thrown in the camera thread,
 // see the event's GetString() for the exception information.
 wxDECLARE_EVENT(EVT_CAMERA_ERROR_EXCEPTION, CameraEvent);
+// Recording failed and was stopped, the event's camera id is CameraOutput::id,
+// see the event's GetString() for the error information.
+wxDECLARE_EVENT(EVT_CAMERA_RECORDING_ERROR, CameraEvent);
 
 
 
@@ -123,17 +265,23 @@ wxDECLARE_EVENT(EVT_CAMERA_ERROR_EXCEPTION, CameraEvent);
 class CameraFrameData
 {
 public:
-    CameraFrameData(const wxString& cameraName,
+    CameraFrameData(const int cameraId,
                     const wxULongLong frameNumber);
-    ~CameraFrameData();
 
-    wxString GetCameraName() const { return m_cameraName; }
+    // see CameraSetupData::id
+    int          GetCameraId() const { return m_cameraId; }
 
-    // captured camera frame
-    wxBitmap*    GetFrame() { return m_frame; }
+    // captured camera frame, shared by frames for all outputs of the camera thread
+    wxBitmap*    GetFrame() { return m_frame.get(); }
 
-    // optional thumbnail, created when thumbnailSize passed to CameraThread is not empty
-    wxBitmap*    GetThumbnail() { return m_thumbnail; }
+    // optional thumbnail, created when CameraOutput::thumbnailSize is not empty,
+    // shared by frames for the outputs with the same thumbnail size
+    wxBitmap*    GetThumbnail() { return m_thumbnail.get(); }
+
+    // With CameraSetupData::nativeImages, the frame and thumbnail are passed as these
+    // instead of the bitmaps above, shared the same way, see BitmapPool.
+    NativeImagePtr GetFrameImage() const     { return m_frameImage; }
+    NativeImagePtr GetThumbnailImage() const { return m_thumbnailImage; }
 
     // frame number, starting with 0
     wxULongLong  GetFrameNumber() const { return m_frameNumber; }
@@ -152,33 +300,55 @@ public:
     // when was the image captured, obtained with wxGetUTCTimeMillis()
     wxLongLong GetCapturedTime() const { return m_capturedTime ; }
 
+    // motion score of the thumbnail (0-1000), -1 when not computed, see MotionDetector
+    int  GetMotionScore() const { return m_motionScore; }
+    // true while the camera is quiet and its frame rate is reduced, see CameraSetupData::quietFrameStride
+    bool IsQuiet() const { return m_quiet; }
+
+    // the bytes of the frame and thumbnails charged to CameraSetupData::frameMemoryBudget,
+    // shared by frames for all outputs, null when there is no budget
+    FrameMemoryChargePtr GetMemoryCharge() const { return m_memoryCharge; }
+
     // Setters
 
-    void SetCameraName(const wxString& cameraName) { m_cameraName = cameraName; }
+    void SetCameraId(const int cameraId)          { m_cameraId = cameraId; }
 
-    void SetFrame(wxBitmap* frame)                { m_frame = frame; }
-    void SetThumbnail(wxBitmap* thumbnail)        { m_thumbnail = thumbnail; }
+    void SetFrame(std::shared_ptr<wxBitmap> frame)         { m_frame = frame; }
+    void SetThumbnail(std::shared_ptr<wxBitmap> thumbnail) { m_thumbnail = thumbnail; }
+    void SetFrameImage(NativeImagePtr image)               { m_frameImage = image; }
+    void SetThumbnailImage(NativeImagePtr image)           { m_thumbnailImage = image; }
     void SetFrameNumber(const wxULongLong number) { m_frameNumber = number; }
 
     void SetTimeToRetrieve(const long t)        { m_timeToRetrieve = t; }
     void SetTimeToConvert(const long t)         { m_timeToConvert = t; }
     void SetTimeToCreateThumbnail(const long t) { m_timeToCreateThumbnail = t; }
     void SetCapturedTime(const wxLongLong t)    { m_capturedTime = t; }
+    void SetMotion(const int score, const bool quiet) { m_motionScore = score; m_quiet = quiet; }
+    void SetMemoryCharge(FrameMemoryChargePtr charge) { m_memoryCharge = charge; }
 private:
-    wxString    m_cameraName;
-    wxBitmap*   m_frame{nullptr};
-    wxBitmap*   m_thumbnail{nullptr};
+    int         m_cameraId{-1};
+    // wxBitmap reference counting is not thread-safe: the camera thread must
+    // release its references before passing the frame to the GUI thread
+    std::shared_ptr<wxBitmap> m_frame;
+    std::shared_ptr<wxBitmap> m_thumbnail;
+    NativeImagePtr            m_frameImage;
+    NativeImagePtr            m_thumbnailImage;
+    FrameMemoryChargePtr      m_memoryCharge;
     wxULongLong m_frameNumber{0};
     wxLongLong  m_capturedTime{0};
     long        m_timeToRetrieve{0};
     long        m_timeToConvert{0};
     long        m_timeToCreateThumbnail{0};
+    int         m_motionScore{-1};
+    bool        m_quiet{false};
 };
 
 typedef std::unique_ptr<CameraFrameData> CameraFrameDataPtr;
 typedef std::vector<CameraFrameDataPtr>  CameraFrameDataPtrs;
 
 
+class FrameBus;
+
 /***********************************************************************************************
 
     CameraSetupData: a struct containing camera setup
@@ -194,24 +364,99 @@ struct CameraSetupData
         SleepNone    =  0  // no sleep in the thread
     };
 
-    wxString             name;
-    wxString             address;
-    int                  apiPreference{0}; // = cv::CAP_ANY
-    long                 sleepDuration{SleepFromFPS}; // either one of Sleep* or time in milliseconds
-    int                  FPS{0}; // if 0 do not attempt to set
-    int                  defaultFPS{25}; // when the camera FPS cannot be retrieved
-    bool                 useMJPGFourCC{false};
+    // A small non-negative number unique for the camera during the application run,
+    // used instead of name to identify the camera on the frame processing path.
+    // id, name, thumbnailSize and metrics describe the first CameraOutput,
+    // more can be added with CameraCommandData::AddOutput.
+    int                          id{-1};
+    wxString                     name;
+    wxString                     address;
+    int                          apiPreference{0}; // = cv::CAP_ANY
+    long                         sleepDuration{SleepFromFPS}; // either one of Sleep* or time in milliseconds
+    int                          FPS{0}; // if 0 do not attempt to set
+    int                          defaultFPS{25}; // when the camera FPS cannot be retrieved
+    bool                         useMJPGFourCC{false};
+    // limits for how long opening the capture and reading a frame can block,
+    // in milliseconds, 0 means the backend default; requires OpenCV 4.5.4
+    // and a backend supporting them, such as FFmpeg
+    int                          openTimeout{0};
+    int                          readTimeout{0};
+
+    // When a frame cannot be retrieved, the thread attempts to reopen the capture,
+    // waiting reconnectDelayInitial ms before the first attempt. The delay is doubled
+    // after every failed attempt up to reconnectDelayMax and randomized by
+    // reconnectJitter percent, so that cameras behind the same failed link
+    // do not reconnect all at once.
+    bool                         reconnect{true};
+    long                         reconnectDelayInitial{1000};
+    long                         reconnectDelayMax{30000};
+    int                          reconnectJitter{20}; // percent of the delay
+    int                          reconnectMaxAttempts{0}; // 0 = unlimited
+
+    // Retrieve compressed packets (e.g., H.264 NAL units) instead of decoded frames,
+    // using cv::VideoCapture raw stream mode (CAP_PROP_FORMAT = -1, FFmpeg backend only).
+    // The packets are not displayed, only published on frameBus, so that they can
+    // be recorded without decoding and re-encoding, see CameraRecorder.
+    // With other backends the frames are decoded, see EVT_CAMERA_ERROR_PASSTHROUGH.
+    bool                         passthrough{false};
+
+    // When false, cv::CAP_PROP_CONVERT_RGB is turned off, so that the frames of grayscale,
+    // 16-bit (e.g., thermal) or YUV cameras are converted to wxBitmap directly, instead of
+    // the backend expanding them to BGR first; supported e.g. by the V4L2 and MSMF backends.
+    // Thumbnails of YUV frames, the motion score and the frames published on frameBus still
+    // use BGR, converted only when needed; the journal gets the frames as retrieved.
+    // When the format of the retrieved frames cannot be determined, the conversion is
+    // turned back on. rawConversion.format overrides the one determined from the frames.
+    bool                         convertRGB{true};
+    MatConversionOptions         rawConversion;
+
+    // When true, the thread creates no wxBitmaps, which is not guaranteed to be safe
+    // outside the GUI thread with every port (e.g., wxGTK). It converts the frames and
+    // thumbnails into NativeImages instead, which the GUI thread copies into the bitmaps
+    // of a BitmapPool, see CameraFrameData::GetFrameImage().
+    bool                         nativeImages{false};
+
+    // Motion adaptive frame rate: a motion score is computed on the thumbnail of the first
+    // output having one, see MotionDetector. When the score stays below motionThreshold
+    // for motionQuietDelay ms, the camera is quiet and only every quietFrameStride-th frame
+    // is retrieved, converted and passed on, the others are only grabbed. The first frame
+    // with motion restores the full rate. Frames are not skipped while recording or journaling.
+    int                          quietFrameStride{1}; // 1 = always the full rate, no motion score
+    int                          motionThreshold{5};  // per mille of the thumbnail's pixels
+    long                         motionQuietDelay{3000};
+
+    // Scheduling of the camera thread, see threadscheduling.h. It is set when the thread
+    // starts, before the capture is opened, so that on Linux the threads the capture backend
+    // creates (e.g., FFmpeg decoding threads) inherit it. CameraCommandData::SetThreadScheduling
+    // changes only the camera thread itself. When it cannot be set, EVT_CAMERA_COMMAND_RESULT
+    // for SetThreadScheduling with the error is sent.
+    int                          priorityClass{ThreadPriorityNormal}; // one of ThreadPriorityClass
+    CPUAffinityMask              cpuAffinityMask{0}; // 0 = any CPU
 
     // where to send EVT_CAMERA_xxx events;
-    wxEvtHandler*        eventSink{nullptr};
+    wxEvtHandler*                eventSink{nullptr};
     // new frames captured from camera, to be processed by the GUI thread
-    CameraFrameDataPtrs* frames{nullptr};
-    wxCriticalSection*   framesCS{nullptr};
-    wxSize               frameSize; // if width or height is 0, not set
-    wxSize               thumbnailSize;
+    CameraFrameDataPtrs*         frames{nullptr};
+    InstrumentedCriticalSection* framesCS{nullptr};
+    wxSize                       frameSize; // if width or height is 0, not set
+    wxSize                       thumbnailSize;
 
     // commands sent from the GUI thread to camera thread
-    CameraCommandDatas*  commands{nullptr};
+    CameraCommandDatas*          commands{nullptr};
+
+    // optional, captured frames are also published there for other consumers
+    // when any subscribes to one of the thread's outputs
+    FrameBus*                    frameBus{nullptr};
+
+    // Optional, shared by all camera threads. The bitmaps of the frames for the GUI and
+    // the images of the frames published on frameBus are charged to it before they are
+    // allocated; when the budget is reached, the frame is not passed to the GUI or not
+    // published, and the thread keeps capturing, so that the memory stays bounded.
+    FrameMemoryBudgetPtr         frameMemoryBudget;
+
+    // counters and gauges updated by the camera thread,
+    // those related to capture are updated only here, not in other outputs
+    CameraMetricsPtr             metrics;
 
     bool IsOk() const;
 };
@@ -225,33 +470,142 @@ struct CameraSetupData
 
 ***********************************************************************************************/
 
-// forward declaration to avoid including OpenCV header
-namespace cv { class VideoCapture; }
+// forward declarations to avoid including OpenCV header
+namespace cv { class Mat; class VideoCapture; }
+
+class CameraRecorder;
+class FrameJournal;
+class MotionDetector;
+class ThreadCPUStopWatch;
 
 
 class CameraThread : public wxThread
 {
 public:
     CameraThread(const CameraSetupData& cameraSetupData);
+    ~CameraThread();
 
+    int      GetCameraId() const      { return m_cameraSetupData.id; }
     wxString GetCameraAddress() const { return m_cameraSetupData.address; }
     wxString GetCameraName() const    { return m_cameraSetupData.name; }
     bool     IsCapturing() const      { return m_isCapturing; }
+
+    // Asks the thread to exit as soon as possible without waiting for it,
+    // unlike Delete(). The thread does not report errors after this
+    // and must be joined with Wait(), see CameraThreadReaper.
+    void     RequestStop()            { m_stopRequested = true; }
+    bool     IsStopRequested() const  { return m_stopRequested; }
+
+    // Asks the thread to reopen the capture, as if the connection was lost,
+    // when it retrieves the next frame; ignored if reconnecting is disabled.
+    void     RequestReconnect()       { m_reconnectRequested = true; }
 protected:
     CameraSetupData                    m_cameraSetupData;
 
     std::unique_ptr<cv::VideoCapture> m_cameraCapture;
     std::atomic_bool                  m_isCapturing{false};
+    std::atomic_bool                  m_stopRequested{false};
+    std::atomic_bool                  m_reconnectRequested{false};
+    int                               m_requestedFPS{0}; // CameraSetupData::FPS is replaced with the actual one
+    std::vector<CameraOutput>         m_outputs;
+    std::minstd_rand                  m_random; // for reconnect jitter
+    std::vector<CameraRecorder*>      m_recorders;
+    std::vector<CameraRecorder*>      m_stoppingRecorders; // asked to stop, not joined yet
+    // only with CameraSetupData::passthrough
+    int                               m_passthroughFourCC{0};
+    std::unique_ptr<cv::Mat>          m_codecExtraData; // e.g., H.264 SPS and PPS
+    std::unique_ptr<FrameJournal>     m_journal; // null when not journaling
     wxLongLong                        m_captureStartedTime; // when was capture opened, obtained with wxGetUTCTimeMillis()
     wxULongLong                       m_framesCapturedCount{0};
+    // the format of the retrieved frames, not BGR only with CameraSetupData::convertRGB off
+    MatConversionOptions              m_frameConversion;
+    std::unique_ptr<cv::Mat>          m_bgrFrame; // see GetBGRFrame()
+    bool                              m_bgrFrameValid{false};
+    // see IsDuplicateFrame()
+    wxUint64                          m_lastFrameHash{0};
+    bool                              m_lastFrameHashValid{false};
+    // only with CameraSetupData::quietFrameStride > 1
+    std::unique_ptr<MotionDetector>   m_motionDetector;
+    bool                              m_quiet{false};
+    int                               m_lastMotionScore{-1};
+    wxLongLong                        m_lastMotionTime;   // captured time of the last frame with motion
+    wxLongLong                        m_lastAnalysedTime; // captured time of the last frame scored
+    // see CameraCommandData::SetDegradationLevel
+    int                               m_degradationLevel{0};
+    int                               m_threadPriorityClass{ThreadPriorityNormal}; // set for the thread, see SetThreadScheduling()
+    // see SkipFrame()
+    int                               m_framesGrabbed{0}; // only grabbed since the last retrieved frame
+    wxInt64                           m_retrievedFrameCpuUs{0}; // moving average of processing a retrieved frame
 
     ExitCode Entry() override;
 
+    // returns false when the capture could not be opened
     bool InitCapture();
+    // switches the opened capture to the raw stream mode, returns false when unsupported
+    bool InitPassthrough();
+    void SetPassthrough(bool passthrough);
+    // applies the settings to the opened capture and sends EVT_CAMERA_CAPTURE_STARTED
+    void StartCapture();
+    // updates CameraMetrics::expectedFrameIntervalMs from FPS and sleep duration
+    void UpdateExpectedFrameInterval();
+    // Only with CameraSetupData::convertRGB off: gives matFrame retrieved as a single row
+    // the frame's dimensions and determines its format. Returns false if the format
+    // is not known, CameraSetupData::convertRGB is then turned back on.
+    bool PrepareRawFrame(cv::Mat& matFrame);
+    // Returns matFrame converted to BGR, converted only once per frame and only
+    // when matFrame is not BGR already. The result is valid until the next frame.
+    const cv::Mat& GetBGRFrame(const cv::Mat& matFrame);
+    // returns true if the decoded frame has the same hash as the previous one, see ComputeFrameHash()
+    bool IsDuplicateFrame(const cv::Mat& matFrame);
+    // returns true if the next frame is to be only grabbed because the camera is quiet or degraded
+    bool SkipFrame();
+    // Charges bytes to CameraSetupData::frameMemoryBudget, returns false when the budget
+    // does not allow it. charge is null when there is no budget or bytes is 0.
+    bool ChargeFrameMemory(size_t bytes, FrameMemoryChargePtr& charge);
+    // bytes per pixel of the wxBitmaps or NativeImages created for the frames
+    size_t GetPixelBytes() const { return m_cameraSetupData.nativeImages ? NativeImage::GetPixelSize() : 3; }
+    // returns the bytes of the wxBitmaps created for matFrame by the converting and CreateOutputFrames()
+    size_t GetOutputFramesBytes(const cv::Mat& matFrame) const;
+    void SetDegradationLevel(int level);
+    // on success, updates CameraSetupData::priorityClass and cpuAffinityMask
+    bool SetThreadScheduling(CameraCommandData::ThreadSchedulingParameter& parameter);
+    // updates the motion score and the quiet state from the thumbnail of the frame captured at capturedTime
+    void UpdateMotion(const cv::Mat& thumbnail, wxLongLong capturedTime);
+    // sleeps according to CameraSetupData::sleepDuration after the frame capture started at frameCaptureStartedTime
+    void SleepAfterFrame(wxLongLong frameCaptureStartedTime, long msPerFrame);
+    // creates frames with thumbnails for all outputs from frameData,
+    // publishing the thumbnails for the outputs with thumbnail subscribers
+    void CreateOutputFrames(const cv::Mat& matFrame, const CameraFrameData& frameData,
+                            CameraFrameDataPtrs& outputFrames, ThreadCPUStopWatch& cpuStopWatch);
+    // publishes bgrThumbnail on CameraSetupData::frameBus, see FrameSubscriber::Thumbnails
+    void PublishThumbnail(const cv::Mat& bgrThumbnail, int outputId, const CameraFrameData& frameData);
+    // Publishes matFrame (a compressed packet with CameraSetupData::passthrough,
+    // converted to BGR if needed otherwise) on CameraSetupData::frameBus for the outputs
+    // with subscribers, returns true if matFrame itself was published, i.e. it is now
+    // shared and must not be reused.
+    bool PublishFrame(const cv::Mat& matFrame, const CameraFrameData& frameData);
+    void AddOutput(const CameraOutput& output);
+    void RemoveOutput(int id);
+    bool StartRecording(CameraCommandData::RecordingParameter& parameter);
+    bool StopRecording(int id);
+    // Joins and deletes the recorders asked to stop or failed which have already exited.
+    // If stopAll is true, all recorders are asked to stop and the call waits for them.
+    void ReapRecorders(bool stopAll);
+    bool StartJournal(CameraCommandData::JournalParameter& parameter);
+    // writes the decoded frame to m_journal if journaling
+    void WriteJournal(const cv::Mat& matFrame, const CameraFrameData& frameData);
+    // Attempts to reopen the capture, waiting before every attempt. Returns false
+    // when the maximum number of attempts was reached or the thread is to exit.
+    bool Reconnect(int& attempts, long& delay);
+    // returns false if the thread was asked to exit while sleeping
+    bool InterruptibleSleep(long milliseconds);
     void SetCameraResolution(const wxSize& resolution);
     void SetCameraUseMJPEG();
     void SetCameraFPS(const int FPS);
 
+    // returns true if a command was received,
+    // does not wait for a command if the queue is empty
+    bool ReceiveCameraCommand(CameraCommandData& commandData);
     void ProcessCameraCommand(const CameraCommandData& commandData);
 };
 
@@ -0,0 +1,89 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        camerathreadreaper.cpp
+// Purpose:     Waits for stopped camera threads and deletes them in the background
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+#include "camerathreadreaper.h"
+
+CameraThreadReaper::CameraThreadReaper(ApplicationMetrics& applicationMetrics)
+    : wxThread(wxTHREAD_JOINABLE),
+      m_applicationMetrics(applicationMetrics)
+{}
+
+void CameraThreadReaper::Reap(CameraThread* thread, CameraCommandDatas* commandDatas)
+{
+    wxCHECK_RET(thread, "thread cannot be null");
+
+    Corpse corpse;
+
+    corpse.thread            = thread;
+    corpse.isCameraThread    = true;
+    corpse.commandDatas      = commandDatas;
+    corpse.threadName        = wxString::Format("Camera thread for camera '%s'", thread->GetCameraName());
+    corpse.stopRequestedTime = wxGetUTCTimeMillis();
+
+    CameraMetrics::Add(m_applicationMetrics.camerasStopping, 1);
+    m_corpses.Post(corpse);
+}
+
+void CameraThreadReaper::Reap(wxThread* thread, const wxString& threadName)
+{
+    wxCHECK_RET(thread, "thread cannot be null");
+
+    Corpse corpse;
+
+    corpse.thread            = thread;
+    corpse.threadName        = threadName;
+    corpse.stopRequestedTime = wxGetUTCTimeMillis();
+
+    m_corpses.Post(corpse);
+}
+
+void CameraThreadReaper::Stop()
+{
+    wxStopWatch stopWatch;
+
+    m_corpses.Post(Corpse());
+    Wait(wxTHREAD_WAIT_BLOCK);
+
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Waited %ld ms for the camera threads to exit.", stopWatch.Time());
+}
+
+wxThread::ExitCode CameraThreadReaper::Entry()
+{
+#if wxCHECK_VERSION(3, 1, 6)
+    SetName("CameraThreadReaper");
+#endif
+
+    Corpse corpse;
+
+    while ( m_corpses.Receive(corpse) == wxMSGQUEUE_NO_ERROR )
+    {
+        if ( !corpse.thread )
+            break;
+
+        corpse.thread->Wait(wxTHREAD_WAIT_BLOCK);
+        delete corpse.thread;
+        delete corpse.commandDatas;
+
+        const wxLongLong teardownTime = wxGetUTCTimeMillis() - corpse.stopRequestedTime;
+
+        if ( corpse.isCameraThread )
+        {
+            CameraMetrics::Add(m_applicationMetrics.camerasStopping, -1);
+            CameraMetrics::Add(m_applicationMetrics.cameraTeardowns);
+            CameraMetrics::Add(m_applicationMetrics.cameraTeardownTimeMs, teardownTime.GetValue());
+            if ( teardownTime.GetValue() > CameraMetrics::Get(m_applicationMetrics.cameraTeardownMaxTimeMs) )
+                CameraMetrics::Set(m_applicationMetrics.cameraTeardownMaxTimeMs, teardownTime.GetValue());
+        }
+
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "%s exited %s ms after it was asked to stop.",
+            corpse.threadName, teardownTime.ToString());
+    }
+
+    return static_cast<wxThread::ExitCode>(nullptr);
+}
@@ -0,0 +1,70 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        camerathreadreaper.h
+// Purpose:     Waits for stopped camera threads and deletes them in the background
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef CAMERATHREADREAPER_H
+#define CAMERATHREADREAPER_H
+
+#include <wx/wx.h>
+#include <wx/msgqueue.h>
+#include <wx/thread.h>
+
+#include "camerathread.h"
+#include "metrics.h"
+
+/***********************************************************************************************
+
+    CameraThreadReaper: a worker wxThread which joins camera threads asked to stop
+                        with CameraThread::RequestStop() and deletes them together
+                        with their command queues, so that the GUI thread does not
+                        have to wait for threads blocked in OpenCV calls.
+                        It also joins and deletes other worker threads of the
+                        cameras, e.g., ReplayEncoder or SharedMemoryExporter,
+                        which may be in the middle of processing a frame.
+
+                        The camera threads may still send events and frames until
+                        they are joined, the event sink and the frame queue must
+                        therefore outlive the reaper, see Stop().
+
+***********************************************************************************************/
+
+class CameraThreadReaper : public wxThread
+{
+public:
+    explicit CameraThreadReaper(ApplicationMetrics& applicationMetrics);
+
+    // Takes the ownership of thread and commandDatas, the thread must
+    // have been asked to stop already. Called from the GUI thread.
+    void Reap(CameraThread* thread, CameraCommandDatas* commandDatas);
+
+    // Takes the ownership of a joinable worker thread, which must have been
+    // asked to stop already; threadName is used only for logging.
+    // Called from the GUI thread.
+    void Reap(wxThread* thread, const wxString& threadName);
+
+    // Waits until all threads passed to Reap() are deleted and
+    // the reaper thread exits. Called from the GUI thread.
+    void Stop();
+protected:
+    struct Corpse
+    {
+        wxThread*           thread{nullptr}; // nullptr means exit the reaper thread
+        bool                isCameraThread{false};
+        CameraCommandDatas* commandDatas{nullptr}; // only for a CameraThread
+        wxString            threadName;
+        wxLongLong          stopRequestedTime; // obtained with wxGetUTCTimeMillis()
+    };
+
+    wxMessageQueue<Corpse> m_corpses;
+    ApplicationMetrics&    m_applicationMetrics;
+
+    ExitCode Entry() override;
+};
+
+#endif // #ifndef CAMERATHREADREAPER_H
@@ -1,6 +1,6 @@
 ///////////////////////////////////////////////////////////////////////////////
 // Name:        convertmattowxbmp.cpp
-// Purpose:     Converts OpenCV bitmap (Mat) stored as BGR CVU8 to wxBitmap
+// Purpose:     Converts OpenCV bitmap (Mat) stored as BGR, gray or YUV to wxBitmap
 // Author:      PB
 // Created:     2020-09-16
 // Copyright:   (c) 2020 PB
@@ -10,15 +10,25 @@
 #include <wx/wx.h>
 #include <wx/rawbmp.h>
 
+#include <cstring>
+#include <memory>
+
 #include <opencv2/core/mat.hpp>
+#include <opencv2/imgproc.hpp>
 
-#include "convertmattowxbmp.h"
+#if defined(__WXGTK__) && WXOPENCVCAMERAS_HAVE_GDKPIXBUF
+    #include <gdk-pixbuf/gdk-pixbuf.h>
+    #define WXOPENCVCAMERAS_USE_GDKPIXBUF 1
+#endif
 
-#ifdef __WXMSW__
+#include "bitmappool.h"
+#include "convertmattowxbmp.h"
 
 namespace
 {
 
+#ifdef __WXMSW__
+
 // Version optimized for Microsoft Windows.
 // matBitmap must be continous and matBitmap.cols % 4 must equal 0
 // as SetDIBits() requires the DIB rows to be DWORD-aligned.
@@ -44,22 +54,323 @@ bool ConvertMatBitmapTowxBitmapMSW(const cv::Mat& matBitmap, wxBitmap& bitmap)
     return success;
 }
 
+#endif // #ifndef __WXMSW__
+
+// The row converters below write width pixels of the bitmap's native format
+// (e.g., RGB on GTK, BGR on MSW, xRGB on macOS) starting at dst. They are
+// used when the bitmap's pixels cannot be converted by OpenCV directly,
+// see ConvertMatBitmapTowxBitmapOpenCV().
+
+const int PixelSize = wxNativePixelFormat::SizePixel;
+const int RedIndex  = wxNativePixelFormat::RED;
+const int GreenIndex = wxNativePixelFormat::GREEN;
+const int BlueIndex = wxNativePixelFormat::BLUE;
+
+inline unsigned char ClipToByte(int value)
+{
+    return static_cast<unsigned char>(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+inline void SetPixel(unsigned char* dst, int red, int green, int blue)
+{
+    dst[RedIndex]   = static_cast<unsigned char>(red);
+    dst[GreenIndex] = static_cast<unsigned char>(green);
+    dst[BlueIndex]  = static_cast<unsigned char>(blue);
+}
+
+void ConvertRowBGR(const unsigned char* bgr, unsigned char* dst, int width)
+{
+    for ( int col = 0; col < width; ++col, bgr += 3, dst += PixelSize )
+        SetPixel(dst, bgr[2], bgr[1], bgr[0]);
+}
+
+void ConvertRowRGB(const unsigned char* rgb, unsigned char* dst, int width)
+{
+    for ( int col = 0; col < width; ++col, rgb += 3, dst += PixelSize )
+        SetPixel(dst, rgb[0], rgb[1], rgb[2]);
+}
+
+void ConvertRowBGRA(const unsigned char* bgra, unsigned char* dst, int width)
+{
+    for ( int col = 0; col < width; ++col, bgra += 4, dst += PixelSize )
+        SetPixel(dst, bgra[2], bgra[1], bgra[0]);
+}
+
+void ConvertRowGray(const unsigned char* gray, unsigned char* dst, int width)
+{
+    for ( int col = 0; col < width; ++col, dst += PixelSize )
+        SetPixel(dst, gray[col], gray[col], gray[col]);
+}
+
+// gray16 values are clipped to [low, low + range] and scaled
+// by scale / 65536 with rounding, scale = 255 * 65536 / range
+void ConvertRowGray16(const unsigned short* gray16, unsigned char* dst, int width,
+                      int low, int range, int scale)
+{
+    for ( int col = 0; col < width; ++col, dst += PixelSize )
+    {
+        int value = gray16[col] - low;
+
+        value = value < 0 ? 0 : (value > range ? range : value);
+        value = (value * scale + 32768) >> 16;
+        SetPixel(dst, value, value, value);
+    }
+}
+
+// BT.601 limited range, with the same integer coefficients as libyuv and OpenCV
+inline void SetPixelYUV(unsigned char* dst, int y, int u, int v)
+{
+    const int c = (y - 16) * 298 + 128;
+    const int d = u - 128;
+    const int e = v - 128;
+
+    SetPixel(dst, ClipToByte((c + 409 * e) >> 8),
+                  ClipToByte((c - 100 * d - 208 * e) >> 8),
+                  ClipToByte((c + 516 * d) >> 8));
+}
+
+// yuyv has width / 2 groups of Y0 U Y1 V
+void ConvertRowYUYV(const unsigned char* yuyv, unsigned char* dst, int width)
+{
+    for ( int col = 0; col + 1 < width; col += 2, yuyv += 4, dst += 2 * PixelSize )
+    {
+        SetPixelYUV(dst, yuyv[0], yuyv[1], yuyv[3]);
+        SetPixelYUV(dst + PixelSize, yuyv[2], yuyv[1], yuyv[3]);
+    }
+}
+
+// y has width values, uv has width / 2 pairs of U V shared with the other row
+void ConvertRowNV12(const unsigned char* y, const unsigned char* uv, unsigned char* dst, int width)
+{
+    for ( int col = 0; col + 1 < width; col += 2, uv += 2, dst += 2 * PixelSize )
+    {
+        SetPixelYUV(dst, y[col], uv[0], uv[1]);
+        SetPixelYUV(dst + PixelSize, y[col + 1], uv[0], uv[1]);
+    }
+}
+
+// Converts the row of the image stored in matBitmap, which is width x height
+// (see GetMatBitmapSize()), to dst in the native pixel format.
+void ConvertRow(const cv::Mat& matBitmap, MatPixelFormat format, const MatConversionOptions& options,
+                int row, int width, int height, unsigned char* dst)
+{
+    switch ( format )
+    {
+        case MatPixelFormatBGR:
+            ConvertRowBGR(matBitmap.ptr<unsigned char>(row), dst, width);
+            break;
+        case MatPixelFormatRGB:
+            ConvertRowRGB(matBitmap.ptr<unsigned char>(row), dst, width);
+            break;
+        case MatPixelFormatBGRA:
+            ConvertRowBGRA(matBitmap.ptr<unsigned char>(row), dst, width);
+            break;
+        case MatPixelFormatGray:
+            ConvertRowGray(matBitmap.ptr<unsigned char>(row), dst, width);
+            break;
+        case MatPixelFormatGray16:
+        {
+            const int low   = options.windowLevel - options.windowWidth / 2;
+            const int range = options.windowWidth;
+
+            ConvertRowGray16(matBitmap.ptr<unsigned short>(row), dst, width,
+                             low, range, static_cast<int>(255LL * 65536 / range));
+            break;
+        }
+        case MatPixelFormatYUYV:
+            ConvertRowYUYV(matBitmap.ptr<unsigned char>(row), dst, width);
+            break;
+        case MatPixelFormatNV12:
+            ConvertRowNV12(matBitmap.ptr<unsigned char>(row), matBitmap.ptr<unsigned char>(height + row / 2), dst, width);
+            break;
+        case MatPixelFormatAuto:
+            break;
+    }
+}
+
+// Converts matBitmap to 24-bit RGB (rgb is true) or BGR with OpenCV, which does it with
+// SIMD instructions and in parallel for large images. With intoTarget, the conversion
+// writes into target's data, which must already have the size and type. Otherwise,
+// target is allocated as needed or, when matBitmap already has the requested order,
+// it just references matBitmap's data.
+bool ConvertMatWithOpenCV(const cv::Mat& matBitmap, MatPixelFormat format,
+                          const MatConversionOptions& options,
+                          bool rgb, bool intoTarget, cv::Mat& target)
+{
+    switch ( format )
+    {
+        case MatPixelFormatBGR:
+        case MatPixelFormatRGB:
+            if ( rgb == (format == MatPixelFormatRGB) )
+            {
+                if ( intoTarget )
+                    matBitmap.copyTo(target);
+                else
+                    target = matBitmap;
+            }
+            else
+            {
+                cv::cvtColor(matBitmap, target, cv::COLOR_BGR2RGB); // the same as RGB2BGR
+            }
+            break;
+        case MatPixelFormatBGRA:
+            cv::cvtColor(matBitmap, target, rgb ? cv::COLOR_BGRA2RGB : cv::COLOR_BGRA2BGR);
+            break;
+        case MatPixelFormatGray:
+            cv::cvtColor(matBitmap, target, rgb ? cv::COLOR_GRAY2RGB : cv::COLOR_GRAY2BGR);
+            break;
+        case MatPixelFormatGray16:
+        {
+            wxCHECK(options.windowWidth > 0, false);
+
+            const double alpha = 255. / options.windowWidth;
+            cv::Mat      gray;
+
+            matBitmap.convertTo(gray, CV_8U, alpha, -alpha * (options.windowLevel - options.windowWidth / 2));
+            cv::cvtColor(gray, target, rgb ? cv::COLOR_GRAY2RGB : cv::COLOR_GRAY2BGR);
+            break;
+        }
+        case MatPixelFormatYUYV:
+            cv::cvtColor(matBitmap, target, rgb ? cv::COLOR_YUV2RGB_YUYV : cv::COLOR_YUV2BGR_YUYV);
+            break;
+        case MatPixelFormatNV12:
+            cv::cvtColor(matBitmap, target, rgb ? cv::COLOR_YUV2RGB_NV12 : cv::COLOR_YUV2BGR_NV12);
+            break;
+        case MatPixelFormatAuto:
+            return false;
+    }
+
+    return true;
+}
+
+// Converts matBitmap with a single OpenCV call writing directly to the bitmap's pixels,
+// see ConvertMatWithOpenCV(). Possible only when the native pixel format has 24 bits
+// and the rows are stored top-down, which is the case of wxGTK, where wxNativePixelData
+// gives access to the bitmap's GdkPixbuf with its row stride. Returns false when not possible.
+bool ConvertMatBitmapTowxBitmapOpenCV(const cv::Mat& matBitmap, MatPixelFormat format,
+                                      const MatConversionOptions& options,
+                                      wxNativePixelData& pixelData)
+{
+    const int width  = pixelData.GetWidth();
+    const int height = pixelData.GetHeight();
+
+    if ( PixelSize != 3 || pixelData.GetRowStride() < width * 3 )
+        return false;
+
+    wxNativePixelData::Iterator pixelDataIt(pixelData);
+    unsigned char*              pixels = reinterpret_cast<unsigned char*>(pixelDataIt.m_ptr);
+    cv::Mat                     target(height, width, CV_8UC3, pixels, static_cast<size_t>(pixelData.GetRowStride()));
+
+    if ( !ConvertMatWithOpenCV(matBitmap, format, options, RedIndex == 0, true, target) )
+        return false;
+
+    // OpenCV would allocate a new target if it did not match, leaving the bitmap unchanged
+    wxCHECK(target.data == pixels, false);
+
+    return true;
+}
+
+#if WXOPENCVCAMERAS_USE_GDKPIXBUF
+
+// GdkDestroyNotify for the pixbufs created in CreatewxBitmapFromMatGTK(),
+// called in whichever thread releases the last reference to the pixbuf
+void ReleasePixbufMat(guchar*, gpointer data)
+{
+    delete static_cast<cv::Mat*>(data);
+}
+
+bool CreatewxBitmapFromMatGTK(const cv::Mat& matBitmap, MatPixelFormat format,
+                              const MatConversionOptions& options, wxBitmap& bitmap)
+{
+    // GdkPixbuf without alpha is always RGB, rows can have any stride
+    std::unique_ptr<cv::Mat> rgb(new cv::Mat());
+
+    if ( !ConvertMatWithOpenCV(matBitmap, format, options, true, false, *rgb) )
+        return false;
+
+    GdkPixbuf* pixbuf = gdk_pixbuf_new_from_data(rgb->data, GDK_COLORSPACE_RGB, FALSE, 8,
+                                                 rgb->cols, rgb->rows, static_cast<int>(rgb->step[0]),
+                                                 ReleasePixbufMat, rgb.get());
+
+    if ( !pixbuf )
+        return false;
+
+    // now owned by the pixbuf, which is owned by the bitmap
+    rgb.release();
+    bitmap = wxBitmap(pixbuf);
+
+    return bitmap.IsOk();
+}
+
+#endif // #if WXOPENCVCAMERAS_USE_GDKPIXBUF
+
 } // unnamed namespace
 
-#endif // #ifndef __WXMSW__
+MatPixelFormat GetMatPixelFormat(const cv::Mat& matBitmap, MatPixelFormat format)
+{
+    if ( matBitmap.empty() || matBitmap.dims != 2 )
+        return MatPixelFormatAuto;
+
+    const int type = matBitmap.type();
+
+    switch ( format )
+    {
+        case MatPixelFormatAuto:
+            switch ( type )
+            {
+                case CV_8UC3:  return MatPixelFormatBGR;
+                case CV_8UC4:  return MatPixelFormatBGRA;
+                case CV_8UC1:  return MatPixelFormatGray;
+                case CV_16UC1: return MatPixelFormatGray16;
+                case CV_8UC2:  return matBitmap.cols % 2 == 0 ? MatPixelFormatYUYV : MatPixelFormatAuto;
+            }
+            return MatPixelFormatAuto;
+        case MatPixelFormatBGR:    return type == CV_8UC3 ? format : MatPixelFormatAuto;
+        case MatPixelFormatBGRA:   return type == CV_8UC4 ? format : MatPixelFormatAuto;
+        case MatPixelFormatGray:   return type == CV_8UC1 ? format : MatPixelFormatAuto;
+        case MatPixelFormatGray16: return type == CV_16UC1 ? format : MatPixelFormatAuto;
+        case MatPixelFormatYUYV:   return type == CV_8UC2 && matBitmap.cols % 2 == 0 ? format : MatPixelFormatAuto;
+        case MatPixelFormatNV12:
+            return type == CV_8UC1 && matBitmap.cols % 2 == 0 && matBitmap.rows % 3 == 0
+                   && (matBitmap.rows / 3) % 2 == 0 ? format : MatPixelFormatAuto;
+        case MatPixelFormatRGB:    return type == CV_8UC3 ? format : MatPixelFormatAuto;
+    }
+
+    return MatPixelFormatAuto;
+}
+
+bool GetMatBitmapSize(const cv::Mat& matBitmap, MatPixelFormat format, int& width, int& height)
+{
+    format = GetMatPixelFormat(matBitmap, format);
+
+    if ( format == MatPixelFormatAuto )
+        return false;
+
+    width  = matBitmap.cols;
+    height = format == MatPixelFormatNV12 ? matBitmap.rows * 2 / 3 : matBitmap.rows;
+
+    return true;
+}
 
 // See the function description in the header file.
-bool ConvertMatBitmapTowxBitmap(const cv::Mat& matBitmap, wxBitmap& bitmap)
+bool ConvertMatBitmapTowxBitmap(const cv::Mat& matBitmap, wxBitmap& bitmap, const MatConversionOptions& options)
 {
+    const MatPixelFormat format = GetMatPixelFormat(matBitmap, options.format);
+    int                  width{0}, height{0};
+
     wxCHECK(!matBitmap.empty(), false);
-    wxCHECK(matBitmap.type() == CV_8UC3, false);
     wxCHECK(matBitmap.dims == 2, false);
+    wxCHECK(format != MatPixelFormatAuto, false);
+    wxCHECK(format != MatPixelFormatGray16 || options.windowWidth > 0, false);
     wxCHECK(bitmap.IsOk(), false);
-    wxCHECK(bitmap.GetWidth() == matBitmap.cols && bitmap.GetHeight() == matBitmap.rows, false);
+    wxCHECK(GetMatBitmapSize(matBitmap, format, width, height), false);
+    wxCHECK(bitmap.GetWidth() == width && bitmap.GetHeight() == height, false);
     wxCHECK(bitmap.GetDepth() == 24, false);
 
 #ifdef __WXMSW__
-    if (  bitmap.IsDIB()
+    if (  !options.portableOnly
+          && format == MatPixelFormatBGR
+          && bitmap.IsDIB()
           && matBitmap.isContinuous()
           && matBitmap.cols % 4 == 0 )
     {
@@ -68,44 +379,73 @@ bool ConvertMatBitmapTowxBitmap(const cv::Mat& matBitmap, wxBitmap& bitmap)
 #endif
 
     wxNativePixelData           pixelData(bitmap);
+
+    if ( !options.portableOnly && ConvertMatBitmapTowxBitmapOpenCV(matBitmap, format, options, pixelData) )
+        return bitmap.IsOk();
+
     wxNativePixelData::Iterator pixelDataIt(pixelData);
 
-    if ( matBitmap.isContinuous() )
+    for ( int row = 0; row < height; ++row )
     {
-        const uchar* bgr = matBitmap.data;
+        pixelDataIt.MoveTo(pixelData, 0, row);
+        ConvertRow(matBitmap, format, options, row, width, height, reinterpret_cast<unsigned char*>(pixelDataIt.m_ptr));
+    }
 
-        for ( int row = 0; row < pixelData.GetHeight(); ++row )
-        {
-            pixelDataIt.MoveTo(pixelData, 0, row);
+    return bitmap.IsOk();
+}
 
-            for ( int col = 0;
-                  col < pixelData.GetWidth();
-                  ++col, ++pixelDataIt )
-            {
-                pixelDataIt.Blue()  = *bgr++;
-                pixelDataIt.Green() = *bgr++;
-                pixelDataIt.Red()   = *bgr++;
-            }
-        }
-    }
-    else // Is it even possible for Mat with image to be not continous?
+bool CreatewxBitmapFromMat(const cv::Mat& matBitmap, wxBitmap& bitmap, const MatConversionOptions& options)
+{
+    const MatPixelFormat format = GetMatPixelFormat(matBitmap, options.format);
+    int                  width{0}, height{0};
+
+    wxCHECK(GetMatBitmapSize(matBitmap, format, width, height), false);
+
+#if WXOPENCVCAMERAS_USE_GDKPIXBUF
+    if ( !options.portableOnly )
+        return CreatewxBitmapFromMatGTK(matBitmap, format, options, bitmap);
+#endif
+
+    if ( !bitmap.Create(width, height, 24) )
+        return false;
+
+    return ConvertMatBitmapTowxBitmap(matBitmap, bitmap, options);
+}
+
+bool ConvertMatToNativeImage(const cv::Mat& matBitmap, NativeImage& image, const MatConversionOptions& options)
+{
+    const MatPixelFormat format = GetMatPixelFormat(matBitmap, options.format);
+    int                  width{0}, height{0};
+
+    wxCHECK(GetMatBitmapSize(matBitmap, format, width, height), false);
+    wxCHECK(image.GetWidth() == width && image.GetHeight() == height, false);
+    wxCHECK(format != MatPixelFormatGray16 || options.windowWidth > 0, false);
+
+    if ( PixelSize == 3 && !options.portableOnly )
     {
-        auto matBitmapIt = matBitmap.begin<cv::Vec3b>();
+        cv::Mat target(height, width, CV_8UC3, image.GetRow(0), image.GetRowStride());
 
-        for ( int row = 0; row < pixelData.GetHeight(); ++row )
-        {
-            pixelDataIt.MoveTo(pixelData, 0, row);
+        if ( !ConvertMatWithOpenCV(matBitmap, format, options, RedIndex == 0, true, target) )
+            return false;
 
-            for ( int col = 0;
-                  col < pixelData.GetWidth();
-                  ++col, ++pixelDataIt, ++matBitmapIt )
-            {
-                pixelDataIt.Blue()  = (*matBitmapIt)[0];
-                pixelDataIt.Green() = (*matBitmapIt)[1];
-                pixelDataIt.Red()   = (*matBitmapIt)[2];
-            }
-        }
+        wxCHECK(target.data == image.GetRow(0), false);
+        return true;
     }
 
-    return bitmap.IsOk();
+    for ( int row = 0; row < height; ++row )
+    {
+        unsigned char* dst = image.GetRow(row);
+
+        // the fourth byte is not written by the converters, make it opaque
+        if ( PixelSize == 4 )
+            memset(dst, 0xFF, image.GetRowStride());
+        ConvertRow(matBitmap, format, options, row, width, height, dst);
+    }
+
+    return true;
+}
+
+bool ConvertMatToBGR(const cv::Mat& matBitmap, cv::Mat& bgr, const MatConversionOptions& options)
+{
+    return ConvertMatWithOpenCV(matBitmap, GetMatPixelFormat(matBitmap, options.format), options, false, false, bgr);
 }
\ No newline at end of file
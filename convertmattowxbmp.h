@@ -1,6 +1,6 @@
 ///////////////////////////////////////////////////////////////////////////////
 // Name:        convertmattowxbmp.h
-// Purpose:     Converts OpenCV bitmap (Mat) stored as BGR CVU8 to wxBitmap
+// Purpose:     Converts OpenCV bitmap (Mat) stored as BGR, gray or YUV to wxBitmap
 // Author:      PB
 // Created:     2020-09-16
 // Copyright:   (c) 2020 PB
@@ -14,23 +14,72 @@
 // forward declarations
 namespace cv { class Mat; }
 class wxBitmap;
+class NativeImage;
+
+// Layouts of the image data in a cv::Mat. Besides BGR, a camera can deliver
+// the other ones when cv::CAP_PROP_CONVERT_RGB is off (e.g., grayscale, IR or
+// thermal cameras, or the raw YUV of webcams), converting them to wxBitmap
+// directly saves expanding them to BGR first.
+enum MatPixelFormat
+{
+    MatPixelFormatAuto = 0, // determined by cv::Mat::type(): all but NV12
+    MatPixelFormatBGR,      // CV_8UC3
+    MatPixelFormatBGRA,     // CV_8UC4, the alpha is ignored
+    MatPixelFormatGray,     // CV_8UC1
+    MatPixelFormatGray16,   // CV_16UC1, mapped to 8 bits with the window, see MatConversionOptions
+    MatPixelFormatYUYV,     // CV_8UC2, YUV 4:2:2 as Y0 U Y1 V, BT.601 limited range
+    MatPixelFormatNV12,     // CV_8UC1 with height * 3 / 2 rows: Y plane followed by interleaved U and V
+    MatPixelFormatRGB,      // CV_8UC3 in RGB order, never determined from the type
+};
+
+struct MatConversionOptions
+{
+    MatPixelFormat format{MatPixelFormatAuto};
+
+    // Only for MatPixelFormatGray16: the values from windowLevel - windowWidth / 2
+    // (black) to windowLevel + windowWidth / 2 (white) are mapped linearly,
+    // the values outside the window are clipped. The default maps the full range.
+    int            windowLevel{32768};
+    int            windowWidth{65536};
+
+    // Only for benchmarking: the portable pixel by pixel conversion
+    // is used even when a faster one is available.
+    bool           portableOnly{false};
+};
+
+// Returns the format of matBitmap: format itself if matBitmap's type
+// matches it, or the one corresponding to the type for MatPixelFormatAuto.
+// Returns MatPixelFormatAuto if matBitmap cannot be converted.
+MatPixelFormat GetMatPixelFormat(const cv::Mat& matBitmap, MatPixelFormat format = MatPixelFormatAuto);
+
+// Sets width and height to the size of the image stored in matBitmap, i.e. the size the
+// wxBitmap it is converted to must have; it differs from the Mat's size only for NV12.
+// Returns false if matBitmap cannot be converted.
+bool GetMatBitmapSize(const cv::Mat& matBitmap, MatPixelFormat format, int& width, int& height);
 
 /**
     @param matBitmap
-        Its data must be encoded as BGR CV_8UC3, which is
-        probably the most common format for OpenCV images.
+        Its data must be encoded as one of MatPixelFormats, the most
+        common format for OpenCV images being BGR CV_8UC3.
     @param bitmap
-        It must be initialized to the same width and height as matBitmap
-        and its depth must be 24.
+        It must be initialized to the same width and height as the image
+        in matBitmap (see GetMatBitmapSize()) and its depth must be 24.
+    @param options
+        The format of matBitmap and how to map the 16-bit values.
     @return @true if the conversion succeeded, @false otherwise.
 
 
-    On MS Windows, a MSW-optimized version is used if possible,
+    On MS Windows, a MSW-optimized version is used for BGR if possible,
     the portable one otherwise. In my testing on MSW with
     3840x2160 image in the Release build, the optimized version
     was about 25% faster then the portable one. MSW-optimized version
     is used when bitmap is a DIB and its width modulo 4 is 0.
 
+    The portable version converts all the formats to the bitmap's native
+    pixel format in a single pass: where the bitmap's pixels can be wrapped
+    in a cv::Mat (e.g., on GTK), with cv::cvtColor() writing directly to
+    them, otherwise pixel by pixel.
+
     In my testing on MSW with MSVS using 3840x2160 image, the portable
     version of conversion function in the Debug build was more then
     60 times slower than in the Release build.
@@ -41,7 +90,31 @@ class wxBitmap;
     wxBitmap outside the loop and reusing it in the loop instead
     of creating it every time inside the loop.
 */
-bool ConvertMatBitmapTowxBitmap(const cv::Mat& matBitmap, wxBitmap& bitmap);
+bool ConvertMatBitmapTowxBitmap(const cv::Mat& matBitmap, wxBitmap& bitmap,
+                                const MatConversionOptions& options = MatConversionOptions());
+
+// Creates bitmap (24-bit, with the size from GetMatBitmapSize()) from matBitmap.
+// On wxGTK, matBitmap is converted with OpenCV into a new RGB buffer, which then
+// becomes the bitmap's GdkPixbuf without being copied; RGB matBitmap is not converted
+// at all, the bitmap shares its data, which therefore must not be modified while the
+// bitmap exists. This saves allocating and initializing the bitmap's own buffer and
+// writing it pixel by pixel. Elsewhere, it is the same as creating the bitmap and
+// calling ConvertMatBitmapTowxBitmap(). Returns false if the conversion failed.
+bool CreatewxBitmapFromMat(const cv::Mat& matBitmap, wxBitmap& bitmap,
+                           const MatConversionOptions& options = MatConversionOptions());
+
+// Converts matBitmap into image, which must have the size from GetMatBitmapSize(),
+// without touching any wxBitmap, so that it is safe in any thread. The conversion
+// is done with OpenCV when the native layout has 24 bits, pixel by pixel otherwise.
+// Returns false if matBitmap cannot be converted.
+bool ConvertMatToNativeImage(const cv::Mat& matBitmap, NativeImage& image,
+                             const MatConversionOptions& options = MatConversionOptions());
+
+// Converts matBitmap in any of MatPixelFormats to BGR CV_8UC3 with OpenCV, for the code
+// which needs BGR (e.g., resizing YUV, motion detection, recording). If matBitmap
+// already is BGR, bgr just references its data. Returns false if it cannot be converted.
+bool ConvertMatToBGR(const cv::Mat& matBitmap, cv::Mat& bgr,
+                     const MatConversionOptions& options = MatConversionOptions());
 
 
 #endif // #ifndef CONVERTMATTOWXBMP_H
\ No newline at end of file
@@ -0,0 +1,108 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        cputime.cpp
+// Purpose:     Measuring CPU time consumed by the current thread and process
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+#include <wx/wx.h>
+
+#ifdef __WXMSW__
+    #include <wx/msw/wrapwin.h>
+#elif defined(__UNIX__)
+    #include <sys/resource.h>
+    #if !defined(__APPLE__)
+        #include <pthread.h>
+        #include <time.h>
+    #endif
+#endif
+
+#include "cputime.h"
+
+wxInt64 GetCurrentThreadCPUTimeUs()
+{
+#ifdef __WXMSW__
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+
+    if ( !::GetThreadTimes(::GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime) )
+        return -1;
+
+    ULARGE_INTEGER kernel, user;
+
+    kernel.LowPart  = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart    = userTime.dwLowDateTime;
+    user.HighPart   = userTime.dwHighDateTime;
+
+    // FILETIME is in 100-nanosecond intervals
+    return static_cast<wxInt64>((kernel.QuadPart + user.QuadPart) / 10);
+#elif defined(__UNIX__) && !defined(__APPLE__)
+    clockid_t clockId;
+    timespec  ts;
+
+    if ( pthread_getcpuclockid(pthread_self(), &clockId) != 0 )
+        return -1;
+
+    if ( clock_gettime(clockId, &ts) != 0 )
+        return -1;
+
+    return static_cast<wxInt64>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+#else
+    return -1;
+#endif
+}
+
+wxInt64 GetProcessCPUTimeUs()
+{
+#ifdef __WXMSW__
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+
+    if ( !::GetProcessTimes(::GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime) )
+        return -1;
+
+    ULARGE_INTEGER kernel, user;
+
+    kernel.LowPart  = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart    = userTime.dwLowDateTime;
+    user.HighPart   = userTime.dwHighDateTime;
+
+    // FILETIME is in 100-nanosecond intervals
+    return static_cast<wxInt64>((kernel.QuadPart + user.QuadPart) / 10);
+#elif defined(__UNIX__)
+    rusage usage;
+
+    if ( getrusage(RUSAGE_SELF, &usage) != 0 )
+        return -1;
+
+    return (static_cast<wxInt64>(usage.ru_utime.tv_sec) + usage.ru_stime.tv_sec) * 1000000
+           + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#else
+    return -1;
+#endif
+}
+
+
+/***********************************************************************************************
+
+    ThreadCPUStopWatch
+
+***********************************************************************************************/
+
+ThreadCPUStopWatch::ThreadCPUStopWatch()
+    : m_lapStartTime(GetCurrentThreadCPUTimeUs())
+{}
+
+wxInt64 ThreadCPUStopWatch::Lap()
+{
+    if ( !IsAvailable() )
+        return 0;
+
+    const wxInt64 now = GetCurrentThreadCPUTimeUs();
+    const wxInt64 lap = now - m_lapStartTime;
+
+    m_lapStartTime = now;
+    return lap;
+}
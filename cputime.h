@@ -0,0 +1,50 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        cputime.h
+// Purpose:     Measuring CPU time consumed by the current thread and process
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef CPUTIME_H
+#define CPUTIME_H
+
+#include <wx/defs.h>
+
+// Returns CPU time (user + system) consumed by the calling thread
+// in microseconds or -1 if it cannot be obtained on this platform.
+// Implemented for Linux (and other platforms with pthread_getcpuclockid())
+// and MS Windows.
+wxInt64 GetCurrentThreadCPUTimeUs();
+
+// Returns CPU time (user + system) consumed by all threads of the process
+// in microseconds or -1 if it cannot be obtained on this platform.
+wxInt64 GetProcessCPUTimeUs();
+
+
+/***********************************************************************************************
+
+    ThreadCPUStopWatch: measures CPU time of the thread it was created in.
+                        It must be used only in the thread it was created in.
+
+***********************************************************************************************/
+
+class ThreadCPUStopWatch
+{
+public:
+    ThreadCPUStopWatch();
+
+    // false if CPU time cannot be obtained on this platform
+    bool IsAvailable() const { return m_lapStartTime >= 0; }
+
+    // Returns CPU time in microseconds consumed by the thread since
+    // the last Lap() call or since the stopwatch was created.
+    // Returns 0 when !IsAvailable().
+    wxInt64 Lap();
+private:
+    wxInt64 m_lapStartTime;
+};
+
+#endif // #ifndef CPUTIME_H
@@ -0,0 +1,182 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        framebus.cpp
+// Purpose:     Publishing captured frames to multiple consumers without copying
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+
+#include "camerathread.h"
+#include "framebus.h"
+
+
+/***********************************************************************************************
+
+    FrameSubscriber
+
+***********************************************************************************************/
+
+FrameSubscriber::FrameSubscriber(const wxString& name, int cameraId, size_t capacity, DropPolicy dropPolicy,
+                                 FrameKind frameKind)
+    : m_name(name), m_cameraId(cameraId), m_capacity(capacity), m_dropPolicy(dropPolicy), m_frameKind(frameKind)
+{
+    wxASSERT(m_capacity > 0);
+}
+
+bool FrameSubscriber::Receive(BusFramePtr& frame, long timeout)
+{
+    wxMutexLocker locker(m_framesMutex);
+
+    if ( m_frames.empty() && !m_closed && timeout > 0 )
+    {
+        wxStopWatch stopWatch;
+
+        // wxCondition can wake up spuriously
+        while ( m_frames.empty() && !m_closed )
+        {
+            const long remaining = timeout - stopWatch.Time();
+
+            if ( remaining <= 0 )
+                break;
+
+            m_framesCondition.WaitTimeout(remaining);
+        }
+    }
+
+    if ( m_frames.empty() )
+        return false;
+
+    frame = m_frames.front();
+    m_frames.pop_front();
+
+    const wxInt64 lag = (wxGetUTCTimeMillis() - frame->capturedTime).GetValue();
+
+    CameraMetrics::Add(framesReceived);
+    CameraMetrics::Set(queueDepth, static_cast<wxInt64>(m_frames.size()));
+    CameraMetrics::Set(lastLagMs, lag);
+    if ( lag > CameraMetrics::Get(maxLagMs) )
+        CameraMetrics::Set(maxLagMs, lag);
+
+    return true;
+}
+
+bool FrameSubscriber::IsClosed() const
+{
+    wxMutexLocker locker(m_framesMutex);
+
+    return m_closed;
+}
+
+void FrameSubscriber::Post(const BusFramePtr& frame)
+{
+    wxMutexLocker locker(m_framesMutex);
+
+    if ( m_closed )
+        return;
+
+    if ( m_frames.size() >= m_capacity )
+    {
+        CameraMetrics::Add(framesDropped);
+
+        if ( m_dropPolicy == DropNewest )
+            return;
+
+        m_frames.pop_front();
+    }
+
+    m_frames.push_back(frame);
+    CameraMetrics::Add(framesDelivered);
+    CameraMetrics::Set(queueDepth, static_cast<wxInt64>(m_frames.size()));
+
+    m_framesCondition.Signal();
+}
+
+void FrameSubscriber::Close()
+{
+    wxMutexLocker locker(m_framesMutex);
+
+    m_closed = true;
+    m_framesCondition.Broadcast();
+}
+
+
+/***********************************************************************************************
+
+    FrameBus
+
+***********************************************************************************************/
+
+FrameSubscriberPtr FrameBus::Subscribe(const wxString& name, int cameraId, size_t capacity,
+                                       FrameSubscriber::DropPolicy dropPolicy, FrameSubscriber::FrameKind frameKind)
+{
+    wxCHECK_MSG(capacity > 0, FrameSubscriberPtr(), "Subscriber queue capacity must be positive");
+
+    FrameSubscriberPtr      subscriber(new FrameSubscriber(name, cameraId, capacity, dropPolicy, frameKind));
+    wxCriticalSectionLocker locker(m_subscribersCS);
+
+    m_subscribers.push_back(subscriber);
+    m_subscriberCount = m_subscribers.size();
+
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Frame bus subscriber '%s' added for camera id %d.", name, cameraId);
+    return subscriber;
+}
+
+void FrameBus::Unsubscribe(const FrameSubscriberPtr& subscriber)
+{
+    wxCHECK_RET(subscriber, "Invalid subscriber");
+
+    {
+        wxCriticalSectionLocker locker(m_subscribersCS);
+
+        m_subscribers.erase(std::remove(m_subscribers.begin(), m_subscribers.end(), subscriber), m_subscribers.end());
+        m_subscriberCount = m_subscribers.size();
+    }
+
+    subscriber->Close();
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Frame bus subscriber '%s' removed.", subscriber->GetName());
+}
+
+bool FrameBus::HasSubscribers(int cameraId, bool thumbnails) const
+{
+    if ( m_subscriberCount.load(std::memory_order_relaxed) == 0 )
+        return false;
+
+    wxCriticalSectionLocker locker(m_subscribersCS);
+
+    return std::any_of(m_subscribers.begin(), m_subscribers.end(),
+                       [cameraId, thumbnails](const FrameSubscriberPtr& s) { return s->Accepts(cameraId, thumbnails); });
+}
+
+size_t FrameBus::Publish(const BusFramePtr& frame)
+{
+    wxCHECK_MSG(frame, 0, "Invalid frame");
+
+    if ( m_subscriberCount.load(std::memory_order_relaxed) == 0 )
+        return 0;
+
+    size_t                  delivered = 0;
+    wxCriticalSectionLocker locker(m_subscribersCS);
+
+    // posting only takes the subscriber's mutex for a few pointer operations,
+    // so it is done while holding the lock instead of copying the subscribers
+    for ( const auto& s : m_subscribers )
+    {
+        if ( s->Accepts(frame->cameraId, frame->thumbnail) )
+        {
+            s->Post(frame);
+            ++delivered;
+        }
+    }
+
+    return delivered;
+}
+
+std::vector<FrameSubscriberPtr> FrameBus::GetSubscribers() const
+{
+    wxCriticalSectionLocker locker(m_subscribersCS);
+
+    return m_subscribers;
+}
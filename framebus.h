@@ -0,0 +1,170 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        framebus.h
+// Purpose:     Publishing captured frames to multiple consumers without copying
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef FRAMEBUS_H
+#define FRAMEBUS_H
+
+#include <wx/wx.h>
+#include <wx/thread.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "framememorybudget.h"
+#include "metrics.h"
+
+/***********************************************************************************************
+
+    BusFrame: a captured frame published on FrameBus. The image data is reference
+              counted by cv::Mat and shared by the camera thread and all subscribers,
+              so it must be treated as read-only: a subscriber wanting to modify it
+              must clone it first.
+
+***********************************************************************************************/
+
+struct BusFrame
+{
+    int         cameraId{-1}; // see CameraSetupData::id
+    wxULongLong frameNumber{0};
+    wxLongLong  capturedTime{0}; // obtained with wxGetUTCTimeMillis()
+    cv::Mat     image; // BGR CV_8UC3 as retrieved from cv::VideoCapture or a compressed packet
+    bool        thumbnail{false}; // image is the BGR thumbnail of the frame, see FrameSubscriber::Thumbnails
+
+    // the following are set only for frames from cameras with CameraSetupData::passthrough
+    bool        encoded{false};  // image is a 1xN CV_8UC1 compressed packet, not decoded
+    bool        keyFrame{true};  // always true when it cannot be determined (OpenCV < 4.5.2)
+    int         fourCC{0};       // codec, as returned by cv::CAP_PROP_FOURCC
+    cv::Mat     codecExtraData;  // e.g. H.264 SPS and PPS, may be empty
+
+    // image's bytes charged to CameraSetupData::frameMemoryBudget, shared by
+    // the frames for all outputs, null when there is no budget
+    FrameMemoryChargePtr memoryCharge;
+};
+
+typedef std::shared_ptr<const BusFrame> BusFramePtr;
+
+
+/***********************************************************************************************
+
+    FrameSubscriber: a bounded queue of frames for a single consumer, created
+                     with FrameBus::Subscribe(). The camera threads add frames
+                     to it, the consumer takes them with Receive() from its own
+                     thread. When the queue is full, the frame is dropped
+                     according to the subscriber's drop policy, so that a slow
+                     consumer never blocks the camera threads.
+
+***********************************************************************************************/
+
+class FrameSubscriber
+{
+public:
+    enum DropPolicy
+    {
+        DropOldest, // discard the oldest queued frame to make room for the new one
+        DropNewest  // keep the queued frames and discard the new one
+    };
+
+    enum FrameKind
+    {
+        FullFrames, // the captured frames
+        Thumbnails  // the thumbnails the camera threads create for the GUI anyway,
+                    // for consumers needing only small images (e.g., ObjectDetector)
+    };
+
+    FrameSubscriber(const wxString& name, int cameraId, size_t capacity, DropPolicy dropPolicy,
+                    FrameKind frameKind = FullFrames);
+
+    const wxString& GetName() const       { return m_name; }
+    // -1 means frames from all cameras
+    int             GetCameraId() const   { return m_cameraId; }
+    size_t          GetCapacity() const   { return m_capacity; }
+    DropPolicy      GetDropPolicy() const { return m_dropPolicy; }
+    FrameKind       GetFrameKind() const  { return m_frameKind; }
+
+    // Waits at most timeout ms for a frame, 0 means do not wait.
+    // Returns false on timeout or when the subscriber was unsubscribed
+    // and there are no more frames to receive.
+    bool Receive(BusFramePtr& frame, long timeout);
+
+    // true after FrameBus::Unsubscribe()
+    bool IsClosed() const;
+
+    // counters and gauges, read with CameraMetrics::Get()
+    CameraMetrics::Counter framesDelivered{0}; // added to the queue
+    CameraMetrics::Counter framesReceived{0};  // taken from the queue by the consumer
+    CameraMetrics::Counter framesDropped{0};   // discarded because the queue was full
+    CameraMetrics::Gauge   queueDepth{0};      // frames in the queue, i.e. lag in frames
+    CameraMetrics::Gauge   lastLagMs{0};       // from capturing the last received frame to receiving it
+    CameraMetrics::Gauge   maxLagMs{0};
+private:
+    friend class FrameBus;
+
+    const wxString          m_name;
+    const int               m_cameraId;
+    const size_t            m_capacity;
+    const DropPolicy        m_dropPolicy;
+    const FrameKind         m_frameKind;
+
+    mutable wxMutex         m_framesMutex;
+    wxCondition             m_framesCondition{m_framesMutex};
+    std::deque<BusFramePtr> m_frames;
+    bool                    m_closed{false};
+
+    // called by FrameBus
+    bool Accepts(int cameraId, bool thumbnail) const
+    {
+        return (m_frameKind == Thumbnails) == thumbnail && (m_cameraId < 0 || m_cameraId == cameraId);
+    }
+    void Post(const BusFramePtr& frame);
+    void Close();
+
+    wxDECLARE_NO_COPY_CLASS(FrameSubscriber);
+};
+
+typedef std::shared_ptr<FrameSubscriber> FrameSubscriberPtr;
+
+
+/***********************************************************************************************
+
+    FrameBus: distributes frames published by the camera threads to the subscribers.
+              It is thread-safe, subscribers can be added and removed any time.
+
+***********************************************************************************************/
+
+class FrameBus
+{
+public:
+    // cameraId -1 means subscribing to frames from all cameras
+    FrameSubscriberPtr Subscribe(const wxString& name, int cameraId = -1, size_t capacity = 4,
+                                 FrameSubscriber::DropPolicy dropPolicy = FrameSubscriber::DropOldest,
+                                 FrameSubscriber::FrameKind frameKind = FrameSubscriber::FullFrames);
+    // Removes the subscriber and wakes up its consumer waiting in Receive(),
+    // the frames already queued can still be received.
+    void               Unsubscribe(const FrameSubscriberPtr& subscriber);
+
+    // Cheap check for the camera thread to avoid creating frames nobody wants.
+    bool               HasSubscribers(int cameraId, bool thumbnails = false) const;
+
+    // Adds the frame to the queues of all subscribers to its camera and its kind,
+    // returns the number of subscribers it was added to.
+    size_t             Publish(const BusFramePtr& frame);
+
+    std::vector<FrameSubscriberPtr> GetSubscribers() const;
+private:
+    mutable wxCriticalSection       m_subscribersCS;
+    std::vector<FrameSubscriberPtr> m_subscribers;
+    std::atomic<size_t>             m_subscriberCount{0};
+};
+
+#endif // #ifndef FRAMEBUS_H
@@ -0,0 +1,75 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        framehash.cpp
+// Purpose:     Fast sampled hash of decoded frames for detecting repeated images
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+#include <wx/wx.h>
+
+#include <cstring>
+
+#include <opencv2/core.hpp>
+
+#include "framehash.h"
+
+namespace
+{
+
+const wxUint64 frameHashPrime = wxULL(0x9E3779B97F4A7C15);
+
+inline wxUint64 MixFrameHash(wxUint64 hash, wxUint64 value)
+{
+    hash ^= value;
+    hash *= frameHashPrime;
+    return hash ^ (hash >> 29);
+}
+
+void HashFrameRow(wxUint64 (&lanes)[4], const unsigned char* data, size_t rowBytes)
+{
+    size_t offset = 0;
+
+    // the lanes do not depend on each other, so the multiplications overlap
+    for ( ; offset + 32 <= rowBytes; offset += 32 )
+    {
+        wxUint64 values[4];
+
+        memcpy(values, data + offset, sizeof(values));
+        lanes[0] = MixFrameHash(lanes[0], values[0]);
+        lanes[1] = MixFrameHash(lanes[1], values[1]);
+        lanes[2] = MixFrameHash(lanes[2], values[2]);
+        lanes[3] = MixFrameHash(lanes[3], values[3]);
+    }
+
+    for ( ; offset < rowBytes; ++offset )
+        lanes[offset % 4] = MixFrameHash(lanes[offset % 4], data[offset]);
+}
+
+} // unnamed namespace
+
+wxUint64 ComputeFrameHash(const cv::Mat& image, int rowStride)
+{
+    wxASSERT(rowStride > 0);
+    wxASSERT(image.dims == 2);
+
+    const size_t rowBytes = image.cols * image.elemSize();
+    wxUint64     lanes[4] = { 1, 2, 3, 4 };
+
+    lanes[0] = MixFrameHash(lanes[0], static_cast<wxUint64>(image.rows) << 32 | static_cast<wxUint32>(image.cols));
+    lanes[1] = MixFrameHash(lanes[1], static_cast<wxUint64>(image.type()));
+
+    for ( int row = 0; row < image.rows; row += rowStride )
+        HashFrameRow(lanes, image.ptr(row), rowBytes);
+
+    if ( image.rows > 0 && (image.rows - 1) % rowStride != 0 )
+        HashFrameRow(lanes, image.ptr(image.rows - 1), rowBytes);
+
+    wxUint64 hash = lanes[0];
+
+    for ( size_t i = 1; i < 4; ++i )
+        hash = MixFrameHash(hash, lanes[i]);
+
+    return hash;
+}
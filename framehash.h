@@ -0,0 +1,28 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        framehash.h
+// Purpose:     Fast sampled hash of decoded frames for detecting repeated images
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef FRAMEHASH_H
+#define FRAMEHASH_H
+
+#include <wx/defs.h>
+
+namespace cv { class Mat; }
+
+// Returns a 64-bit hash of the image's size, type and every rowStride-th row
+// (always including the last one). The rows are hashed whole, 8 bytes at a time
+// in four independent lanes, so hashing a 1080p frame with the default stride
+// reads about 1/8 of it and costs a small fraction of converting it to wxBitmap.
+// A change confined to the rows not sampled goes unnoticed, which is acceptable
+// for detecting sources repeating the same image (e.g., static slides, frozen
+// encoders, or a camera read faster than it produces frames), as any real
+// change of the scene spans many rows.
+wxUint64 ComputeFrameHash(const cv::Mat& image, int rowStride = 8);
+
+#endif // #ifndef FRAMEHASH_H
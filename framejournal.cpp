@@ -0,0 +1,267 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        framejournal.cpp
+// Purpose:     Writing raw frames to a memory-mapped circular file
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+#include <wx/wx.h>
+
+#ifdef __WXMSW__
+    #include <wx/msw/wrapwin.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #include <cerrno>
+#endif
+
+#include <cstring>
+#include <limits>
+
+#include <opencv2/core.hpp>
+
+#include "camerathread.h"
+#include "framejournal.h"
+
+namespace
+{
+
+uint64_t RoundUpToPage(uint64_t size)
+{
+    return (size + FrameJournalPageSize - 1) / FrameJournalPageSize * FrameJournalPageSize;
+}
+
+// copies a zero-terminated UTF-8 string, truncating it if needed
+void CopyString(char* dest, size_t destSize, const wxString& s)
+{
+    const wxScopedCharBuffer utf8 = s.utf8_str();
+
+    strncpy(dest, utf8.data(), destSize - 1);
+    dest[destSize - 1] = 0;
+}
+
+int32_t GetJournalPixelFormat(MatPixelFormat pixelFormat)
+{
+    switch ( pixelFormat )
+    {
+        case MatPixelFormatYUYV: return FrameJournalPixelFormatYUYV;
+        case MatPixelFormatNV12: return FrameJournalPixelFormatNV12;
+        case MatPixelFormatRGB:  return FrameJournalPixelFormatRGB;
+        default:                 return FrameJournalPixelFormatByType;
+    }
+}
+
+} // unnamed namespace
+
+
+FrameJournal::~FrameJournal()
+{
+    Close();
+}
+
+bool FrameJournal::Open(const wxString& fileName, wxULongLong size,
+                        const wxString& cameraName, const wxString& cameraAddress,
+                        wxString& errorMessage)
+{
+    wxCHECK_MSG(!IsOpened(), false, "Journal is already opened");
+
+    if ( size.GetValue() < FrameJournalPageSize * 2 || size.GetValue() > std::numeric_limits<size_t>::max() )
+    {
+        errorMessage = "Invalid journal size.";
+        return false;
+    }
+
+    const size_t mapSize = static_cast<size_t>(size.GetValue());
+
+#ifdef __WXMSW__
+    HANDLE fileHandle = ::CreateFileW(fileName.wc_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+                                      nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if ( fileHandle == INVALID_HANDLE_VALUE )
+    {
+        errorMessage.Printf("Could not create '%s': %s", fileName, wxSysErrorMsgStr());
+        return false;
+    }
+
+    // creating the mapping extends the file to its size
+    HANDLE mappingHandle = ::CreateFileMappingW(fileHandle, nullptr, PAGE_READWRITE,
+                                                static_cast<DWORD>(size.GetHi()), static_cast<DWORD>(size.GetLo()), nullptr);
+
+    if ( !mappingHandle )
+    {
+        errorMessage.Printf("Could not create file mapping for '%s': %s", fileName, wxSysErrorMsgStr());
+        ::CloseHandle(fileHandle);
+        return false;
+    }
+
+    void* data = ::MapViewOfFile(mappingHandle, FILE_MAP_WRITE, 0, 0, mapSize);
+
+    if ( !data )
+    {
+        errorMessage.Printf("Could not map '%s' to memory: %s", fileName, wxSysErrorMsgStr());
+        ::CloseHandle(mappingHandle);
+        ::CloseHandle(fileHandle);
+        return false;
+    }
+
+    m_fileHandle    = fileHandle;
+    m_mappingHandle = mappingHandle;
+#else
+    const int fd = open(fileName.fn_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+
+    if ( fd == -1 )
+    {
+        errorMessage.Printf("Could not create '%s': %s", fileName, strerror(errno));
+        return false;
+    }
+
+#ifdef __LINUX__
+    // allocate the disk space now, writing to a mapped page of a sparse file
+    // when the disk is full would kill the camera thread with SIGBUS
+    const int allocateError = posix_fallocate(fd, 0, static_cast<off_t>(mapSize));
+
+    if ( allocateError != 0 )
+    {
+        errorMessage.Printf("Could not allocate %s bytes for '%s': %s", size.ToString(), fileName, strerror(allocateError));
+        close(fd);
+        return false;
+    }
+#else
+    if ( ftruncate(fd, static_cast<off_t>(mapSize)) != 0 )
+    {
+        errorMessage.Printf("Could not resize '%s': %s", fileName, strerror(errno));
+        close(fd);
+        return false;
+    }
+#endif
+
+    void* data = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    // the mapping keeps the file open
+    close(fd);
+
+    if ( data == MAP_FAILED )
+    {
+        errorMessage.Printf("Could not map '%s' to memory: %s", fileName, strerror(errno));
+        return false;
+    }
+#endif
+
+    m_data     = static_cast<unsigned char*>(data);
+    m_size     = mapSize;
+    m_fileName = fileName;
+    m_header   = reinterpret_cast<FrameJournalFileHeader*>(m_data);
+
+    memset(m_header, 0, sizeof(FrameJournalFileHeader));
+    memcpy(m_header->magic, FRAMEJOURNAL_MAGIC, sizeof(m_header->magic));
+    m_header->version     = 2;
+    m_header->headerSize  = sizeof(FrameJournalFileHeader);
+    m_header->fileSize    = m_size;
+    m_header->slotsOffset = RoundUpToPage(sizeof(FrameJournalFileHeader));
+    CopyString(m_header->cameraName, sizeof(m_header->cameraName), cameraName);
+    CopyString(m_header->cameraAddress, sizeof(m_header->cameraAddress), cameraAddress);
+
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Opened frame journal '%s' (%s bytes) for camera '%s'.", m_fileName, size.ToString(), cameraName);
+    return true;
+}
+
+void FrameJournal::Close()
+{
+    if ( !IsOpened() )
+        return;
+
+    const wxULongLong framesWritten(m_header->framesWritten);
+
+#ifdef __WXMSW__
+    // only initiates writing the pages, does not wait for it
+    ::FlushViewOfFile(m_data, 0);
+    ::UnmapViewOfFile(m_data);
+    ::CloseHandle(m_mappingHandle);
+    ::CloseHandle(m_fileHandle);
+    m_mappingHandle = nullptr;
+    m_fileHandle = nullptr;
+#else
+    msync(m_data, m_size, MS_ASYNC);
+    munmap(m_data, m_size);
+#endif
+
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Closed frame journal '%s' after %s frames.",
+               m_fileName, framesWritten.ToString());
+
+    m_data = nullptr;
+    m_header = nullptr;
+    m_size = 0;
+    m_fileName.clear();
+}
+
+bool FrameJournal::InitSlots(const cv::Mat& matFrame)
+{
+    const uint64_t dataOffset = RoundUpToPage(sizeof(FrameJournalSlotHeader));
+    const uint64_t dataSize   = static_cast<uint64_t>(matFrame.cols) * matFrame.elemSize() * matFrame.rows;
+    const uint64_t slotSize   = RoundUpToPage(dataOffset + dataSize);
+    const uint64_t slotCount  = (m_size - m_header->slotsOffset) / slotSize;
+
+    if ( slotCount == 0 )
+        return false;
+
+    m_header->slotSize  = slotSize;
+    m_header->slotCount = slotCount;
+
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Frame journal '%s' holds %s frames of %dx%d.",
+               m_fileName, wxULongLong(slotCount).ToString(), matFrame.cols, matFrame.rows);
+    return true;
+}
+
+bool FrameJournal::Write(const cv::Mat& matFrame, MatPixelFormat pixelFormat, const CameraFrameData& frameData)
+{
+    wxCHECK_MSG(IsOpened(), false, "Journal is not opened");
+    wxCHECK_MSG(matFrame.dims == 2, false, "Only 2D frames can be journaled");
+
+    if ( m_header->slotCount == 0 && !InitSlots(matFrame) )
+        return false;
+
+    const uint64_t rowBytes = static_cast<uint64_t>(matFrame.cols) * matFrame.elemSize();
+    const uint64_t dataSize = rowBytes * matFrame.rows;
+    const uint64_t sequence = m_header->framesWritten + 1;
+
+    unsigned char*          slot = m_data + m_header->slotsOffset + ((sequence - 1) % m_header->slotCount) * m_header->slotSize;
+    FrameJournalSlotHeader* slotHeader = reinterpret_cast<FrameJournalSlotHeader*>(slot);
+    const uint64_t          dataOffset = RoundUpToPage(sizeof(FrameJournalSlotHeader));
+
+    if ( dataOffset + dataSize > m_header->slotSize )
+        return false;
+
+    // mark the slot as being written, see framejournalformat.h
+    slotHeader->sequence = 0;
+
+    if ( matFrame.isContinuous() )
+    {
+        memcpy(slot + dataOffset, matFrame.data, dataSize);
+    }
+    else
+    {
+        for ( int row = 0; row < matFrame.rows; ++row )
+            memcpy(slot + dataOffset + row * rowBytes, matFrame.ptr(row), rowBytes);
+    }
+
+    slotHeader->frameNumber           = frameData.GetFrameNumber().GetValue();
+    slotHeader->capturedTime          = frameData.GetCapturedTime().GetValue();
+    slotHeader->timeToRetrieve        = static_cast<int32_t>(frameData.GetTimeToRetrieve());
+    slotHeader->timeToConvert         = static_cast<int32_t>(frameData.GetTimeToConvert());
+    slotHeader->timeToCreateThumbnail = static_cast<int32_t>(frameData.GetTimeToCreateThumbnail());
+    slotHeader->width                 = matFrame.cols;
+    slotHeader->height                = matFrame.rows;
+    slotHeader->type                  = matFrame.type();
+    slotHeader->pixelFormat           = GetJournalPixelFormat(pixelFormat);
+    slotHeader->rowBytes              = rowBytes;
+    slotHeader->dataSize              = dataSize;
+    slotHeader->dataOffset            = dataOffset;
+    slotHeader->sequence              = sequence;
+
+    m_header->framesWritten = sequence;
+    return true;
+}
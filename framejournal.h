@@ -0,0 +1,77 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        framejournal.h
+// Purpose:     Writing raw frames to a memory-mapped circular file
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef FRAMEJOURNAL_H
+#define FRAMEJOURNAL_H
+
+#include <wx/wx.h>
+
+#include "convertmattowxbmp.h"
+#include "framejournalformat.h"
+
+namespace cv { class Mat; }
+class CameraFrameData;
+
+/***********************************************************************************************
+
+    FrameJournal: keeps the last frames of a camera bit-exact, as retrieved from
+                  cv::VideoCapture, together with their CameraFrameData metadata,
+                  in a preallocated memory-mapped file used as a circular buffer,
+                  see framejournalformat.h for its layout.
+
+                  Writing a frame costs just copying it to the mapped memory, the OS
+                  writes the pages to the file asynchronously. As the pages belong
+                  to the file, not to the process, the frames are preserved even
+                  when the application crashes. Use the journal reader tool
+                  (journalreader.cpp) to extract the frames afterwards.
+
+                  It is used only by the camera thread, see CameraCommandData::StartJournal.
+
+***********************************************************************************************/
+
+class FrameJournal
+{
+public:
+    FrameJournal() {}
+    ~FrameJournal();
+
+    // Creates (or overwrites) fileName with size bytes and maps it to memory.
+    bool Open(const wxString& fileName, wxULongLong size,
+              const wxString& cameraName, const wxString& cameraAddress,
+              wxString& errorMessage);
+    // Unmaps the file, the OS still writes the modified pages to it afterwards.
+    void Close();
+
+    bool            IsOpened() const    { return m_data != nullptr; }
+    const wxString& GetFileName() const { return m_fileName; }
+
+    // Copies the frame to the slot of the oldest frame. Returns false when
+    // the frame does not fit into a slot, the slot size is determined by
+    // the first frame written, so that can happen when the camera changes
+    // resolution while journaling. pixelFormat is the format of matFrame,
+    // MatPixelFormatAuto for decoded frames.
+    bool Write(const cv::Mat& matFrame, MatPixelFormat pixelFormat, const CameraFrameData& frameData);
+private:
+    wxString                m_fileName;
+    unsigned char*          m_data{nullptr};
+    size_t                  m_size{0};
+    FrameJournalFileHeader* m_header{nullptr};
+#ifdef __WXMSW__
+    void*                   m_fileHandle{nullptr};
+    void*                   m_mappingHandle{nullptr};
+#endif
+
+    // sets slotSize and slotCount in the file header
+    bool InitSlots(const cv::Mat& matFrame);
+
+    wxDECLARE_NO_COPY_CLASS(FrameJournal);
+};
+
+#endif // #ifndef FRAMEJOURNAL_H
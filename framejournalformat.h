@@ -0,0 +1,85 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        framejournalformat.h
+// Purpose:     Layout of the raw frame journal file, see FrameJournal
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef FRAMEJOURNALFORMAT_H
+#define FRAMEJOURNALFORMAT_H
+
+// Only standard types are used here, so that the journal reader
+// tool does not depend on wxWidgets.
+
+#include <cstdint>
+
+/***********************************************************************************************
+
+    The journal file starts with FrameJournalFileHeader, followed at slotsOffset
+    by slotCount slots of slotSize bytes, used as a circular buffer: frame n
+    (counted from 1) is written to slot (n - 1) % slotCount. Each slot starts
+    with FrameJournalSlotHeader, followed at dataOffset by the frame's pixel rows
+    stored contiguously. The slot layout is determined by the first frame written,
+    until then slotSize and slotCount are 0. All values are little-endian
+    (i.e., in the native byte order of the supported platforms).
+
+    A slot's sequence is set to 0 before its frame is copied and to the frame's
+    number in the journal after, so a slot with sequence 0 is either unused
+    or contains a partially written frame and must be ignored.
+
+***********************************************************************************************/
+
+#define FRAMEJOURNAL_MAGIC "WXOCVFJ1"
+
+// FrameJournalSlotHeader::pixelFormat, needed for the raw frames whose
+// layout cannot be told from the type
+enum FrameJournalPixelFormat
+{
+    FrameJournalPixelFormatByType = 0, // CV_8UC3 BGR, CV_8UC4 BGRA, CV_8UC1 or CV_16UC1 gray
+    FrameJournalPixelFormatYUYV   = 1, // CV_8UC2, YUV 4:2:2 as Y0 U Y1 V
+    FrameJournalPixelFormatNV12   = 2, // CV_8UC1 with height * 3 / 2 rows
+    FrameJournalPixelFormatRGB    = 3, // CV_8UC3 in RGB order
+};
+
+struct FrameJournalFileHeader
+{
+    char     magic[8];          // FRAMEJOURNAL_MAGIC without the terminating zero
+    uint32_t version;           // 2, version 1 journals do not have FrameJournalSlotHeader::pixelFormat
+    uint32_t headerSize;        // sizeof(FrameJournalFileHeader)
+    uint64_t fileSize;
+    uint64_t slotsOffset;
+    uint64_t slotSize;
+    uint64_t slotCount;
+    uint64_t framesWritten;     // the sequence of the last frame written
+    char     cameraName[128];   // UTF-8, zero-terminated
+    char     cameraAddress[512];
+};
+
+struct FrameJournalSlotHeader
+{
+    uint64_t sequence;
+    uint64_t frameNumber;           // CameraFrameData::GetFrameNumber()
+    int64_t  capturedTime;          // ms since the epoch (UTC)
+    int32_t  timeToRetrieve;        // ms, see CameraFrameData
+    int32_t  timeToConvert;
+    int32_t  timeToCreateThumbnail;
+    int32_t  width;
+    int32_t  height;
+    int32_t  type;                  // cv::Mat::type(), CV_8UC3 (BGR) for decoded frames; as retrieved
+                                    // without the conversion to RGB, e.g. CV_8UC2 for YUYV or CV_8UC1
+                                    // with height * 3 / 2 rows for NV12
+    int32_t  pixelFormat;           // FrameJournalPixelFormat, in the former padding, so
+                                    // it must be ignored in version 1 journals
+    uint64_t rowBytes;              // width * bytes per pixel, rows are not padded
+    uint64_t dataSize;              // rowBytes * height
+    uint64_t dataOffset;            // from the start of the slot
+};
+
+// the header is followed by the slots at the first page boundary
+// and the slots are page-aligned too
+const uint64_t FrameJournalPageSize = 4096;
+
+#endif // #ifndef FRAMEJOURNALFORMAT_H
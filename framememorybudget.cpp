@@ -0,0 +1,60 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        framememorybudget.cpp
+// Purpose:     Accounting of memory held by frames in flight against a global budget
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+#include <wx/wx.h>
+
+#include "framememorybudget.h"
+
+FrameMemoryCharge::FrameMemoryCharge(const std::shared_ptr<FrameMemoryBudget>& budget,
+                                     const CameraMetricsPtr& metrics, size_t bytes)
+    : m_budget(budget), m_metrics(metrics), m_bytes(bytes)
+{
+    wxASSERT(m_budget);
+    wxASSERT(m_metrics);
+}
+
+FrameMemoryCharge::~FrameMemoryCharge()
+{
+    m_budget->Release(m_bytes);
+    CameraMetrics::Add(m_metrics->frameMemoryBytes, -static_cast<wxInt64>(m_bytes));
+}
+
+FrameMemoryChargePtr FrameMemoryBudget::Charge(size_t bytes, const CameraMetricsPtr& metrics)
+{
+    wxCHECK(metrics, FrameMemoryChargePtr());
+
+    if ( bytes == 0 )
+        return FrameMemoryChargePtr();
+
+    const wxUint64 budget = m_budgetBytes;
+    wxUint64       used = m_usedBytes.load();
+    wxUint64       newUsed;
+
+    // the camera threads charge concurrently, so the budget
+    // must be checked and the bytes added in a single step
+    do
+    {
+        newUsed = used + bytes;
+        if ( budget > 0 && newUsed > budget )
+        {
+            m_framesDropped++;
+            CameraMetrics::Add(metrics->framesDroppedMemory);
+            return FrameMemoryChargePtr();
+        }
+    } while ( !m_usedBytes.compare_exchange_weak(used, newUsed) );
+
+    wxUint64 peak = m_peakBytes.load();
+
+    while ( newUsed > peak && !m_peakBytes.compare_exchange_weak(peak, newUsed) )
+        ;
+
+    CameraMetrics::Add(metrics->frameMemoryBytes, static_cast<wxInt64>(bytes));
+
+    return std::make_shared<FrameMemoryCharge>(shared_from_this(), metrics, bytes);
+}
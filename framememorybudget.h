@@ -0,0 +1,96 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        framememorybudget.h
+// Purpose:     Accounting of memory held by frames in flight against a global budget
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef FRAMEMEMORYBUDGET_H
+#define FRAMEMEMORYBUDGET_H
+
+#include <wx/wx.h>
+
+#include <atomic>
+#include <memory>
+
+#include "metrics.h"
+
+class FrameMemoryBudget;
+
+/***********************************************************************************************
+
+    FrameMemoryCharge: bytes charged to FrameMemoryBudget and to a camera's
+                       CameraMetrics::frameMemoryBytes, released when destroyed.
+                       It is shared by everything referencing the charged buffers,
+                       e.g., all CameraFrameData sharing a frame's bitmaps, so that
+                       the bytes are released when the last of them is destroyed,
+                       in whichever thread that happens.
+
+***********************************************************************************************/
+
+class FrameMemoryCharge
+{
+public:
+    FrameMemoryCharge(const std::shared_ptr<FrameMemoryBudget>& budget, const CameraMetricsPtr& metrics, size_t bytes);
+    ~FrameMemoryCharge();
+
+    size_t GetBytes() const { return m_bytes; }
+private:
+    std::shared_ptr<FrameMemoryBudget> m_budget;
+    CameraMetricsPtr                   m_metrics;
+    const size_t                       m_bytes;
+
+    wxDECLARE_NO_COPY_CLASS(FrameMemoryCharge);
+};
+
+typedef std::shared_ptr<FrameMemoryCharge> FrameMemoryChargePtr;
+
+
+/***********************************************************************************************
+
+    FrameMemoryBudget: the total of bytes held by frames in flight, i.e. the bitmaps
+                       of CameraFrameData waiting for the GUI thread and the images
+                       of BusFrames waiting in the FrameBus subscribers' queues.
+                       The camera threads charge the bytes before allocating the buffers
+                       and when the budget would be exceeded, they drop the frame instead.
+
+                       It is thread-safe and shared by the camera threads, see
+                       CameraSetupData::frameMemoryBudget. It is not charged for the
+                       bitmaps already shown by the GUI (one thumbnail per camera and
+                       one frame per OneCameraFrame) nor for the capture backends' buffers.
+
+***********************************************************************************************/
+
+class FrameMemoryBudget : public std::enable_shared_from_this<FrameMemoryBudget>
+{
+public:
+    // 0 = unlimited, only accounting
+    void     SetBudget(wxUint64 bytes) { m_budgetBytes = bytes; }
+    wxUint64 GetBudget() const         { return m_budgetBytes; }
+
+    // Returns null when charging bytes would exceed the budget, the frame is then counted
+    // as dropped in metrics. Charging 0 bytes always succeeds and returns null.
+    FrameMemoryChargePtr Charge(size_t bytes, const CameraMetricsPtr& metrics);
+
+    wxUint64 GetUsed() const          { return m_usedBytes; }
+    wxUint64 GetPeak() const          { return m_peakBytes; }
+    wxUint64 GetFramesDropped() const { return m_framesDropped; }
+    void     ResetPeak()              { m_peakBytes = m_usedBytes.load(); }
+private:
+    friend class FrameMemoryCharge;
+
+    std::atomic<wxUint64> m_budgetBytes{0};
+    std::atomic<wxUint64> m_usedBytes{0};
+    std::atomic<wxUint64> m_peakBytes{0};
+    std::atomic<wxUint64> m_framesDropped{0};
+
+    // called by FrameMemoryCharge
+    void Release(size_t bytes) { m_usedBytes -= bytes; }
+};
+
+typedef std::shared_ptr<FrameMemoryBudget> FrameMemoryBudgetPtr;
+
+#endif // #ifndef FRAMEMEMORYBUDGET_H
@@ -0,0 +1,234 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        journalreader.cpp
+// Purpose:     Command line tool extracting frames from a raw frame journal
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+// Usage: wxOpenCVCamerasJournalReader journal-file [output-directory]
+//
+// Lists the frames in the journal written by FrameJournal, oldest first.
+// When the output directory (which must exist) is given, every frame is also
+// saved there losslessly as frame_<frame number>.png and the metadata of all
+// frames are written to frames.csv. Raw YUV and RGB frames are converted
+// to BGR first, so their PNGs are not bit-exact.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "framejournalformat.h"
+
+namespace
+{
+
+struct JournalFrame
+{
+    uint64_t               slotIndex;
+    FrameJournalSlotHeader header;
+};
+
+bool ReadHeader(std::ifstream& file, FrameJournalFileHeader& header)
+{
+    if ( !file.read(reinterpret_cast<char*>(&header), sizeof(header)) )
+    {
+        fprintf(stderr, "Could not read the journal header.\n");
+        return false;
+    }
+
+    if ( memcmp(header.magic, FRAMEJOURNAL_MAGIC, sizeof(header.magic)) != 0
+         || header.version < 1 || header.version > 2 || header.headerSize != sizeof(header) )
+    {
+        fprintf(stderr, "Not a frame journal or an unsupported version.\n");
+        return false;
+    }
+
+    header.cameraName[sizeof(header.cameraName) - 1] = 0;
+    header.cameraAddress[sizeof(header.cameraAddress) - 1] = 0;
+    return true;
+}
+
+bool IsValidPixelFormat(const FrameJournalSlotHeader& h)
+{
+    switch ( h.pixelFormat )
+    {
+        case FrameJournalPixelFormatByType: return true;
+        case FrameJournalPixelFormatYUYV:   return h.type == CV_8UC2 && h.width % 2 == 0;
+        case FrameJournalPixelFormatNV12:   return h.type == CV_8UC1 && h.width % 2 == 0 && h.height % 3 == 0;
+        case FrameJournalPixelFormatRGB:    return h.type == CV_8UC3;
+        default:                            return false;
+    }
+}
+
+// returns the image to save, converted to BGR when it is not in a format PNG supports
+cv::Mat GetImageToWrite(const cv::Mat& frame, int32_t pixelFormat)
+{
+    cv::Mat image;
+
+    switch ( pixelFormat )
+    {
+        case FrameJournalPixelFormatYUYV: cv::cvtColor(frame, image, cv::COLOR_YUV2BGR_YUYV); break;
+        case FrameJournalPixelFormatNV12: cv::cvtColor(frame, image, cv::COLOR_YUV2BGR_NV12); break;
+        case FrameJournalPixelFormatRGB:  cv::cvtColor(frame, image, cv::COLOR_RGB2BGR); break;
+        default:                          image = frame;
+    }
+
+    return image;
+}
+
+// returns the valid frames sorted from the oldest
+std::vector<JournalFrame> ReadFrames(std::ifstream& file, const FrameJournalFileHeader& header)
+{
+    std::vector<JournalFrame> frames;
+
+    for ( uint64_t i = 0; i < header.slotCount; ++i )
+    {
+        JournalFrame frame;
+
+        frame.slotIndex = i;
+        file.seekg(static_cast<std::streamoff>(header.slotsOffset + i * header.slotSize));
+        if ( !file.read(reinterpret_cast<char*>(&frame.header), sizeof(frame.header)) )
+            break; // truncated file
+
+        FrameJournalSlotHeader& h = frame.header;
+
+        // 0 = never written or being written when the application ended
+        if ( h.sequence == 0 )
+            continue;
+
+        if ( header.version < 2 )
+            h.pixelFormat = FrameJournalPixelFormatByType;
+
+        if ( h.width <= 0 || h.height <= 0
+             || h.rowBytes != static_cast<uint64_t>(h.width) * CV_ELEM_SIZE(h.type)
+             || h.dataSize != h.rowBytes * h.height
+             || h.dataOffset + h.dataSize > header.slotSize
+             || !IsValidPixelFormat(h) )
+        {
+            fprintf(stderr, "Skipping slot %llu with invalid frame information.\n", static_cast<unsigned long long>(i));
+            continue;
+        }
+
+        frames.push_back(frame);
+    }
+
+    std::sort(frames.begin(), frames.end(),
+              [](const JournalFrame& a, const JournalFrame& b) { return a.header.sequence < b.header.sequence; });
+
+    return frames;
+}
+
+} // unnamed namespace
+
+int main(int argc, char* argv[])
+{
+    if ( argc < 2 || argc > 3 )
+    {
+        fprintf(stderr, "Usage: %s journal-file [output-directory]\n", argv[0]);
+        return 1;
+    }
+
+    std::ifstream          file(argv[1], std::ios::binary);
+    FrameJournalFileHeader header;
+
+    if ( !file )
+    {
+        fprintf(stderr, "Could not open '%s'.\n", argv[1]);
+        return 1;
+    }
+
+    if ( !ReadHeader(file, header) )
+        return 1;
+
+    const std::vector<JournalFrame> frames = ReadFrames(file, header);
+    const std::string               outputDirectory = argc == 3 ? argv[2] : "";
+    FILE*                           csv = nullptr;
+
+    printf("Camera '%s' (%s)\n", header.cameraName, header.cameraAddress);
+    printf("%llu frames written, %llu slots, %zu frames available\n",
+           static_cast<unsigned long long>(header.framesWritten), static_cast<unsigned long long>(header.slotCount), frames.size());
+
+    if ( !outputDirectory.empty() )
+    {
+        const std::string csvFileName = outputDirectory + "/frames.csv";
+
+        csv = fopen(csvFileName.c_str(), "w");
+        if ( !csv )
+        {
+            fprintf(stderr, "Could not create '%s'.\n", csvFileName.c_str());
+            return 1;
+        }
+        fprintf(csv, "sequence,frame_number,captured_time_ms,width,height,type,time_to_retrieve_ms,time_to_convert_ms,time_to_create_thumbnail_ms,file\n");
+    }
+
+    std::vector<unsigned char> data;
+    int                        result = 0;
+
+    for ( const auto& frame : frames )
+    {
+        const FrameJournalSlotHeader& h = frame.header;
+        // NV12 has the chroma rows below the image
+        const int                     height = h.pixelFormat == FrameJournalPixelFormatNV12 ? h.height / 3 * 2 : h.height;
+
+        printf("#%llu frame %llu captured %lld ms %dx%d retrieve %d ms convert %d ms thumbnail %d ms\n",
+               static_cast<unsigned long long>(h.sequence), static_cast<unsigned long long>(h.frameNumber),
+               static_cast<long long>(h.capturedTime), h.width, height,
+               h.timeToRetrieve, h.timeToConvert, h.timeToCreateThumbnail);
+
+        if ( !csv )
+            continue;
+
+        data.resize(static_cast<size_t>(h.dataSize));
+        file.clear();
+        file.seekg(static_cast<std::streamoff>(header.slotsOffset + frame.slotIndex * header.slotSize + h.dataOffset));
+        if ( !file.read(reinterpret_cast<char*>(data.data()), data.size()) )
+        {
+            fprintf(stderr, "Could not read frame %llu.\n", static_cast<unsigned long long>(h.frameNumber));
+            result = 1;
+            continue;
+        }
+
+        const cv::Mat     image(h.height, h.width, h.type, data.data(), static_cast<size_t>(h.rowBytes));
+        const std::string fileName = "frame_" + std::to_string(static_cast<unsigned long long>(h.frameNumber)) + ".png";
+        bool              written = false;
+
+        // PNG is lossless, so the pixels of the frames not converted
+        // here are the same as retrieved from the camera
+        try
+        {
+            written = cv::imwrite(outputDirectory + "/" + fileName, GetImageToWrite(image, h.pixelFormat));
+        }
+        catch ( const cv::Exception& e )
+        {
+            fprintf(stderr, "Could not write '%s': %s\n", fileName.c_str(), e.what());
+            result = 1;
+            continue;
+        }
+
+        if ( !written )
+        {
+            fprintf(stderr, "Could not write '%s'.\n", fileName.c_str());
+            result = 1;
+            continue;
+        }
+
+        fprintf(csv, "%llu,%llu,%lld,%d,%d,%d,%d,%d,%d,%s\n",
+                static_cast<unsigned long long>(h.sequence), static_cast<unsigned long long>(h.frameNumber),
+                static_cast<long long>(h.capturedTime), h.width, height, h.type,
+                h.timeToRetrieve, h.timeToConvert, h.timeToCreateThumbnail, fileName.c_str());
+    }
+
+    if ( csv )
+        fclose(csv);
+
+    return result;
+}
@@ -0,0 +1,236 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        lockstats.cpp
+// Purpose:     Lock contention statistics and an instrumented critical section
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+#include <wx/wx.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "lockstats.h"
+
+namespace
+{
+
+thread_local wxString currentThreadName;
+
+} // unnamed namespace
+
+
+/***********************************************************************************************
+
+    LockStats
+
+***********************************************************************************************/
+
+std::atomic_bool LockStats::ms_enabled{false};
+std::atomic<wxUint64> LockStats::ms_lastId{0};
+
+void LockStats::SetCurrentThreadName(const wxString& name)
+{
+    // wxString is not safe to share between threads
+    currentThreadName = name.Clone();
+}
+
+wxString LockStats::GetCurrentThreadName()
+{
+    if ( !currentThreadName.empty() )
+        return currentThreadName;
+
+    return wxString::Format("%lu", static_cast<unsigned long>(wxThread::GetCurrentId()));
+}
+
+long LockStats::GetWaitHistogramBucketBound(size_t bucket)
+{
+    if ( bucket >= WaitHistogramBucketCount - 1 )
+        return -1;
+
+    return 1L << bucket;
+}
+
+void LockStats::Record(wxInt64 waitUs, wxInt64 holdUs)
+{
+    const wxUint64  wait = std::max<wxInt64>(waitUs, 0);
+    const wxUint64  hold = std::max<wxInt64>(holdUs, 0);
+    size_t          bucket = 0;
+    ThreadCounters& counters = GetThreadCounters();
+
+    while ( bucket < WaitHistogramBucketCount - 1 && wait > static_cast<wxUint64>(GetWaitHistogramBucketBound(bucket)) )
+        ++bucket;
+
+    // adding instead of storing, so that Reset() from another thread is not lost,
+    // the maximums are written only by this thread
+    counters.acquisitions.fetch_add(1, std::memory_order_relaxed);
+    counters.waitUs.fetch_add(wait, std::memory_order_relaxed);
+    counters.holdUs.fetch_add(hold, std::memory_order_relaxed);
+    counters.waitHistogram[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    if ( wait > counters.maxWaitUs.load(std::memory_order_relaxed) )
+        counters.maxWaitUs.store(wait, std::memory_order_relaxed);
+    if ( hold > counters.maxHoldUs.load(std::memory_order_relaxed) )
+        counters.maxHoldUs.store(hold, std::memory_order_relaxed);
+}
+
+LockStats::ThreadCounters& LockStats::GetThreadCounters()
+{
+    // a thread uses only a few locks, so searching linearly is fast,
+    // entries of destroyed stats are left behind but their ids never match
+    thread_local std::vector<std::pair<wxUint64, ThreadCounters*>> cache;
+
+    for ( const auto& c : cache )
+    {
+        if ( c.first == m_id )
+            return *c.second;
+    }
+
+    ThreadCounters* counters = nullptr;
+
+    {
+        wxCriticalSectionLocker locker(m_threadsCS);
+
+        std::unique_ptr<ThreadCounters>& threadCounters = m_threads[wxThread::GetCurrentId()];
+
+        // a new thread may have the id of an exited one, then it continues its counters
+        if ( !threadCounters )
+        {
+            threadCounters.reset(new ThreadCounters);
+            threadCounters->threadName = GetCurrentThreadName();
+        }
+        counters = threadCounters.get();
+    }
+
+    cache.push_back(std::make_pair(m_id, counters));
+    return *counters;
+}
+
+LockStats::Snapshot LockStats::GetSnapshot() const
+{
+    Snapshot snapshot;
+
+    snapshot.name = m_name;
+
+    wxCriticalSectionLocker locker(m_threadsCS);
+
+    for ( const auto& t : m_threads )
+    {
+        const ThreadCounters& counters = *t.second;
+        ThreadStats           stats;
+
+        stats.acquisitions = counters.acquisitions.load(std::memory_order_relaxed);
+        if ( stats.acquisitions == 0 )
+            continue;
+
+        stats.threadName = counters.threadName;
+        stats.waitUs     = counters.waitUs.load(std::memory_order_relaxed);
+        stats.maxWaitUs  = counters.maxWaitUs.load(std::memory_order_relaxed);
+        stats.holdUs     = counters.holdUs.load(std::memory_order_relaxed);
+        stats.maxHoldUs  = counters.maxHoldUs.load(std::memory_order_relaxed);
+
+        for ( size_t i = 0; i < WaitHistogramBucketCount; ++i )
+        {
+            stats.waitHistogram[i] = counters.waitHistogram[i].load(std::memory_order_relaxed);
+            snapshot.total.waitHistogram[i] += stats.waitHistogram[i];
+        }
+
+        snapshot.total.acquisitions += stats.acquisitions;
+        snapshot.total.waitUs       += stats.waitUs;
+        snapshot.total.maxWaitUs     = std::max(snapshot.total.maxWaitUs, stats.maxWaitUs);
+        snapshot.total.holdUs       += stats.holdUs;
+        snapshot.total.maxHoldUs     = std::max(snapshot.total.maxHoldUs, stats.maxHoldUs);
+
+        snapshot.threads[t.first] = stats;
+    }
+
+    return snapshot;
+}
+
+void LockStats::Reset()
+{
+    wxCriticalSectionLocker locker(m_threadsCS);
+
+    // the counters are not removed, their threads may still use them
+    for ( auto& t : m_threads )
+    {
+        ThreadCounters& counters = *t.second;
+
+        counters.acquisitions = 0;
+        counters.waitUs       = 0;
+        counters.maxWaitUs    = 0;
+        counters.holdUs       = 0;
+        counters.maxHoldUs    = 0;
+        for ( auto& count : counters.waitHistogram )
+            count = 0;
+    }
+}
+
+wxString LockStats::FormatSummary() const
+{
+    const Snapshot snapshot = GetSnapshot();
+    wxString       summary;
+
+    auto formatStats = [](const ThreadStats& stats) -> wxString
+    {
+        if ( stats.acquisitions == 0 )
+            return wxString("no acquisitions");
+
+        return wxString::Format("%" wxLongLongFmtSpec "u acquisitions, wait avg %.1f / max %" wxLongLongFmtSpec "u us, hold avg %.1f / max %" wxLongLongFmtSpec "u us",
+            stats.acquisitions,
+            static_cast<double>(stats.waitUs) / stats.acquisitions, stats.maxWaitUs,
+            static_cast<double>(stats.holdUs) / stats.acquisitions, stats.maxHoldUs);
+    };
+
+    summary.Printf("Lock '%s': %s\n", snapshot.name, formatStats(snapshot.total));
+
+    for ( const auto& t : snapshot.threads )
+        summary += wxString::Format("  Thread '%s': %s\n", t.second.threadName, formatStats(t.second));
+
+    return summary;
+}
+
+
+/***********************************************************************************************
+
+    InstrumentedCriticalSection
+
+***********************************************************************************************/
+
+void InstrumentedCriticalSection::Enter()
+{
+    if ( !LockStats::IsEnabled() )
+    {
+        m_cs.Enter();
+        m_instrumented = false;
+        return;
+    }
+
+    const Clock::time_point waitStartedTime = Clock::now();
+
+    m_cs.Enter();
+    m_enteredTime  = Clock::now();
+    m_waitUs       = std::chrono::duration_cast<std::chrono::microseconds>(m_enteredTime - waitStartedTime).count();
+    m_instrumented = true;
+}
+
+void InstrumentedCriticalSection::Leave()
+{
+    if ( !m_instrumented )
+    {
+        m_cs.Leave();
+        return;
+    }
+
+    // the members are copied while still owning m_cs, the stats are recorded
+    // only after leaving it so that recording does not add to the hold time
+    const wxInt64 waitUs = m_waitUs;
+    const wxInt64 holdUs = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - m_enteredTime).count();
+
+    m_instrumented = false;
+    m_cs.Leave();
+
+    m_stats.Record(waitUs, holdUs);
+}
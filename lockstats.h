@@ -0,0 +1,161 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        lockstats.h
+// Purpose:     Lock contention statistics and an instrumented critical section
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef LOCKSTATS_H
+#define LOCKSTATS_H
+
+#include <wx/wx.h>
+#include <wx/thread.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+
+/***********************************************************************************************
+
+    LockStats: acquisition count, wait time histogram and hold time of a lock,
+               in total and per thread. It is thread-safe.
+
+               Every thread records into its own atomic counters, so recording
+               does not take any lock which would add to the contention being
+               measured; only the first acquisition by a thread, building
+               a snapshot and resetting lock m_threadsCS.
+
+               Collecting is switched on and off at runtime for all locks at once
+               with LockStats::Enable(), when disabled, the instrumented locks
+               cost just an atomic load more than the plain ones.
+
+***********************************************************************************************/
+
+class LockStats
+{
+public:
+    // Wait time histogram buckets: upper bounds are 1, 2, 4, ..., 32768 microseconds,
+    // the last bucket is for longer waits.
+    enum { WaitHistogramBucketCount = 17 };
+
+    struct ThreadStats
+    {
+        wxString threadName;
+        wxUint64 acquisitions{0};
+        wxUint64 waitUs{0};
+        wxUint64 maxWaitUs{0};
+        wxUint64 holdUs{0};
+        wxUint64 maxHoldUs{0};
+        wxUint64 waitHistogram[WaitHistogramBucketCount]{};
+    };
+
+    struct Snapshot
+    {
+        wxString                                name;
+        ThreadStats                             total;
+        std::map<wxThreadIdType, ThreadStats>   threads;
+    };
+
+    explicit LockStats(const wxString& name) : m_id(++ms_lastId), m_name(name) {}
+
+    static void Enable(bool enable)  { ms_enabled = enable; }
+    static bool IsEnabled()          { return ms_enabled.load(std::memory_order_relaxed); }
+
+    // The name of the calling thread used in statistics,
+    // if not set, the thread id is used instead.
+    static void     SetCurrentThreadName(const wxString& name);
+    static wxString GetCurrentThreadName();
+
+    // returns the upper bound of the bucket in microseconds,
+    // -1 for the last one
+    static long GetWaitHistogramBucketBound(size_t bucket);
+
+    // Records a single acquisition of the lock by the calling thread.
+    void Record(wxInt64 waitUs, wxInt64 holdUs);
+
+    // threads without acquisitions (e.g., since Reset()) are not included
+    Snapshot GetSnapshot() const;
+    void     Reset();
+
+    // a human readable summary for the Diagnostics menu
+    wxString FormatSummary() const;
+
+    const wxString& GetName() const { return m_name; }
+private:
+    // written only by their thread, read by GetSnapshot()
+    struct ThreadCounters
+    {
+        wxString              threadName;
+        std::atomic<wxUint64> acquisitions{0};
+        std::atomic<wxUint64> waitUs{0};
+        std::atomic<wxUint64> maxWaitUs{0};
+        std::atomic<wxUint64> holdUs{0};
+        std::atomic<wxUint64> maxHoldUs{0};
+        std::atomic<wxUint64> waitHistogram[WaitHistogramBucketCount]{};
+    };
+
+    static std::atomic_bool      ms_enabled;
+    static std::atomic<wxUint64> ms_lastId;
+
+    const wxUint64               m_id; // never reused, identifies the stats in the threads' caches
+    const wxString               m_name;
+    mutable wxCriticalSection    m_threadsCS;
+    // the counters are kept after their thread exits, so the cached pointers stay valid
+    std::map<wxThreadIdType, std::unique_ptr<ThreadCounters>> m_threads;
+
+    // returns the counters of the calling thread, creating them on its first acquisition
+    ThreadCounters& GetThreadCounters();
+};
+
+
+/***********************************************************************************************
+
+    InstrumentedCriticalSection: wxCriticalSection recording its use in LockStats.
+
+***********************************************************************************************/
+
+class InstrumentedCriticalSection
+{
+public:
+    explicit InstrumentedCriticalSection(const wxString& name) : m_stats(name) {}
+
+    void Enter();
+    void Leave();
+
+    const LockStats& GetStats() const { return m_stats; }
+    LockStats&       GetStats()       { return m_stats; }
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    wxCriticalSection m_cs;
+    LockStats         m_stats;
+
+    // valid only while the critical section is entered
+    bool              m_instrumented{false};
+    Clock::time_point m_enteredTime;
+    wxInt64           m_waitUs{0};
+
+    wxDECLARE_NO_COPY_CLASS(InstrumentedCriticalSection);
+};
+
+class InstrumentedCriticalSectionLocker
+{
+public:
+    explicit InstrumentedCriticalSectionLocker(InstrumentedCriticalSection& cs)
+        : m_cs(cs)
+    {
+        m_cs.Enter();
+    }
+
+    ~InstrumentedCriticalSectionLocker() { m_cs.Leave(); }
+private:
+    InstrumentedCriticalSection& m_cs;
+
+    wxDECLARE_NO_COPY_CLASS(InstrumentedCriticalSectionLocker);
+};
+
+#endif // #ifndef LOCKSTATS_H
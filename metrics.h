@@ -0,0 +1,299 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        metrics.h
+// Purpose:     Per-camera counters and gauges, exported in Prometheus text format
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <wx/wx.h>
+#include <wx/socket.h>
+#include <wx/thread.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "lockstats.h"
+
+class FrameBus;
+class FrameMemoryBudget;
+
+/***********************************************************************************************
+
+    CameraMetrics: counters and gauges for a single camera. Camera threads
+                   and the GUI thread update them without locking, so every
+                   value is an atomic updated with relaxed memory ordering.
+
+***********************************************************************************************/
+
+struct CameraMetrics
+{
+    typedef std::atomic<wxUint64> Counter;
+    typedef std::atomic<wxInt64>  Gauge;
+
+    CameraMetrics(const wxString& name, const wxString& address)
+        : cameraName(name), cameraAddress(address)
+    {}
+
+    const wxString cameraName;
+    const wxString cameraAddress; // without the URL's user info, i.e. credentials
+
+    // updated by the camera thread
+    Counter framesCaptured{0};
+    Counter framesConverted{0};
+    Counter framesPublished{0};   // frames published on FrameBus
+    Counter framesDuplicate{0};   // the same image as the previous frame, not converted
+    Counter frameHashTimeUs{0};   // total time spent hashing frames to detect duplicates
+    Counter reconnects{0};        // successful, i.e. frames were retrieved after reconnecting
+    Counter reconnectAttempts{0};
+    Counter bytesAllocated{0};    // bytes of wxBitmaps created for frames and thumbnails
+    Counter timeToRetrieveMs{0};  // total of CameraFrameData::GetTimeToRetrieve()
+    Counter timeToConvertMs{0};   // total of CameraFrameData::GetTimeToConvert()
+    Counter timeToCreateThumbnailMs{0}; // total of CameraFrameData::GetTimeToCreateThumbnail()
+
+    // CPU time consumed by the camera thread in microseconds, split by stage,
+    // see ThreadCPUStopWatch; remain 0 when the CPU time is not available
+    Counter cpuRetrieveUs{0};
+    Counter cpuConvertUs{0};
+    Counter cpuThumbnailUs{0};
+    Counter cpuSleepUs{0};
+    Counter cpuOtherUs{0};    // processing commands, passing frames to the GUI...
+
+    // operator new calls and cv::Mat allocations made by the camera thread for captured frames,
+    // remain 0 unless WXOPENCVCAMERAS_TRACK_ALLOCATIONS is 1, see alloctracker.h
+    Counter allocationCount{0};
+    Counter allocationBytes{0};
+
+    wxUint64 GetCPUTotalUs() const
+    {
+        return Get(cpuRetrieveUs) + Get(cpuConvertUs) + Get(cpuThumbnailUs)
+               + Get(cpuSleepUs) + Get(cpuOtherUs);
+    }
+
+    // updated by the GUI thread
+    Counter framesDisplayed{0};
+    Counter framesDropped{0};   // frames received by the GUI but not displayed
+
+    // frames added by the camera thread but not processed by the GUI yet
+    Gauge   framesPending{0};
+
+    // updated by the camera thread
+    Gauge   reconnecting{0};         // 1 while the camera thread is reconnecting
+    Gauge   lastTimeToRecoverMs{0};  // from losing the connection to the first frame after reconnecting
+
+    // for detecting stalled cameras, see CameraGridFrame::OnCheckStalledCameras()
+    Gauge   lastFrameTimeMs{0};          // updated by the camera thread, obtained with wxGetUTCTimeMillis()
+    Gauge   expectedFrameIntervalMs{0};  // updated by the camera thread
+    Gauge   stalled{0};                  // updated by the GUI thread, 1 while stalled
+    Counter stalls{0};                   // updated by the GUI thread
+
+    // updated by the camera recorder, see CameraRecorder; frames waiting to be written
+    // and dropped are in the metrics of its FrameSubscriber
+    Gauge   recording{0};               // 1 while recording
+    Counter recordingSegments{0};       // files started
+    Counter recordingFramesWritten{0};
+    Counter recordingWriteTimeUs{0};    // total time spent in cv::VideoWriter::write()
+    Gauge   recordingMaxWriteTimeUs{0};
+    Counter recordingCpuUs{0};          // CPU time consumed by the recorder thread, see ThreadCPUStopWatch
+    Counter recordingErrors{0};
+
+    // updated by the camera thread while writing raw frames to FrameJournal
+    Gauge   journaling{0};              // 1 while journaling
+    Counter journalFramesWritten{0};
+    Counter journalFramesSkipped{0};    // did not fit into a journal slot
+    Counter journalWriteTimeUs{0};      // total time spent copying frames to the journal
+
+    // updated by the replay encoder and the GUI thread, see ReplayBuffer
+    Gauge   replayBufferBytes{0};       // JPEG data held in the buffer
+    Gauge   replayBufferFrames{0};
+    Gauge   replayBufferDurationMs{0};  // from the oldest to the newest buffered frame
+    Counter replayFramesEncoded{0};
+    Counter replayEncodeTimeUs{0};      // total time spent in cv::imencode()
+    Counter replayCpuUs{0};             // CPU time consumed by the replay encoder thread
+    Gauge   replayLastSeekTimeUs{0};    // finding, decoding and converting a frame to wxBitmap
+    Gauge   replayMaxSeekTimeUs{0};
+
+    // updated by the shared memory exporter, see SharedMemoryExporter
+    Gauge   sharedMemoryExporting{0};       // 1 while exporting
+    Counter sharedMemoryFramesExported{0};
+    Counter sharedMemoryFramesSkipped{0};   // larger than the ring's slots
+    Counter sharedMemoryWriteTimeUs{0};     // total time spent copying frames to the ring
+    Counter sharedMemoryCpuUs{0};           // CPU time consumed by the exporter thread
+
+    // updated by MJPEGServer and the camera's MJPEGEncoder
+    Gauge   mjpegClients{0};            // connections streaming the camera
+    Counter mjpegFramesEncoded{0};      // once per frame and JPEG quality wanted by the clients
+    Counter mjpegEncodeTimeUs{0};       // total time spent in cv::imencode()
+    Counter mjpegCpuUs{0};              // CPU time consumed by the encoder thread
+    Counter mjpegFramesSent{0};         // to all the clients
+    Counter mjpegFramesSkipped{0};      // encoded while a slow client was still receiving the previous frame
+    Counter mjpegBytesSent{0};
+
+    // updated by the camera thread with CameraSetupData::quietFrameStride > 1, see MotionDetector
+    Gauge   motionScore{0};             // of the last retrieved frame, per mille of changed pixels
+    Gauge   motionQuiet{0};             // 1 while the frame rate is reduced
+    Counter framesSkippedQuiet{0};      // only grabbed while quiet
+    Counter motionCpuSavedUs{0};        // estimated: the average CPU time of a retrieved frame minus that of grabbing
+    Counter motionReactions{0};         // quiet periods ended by motion
+    Counter motionReactionTimeMs{0};    // total, from the last scored quiet frame to the frame with motion
+    Gauge   motionLastReactionTimeMs{0};
+
+    // updated by the camera thread as set by CameraGridFrame::OnGovernCPU(),
+    // see CameraCommandData::SetDegradationLevel
+    Gauge   degradationLevel{0};
+    Counter framesSkippedDegraded{0};   // only grabbed while degraded and not quiet
+    Counter degradationCpuSavedUs{0};   // estimated as motionCpuSavedUs
+
+    // updated by the camera thread, see CameraSetupData::priorityClass
+    Gauge   threadPriorityClass{0};
+
+    // updated by the camera thread and whichever thread releases the frames, see FrameMemoryBudget
+    Gauge   frameMemoryBytes{0};        // held by the camera's frames in flight
+    Counter framesDroppedMemory{0};     // not passed to the GUI or not published because of the budget
+
+    // polling the camera thread's CameraCommandDatas
+    LockStats commandQueueStats{"command_queue"};
+
+    static void     Add(Counter& counter, wxUint64 amount = 1) { counter.fetch_add(amount, std::memory_order_relaxed); }
+    static void     Add(Gauge& gauge, wxInt64 amount)          { gauge.fetch_add(amount, std::memory_order_relaxed); }
+    static void     Set(Gauge& gauge, wxInt64 value)           { gauge.store(value, std::memory_order_relaxed); }
+    static wxUint64 Get(const Counter& counter)                { return counter.load(std::memory_order_relaxed); }
+    static wxInt64  Get(const Gauge& gauge)                    { return gauge.load(std::memory_order_relaxed); }
+};
+
+typedef std::shared_ptr<CameraMetrics> CameraMetricsPtr;
+
+
+/***********************************************************************************************
+
+    ApplicationMetrics: values not related to a particular camera.
+
+***********************************************************************************************/
+
+struct ApplicationMetrics
+{
+    CameraMetrics::Counter guiFramesProcessed{0};
+    CameraMetrics::Counter guiFramesDiscarded{0}; // frames from removed cameras
+    CameraMetrics::Counter guiProcessTimeUs{0};   // total time spent in processing frames
+    CameraMetrics::Counter guiBitmapsCreated{0};  // for NativeImages when no pooled one was free, see BitmapPool
+    CameraMetrics::Gauge   guiQueueDepth{0};      // frames in the last processed batch
+    // operator new calls and cv::Mat allocations made by the GUI thread when processing frames, see alloctracker.h
+    CameraMetrics::Counter guiAllocationCount{0};
+    CameraMetrics::Counter guiAllocationBytes{0};
+
+    // removed cameras, see CameraThreadReaper
+    CameraMetrics::Gauge   camerasStopping{0};         // threads asked to stop but not exited yet
+    CameraMetrics::Counter cameraTeardowns{0};
+    CameraMetrics::Counter cameraTeardownTimeMs{0};    // from asking a thread to stop to its exit
+    CameraMetrics::Gauge   cameraTeardownMaxTimeMs{0};
+
+    // object detection, see ObjectDetector
+    CameraMetrics::Gauge   detectionRunning{0};
+    CameraMetrics::Counter detectionBatches{0};
+    CameraMetrics::Counter detectionFrames{0};       // frames in all batches
+    CameraMetrics::Gauge   detectionLastBatchSize{0};
+    CameraMetrics::Counter detectionObjects{0};      // detections above the confidence threshold
+    CameraMetrics::Counter detectionPreprocessTimeUs{0}; // resizing the frames and creating the blob
+    CameraMetrics::Counter detectionInferenceTimeUs{0};  // forward passes
+    CameraMetrics::Counter detectionLatencyTimeMs{0};    // from capturing a frame to its result, total
+    CameraMetrics::Gauge   detectionLastLatencyMs{0};    // the oldest frame of the last batch
+    CameraMetrics::Counter detectionCpuUs{0};
+
+    // CPU governor, see CameraGridFrame::OnGovernCPU()
+    CameraMetrics::Gauge   processCpuPercent{0};   // of all CPUs, measured by the governor
+    CameraMetrics::Counter governorDegradations{0}; // a camera degraded by one level
+    CameraMetrics::Counter governorRestorations{0}; // a camera restored by one level
+};
+
+
+/***********************************************************************************************
+
+    MetricsRegistry: owns metrics for all cameras and formats them
+                     as Prometheus text exposition format.
+
+***********************************************************************************************/
+
+class MetricsRegistry
+{
+public:
+    CameraMetricsPtr AddCamera(const wxString& cameraName, const wxString& cameraAddress);
+    void             RemoveCamera(const CameraMetricsPtr& metrics);
+
+    std::vector<CameraMetricsPtr> GetCameras() const;
+
+    ApplicationMetrics& GetApplicationMetrics() { return m_applicationMetrics; }
+
+    // locks not belonging to a camera, such as CameraGridFrame::m_newCameraFrameDataCS,
+    // they must outlive the registry or be removed before destroyed
+    void AddLockStats(LockStats* stats);
+    void RemoveLockStats(LockStats* stats);
+
+    // the subscribers of the bus are exported too, the bus must outlive the registry
+    // or be removed by passing nullptr before destroyed
+    void SetFrameBus(const FrameBus* frameBus);
+
+    // the same applies to the budget as to the frame bus
+    void SetFrameMemoryBudget(const FrameMemoryBudget* frameMemoryBudget);
+
+    // human readable summary of all locks with recorded acquisitions
+    wxString FormatLockStatsSummary() const;
+    void     ResetLockStats();
+
+    // returns all metrics in Prometheus text format (version 0.0.4)
+    wxString FormatPrometheusText() const;
+
+    // writes metrics to a temporary file which is then renamed to fileName,
+    // so that the readers (e.g., node_exporter textfile collector)
+    // never see a partially written file
+    bool WriteToFile(const wxString& fileName) const;
+
+private:
+    mutable wxCriticalSection     m_camerasCS;
+    std::vector<CameraMetricsPtr> m_cameras;
+    std::vector<LockStats*>       m_lockStats;
+    const FrameBus*               m_frameBus{nullptr};
+    const FrameMemoryBudget*      m_frameMemoryBudget{nullptr};
+    ApplicationMetrics            m_applicationMetrics;
+};
+
+
+/***********************************************************************************************
+
+    MetricsHTTPServer: serves metrics from MetricsRegistry at http://localhost:port/metrics.
+                       It runs in the GUI thread, using wxSocket events.
+
+***********************************************************************************************/
+
+class MetricsHTTPServer : public wxEvtHandler
+{
+public:
+    explicit MetricsHTTPServer(const MetricsRegistry& registry);
+    ~MetricsHTTPServer();
+
+    bool Start(unsigned short port);
+    void Stop();
+
+    bool           IsRunning() const { return m_server != nullptr; }
+    unsigned short GetPort() const   { return m_port; }
+private:
+    const MetricsRegistry&             m_registry;
+    wxSocketServer*                    m_server{nullptr};
+    unsigned short                     m_port{0};
+    // partially received requests
+    std::map<wxSocketBase*, wxString>  m_requests;
+
+    void OnServerEvent(wxSocketEvent& evt);
+    void OnClientEvent(wxSocketEvent& evt);
+
+    void SendResponse(wxSocketBase* socket, const wxString& request);
+    void CloseClient(wxSocketBase* socket);
+};
+
+#endif // #ifndef METRICS_H
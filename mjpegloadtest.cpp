@@ -0,0 +1,295 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        mjpegloadtest.cpp
+// Purpose:     Load test of MJPEGServer with many clients on localhost
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+// Usage: wxOpenCVCamerasMJPEGLoadTest [port [clients [seconds [path ...]]]]
+//
+// Connects the given number of clients (default 50) to MJPEGServer listening
+// on localhost at port (default 8080) and reads the MJPEG streams for the given
+// number of seconds (default 10), printing the throughput once a second.
+// The clients are distributed among the paths (default /camera/0), e.g.,
+// "/camera/0?quality=50 /camera/0?quality=90" tests two quality levels.
+// Every part received must be a complete JPEG image. The exit code is 1 when any
+// client failed or received no frame.
+//
+// The server's metrics (mjpeg_frames_encoded_total vs. mjpeg_frames_sent_total)
+// show that each frame is encoded once per quality, no matter the number of clients.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+    typedef SOCKET Socket;
+    const Socket invalidSocket = INVALID_SOCKET;
+    void CloseSocket(Socket socket) { closesocket(socket); }
+#else
+    #include <arpa/inet.h>
+    #include <netinet/in.h>
+    #include <sys/socket.h>
+    #include <sys/time.h>
+    #include <unistd.h>
+    typedef int Socket;
+    const Socket invalidSocket = -1;
+    void CloseSocket(Socket socket) { close(socket); }
+#endif
+
+namespace
+{
+
+struct ClientStats
+{
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<bool>     finished{false};
+    std::string           error; // set before finished
+};
+
+Socket Connect(unsigned short port)
+{
+    const Socket socket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+    if ( socket == invalidSocket )
+        return invalidSocket;
+
+    sockaddr_in address;
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family      = AF_INET;
+    address.sin_port        = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if ( connect(socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 )
+    {
+        CloseSocket(socket);
+        return invalidSocket;
+    }
+
+    // the server sends nothing while the camera delivers no frames
+#ifdef _WIN32
+    const DWORD timeout = 5000;
+#else
+    timeval     timeout;
+
+    timeout.tv_sec  = 5;
+    timeout.tv_usec = 0;
+#endif
+    setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+
+    return socket;
+}
+
+// reads from the socket and appends to buffer, returns false on error or when closed
+bool Receive(Socket socket, std::string& buffer, ClientStats& stats)
+{
+    char      data[65536];
+    const int count = static_cast<int>(recv(socket, data, sizeof(data), 0));
+
+    if ( count <= 0 )
+        return false;
+
+    buffer.append(data, count);
+    stats.bytes += count;
+    return true;
+}
+
+void RunClient(unsigned short port, const std::string& path,
+               std::chrono::steady_clock::time_point endTime, ClientStats& stats)
+{
+    const Socket socket = Connect(port);
+
+    if ( socket == invalidSocket )
+    {
+        stats.error = "could not connect";
+        stats.finished = true;
+        return;
+    }
+
+    const std::string request = "GET " + path + " HTTP/1.0\r\nHost: localhost\r\n\r\n";
+    std::string       buffer;
+    size_t            headerEnd = std::string::npos;
+
+    send(socket, request.data(), static_cast<int>(request.size()), 0);
+
+    // the response header
+    while ( (headerEnd = buffer.find("\r\n\r\n")) == std::string::npos )
+    {
+        if ( !Receive(socket, buffer, stats) )
+        {
+            stats.error = "no response";
+            break;
+        }
+    }
+
+    if ( stats.error.empty() )
+    {
+        const std::string header = buffer.substr(0, headerEnd);
+
+        if ( header.find(" 200 ") == std::string::npos || header.find("multipart/x-mixed-replace") == std::string::npos )
+            stats.error = "unexpected response: " + header.substr(0, header.find("\r\n"));
+        buffer.erase(0, headerEnd + 4);
+    }
+
+    // the parts: --boundary, headers with Content-Length, empty line, JPEG, CRLF
+    while ( stats.error.empty() && std::chrono::steady_clock::now() < endTime )
+    {
+        const size_t partHeaderEnd = buffer.find("\r\n\r\n");
+
+        if ( partHeaderEnd == std::string::npos )
+        {
+            if ( !Receive(socket, buffer, stats) )
+                stats.error = "connection closed or timed out";
+            continue;
+        }
+
+        const size_t lengthPos = buffer.find("Content-Length: ");
+
+        if ( buffer.compare(0, 2, "--") != 0 || lengthPos == std::string::npos || lengthPos > partHeaderEnd )
+        {
+            stats.error = "invalid part header";
+            break;
+        }
+
+        const size_t length = static_cast<size_t>(strtoul(buffer.c_str() + lengthPos + 16, nullptr, 10));
+        const size_t partEnd = partHeaderEnd + 4 + length + 2;
+
+        while ( buffer.size() < partEnd && stats.error.empty() )
+        {
+            if ( !Receive(socket, buffer, stats) )
+                stats.error = "connection closed or timed out in a frame";
+        }
+
+        if ( !stats.error.empty() )
+            break;
+
+        const unsigned char* jpeg = reinterpret_cast<const unsigned char*>(buffer.data() + partHeaderEnd + 4);
+
+        if ( length < 4 || jpeg[0] != 0xFF || jpeg[1] != 0xD8 || jpeg[length - 2] != 0xFF || jpeg[length - 1] != 0xD9 )
+        {
+            stats.error = "incomplete JPEG image";
+            break;
+        }
+
+        stats.frames++;
+        buffer.erase(0, partEnd);
+    }
+
+    CloseSocket(socket);
+    stats.finished = true;
+}
+
+} // unnamed namespace
+
+int main(int argc, char* argv[])
+{
+    const unsigned short     port = static_cast<unsigned short>(argc > 1 ? atoi(argv[1]) : 8080);
+    const int                clientCount = argc > 2 ? atoi(argv[2]) : 50;
+    const int                seconds = argc > 3 ? atoi(argv[3]) : 10;
+    std::vector<std::string> paths;
+
+    for ( int i = 4; i < argc; ++i )
+        paths.push_back(argv[i]);
+    if ( paths.empty() )
+        paths.push_back("/camera/0");
+
+    if ( port == 0 || clientCount <= 0 || seconds <= 0 )
+    {
+        fprintf(stderr, "Usage: %s [port [clients [seconds [path ...]]]]\n", argv[0]);
+        return 1;
+    }
+
+#ifdef _WIN32
+    WSADATA wsaData;
+
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+
+    const auto                                startTime = std::chrono::steady_clock::now();
+    const auto                                endTime = startTime + std::chrono::seconds(seconds);
+    std::vector<std::unique_ptr<ClientStats>> stats;
+    std::vector<std::thread>                  threads;
+
+    printf("Streaming with %d clients from localhost:%hu for %d s...\n", clientCount, port, seconds);
+
+    for ( int i = 0; i < clientCount; ++i )
+    {
+        stats.emplace_back(new ClientStats);
+        threads.emplace_back(RunClient, port, paths[i % paths.size()], endTime, std::ref(*stats.back()));
+    }
+
+    std::vector<uint64_t> prevFrames(clientCount, 0);
+    uint64_t              prevBytes = 0;
+
+    for ( int second = 1; second <= seconds; ++second )
+    {
+        std::this_thread::sleep_until(startTime + std::chrono::seconds(second));
+
+        uint64_t frames = 0, bytes = 0, minFrames = UINT64_MAX, maxFrames = 0;
+        int      running = 0;
+
+        for ( int i = 0; i < clientCount; ++i )
+        {
+            const uint64_t clientFrames = stats[i]->frames;
+            const uint64_t delta = clientFrames - prevFrames[i];
+
+            prevFrames[i] = clientFrames;
+            frames += delta;
+            bytes += stats[i]->bytes;
+            minFrames = std::min(minFrames, delta);
+            maxFrames = std::max(maxFrames, delta);
+            if ( !stats[i]->finished )
+                running++;
+        }
+
+        printf("%2d s: %d clients running, %.1f frames/s in total, per client min %llu max %llu, %.1f MB/s\n",
+               second, running, static_cast<double>(frames),
+               static_cast<unsigned long long>(minFrames), static_cast<unsigned long long>(maxFrames),
+               (bytes - prevBytes) / (1024. * 1024.));
+        prevBytes = bytes;
+    }
+
+    for ( auto& thread : threads )
+        thread.join();
+
+    int      failed = 0;
+    uint64_t totalFrames = 0;
+
+    for ( int i = 0; i < clientCount; ++i )
+    {
+        const ClientStats& s = *stats[i];
+
+        totalFrames += s.frames;
+        if ( !s.error.empty() || s.frames == 0 )
+        {
+            failed++;
+            fprintf(stderr, "Client %d (%s): %s, %llu frames received\n", i, paths[i % paths.size()].c_str(),
+                    s.error.empty() ? "no frames" : s.error.c_str(), static_cast<unsigned long long>(s.frames));
+        }
+    }
+
+    printf("%llu frames received by %d clients (%.1f frames/s per client), %d failed\n",
+           static_cast<unsigned long long>(totalFrames), clientCount,
+           static_cast<double>(totalFrames) / clientCount / seconds, failed);
+
+#ifdef _WIN32
+    WSACleanup();
+#endif
+
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,882 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        mjpegserver.cpp
+// Purpose:     HTTP server re-streaming cameras as MJPEG to browsers
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+#include <wx/wx.h>
+#include <wx/arrstr.h>
+
+#ifdef __WXMSW__
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+#else
+    #include <arpa/inet.h>
+    #include <fcntl.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <unistd.h>
+    #include <cerrno>
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <opencv2/imgcodecs.hpp>
+
+#include "camerathread.h"
+#include "cputime.h"
+#include "mjpegserver.h"
+
+namespace
+{
+
+const char* const mjpegBoundary = "wxopencvcamerasframe";
+
+// longer requests are not expected and are refused
+const size_t maxRequestLength = 8192;
+
+// further connections are closed immediately
+const size_t maxClients = 256;
+
+// a client's quality is snapped to one of these, as every quality
+// requested for a camera means another encoding of each of its frames
+const int JPEGQualities[] = { 50, 75, 90 };
+const int defaultJPEGQuality = 75;
+
+int SnapJPEGQuality(long quality)
+{
+    int snapped = JPEGQualities[0];
+
+    for ( const auto q : JPEGQualities )
+    {
+        if ( std::abs(quality - q) <= std::abs(quality - snapped) )
+            snapped = q;
+    }
+
+    return snapped;
+}
+
+// enough for a 1080p frame on a LAN
+const size_t sendBufferBytes = 256 * 1024;
+
+/***********************************************************************************************
+
+    Socket functions differing between Winsock and POSIX
+
+***********************************************************************************************/
+
+#ifdef __WXMSW__
+
+typedef WSAPOLLFD PollFD;
+
+const MJPEGSocket invalidSocket = INVALID_SOCKET;
+
+int  PollSockets(PollFD* fds, size_t count, int timeout) { return WSAPoll(fds, static_cast<ULONG>(count), timeout); }
+void CloseSocket(MJPEGSocket socket)                     { closesocket(socket); }
+bool LastSocketErrorWouldBlock()                         { return WSAGetLastError() == WSAEWOULDBLOCK; }
+wxString LastSocketErrorMessage()                        { return wxSysErrorMsgStr(WSAGetLastError()); }
+
+bool SetNonBlocking(MJPEGSocket socket)
+{
+    u_long nonBlocking = 1;
+
+    return ioctlsocket(socket, FIONBIO, &nonBlocking) == 0;
+}
+
+long SendToSocket(MJPEGSocket socket, const char* data, size_t size)
+{
+    return send(socket, data, static_cast<int>(size), 0);
+}
+
+long ReceiveFromSocket(MJPEGSocket socket, char* buffer, size_t size)
+{
+    return recv(socket, buffer, static_cast<int>(size), 0);
+}
+
+#else // #ifdef __WXMSW__
+
+typedef pollfd PollFD;
+
+const MJPEGSocket invalidSocket = -1;
+
+int  PollSockets(PollFD* fds, size_t count, int timeout) { return poll(fds, static_cast<nfds_t>(count), timeout); }
+void CloseSocket(MJPEGSocket socket)                     { close(socket); }
+bool LastSocketErrorWouldBlock()                         { return errno == EAGAIN || errno == EWOULDBLOCK; }
+wxString LastSocketErrorMessage()                        { return wxSysErrorMsgStr(errno); }
+
+bool SetNonBlocking(MJPEGSocket socket)
+{
+    const int flags = fcntl(socket, F_GETFL, 0);
+
+    return flags != -1 && fcntl(socket, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+long SendToSocket(MJPEGSocket socket, const char* data, size_t size)
+{
+    // a client disconnecting must not raise SIGPIPE,
+    // where MSG_NOSIGNAL is not available SO_NOSIGPIPE is set instead
+#ifdef MSG_NOSIGNAL
+    return send(socket, data, size, MSG_NOSIGNAL);
+#else
+    return send(socket, data, size, 0);
+#endif
+}
+
+long ReceiveFromSocket(MJPEGSocket socket, char* buffer, size_t size)
+{
+    return recv(socket, buffer, size, 0);
+}
+
+#endif // #else #ifdef __WXMSW__
+
+PollFD MakePollFD(MJPEGSocket socket, short events)
+{
+    PollFD fd;
+
+    fd.fd      = socket;
+    fd.events  = events;
+    fd.revents = 0;
+    return fd;
+}
+
+wxString EscapeHTML(const wxString& text)
+{
+    wxString escaped(text);
+
+    escaped.Replace("&", "&amp;");
+    escaped.Replace("<", "&lt;");
+    escaped.Replace(">", "&gt;");
+    escaped.Replace("\"", "&quot;");
+    return escaped;
+}
+
+} // unnamed namespace
+
+
+/***********************************************************************************************
+
+    MJPEGServer
+
+***********************************************************************************************/
+
+MJPEGServer::MJPEGServer(FrameBus& frameBus, unsigned short port, bool localOnly)
+    : wxThread(wxTHREAD_JOINABLE),
+      m_frameBus(frameBus), m_port(port), m_localOnly(localOnly),
+      m_listenSocket(invalidSocket), m_wakeSocket(invalidSocket)
+{
+#ifdef __WXMSW__
+    WSADATA wsaData;
+
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+}
+
+MJPEGServer::~MJPEGServer()
+{
+    CloseSockets();
+
+#ifdef __WXMSW__
+    WSACleanup();
+#endif
+}
+
+bool MJPEGServer::Listen(wxString& errorMessage)
+{
+    wxCHECK_MSG(m_listenSocket == invalidSocket, false, "Already listening");
+
+    sockaddr_in address;
+
+    const auto fail = [&](const char* what) -> bool
+    {
+        errorMessage = wxString::Format("%s failed: %s", what, LastSocketErrorMessage());
+        CloseSockets();
+        return false;
+    };
+
+    m_listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if ( m_listenSocket == invalidSocket )
+        return fail("socket()");
+
+#ifndef __WXMSW__
+    // allows restarting the server while the previous connections are in TIME_WAIT,
+    // on MS Windows it would allow another process to take over the port
+    const int reuseAddress = 1;
+
+    setsockopt(m_listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuseAddress, sizeof(reuseAddress));
+#endif
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family      = AF_INET;
+    address.sin_port        = htons(m_port);
+    address.sin_addr.s_addr = htonl(m_localOnly ? INADDR_LOOPBACK : INADDR_ANY);
+
+    if ( bind(m_listenSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 )
+        return fail("bind()");
+    if ( listen(m_listenSocket, SOMAXCONN) != 0 )
+        return fail("listen()");
+    if ( !SetNonBlocking(m_listenSocket) )
+        return fail("Setting non-blocking mode");
+
+    // poll() cannot wait for anything but sockets on MS Windows,
+    // so the other threads wake the server up by sending a datagram to this socket
+    m_wakeSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if ( m_wakeSocket == invalidSocket )
+        return fail("socket()");
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family      = AF_INET;
+    address.sin_port        = 0;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+#ifdef __WXMSW__
+    int       addressLength = sizeof(address);
+#else
+    socklen_t addressLength = sizeof(address);
+#endif
+
+    if ( bind(m_wakeSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 )
+        return fail("bind()");
+    if ( getsockname(m_wakeSocket, reinterpret_cast<sockaddr*>(&address), &addressLength) != 0 )
+        return fail("getsockname()");
+    if ( connect(m_wakeSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 )
+        return fail("connect()");
+    if ( !SetNonBlocking(m_wakeSocket) )
+        return fail("Setting non-blocking mode");
+
+    return true;
+}
+
+void MJPEGServer::RequestStop()
+{
+    m_stopRequested = true;
+    Wake();
+}
+
+void MJPEGServer::AddCamera(int cameraId, const wxString& cameraName, const CameraMetricsPtr& metrics)
+{
+    wxCHECK_RET(metrics, "Invalid metrics");
+
+    wxCriticalSectionLocker locker(m_camerasCS);
+    Camera&                 camera = m_cameras[cameraId];
+
+    camera.name    = cameraName;
+    camera.metrics = metrics;
+}
+
+void MJPEGServer::RemoveCamera(int cameraId)
+{
+    {
+        wxCriticalSectionLocker locker(m_camerasCS);
+
+        if ( m_cameras.erase(cameraId) == 0 )
+            return;
+        m_camerasChanged = true;
+    }
+
+    Wake();
+}
+
+void MJPEGServer::Wake()
+{
+    const char data = 0;
+
+    // when it fails because the socket buffer is full,
+    // the server has not processed the previous wake-ups yet
+    if ( m_wakeSocket != invalidSocket )
+        SendToSocket(m_wakeSocket, &data, sizeof(data));
+}
+
+wxThread::ExitCode MJPEGServer::Entry()
+{
+#if wxCHECK_VERSION(3, 1, 6)
+    SetName("MJPEGServer");
+#endif
+
+    // for checking m_stopRequested even if wake-up was lost
+    static const int pollTimeout = 250;
+
+    std::vector<PollFD> fds;
+
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Entered MJPEGServer on port %hu.", m_port);
+
+    try
+    {
+        while ( !m_stopRequested )
+        {
+            fds.clear();
+            fds.push_back(MakePollFD(m_listenSocket, POLLIN));
+            fds.push_back(MakePollFD(m_wakeSocket, POLLIN));
+            for ( const auto& client : m_clients )
+                fds.push_back(MakePollFD(client->socket, client->sending ? POLLIN | POLLOUT : POLLIN));
+
+            if ( PollSockets(fds.data(), fds.size(), pollTimeout) < 0 )
+            {
+#ifndef __WXMSW__
+                if ( errno == EINTR )
+                    continue;
+#endif
+                wxLogTrace(TRACE_WXOPENCVCAMERAS, "poll() failed in MJPEGServer: %s", LastSocketErrorMessage());
+                break;
+            }
+
+            if ( fds[1].revents )
+                DrainWakeSocket();
+
+            // clients are accepted only after processing the polled ones,
+            // so that their indices in m_clients and fds match
+            for ( size_t i = 0; i < fds.size() - 2; ++i )
+            {
+                Client&     client = *m_clients[i];
+                const short events = fds[i + 2].revents;
+
+                if ( client.closed || events == 0 )
+                    continue;
+
+                if ( events & (POLLERR | POLLNVAL) )
+                {
+                    CloseClient(client);
+                    continue;
+                }
+
+                // POLLHUP: recv() returns 0 when the client closed the connection
+                if ( events & (POLLIN | POLLHUP) )
+                    ReadFromClient(client);
+                if ( !client.closed && (events & POLLOUT) )
+                    SendToClient(client);
+            }
+
+            if ( fds[0].revents & POLLIN )
+                AcceptClients();
+
+            CloseClientsOfRemovedCameras();
+
+            // the clients which have sent the previous frame get the latest one,
+            // optimistically sent right away instead of waiting for POLLOUT
+            for ( auto& client : m_clients )
+            {
+                if ( !client->closed && client->stream && !client->sending && TakeLatestFrame(*client) )
+                    SendToClient(*client);
+            }
+
+            m_clients.erase(std::remove_if(m_clients.begin(), m_clients.end(),
+                                           [](const ClientPtr& client) { return client->closed; }),
+                            m_clients.end());
+
+            JoinStoppedEncoders(false);
+        }
+    }
+    catch ( const std::exception& e )
+    {
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "Exception in MJPEGServer: %s", e.what());
+    }
+    catch ( ... )
+    {
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "Unknown exception in MJPEGServer.");
+    }
+
+    // the port is released at once, so that a new server can listen on it while
+    // this one is being reaped; the wake socket is closed in the destructor,
+    // Wake() may still be called until then
+    if ( m_listenSocket != invalidSocket )
+    {
+        CloseSocket(m_listenSocket);
+        m_listenSocket = invalidSocket;
+    }
+
+    for ( auto& client : m_clients )
+        CloseClient(*client);
+    m_clients.clear();
+    JoinStoppedEncoders(true);
+
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Exiting MJPEGServer on port %hu...", m_port);
+
+    return static_cast<wxThread::ExitCode>(nullptr);
+}
+
+void MJPEGServer::AcceptClients()
+{
+    for ( ;; )
+    {
+        const MJPEGSocket socket = accept(m_listenSocket, nullptr, nullptr);
+
+        // no more pending connections (or an error, e.g., the client gave up meanwhile)
+        if ( socket == invalidSocket )
+            return;
+
+        if ( m_clients.size() >= maxClients || !SetNonBlocking(socket) )
+        {
+            CloseSocket(socket);
+            continue;
+        }
+
+        // the end of a frame must not wait for the ACK of its beginning
+        const int noDelay = 1;
+
+        setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+
+        // the kernel would otherwise buffer megabytes for a slow client,
+        // i.e. seconds of frames it would have to receive before the latest one
+        const int sendBufferSize = static_cast<int>(sendBufferBytes);
+
+        setsockopt(socket, SOL_SOCKET, SO_SNDBUF, reinterpret_cast<const char*>(&sendBufferSize), sizeof(sendBufferSize));
+#if defined(SO_NOSIGPIPE) && !defined(MSG_NOSIGNAL)
+        const int noSigPipe = 1;
+
+        setsockopt(socket, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+
+        ClientPtr client(new Client);
+
+        client->socket = socket;
+        m_clients.push_back(std::move(client));
+    }
+}
+
+void MJPEGServer::ReadFromClient(Client& client)
+{
+    char buffer[2048];
+
+    while ( !client.closed )
+    {
+        const long count = ReceiveFromSocket(client.socket, buffer, sizeof(buffer));
+
+        if ( count <= 0 )
+        {
+            if ( count == 0 || !LastSocketErrorWouldBlock() )
+                CloseClient(client);
+            return;
+        }
+
+        // anything sent after the request is ignored
+        if ( client.stream || client.sending )
+            continue;
+
+        client.request.append(buffer, static_cast<size_t>(count));
+
+        if ( client.request.find("\r\n\r\n") != std::string::npos || client.request.length() > maxRequestLength )
+            HandleRequest(client);
+    }
+}
+
+void MJPEGServer::HandleRequest(Client& client)
+{
+    const wxString requestLine = wxString::FromUTF8(client.request.c_str()).BeforeFirst('\r');
+    const wxString target = requestLine.AfterFirst(' ').BeforeFirst(' ');
+    const wxString path = target.BeforeFirst('?');
+    const wxString query = target.AfterFirst('?');
+    wxString       cameraIdString;
+    long           cameraId = -1;
+
+    client.request.clear();
+
+    if ( !requestLine.StartsWith("GET ") )
+    {
+        SendResponse(client, "405 Method Not Allowed", "text/plain; charset=utf-8", "Only GET is supported.\n");
+    }
+    else if ( path == "/" || path == "/index.html" )
+    {
+        wxString html("<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"><title>wxOpenCVCameras</title></head><body>\n");
+
+        {
+            wxCriticalSectionLocker locker(m_camerasCS);
+
+            // browsers open only a few connections to a server, so with many cameras
+            // not all previews may be shown; the previews use a lower quality
+            for ( const auto& camera : m_cameras )
+            {
+                html += wxString::Format("<figure style=\"display: inline-block\"><a href=\"/camera/%d\">"
+                                         "<img src=\"/camera/%d?quality=50\" width=\"320\" alt=\"%s\"></a>"
+                                         "<figcaption>%s</figcaption></figure>\n",
+                                         camera.first, camera.first,
+                                         EscapeHTML(camera.second.name), EscapeHTML(camera.second.name));
+            }
+
+            if ( m_cameras.empty() )
+                html += "<p>No cameras.</p>\n";
+        }
+
+        html += "</body></html>\n";
+        SendResponse(client, "200 OK", "text/html; charset=utf-8", html.utf8_str().data());
+    }
+    else if ( path.StartsWith("/camera/", &cameraIdString) && cameraIdString.ToLong(&cameraId) && cameraId >= 0 )
+    {
+        int quality = defaultJPEGQuality;
+
+        for ( const auto& parameter : wxSplit(query, '&', '\0') )
+        {
+            wxString value;
+            long     requestedQuality;
+
+            if ( parameter.StartsWith("quality=", &value) && value.ToLong(&requestedQuality) )
+                quality = SnapJPEGQuality(requestedQuality);
+        }
+
+        StartStreaming(client, static_cast<int>(cameraId), quality);
+    }
+    else
+    {
+        SendResponse(client, "404 Not Found", "text/plain; charset=utf-8",
+                     "Cameras are listed at / and streamed at /camera/<id>?quality=<1-100>.\n");
+    }
+}
+
+void MJPEGServer::StartStreaming(Client& client, int cameraId, int quality)
+{
+    Camera camera;
+
+    {
+        wxCriticalSectionLocker locker(m_camerasCS);
+        const auto              it = m_cameras.find(cameraId);
+
+        if ( it == m_cameras.end() )
+        {
+            SendResponse(client, "404 Not Found", "text/plain; charset=utf-8", "No such camera.\n");
+            return;
+        }
+        camera = it->second;
+    }
+
+    StreamPtr& stream = m_streams[cameraId];
+
+    if ( !stream )
+    {
+        stream = std::make_shared<Stream>();
+        stream->cameraId = cameraId;
+        stream->metrics  = camera.metrics;
+        stream->frames   = std::make_shared<MJPEGFrames>();
+        stream->encoder  = new MJPEGEncoder(*this, m_frameBus, cameraId, camera.name, stream->frames, stream->metrics);
+
+        if ( stream->encoder->Run() != wxTHREAD_NO_ERROR )
+        {
+            delete stream->encoder;
+            m_streams.erase(cameraId);
+            SendResponse(client, "503 Service Unavailable", "text/plain; charset=utf-8", "Could not start encoding the camera.\n");
+            return;
+        }
+
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "MJPEGServer started streaming camera '%s'.", camera.name);
+    }
+
+    if ( stream->clientsByQuality[quality]++ == 0 )
+    {
+        wxMutexLocker lock(stream->frames->mutex);
+
+        stream->frames->qualities.insert(quality);
+    }
+
+    CameraMetrics::Add(stream->metrics->mjpegClients, 1);
+
+    client.stream  = stream;
+    client.quality = quality;
+    client.sending = std::make_shared<const std::string>(wxString::Format(
+        "HTTP/1.0 200 OK\r\nContent-Type: multipart/x-mixed-replace; boundary=%s\r\n"
+        "Cache-Control: no-cache, no-store\r\nPragma: no-cache\r\nConnection: close\r\n\r\n",
+        mjpegBoundary).ToStdString());
+    client.sendingOffset = 0;
+    client.sendingFrame  = false;
+
+    SendToClient(client);
+}
+
+void MJPEGServer::SendResponse(Client& client, const wxString& status, const wxString& contentType, const std::string& body)
+{
+    const std::string header = wxString::Format(
+        "HTTP/1.0 %s\r\nContent-Type: %s\r\nContent-Length: %lu\r\nConnection: close\r\n\r\n",
+        status, contentType, static_cast<unsigned long>(body.length())).ToStdString();
+
+    client.sending       = std::make_shared<const std::string>(header + body);
+    client.sendingOffset = 0;
+    client.sendingFrame  = false;
+    client.closeWhenSent = true;
+
+    SendToClient(client);
+}
+
+void MJPEGServer::SendToClient(Client& client)
+{
+    while ( client.sending && !client.closed )
+    {
+        const std::string& data = *client.sending;
+        const long         count = SendToSocket(client.socket, data.data() + client.sendingOffset, data.size() - client.sendingOffset);
+
+        if ( count < 0 )
+        {
+            // the rest is sent on POLLOUT
+            if ( !LastSocketErrorWouldBlock() )
+                CloseClient(client);
+            return;
+        }
+
+        client.sendingOffset += static_cast<size_t>(count);
+        if ( client.stream )
+            CameraMetrics::Add(client.stream->metrics->mjpegBytesSent, static_cast<wxUint64>(count));
+
+        if ( client.sendingOffset < data.size() )
+            continue;
+
+        if ( client.sendingFrame )
+            CameraMetrics::Add(client.stream->metrics->mjpegFramesSent);
+
+        client.sending.reset();
+        client.sendingOffset = 0;
+        client.sendingFrame  = false;
+
+        if ( client.closeWhenSent )
+            CloseClient(client);
+        else if ( client.stream )
+            TakeLatestFrame(client);
+    }
+}
+
+bool MJPEGServer::TakeLatestFrame(Client& client)
+{
+    MJPEGFrames&  frames = *client.stream->frames;
+    wxMutexLocker lock(frames.mutex);
+    const auto    it = frames.frames.find(client.quality);
+
+    if ( it == frames.frames.end() || it->second.sequence <= client.lastSequence )
+        return false;
+
+    // the frames encoded while the client was still receiving the previous one
+    if ( client.lastSequence != 0 )
+        CameraMetrics::Add(client.stream->metrics->mjpegFramesSkipped, it->second.sequence - client.lastSequence - 1);
+
+    client.lastSequence  = it->second.sequence;
+    client.sending       = it->second.data;
+    client.sendingOffset = 0;
+    client.sendingFrame  = true;
+    return true;
+}
+
+void MJPEGServer::CloseClient(Client& client)
+{
+    if ( client.closed )
+        return;
+
+    CloseSocket(client.socket);
+    client.closed = true;
+    client.sending.reset();
+
+    const StreamPtr stream = client.stream;
+
+    if ( !stream )
+        return;
+
+    client.stream.reset();
+    CameraMetrics::Add(stream->metrics->mjpegClients, -1);
+
+    if ( --stream->clientsByQuality[client.quality] == 0 )
+    {
+        wxMutexLocker lock(stream->frames->mutex);
+
+        stream->clientsByQuality.erase(client.quality);
+        stream->frames->qualities.erase(client.quality);
+        stream->frames->frames.erase(client.quality);
+    }
+
+    if ( stream->clientsByQuality.empty() )
+    {
+        // the encoder exits after the frame it is encoding, it is joined
+        // later so that the other clients are not stalled meanwhile
+        stream->encoder->RequestStop();
+        m_stoppedEncoders.push_back(stream->encoder);
+        stream->encoder = nullptr;
+        m_streams.erase(stream->cameraId);
+
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "MJPEGServer stopped streaming camera with id %d.", stream->cameraId);
+    }
+}
+
+void MJPEGServer::CloseClientsOfRemovedCameras()
+{
+    std::set<int> cameraIds;
+
+    {
+        wxCriticalSectionLocker locker(m_camerasCS);
+
+        if ( !m_camerasChanged )
+            return;
+
+        m_camerasChanged = false;
+        for ( const auto& camera : m_cameras )
+            cameraIds.insert(camera.first);
+    }
+
+    for ( auto& client : m_clients )
+    {
+        if ( client->stream && cameraIds.count(client->stream->cameraId) == 0 )
+            CloseClient(*client);
+    }
+}
+
+void MJPEGServer::JoinStoppedEncoders(bool wait)
+{
+    for ( auto it = m_stoppedEncoders.begin(); it != m_stoppedEncoders.end(); )
+    {
+        MJPEGEncoder* encoder = *it;
+
+        if ( !wait && encoder->IsAlive() )
+        {
+            ++it;
+            continue;
+        }
+
+        encoder->Wait(wxTHREAD_WAIT_BLOCK);
+        delete encoder;
+        it = m_stoppedEncoders.erase(it);
+    }
+}
+
+void MJPEGServer::DrainWakeSocket()
+{
+    char buffer[64];
+
+    while ( ReceiveFromSocket(m_wakeSocket, buffer, sizeof(buffer)) > 0 ) {}
+}
+
+void MJPEGServer::CloseSockets()
+{
+    if ( m_listenSocket != invalidSocket )
+    {
+        CloseSocket(m_listenSocket);
+        m_listenSocket = invalidSocket;
+    }
+
+    if ( m_wakeSocket != invalidSocket )
+    {
+        CloseSocket(m_wakeSocket);
+        m_wakeSocket = invalidSocket;
+    }
+}
+
+
+/***********************************************************************************************
+
+    MJPEGEncoder
+
+***********************************************************************************************/
+
+MJPEGEncoder::MJPEGEncoder(MJPEGServer& server, FrameBus& frameBus, int cameraId, const wxString& cameraName,
+                           const MJPEGFramesPtr& frames, const CameraMetricsPtr& metrics)
+    : wxThread(wxTHREAD_JOINABLE),
+      m_server(server), m_frameBus(frameBus), m_cameraName(cameraName),
+      m_frames(frames), m_metrics(metrics)
+{
+    wxASSERT(m_frames);
+    wxASSERT(m_metrics);
+
+    // the clients want the latest frame, not to fall behind
+    m_subscriber = m_frameBus.Subscribe(wxString::Format("MJPEG %s", m_cameraName),
+                                        cameraId, 2, FrameSubscriber::DropOldest);
+}
+
+MJPEGEncoder::~MJPEGEncoder()
+{
+    RequestStop();
+}
+
+void MJPEGEncoder::RequestStop()
+{
+    if ( m_subscriber && !m_subscriber->IsClosed() )
+        m_frameBus.Unsubscribe(m_subscriber);
+}
+
+wxThread::ExitCode MJPEGEncoder::Entry()
+{
+#if wxCHECK_VERSION(3, 1, 6)
+    SetName(wxString::Format("MJPEGEncoder %s", m_cameraName));
+#endif
+
+    static const long receiveTimeout = 250;
+
+    CameraMetrics&             metrics = *m_metrics;
+    ThreadCPUStopWatch         cpuStopWatch;
+    std::vector<int>           qualities;
+    std::vector<unsigned char> jpeg;
+
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Entered MJPEGEncoder for camera '%s'.", m_cameraName);
+
+    try
+    {
+        for ( ;; )
+        {
+            BusFramePtr frame;
+            bool        encoded = false;
+
+            CameraMetrics::Add(metrics.mjpegCpuUs, cpuStopWatch.Lap());
+
+            if ( !m_subscriber->Receive(frame, receiveTimeout) )
+            {
+                if ( m_subscriber->IsClosed() )
+                    break;
+                continue;
+            }
+
+            if ( frame->encoded || frame->image.empty() )
+                continue;
+
+            {
+                wxMutexLocker lock(m_frames->mutex);
+
+                qualities.assign(m_frames->qualities.begin(), m_frames->qualities.end());
+            }
+
+            // each quality is encoded once, no matter how many clients want it
+            for ( const auto quality : qualities )
+            {
+                const std::vector<int> encodeParams{ cv::IMWRITE_JPEG_QUALITY, quality };
+                wxStopWatch            stopWatch;
+
+                if ( !cv::imencode(".jpg", frame->image, jpeg, encodeParams) )
+                    continue;
+
+                const std::string header = wxString::Format("--%s\r\nContent-Type: image/jpeg\r\nContent-Length: %lu\r\n\r\n",
+                                                            mjpegBoundary, static_cast<unsigned long>(jpeg.size())).ToStdString();
+                std::string       data;
+
+                data.reserve(header.size() + jpeg.size() + 2);
+                data += header;
+                data.append(reinterpret_cast<const char*>(jpeg.data()), jpeg.size());
+                data += "\r\n";
+
+                CameraMetrics::Add(metrics.mjpegFramesEncoded);
+                CameraMetrics::Add(metrics.mjpegEncodeTimeUs, stopWatch.TimeInMicro().GetValue());
+
+                {
+                    wxMutexLocker       lock(m_frames->mutex);
+                    MJPEGFrames::Frame& latest = m_frames->frames[quality];
+
+                    latest.sequence++;
+                    latest.data = std::make_shared<const std::string>(std::move(data));
+                }
+
+                encoded = true;
+            }
+
+            if ( encoded )
+                m_server.Wake();
+        }
+    }
+    catch ( const std::exception& e )
+    {
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "Exception in MJPEGEncoder for camera '%s': %s", m_cameraName, e.what());
+    }
+    catch ( ... )
+    {
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "Unknown exception in MJPEGEncoder for camera '%s'.", m_cameraName);
+    }
+
+    RequestStop();
+
+    CameraMetrics::Add(metrics.mjpegCpuUs, cpuStopWatch.Lap());
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Exiting MJPEGEncoder for camera '%s'...", m_cameraName);
+
+    return static_cast<wxThread::ExitCode>(nullptr);
+}
@@ -0,0 +1,196 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        mjpegserver.h
+// Purpose:     HTTP server re-streaming cameras as MJPEG to browsers
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef MJPEGSERVER_H
+#define MJPEGSERVER_H
+
+#include <wx/wx.h>
+#include <wx/thread.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "framebus.h"
+#include "metrics.h"
+
+#ifdef __WXMSW__
+    typedef wxUIntPtr MJPEGSocket; // SOCKET
+#else
+    typedef int       MJPEGSocket;
+#endif
+
+// a multipart part with the headers and the JPEG data, shared by all clients sent it
+typedef std::shared_ptr<const std::string> MJPEGDataPtr;
+
+// The encoded frames of a camera, shared by MJPEGServer and the camera's MJPEGEncoder.
+struct MJPEGFrames
+{
+    struct Frame
+    {
+        wxUint64     sequence{0}; // incremented for every frame encoded with the quality
+        MJPEGDataPtr data;
+    };
+
+    wxMutex              mutex; // guards the following
+    std::set<int>        qualities; // wanted by the clients
+    std::map<int, Frame> frames;    // the latest frame for each quality
+};
+
+typedef std::shared_ptr<MJPEGFrames> MJPEGFramesPtr;
+
+class MJPEGEncoder;
+
+/***********************************************************************************************
+
+    MJPEGServer: a wxThread serving the cameras as multipart/x-mixed-replace MJPEG streams,
+                 which browsers display in an <img> element, so the wall can be viewed
+                 from other computers without each of them connecting to the cameras.
+
+                 http://host:port/ lists the cameras, http://host:port/camera/<id>?quality=<1-100>
+                 streams a camera (id is CameraSetupData::id, quality defaults to 75 and is
+                 snapped to 50, 75, or 90, so that a camera is encoded at most three times).
+
+                 The thread handles all the connections itself with non-blocking sockets
+                 and poll(); the JPEG encoding is done by an MJPEGEncoder per streamed camera,
+                 which encodes each frame once for every quality requested by the clients,
+                 no matter how many clients want it. A client which has not received
+                 the previous frame yet is never queued another one: it is sent the latest
+                 frame available once it is ready, so slow clients just get fewer frames.
+
+                 Compressed frames of cameras with CameraSetupData::passthrough are not streamed.
+
+***********************************************************************************************/
+
+class MJPEGServer : public wxThread
+{
+public:
+    // When localOnly is true, only connections from this computer are accepted.
+    MJPEGServer(FrameBus& frameBus, unsigned short port, bool localOnly);
+    ~MJPEGServer();
+
+    // Creates the listening socket, must be called (and succeed) before Run().
+    bool Listen(wxString& errorMessage);
+
+    // The thread closes the listening socket and all connections and exits,
+    // it must be joined with Wait().
+    void RequestStop();
+
+    // Cameras which can be streamed, can be called from any thread.
+    void AddCamera(int cameraId, const wxString& cameraName, const CameraMetricsPtr& metrics);
+    void RemoveCamera(int cameraId);
+
+    unsigned short GetPort() const     { return m_port; }
+    bool           IsLocalOnly() const { return m_localOnly; }
+
+    // Wakes up the thread waiting in poll(), called by the encoders after encoding a frame.
+    void Wake();
+protected:
+    struct Camera
+    {
+        wxString         name;
+        CameraMetricsPtr metrics;
+    };
+
+    // a camera with at least one client
+    struct Stream
+    {
+        int                   cameraId{-1};
+        CameraMetricsPtr      metrics;
+        MJPEGFramesPtr        frames;
+        MJPEGEncoder*         encoder{nullptr};
+        std::map<int, size_t> clientsByQuality;
+    };
+    typedef std::shared_ptr<Stream> StreamPtr;
+
+    struct Client
+    {
+        MJPEGSocket   socket;
+        std::string   request;        // until it is complete
+        StreamPtr     stream;         // null until the stream response is sent
+        int           quality{0};
+        wxUint64      lastSequence{0};
+        MJPEGDataPtr  sending;        // a response header or a frame
+        size_t        sendingOffset{0};
+        bool          sendingFrame{false};
+        bool          closeWhenSent{false};
+        bool          closed{false};
+    };
+    typedef std::unique_ptr<Client> ClientPtr;
+
+    FrameBus&                m_frameBus;
+    const unsigned short     m_port;
+    const bool               m_localOnly;
+    MJPEGSocket              m_listenSocket;
+    MJPEGSocket              m_wakeSocket; // a loopback UDP socket sending to itself
+    std::atomic<bool>        m_stopRequested{false};
+
+    wxCriticalSection        m_camerasCS; // guards m_cameras and m_camerasChanged
+    std::map<int, Camera>    m_cameras;
+    bool                     m_camerasChanged{false};
+
+    // used only by the server thread
+    std::vector<ClientPtr>   m_clients;
+    std::map<int, StreamPtr> m_streams;
+    std::vector<MJPEGEncoder*> m_stoppedEncoders; // asked to stop, not joined yet
+
+    ExitCode Entry() override;
+
+    void AcceptClients();
+    void ReadFromClient(Client& client);
+    void HandleRequest(Client& client);
+    void SendToClient(Client& client);
+    bool TakeLatestFrame(Client& client);
+    void StartStreaming(Client& client, int cameraId, int quality);
+    void SendResponse(Client& client, const wxString& status, const wxString& contentType, const std::string& body);
+    void CloseClient(Client& client);
+    void CloseClientsOfRemovedCameras();
+    // joins the encoders which have exited or, when wait is true, all of them
+    void JoinStoppedEncoders(bool wait);
+    void DrainWakeSocket();
+    void CloseSockets();
+};
+
+
+/***********************************************************************************************
+
+    MJPEGEncoder: a worker wxThread receiving frames of a single camera from FrameBus
+                  and encoding them as JPEG for MJPEGServer, in every quality the clients
+                  of the camera currently want.
+
+                  It is owned by MJPEGServer, which creates it for the first client
+                  of a camera and stops it after the last one disconnects.
+
+***********************************************************************************************/
+
+class MJPEGEncoder : public wxThread
+{
+public:
+    MJPEGEncoder(MJPEGServer& server, FrameBus& frameBus, int cameraId, const wxString& cameraName,
+                 const MJPEGFramesPtr& frames, const CameraMetricsPtr& metrics);
+    ~MJPEGEncoder();
+
+    // The thread exits after the frame being encoded, it must be joined with Wait().
+    void RequestStop();
+protected:
+    MJPEGServer&       m_server;
+    FrameBus&          m_frameBus;
+    const wxString     m_cameraName;
+    MJPEGFramesPtr     m_frames;
+    CameraMetricsPtr   m_metrics;
+    FrameSubscriberPtr m_subscriber;
+
+    ExitCode Entry() override;
+};
+
+#endif // #ifndef MJPEGSERVER_H
@@ -0,0 +1,44 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        motiondetector.cpp
+// Purpose:     Cheap motion score of downscaled camera frames
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+#include <opencv2/imgproc.hpp>
+
+#include "motiondetector.h"
+
+MotionDetector::MotionDetector(int pixelThreshold, double learningRate)
+    : m_pixelThreshold(pixelThreshold), m_learningRate(learningRate)
+{}
+
+int MotionDetector::Update(const cv::Mat& image)
+{
+    CV_Assert(image.type() == CV_8UC3);
+
+    cv::cvtColor(image, m_gray, cv::COLOR_BGR2GRAY);
+
+    if ( m_background.size() != m_gray.size() )
+    {
+        m_gray.convertTo(m_background, CV_32F);
+        return 0;
+    }
+
+    m_background.convertTo(m_background8U, CV_8U);
+    cv::absdiff(m_gray, m_background8U, m_difference);
+    cv::threshold(m_difference, m_difference, m_pixelThreshold, 255, cv::THRESH_BINARY);
+
+    const int score = static_cast<int>(static_cast<int64_t>(cv::countNonZero(m_difference)) * 1000 / m_difference.total());
+
+    cv::accumulateWeighted(m_gray, m_background, m_learningRate);
+
+    return score;
+}
+
+void MotionDetector::Reset()
+{
+    m_background.release();
+}
@@ -0,0 +1,54 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        motiondetector.h
+// Purpose:     Cheap motion score of downscaled camera frames
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef MOTIONDETECTOR_H
+#define MOTIONDETECTOR_H
+
+#include <opencv2/core.hpp>
+
+/***********************************************************************************************
+
+    MotionDetector: compares frames to a running average of the previous ones
+                    (the background) and scores the motion as the per mille of pixels
+                    differing from it by more than a threshold. It is meant to be used
+                    on thumbnails, which are already downscaled, so that the score
+                    costs only a few OpenCV calls (all of them vectorized) on a small
+                    image. Slow changes such as lighting are absorbed by the background.
+
+                    It is used only by the camera thread, see CameraSetupData::quietFrameStride.
+
+***********************************************************************************************/
+
+class MotionDetector
+{
+public:
+    // pixelThreshold is the difference of a grayscale pixel (0-255) from the background
+    // to count as changed, learningRate is the weight of a new frame in the background
+    MotionDetector(int pixelThreshold = 25, double learningRate = 0.05);
+
+    // Returns the motion score (0-1000) of a BGR CV_8UC3 image and adds the image
+    // to the background. The first image, or one of a different size, only
+    // (re)initializes the background and scores 0.
+    int Update(const cv::Mat& image);
+
+    // forgets the background, e.g. after reconnecting
+    void Reset();
+private:
+    const int    m_pixelThreshold;
+    const double m_learningRate;
+
+    // reused between the calls to avoid allocations
+    cv::Mat      m_gray;
+    cv::Mat      m_background;   // CV_32FC1
+    cv::Mat      m_background8U;
+    cv::Mat      m_difference;
+};
+
+#endif // #ifndef MOTIONDETECTOR_H
@@ -0,0 +1,265 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        objectdetector.cpp
+// Purpose:     Thread detecting objects in frames from all cameras with batched DNN inference
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+#include <wx/wx.h>
+
+#include <algorithm>
+
+#include <opencv2/imgproc.hpp>
+
+#include "camerathread.h"
+#include "cputime.h"
+#include "objectdetector.h"
+
+wxDEFINE_EVENT(EVT_OBJECT_DETECTIONS, wxThreadEvent);
+
+ObjectDetector::ObjectDetector(FrameBus& frameBus, wxEvtHandler* eventSink,
+                               const ObjectDetectorSettings& settings, ApplicationMetrics& metrics)
+    : wxThread(wxTHREAD_JOINABLE),
+      m_frameBus(frameBus), m_eventSink(eventSink), m_settings(settings), m_metrics(metrics)
+{
+    wxASSERT(m_eventSink);
+    wxASSERT(m_settings.maxBatchSize > 0);
+    wxASSERT(m_settings.interval > 0);
+
+    // only the latest frame of each camera is wanted, the queue
+    // is emptied continuously, so it needs to be just large enough
+    // to absorb frames from many cameras arriving at once; the thumbnails
+    // are made by the camera threads anyway and are much closer to the network's
+    // input size than the full frames, ProcessBatch() resizes them to it
+    m_subscriber = m_frameBus.Subscribe("object detector", -1, 64, FrameSubscriber::DropOldest,
+                                        FrameSubscriber::Thumbnails);
+}
+
+ObjectDetector::~ObjectDetector()
+{
+    RequestStop();
+}
+
+bool ObjectDetector::LoadModel(wxString& errorMessage)
+{
+#ifdef HAVE_OPENCV_DNN
+    try
+    {
+        m_net = cv::dnn::readNet(m_settings.modelFile.ToStdString(), m_settings.configFile.ToStdString());
+    }
+    catch ( const std::exception& e )
+    {
+        errorMessage = e.what();
+        return false;
+    }
+
+    if ( m_net.empty() )
+    {
+        errorMessage.Printf("Could not load the network from '%s'.", m_settings.modelFile);
+        return false;
+    }
+
+    m_net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+    m_net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+
+    return true;
+#else
+    errorMessage = "OpenCV was built without the dnn module.";
+    return false;
+#endif
+}
+
+void ObjectDetector::RequestStop()
+{
+    if ( m_subscriber && !m_subscriber->IsClosed() )
+        m_frameBus.Unsubscribe(m_subscriber);
+}
+
+wxString ObjectDetector::GetClassName(const ObjectDetectorSettings& settings, int classId)
+{
+    if ( classId >= 0 && static_cast<size_t>(classId) < settings.classNames.size() )
+        return settings.classNames[classId];
+
+    return wxString::Format("class %d", classId);
+}
+
+wxThread::ExitCode ObjectDetector::Entry()
+{
+#if wxCHECK_VERSION(3, 1, 6)
+    SetName("ObjectDetector");
+#endif
+
+    ThreadCPUStopWatch cpuStopWatch;
+
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Entered ObjectDetector with model '%s'.", m_settings.modelFile);
+    CameraMetrics::Set(m_metrics.detectionRunning, 1);
+
+    try
+    {
+        wxLongLong nextBatchTime = wxGetUTCTimeMillis() + m_settings.interval;
+
+        while ( ReceiveFrames(nextBatchTime) )
+        {
+            // the interval is between the starts of the batches,
+            // but batches taking longer than that are not made up for
+            nextBatchTime = std::max(nextBatchTime + m_settings.interval, wxGetUTCTimeMillis());
+
+            ProcessBatch();
+            CameraMetrics::Add(m_metrics.detectionCpuUs, cpuStopWatch.Lap());
+        }
+    }
+    catch ( const std::exception& e )
+    {
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "Exception in ObjectDetector: %s", e.what());
+    }
+    catch ( ... )
+    {
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "Unknown exception in ObjectDetector.");
+    }
+
+    RequestStop();
+
+    CameraMetrics::Add(m_metrics.detectionCpuUs, cpuStopWatch.Lap());
+    CameraMetrics::Set(m_metrics.detectionRunning, 0);
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Exiting ObjectDetector...");
+
+    return static_cast<wxThread::ExitCode>(nullptr);
+}
+
+bool ObjectDetector::ReceiveFrames(wxLongLong until)
+{
+    for ( ;; )
+    {
+        const wxLongLong timeout = until - wxGetUTCTimeMillis();
+        BusFramePtr      frame;
+
+        if ( timeout <= 0 )
+            return true;
+
+        if ( !m_subscriber->Receive(frame, timeout.ToLong()) )
+        {
+            if ( m_subscriber->IsClosed() )
+                return false;
+            continue;
+        }
+
+        if ( !frame->encoded && !frame->image.empty() && frame->image.type() == CV_8UC3 )
+            m_latestFrames[frame->cameraId] = frame;
+    }
+}
+
+void ObjectDetector::ProcessBatch()
+{
+    if ( m_latestFrames.empty() )
+        return;
+
+    // take at most maxBatchSize frames, starting with the camera after
+    // the last one in the previous batch, so that all cameras get their turn
+    std::vector<BusFramePtr> batchFrames;
+    auto                     it = m_latestFrames.lower_bound(m_nextCameraId);
+
+    while ( batchFrames.size() < m_settings.maxBatchSize && !m_latestFrames.empty() )
+    {
+        if ( it == m_latestFrames.end() )
+            it = m_latestFrames.begin();
+
+        batchFrames.push_back(it->second);
+        it = m_latestFrames.erase(it);
+    }
+    m_nextCameraId = batchFrames.back()->cameraId + 1;
+
+#ifdef HAVE_OPENCV_DNN
+    wxStopWatch stopWatch;
+
+    // resizing with INTER_AREA here instead of letting blobFromImages()
+    // do it is both faster and better for downscaling
+    m_inputImages.resize(batchFrames.size());
+    for ( size_t i = 0; i < batchFrames.size(); ++i )
+        cv::resize(batchFrames[i]->image, m_inputImages[i], m_settings.inputSize, 0, 0, cv::INTER_AREA);
+
+    const cv::Mat blob = cv::dnn::blobFromImages(m_inputImages, m_settings.scaleFactor, cv::Size(),
+                                                 m_settings.mean, m_settings.swapRB, false);
+
+    CameraMetrics::Add(m_metrics.detectionPreprocessTimeUs, stopWatch.TimeInMicro().GetValue());
+    stopWatch.Start();
+
+    m_net.setInput(blob);
+
+    // DetectionOutput is 1x1xNx7, each row is
+    // [image index in batch, class id, confidence, left, top, right, bottom]
+    const cv::Mat output = m_net.forward();
+
+    CameraMetrics::Add(m_metrics.detectionInferenceTimeUs, stopWatch.TimeInMicro().GetValue());
+
+    ObjectDetectionResults results(batchFrames.size());
+
+    for ( size_t i = 0; i < batchFrames.size(); ++i )
+    {
+        results[i].cameraId     = batchFrames[i]->cameraId;
+        results[i].frameNumber  = batchFrames[i]->frameNumber;
+        results[i].capturedTime = batchFrames[i]->capturedTime;
+    }
+
+    if ( output.dims == 4 && output.size[3] == 7 )
+    {
+        const cv::Mat detections(output.size[2], 7, CV_32F, const_cast<float*>(output.ptr<float>()));
+        size_t        objectCount = 0;
+
+        for ( int row = 0; row < detections.rows; ++row )
+        {
+            const float* d = detections.ptr<float>(row);
+            const int    imageIndex = static_cast<int>(d[0]);
+            const float  confidence = d[2];
+
+            // rows with a negative image index are padding
+            if ( imageIndex < 0 || static_cast<size_t>(imageIndex) >= results.size()
+                 || confidence < m_settings.confidenceThreshold )
+            {
+                continue;
+            }
+
+            ObjectDetection detection;
+            const float     left = std::max(0.f, d[3]), top = std::max(0.f, d[4]);
+
+            detection.classId    = static_cast<int>(d[1]);
+            detection.confidence = confidence;
+            detection.box        = cv::Rect2f(left, top, std::min(1.f, d[5]) - left, std::min(1.f, d[6]) - top);
+
+            if ( detection.box.width > 0 && detection.box.height > 0 )
+            {
+                results[imageIndex].detections.push_back(detection);
+                objectCount++;
+            }
+        }
+
+        CameraMetrics::Add(m_metrics.detectionObjects, objectCount);
+    }
+    else
+    {
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "ObjectDetector: the network output is not an SSD DetectionOutput.");
+    }
+
+    const wxLongLong now = wxGetUTCTimeMillis();
+    wxLongLong       maxLatency = 0;
+
+    for ( const auto& frame : batchFrames )
+    {
+        const wxLongLong latency = now - frame->capturedTime;
+
+        CameraMetrics::Add(m_metrics.detectionLatencyTimeMs, latency.GetValue());
+        maxLatency = std::max(maxLatency, latency);
+    }
+
+    CameraMetrics::Add(m_metrics.detectionBatches);
+    CameraMetrics::Add(m_metrics.detectionFrames, batchFrames.size());
+    CameraMetrics::Set(m_metrics.detectionLastBatchSize, batchFrames.size());
+    CameraMetrics::Set(m_metrics.detectionLastLatencyMs, maxLatency.GetValue());
+
+    wxThreadEvent* evt = new wxThreadEvent(EVT_OBJECT_DETECTIONS);
+
+    evt->SetPayload(results);
+    m_eventSink->QueueEvent(evt);
+#endif // #ifdef HAVE_OPENCV_DNN
+}
@@ -0,0 +1,128 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        objectdetector.h
+// Purpose:     Thread detecting objects in frames from all cameras with batched DNN inference
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef OBJECTDETECTOR_H
+#define OBJECTDETECTOR_H
+
+#include <wx/wx.h>
+#include <wx/thread.h>
+
+#include <map>
+#include <vector>
+
+#include <opencv2/opencv_modules.hpp>
+#ifdef HAVE_OPENCV_DNN
+    #include <opencv2/dnn.hpp>
+#endif
+
+#include "framebus.h"
+#include "metrics.h"
+
+// The defaults are for MobileNet-SSD (Caffe or TensorFlow), any network
+// ending with an SSD-style DetectionOutput layer can be used.
+struct ObjectDetectorSettings
+{
+    wxString              modelFile;  // e.g., .caffemodel, .pb, .onnx
+    wxString              configFile; // e.g., .prototxt, .pbtxt, may be empty
+    std::vector<wxString> classNames; // indexed by class id, may be empty
+
+    cv::Size              inputSize{300, 300};
+    double                scaleFactor{1 / 127.5};
+    cv::Scalar            mean{127.5, 127.5, 127.5};
+    bool                  swapRB{false};
+    float                 confidenceThreshold{0.5f};
+
+    long                  interval{200}; // ms between batches
+    size_t                maxBatchSize{16};
+};
+
+struct ObjectDetection
+{
+    int        classId{0};
+    float      confidence{0};
+    cv::Rect2f box; // relative to the frame size, i.e. in range 0..1
+};
+
+// The result for a single frame, sent also when nothing was detected,
+// so that the GUI can remove outdated detections.
+struct CameraObjectDetections
+{
+    int                          cameraId{-1};
+    wxULongLong                  frameNumber{0};
+    wxLongLong                   capturedTime{0};
+    std::vector<ObjectDetection> detections;
+};
+
+typedef std::vector<CameraObjectDetections> ObjectDetectionResults;
+
+/***********************************************************************************************
+
+    ObjectDetector: a worker wxThread running a DNN object detector on frames
+                    from all cameras. It receives the thumbnails the camera threads
+                    create for the GUI from FrameBus (see FrameSubscriber::Thumbnails),
+                    so cameras without a thumbnail are not processed, and keeps only
+                    the latest one of each camera. Every interval ms, it resizes
+                    the thumbnails which arrived since the previous batch to the network's
+                    input size, puts them into a single blob with cv::dnn::blobFromImages()
+                    and runs one forward pass for all of them, which is much cheaper
+                    than running the network for each camera separately. When more
+                    cameras have a new frame than maxBatchSize, the remaining ones are
+                    processed first in the next batch.
+
+                    The results are sent to the event sink as EVT_OBJECT_DETECTIONS.
+
+                    It is owned by CameraGridFrame, see CameraGridFrame::m_objectDetector.
+
+***********************************************************************************************/
+
+class ObjectDetector : public wxThread
+{
+public:
+    ObjectDetector(FrameBus& frameBus, wxEvtHandler* eventSink,
+                   const ObjectDetectorSettings& settings, ApplicationMetrics& metrics);
+    ~ObjectDetector();
+
+    // Loads the network, must be called (and succeed) before Run().
+    bool LoadModel(wxString& errorMessage);
+
+    // The thread exits after the batch being processed, it must be joined with Wait().
+    void RequestStop();
+
+    const ObjectDetectorSettings& GetSettings() const { return m_settings; }
+
+    // returns "class N" for an unknown class
+    static wxString GetClassName(const ObjectDetectorSettings& settings, int classId);
+protected:
+    FrameBus&                    m_frameBus;
+    wxEvtHandler*                m_eventSink;
+    const ObjectDetectorSettings m_settings;
+    ApplicationMetrics&          m_metrics;
+    FrameSubscriberPtr           m_subscriber;
+
+    // used only by the detector thread
+#ifdef HAVE_OPENCV_DNN
+    cv::dnn::Net                 m_net;
+#endif
+    std::map<int, BusFramePtr>   m_latestFrames; // by camera id
+    int                          m_nextCameraId{0}; // the batch starts with this or the next camera
+    std::vector<cv::Mat>         m_inputImages;  // reused, each of m_settings.inputSize
+
+    ExitCode Entry() override;
+
+    // returns false when the subscriber was closed
+    bool ReceiveFrames(wxLongLong until);
+    void ProcessBatch();
+};
+
+// Sent by ObjectDetector after each batch, the results are in the event's
+// payload, retrieve them with GetPayload<ObjectDetectionResults>().
+wxDECLARE_EVENT(EVT_OBJECT_DETECTIONS, wxThreadEvent);
+
+#endif // #ifndef OBJECTDETECTOR_H
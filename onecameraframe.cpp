@@ -7,29 +7,251 @@
 // Licence:     wxWindows licence
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <wx/slider.h>
 
 #include "onecameraframe.h"
 
-OneCameraFrame::OneCameraFrame(wxWindow* parent, const wxString& cameraName)
-    : wxFrame(parent, wxID_ANY, cameraName)
+OneCameraFrame::OneCameraFrame(wxWindow* parent, int cameraId, const wxString& cameraName,
+                               const ReplayBufferPtr& replayBuffer)
+    : wxFrame(parent, wxID_ANY, cameraName),
+      m_replayBuffer(replayBuffer)
 {
-    m_cameraPanel = new CameraPanel(this, cameraName, true);
+    wxBoxSizer* mainSizer = new wxBoxSizer(wxVERTICAL);
+
+    m_cameraPanel = new CameraPanel(this, cameraId, cameraName, true);
     m_cameraPanel->SetMinSize(wxSize(640, 400));
     m_cameraPanel->SetMaxSize(wxSize(640, 400));
+    mainSizer->Add(m_cameraPanel);
+    SetSizer(mainSizer);
+
+    if ( m_replayBuffer )
+        CreateReplayControls();
+
+    mainSizer->Fit(this);
 }
 
 void OneCameraFrame::SetCameraBitmap(const wxBitmap& bitmap, CameraPanel::Status status)
 {
+    m_liveStatus = status;
+
+    if ( m_replaying )
+        return;
+
     m_cameraPanel->SetBitmap(bitmap, status);
 
-    if ( bitmap.IsOk() && !m_clientSizeAdjusted )
+    if ( bitmap.IsOk() )
+        AdjustClientSize(bitmap.GetSize());
+}
+
+void OneCameraFrame::SetCameraStatus(CameraPanel::Status status)
+{
+    m_liveStatus = status;
+
+    if ( !m_replaying )
+        m_cameraPanel->SetStatus(status);
+}
+
+void OneCameraFrame::CreateReplayControls()
+{
+    wxPanel*    controlsPanel = new wxPanel(this);
+    wxBoxSizer* controlsSizer = new wxBoxSizer(wxHORIZONTAL);
+
+    m_liveButton = new wxButton(controlsPanel, wxID_ANY, "&Live");
+    m_liveButton->Bind(wxEVT_BUTTON, &OneCameraFrame::OnLive, this);
+    controlsSizer->Add(m_liveButton, wxSizerFlags().Border(wxALL & ~wxRIGHT));
+
+    m_playPauseButton = new wxButton(controlsPanel, wxID_ANY, "&Pause");
+    m_playPauseButton->Bind(wxEVT_BUTTON, &OneCameraFrame::OnPlayPause, this);
+    controlsSizer->Add(m_playPauseButton, wxSizerFlags().Border());
+
+    // the position is the offset from the newest buffered frame in ms
+    m_replaySlider = new wxSlider(controlsPanel, wxID_ANY, 0, -m_replayBuffer->GetDuration(), 0);
+    m_replaySlider->Bind(wxEVT_SLIDER, &OneCameraFrame::OnReplaySlider, this);
+    controlsSizer->Add(m_replaySlider, wxSizerFlags(1).CenterVertical().Border(wxLEFT | wxRIGHT));
+
+    m_replayInfoText = new wxStaticText(controlsPanel, wxID_ANY, "",
+                                        wxDefaultPosition, wxDefaultSize, wxST_NO_AUTORESIZE);
+    m_replayInfoText->SetMinSize(m_replayInfoText->GetTextExtent("Replay -999.9 s, seek 999.9 ms  "));
+    controlsSizer->Add(m_replayInfoText, wxSizerFlags().CenterVertical().Border());
+
+    controlsPanel->SetSizer(controlsSizer);
+    GetSizer()->Add(controlsPanel, wxSizerFlags().Expand());
+
+    m_replayTimer.Bind(wxEVT_TIMER, &OneCameraFrame::OnReplayTimer, this);
+    m_replayTimer.Start(ms_replayTimerInterval);
+
+    UpdateReplayControls();
+}
+
+void OneCameraFrame::AdjustClientSize(const wxSize& bitmapSize)
+{
+    if ( m_clientSizeAdjusted )
+        return;
+
+    m_cameraPanel->SetMinSize(bitmapSize);
+    m_cameraPanel->SetMaxSize(bitmapSize);
+    GetSizer()->Fit(this);
+    m_clientSizeAdjusted = true;
+    SetTitle(wxString::Format("%s (resolution %dx%d)",
+        GetCameraName(), bitmapSize.GetWidth(), bitmapSize.GetHeight()));
+}
+
+void OneCameraFrame::GoLive()
+{
+    m_replaying = false;
+    m_playing = false;
+    m_replayFrame.reset();
+    m_replayBitmap = wxBitmap();
+
+    // the last replayed frame is shown until the next live one arrives
+    m_cameraPanel->SetStatus(m_liveStatus);
+    UpdateReplayControls();
+}
+
+void OneCameraFrame::Pause()
+{
+    if ( !m_replaying )
+    {
+        wxLongLong oldest, newest;
+
+        if ( !m_replayBuffer->GetTimeRange(oldest, newest) )
+        {
+            wxLogMessage("No frames have been buffered for camera '%s' yet.", GetCameraName());
+            return;
+        }
+
+        m_replaying = true;
+        m_replayTime = newest;
+    }
+
+    m_playing = false;
+    ShowReplayFrame();
+    UpdateReplayControls();
+}
+
+void OneCameraFrame::Play()
+{
+    if ( !m_replaying )
+        return;
+
+    m_playing = true;
+    m_playStartedTime = wxGetUTCTimeMillis();
+    m_playStartedReplayTime = m_replayTime;
+    UpdateReplayControls();
+}
+
+void OneCameraFrame::ShowReplayFrame()
+{
+    wxLongLong oldest, newest;
+
+    // the buffer may have been emptied by reconnecting the camera
+    if ( !m_replayBuffer->GetTimeRange(oldest, newest) )
     {
-        m_cameraPanel->SetMinSize(bitmap.GetSize());
-        m_cameraPanel->SetMaxSize(bitmap.GetSize());
-        SetClientSize(bitmap.GetSize());
-        m_clientSizeAdjusted = true;
-        SetTitle(wxString::Format("%s (resolution %dx%d)",
-            GetCameraName(), bitmap.GetWidth(), bitmap.GetHeight()));
+        GoLive();
+        return;
+    }
+
+    // the frames at the position may have been discarded meanwhile
+    if ( m_replayTime < oldest )
+        m_replayTime = oldest;
+    else if ( m_replayTime > newest )
+        m_replayTime = newest;
+
+    const ReplayFramePtr previousFrame = m_replayFrame;
+
+    if ( !m_replayBuffer->Seek(m_replayTime, m_replayFrame, m_replayBitmap) )
+        return;
+
+    if ( m_replayFrame != previousFrame )
+    {
+        m_cameraPanel->SetBitmap(m_replayBitmap, CameraPanel::Replay);
+        AdjustClientSize(m_replayBitmap.GetSize());
     }
 }
 
+void OneCameraFrame::UpdateReplayControls()
+{
+    wxLongLong oldest, newest;
+    const bool hasFrames = m_replayBuffer->GetTimeRange(oldest, newest);
+
+    const wxString playPauseLabel(m_replaying && !m_playing ? "&Play" : "&Pause");
+    wxString       info;
+
+    m_liveButton->Enable(m_replaying);
+    // called often by the timer, avoid needless flicker
+    if ( m_playPauseButton->GetLabel() != playPauseLabel )
+        m_playPauseButton->SetLabel(playPauseLabel);
+    m_playPauseButton->Enable(hasFrames);
+    m_replaySlider->Enable(hasFrames);
+
+    if ( !m_replaying )
+    {
+        const wxInt64 bufferedMs = hasFrames ? (newest - oldest).GetValue() : 0;
+
+        m_replaySlider->SetValue(0);
+        info.Printf("Live, buffered %.1f s, %.1f MB",
+            bufferedMs / 1000., m_replayBuffer->GetBytes() / (1024. * 1024.));
+    }
+    else
+    {
+        const wxInt64 offsetMs = hasFrames ? (m_replayTime - newest).GetValue() : 0;
+
+        // not moved while paused, as it could be just dragged by the user
+        if ( m_playing )
+            m_replaySlider->SetValue(static_cast<int>(wxMax(offsetMs, -m_replayBuffer->GetDuration())));
+
+        info.Printf("Replay %.1f s, seek %.1f ms",
+            offsetMs / 1000., CameraMetrics::Get(m_replayBuffer->GetMetrics()->replayLastSeekTimeUs) / 1000.);
+    }
+
+    if ( m_replayInfoText->GetLabel() != info )
+        m_replayInfoText->SetLabel(info);
+}
+
+void OneCameraFrame::OnLive(wxCommandEvent&)
+{
+    GoLive();
+}
+
+void OneCameraFrame::OnPlayPause(wxCommandEvent&)
+{
+    if ( m_replaying && !m_playing )
+        Play();
+    else
+        Pause();
+}
+
+void OneCameraFrame::OnReplaySlider(wxCommandEvent& evt)
+{
+    wxLongLong oldest, newest;
+
+    if ( !m_replayBuffer->GetTimeRange(oldest, newest) )
+        return;
+
+    m_replaying = true;
+    m_playing = false;
+    m_replayTime = newest + evt.GetInt();
+    ShowReplayFrame();
+    UpdateReplayControls();
+}
+
+void OneCameraFrame::OnReplayTimer(wxTimerEvent&)
+{
+    if ( m_playing )
+    {
+        wxLongLong oldest, newest;
+
+        m_replayTime = m_playStartedReplayTime + (wxGetUTCTimeMillis() - m_playStartedTime);
+
+        // caught up with the live output
+        if ( !m_replayBuffer->GetTimeRange(oldest, newest) || m_replayTime >= newest )
+        {
+            GoLive();
+            return;
+        }
+
+        ShowReplayFrame();
+    }
+
+    UpdateReplayControls();
+}
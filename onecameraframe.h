@@ -13,19 +13,65 @@
 #include <wx/wx.h>
 
 #include "camerapanel.h"
+#include "replaybuffer.h"
+
+class wxSlider;
 
 class OneCameraFrame : public wxFrame
 {
 public:
-    OneCameraFrame(wxWindow* parent, const wxString& cameraName);
+    // When replayBuffer is not null, the frame has controls for pausing
+    // the live output and scrubbing and replaying the buffered frames.
+    OneCameraFrame(wxWindow* parent, int cameraId, const wxString& cameraName,
+                   const ReplayBufferPtr& replayBuffer = ReplayBufferPtr());
 
+    // the live bitmap and status are ignored while replaying
     void SetCameraBitmap(const wxBitmap& bitmap, CameraPanel::Status status = CameraPanel::Receiving);
+    void SetCameraStatus(CameraPanel::Status status);
 
+    int      GetCameraId() const   { return m_cameraPanel->GetCameraId(); }
     wxString GetCameraName() const { return m_cameraPanel->GetCameraName(); }
 
+    bool     IsReplaying() const   { return m_replaying; }
+
 private:
-    bool         m_clientSizeAdjusted{false};
-    CameraPanel* m_cameraPanel{nullptr};
+    // how often the replay position and the information are updated
+    static const long ms_replayTimerInterval = 40;
+
+    bool           m_clientSizeAdjusted{false};
+    CameraPanel*   m_cameraPanel{nullptr};
+    CameraPanel::Status m_liveStatus{CameraPanel::Connecting};
+
+    ReplayBufferPtr m_replayBuffer;
+    bool           m_replaying{false}; // showing the frames from m_replayBuffer, paused or playing
+    bool           m_playing{false};
+    wxLongLong     m_replayTime{0}; // capture time of the replay position
+    // for playing in real time
+    wxLongLong     m_playStartedTime{0};
+    wxLongLong     m_playStartedReplayTime{0};
+    ReplayFramePtr m_replayFrame; // currently shown
+    wxBitmap       m_replayBitmap;
+    wxTimer        m_replayTimer;
+
+    wxButton*      m_liveButton{nullptr};
+    wxButton*      m_playPauseButton{nullptr};
+    wxSlider*      m_replaySlider{nullptr};
+    wxStaticText*  m_replayInfoText{nullptr};
+
+    void CreateReplayControls();
+    void AdjustClientSize(const wxSize& bitmapSize);
+
+    void GoLive();
+    void Pause();
+    void Play();
+    // shows the frame at m_replayTime
+    void ShowReplayFrame();
+    void UpdateReplayControls();
+
+    void OnLive(wxCommandEvent&);
+    void OnPlayPause(wxCommandEvent&);
+    void OnReplaySlider(wxCommandEvent& evt);
+    void OnReplayTimer(wxTimerEvent&);
 };
 
 #endif // #ifndef ONECAMERAFRAME_H
\ No newline at end of file
@@ -0,0 +1,394 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        recordingbenchmark.cpp
+// Purpose:     Benchmark of recording decoded and passed through compressed frames
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+// Usage: wxOpenCVCamerasRecordingBenchmark address [views [seconds [output-directory]]]
+//
+// Records the stream (e.g., an RTSP camera or an H.264 video file) as the given number
+// of views (default 4), i.e. cameras added with the same address, each for the given
+// number of seconds (default 10) or until the stream ends, in four runs:
+//
+//   decode, per view       every view opens the stream, decodes the frames and
+//                          encodes them again with cv::VideoWriter (MJPG in AVI)
+//   decode, shared         one capture decodes the frames for all the views,
+//                          every view encodes them
+//   passthrough, per view  every view opens the stream in the raw stream mode
+//                          (cv::CAP_PROP_FORMAT = -1) and writes the compressed packets
+//   passthrough, shared    one capture in the raw stream mode for all the views
+//
+// As in the application, each capture runs in its own thread (like CameraThread) and
+// hands the frames to a bounded queue of each view's writer thread (like CameraRecorder),
+// a frame which does not fit into a full queue replaces the oldest one there.
+//
+// For each run, the process CPU time per view and per frame written is printed,
+// together with the latency of the frames: the time from when a capture returned
+// a frame to when the writer finished writing it. The files are written to the
+// output directory (default the current one) and removed after each run.
+// The raw stream mode requires the FFmpeg backend, with other backends the
+// passthrough runs are skipped.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+struct Frame
+{
+    cv::Mat           image; // decoded frame or compressed packet
+    Clock::time_point retrievedTime;
+};
+
+// the queue of a view's writer, see FrameSubscriber::DropOldest
+class FrameQueue
+{
+public:
+    static const size_t capacity = 8;
+
+    void Push(const Frame& frame)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if ( m_frames.size() >= capacity )
+        {
+            m_frames.pop_front();
+            m_dropped++;
+        }
+        m_frames.push_back(frame);
+        m_condition.notify_one();
+    }
+
+    // returns false when the queue was closed and is empty
+    bool Pop(Frame& frame)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        m_condition.wait(lock, [this] { return !m_frames.empty() || m_closed; });
+        if ( m_frames.empty() )
+            return false;
+
+        frame = m_frames.front();
+        m_frames.pop_front();
+        return true;
+    }
+
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_closed = true;
+        m_condition.notify_one();
+    }
+
+    uint64_t GetDropped() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        return m_dropped;
+    }
+private:
+    mutable std::mutex      m_mutex;
+    std::condition_variable m_condition;
+    std::deque<Frame>       m_frames;
+    uint64_t                m_dropped{0};
+    bool                    m_closed{false};
+};
+
+struct View
+{
+    std::string         fileName;
+    FrameQueue          queue;
+    std::vector<double> latenciesMs;
+    uint64_t            frames{0};
+    std::string         error;
+};
+
+struct StreamInfo
+{
+    double  FPS{25};
+    int     fourCC{0};
+    cv::Mat codecExtraData; // empty when not available
+};
+
+// returns the CPU time (user + system) of all threads of the process in ms or -1
+double GetProcessCPUTimeMs()
+{
+#ifdef _WIN32
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+
+    if ( !::GetProcessTimes(::GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime) )
+        return -1;
+
+    ULARGE_INTEGER kernel, user;
+
+    kernel.LowPart  = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart    = userTime.dwLowDateTime;
+    user.HighPart   = userTime.dwHighDateTime;
+
+    // FILETIME is in 100-nanosecond intervals
+    return (kernel.QuadPart + user.QuadPart) / 10000.;
+#else
+    timespec ts;
+
+    if ( clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) != 0 )
+        return -1;
+
+    return ts.tv_sec * 1000. + ts.tv_nsec / 1000000.;
+#endif
+}
+
+// returns false when the stream could not be opened in the requested mode
+bool OpenCapture(cv::VideoCapture& capture, const std::string& address, bool passthrough, StreamInfo& info)
+{
+    if ( !capture.open(address, cv::CAP_FFMPEG) && !capture.open(address) )
+        return false;
+
+    // only the FFmpeg backend supports the raw stream mode, see CameraThread::InitPassthrough()
+    if ( passthrough && !capture.set(cv::CAP_PROP_FORMAT, -1) )
+        return false;
+
+    const double FPS = capture.get(cv::CAP_PROP_FPS);
+
+    info.FPS    = FPS > 0 && FPS < 1000 ? FPS : 25;
+    info.fourCC = static_cast<int>(capture.get(cv::CAP_PROP_FOURCC));
+
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && (CV_VERSION_MINOR > 5 || (CV_VERSION_MINOR == 5 && CV_VERSION_REVISION >= 2)))
+    if ( passthrough )
+    {
+        const int extraDataIndex = static_cast<int>(capture.get(cv::CAP_PROP_CODEC_EXTRADATA_INDEX));
+
+        capture.retrieve(info.codecExtraData, extraDataIndex);
+    }
+#endif
+
+    return true;
+}
+
+// reads the frames and hands them to the views until endTime or the end of the stream
+void RunCapture(cv::VideoCapture& capture, Clock::time_point endTime, std::vector<View*> views)
+{
+    Frame frame;
+
+    while ( Clock::now() < endTime && capture.read(frame.image) && !frame.image.empty() )
+    {
+        frame.retrievedTime = Clock::now();
+        for ( auto view : views )
+            view->queue.Push(frame);
+
+        // the next frame is read into a new buffer, the views share this one
+        frame.image = cv::Mat();
+    }
+
+    for ( auto view : views )
+        view->queue.Close();
+}
+
+// writes the frames as CameraRecorder does
+void RunWriter(View& view, bool passthrough, const StreamInfo& info)
+{
+    std::unique_ptr<cv::VideoWriter> writer;
+    FILE*                            file = nullptr;
+    Frame                            frame;
+
+    if ( passthrough )
+    {
+        file = fopen(view.fileName.c_str(), "wb");
+        if ( !file )
+            view.error = "could not open '" + view.fileName + "' for writing";
+        else if ( !info.codecExtraData.empty() )
+            fwrite(info.codecExtraData.data, 1, info.codecExtraData.total() * info.codecExtraData.elemSize(), file);
+    }
+
+    while ( view.queue.Pop(frame) )
+    {
+        if ( !view.error.empty() )
+            continue;
+
+        if ( passthrough )
+        {
+            const size_t size = frame.image.total() * frame.image.elemSize();
+
+            if ( fwrite(frame.image.data, 1, size, file) != size )
+                view.error = "could not write to '" + view.fileName + "'";
+        }
+        else
+        {
+            if ( !writer )
+            {
+                writer.reset(new cv::VideoWriter(view.fileName, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'),
+                                                 info.FPS, frame.image.size()));
+                if ( !writer->isOpened() )
+                {
+                    view.error = "could not open '" + view.fileName + "' for writing";
+                    continue;
+                }
+            }
+            writer->write(frame.image);
+        }
+
+        view.frames++;
+        view.latenciesMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - frame.retrievedTime).count());
+    }
+
+    if ( file )
+        fclose(file);
+    writer.reset();
+}
+
+double Percentile(const std::vector<double>& sorted, double percentile)
+{
+    if ( sorted.empty() )
+        return 0;
+
+    const size_t index = static_cast<size_t>(percentile / 100. * (sorted.size() - 1) + 0.5);
+
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+// returns false when the stream could not be opened
+bool RunBenchmark(const char* name, const std::string& address, int viewCount, int seconds,
+                  const std::string& outputDirectory, bool passthrough, bool shared)
+{
+    const int                                      captureCount = shared ? 1 : viewCount;
+    std::vector<std::unique_ptr<cv::VideoCapture>> captures;
+    std::vector<StreamInfo>                        infos(captureCount);
+    std::vector<std::unique_ptr<View>>             views;
+
+    // opening is not measured, it is the same for both recording paths
+    for ( int i = 0; i < captureCount; ++i )
+    {
+        captures.emplace_back(new cv::VideoCapture);
+        if ( !OpenCapture(*captures.back(), address, passthrough, infos[i]) )
+            return false;
+    }
+
+    for ( int i = 0; i < viewCount; ++i )
+    {
+        views.emplace_back(new View);
+        views.back()->fileName = outputDirectory + "/recordingbenchmark_" + std::to_string(i) + (passthrough ? ".raw" : ".avi");
+    }
+
+    const double            startCPUTimeMs = GetProcessCPUTimeMs();
+    const Clock::time_point startTime = Clock::now();
+    const Clock::time_point endTime = startTime + std::chrono::seconds(seconds);
+    std::vector<std::thread> threads;
+
+    for ( int i = 0; i < viewCount; ++i )
+        threads.emplace_back(RunWriter, std::ref(*views[i]), passthrough, std::cref(infos[shared ? 0 : i]));
+
+    for ( int i = 0; i < captureCount; ++i )
+    {
+        std::vector<View*> captureViews;
+
+        if ( shared )
+        {
+            for ( auto& view : views )
+                captureViews.push_back(view.get());
+        }
+        else
+        {
+            captureViews.push_back(views[i].get());
+        }
+        threads.emplace_back(RunCapture, std::ref(*captures[i]), endTime, captureViews);
+    }
+
+    for ( auto& thread : threads )
+        thread.join();
+
+    const double elapsedMs = std::chrono::duration<double, std::milli>(Clock::now() - startTime).count();
+    const double CPUTimeMs = GetProcessCPUTimeMs() - startCPUTimeMs;
+
+    uint64_t            frames = 0, dropped = 0;
+    std::vector<double> latencies;
+
+    for ( const auto& view : views )
+    {
+        frames += view->frames;
+        dropped += view->queue.GetDropped();
+        latencies.insert(latencies.end(), view->latenciesMs.begin(), view->latenciesMs.end());
+        if ( !view->error.empty() )
+            fprintf(stderr, "  %s\n", view->error.c_str());
+        remove(view->fileName.c_str());
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+
+    printf("%-22s %8llu %8llu %10.1f %10.2f %8.1f %8.1f %8.1f\n", name,
+           static_cast<unsigned long long>(frames), static_cast<unsigned long long>(dropped),
+           100. * CPUTimeMs / elapsedMs / viewCount, frames > 0 ? CPUTimeMs / frames : 0.,
+           Percentile(latencies, 50), Percentile(latencies, 99), latencies.empty() ? 0. : latencies.back());
+
+    return true;
+}
+
+} // unnamed namespace
+
+int main(int argc, char* argv[])
+{
+    const int         viewCount = argc > 2 ? atoi(argv[2]) : 4;
+    const int         seconds = argc > 3 ? atoi(argv[3]) : 10;
+    const std::string outputDirectory = argc > 4 ? argv[4] : ".";
+
+    if ( argc < 2 || argc > 5 || viewCount <= 0 || seconds <= 0 )
+    {
+        fprintf(stderr, "Usage: %s address [views [seconds [output-directory]]]\n", argv[0]);
+        return 1;
+    }
+
+    if ( GetProcessCPUTimeMs() < 0 )
+    {
+        fprintf(stderr, "The CPU time cannot be obtained on this platform.\n");
+        return 1;
+    }
+
+    printf("Recording '%s' as %d views for %d seconds\n", argv[1], viewCount, seconds);
+    printf("\n%-22s %8s %8s %10s %10s %8s %8s %8s\n", "", "frames", "dropped", "CPU/view", "CPU ms", "latency", "", "");
+    printf("%-22s %8s %8s %10s %10s %8s %8s %8s\n", "recording", "written", "", "%", "/frame", "p50 ms", "p99 ms", "max ms");
+
+    if ( !RunBenchmark("decode, per view", argv[1], viewCount, seconds, outputDirectory, false, false) )
+    {
+        fprintf(stderr, "Could not open '%s'.\n", argv[1]);
+        return 1;
+    }
+
+    RunBenchmark("decode, shared", argv[1], viewCount, seconds, outputDirectory, false, true);
+
+    if ( !RunBenchmark("passthrough, per view", argv[1], viewCount, seconds, outputDirectory, true, false) )
+    {
+        fprintf(stderr, "The backend cannot pass through the compressed frames of '%s'.\n", argv[1]);
+        return 1;
+    }
+
+    RunBenchmark("passthrough, shared", argv[1], viewCount, seconds, outputDirectory, true, true);
+
+    return 0;
+}
@@ -0,0 +1,245 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        replaybuffer.cpp
+// Purpose:     In-memory buffer of recent JPEG-compressed camera frames for replay
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+
+#include <opencv2/opencv.hpp>
+
+#include "camerathread.h"
+#include "convertmattowxbmp.h"
+#include "cputime.h"
+#include "replaybuffer.h"
+
+/***********************************************************************************************
+
+    ReplayBuffer
+
+***********************************************************************************************/
+
+ReplayBuffer::ReplayBuffer(long duration, size_t maxBytes, const CameraMetricsPtr& metrics)
+    : m_duration(duration), m_maxBytes(maxBytes), m_metrics(metrics)
+{
+    wxASSERT(m_duration > 0);
+    wxASSERT(m_maxBytes > 0);
+    wxASSERT(m_metrics);
+}
+
+bool ReplayBuffer::Add(const ReplayFramePtr& frame)
+{
+    wxCHECK_MSG(frame, false, "Invalid frame");
+
+    const size_t frameBytes = frame->jpeg.size();
+
+    if ( frameBytes > m_maxBytes )
+        return false;
+
+    wxCriticalSectionLocker locker(m_framesCS);
+
+    // the frames from a single camera thread come in order,
+    // but a reconnected camera may start with an older timestamp
+    if ( !m_frames.empty() && frame->capturedTime < m_frames.back()->capturedTime )
+    {
+        m_frames.clear();
+        m_bytes = 0;
+    }
+
+    while ( !m_frames.empty()
+            && (m_bytes + frameBytes > m_maxBytes
+                || (frame->capturedTime - m_frames.front()->capturedTime).GetValue() > m_duration) )
+    {
+        m_bytes -= m_frames.front()->jpeg.size();
+        m_frames.pop_front();
+    }
+
+    m_frames.push_back(frame);
+    m_bytes += frameBytes;
+
+    CameraMetrics::Set(m_metrics->replayBufferBytes, static_cast<wxInt64>(m_bytes));
+    CameraMetrics::Set(m_metrics->replayBufferFrames, static_cast<wxInt64>(m_frames.size()));
+    CameraMetrics::Set(m_metrics->replayBufferDurationMs,
+                       (m_frames.back()->capturedTime - m_frames.front()->capturedTime).GetValue());
+    return true;
+}
+
+bool ReplayBuffer::GetTimeRange(wxLongLong& oldest, wxLongLong& newest) const
+{
+    wxCriticalSectionLocker locker(m_framesCS);
+
+    if ( m_frames.empty() )
+        return false;
+
+    oldest = m_frames.front()->capturedTime;
+    newest = m_frames.back()->capturedTime;
+    return true;
+}
+
+ReplayFramePtr ReplayBuffer::GetFrameAt(const wxLongLong& time) const
+{
+    wxCriticalSectionLocker locker(m_framesCS);
+
+    if ( m_frames.empty() )
+        return ReplayFramePtr();
+
+    // the first frame captured after time
+    const auto it = std::upper_bound(m_frames.begin(), m_frames.end(), time,
+                                     [](const wxLongLong& t, const ReplayFramePtr& f) { return t < f->capturedTime; });
+
+    if ( it == m_frames.begin() )
+        return m_frames.front();
+
+    return *(it - 1);
+}
+
+bool ReplayBuffer::Seek(const wxLongLong& time, ReplayFramePtr& frame, wxBitmap& bitmap)
+{
+    wxStopWatch          stopWatch;
+    const ReplayFramePtr found = GetFrameAt(time);
+
+    if ( !found )
+        return false;
+
+    if ( found == frame && bitmap.IsOk() )
+        return true;
+
+    // decoded only here, the buffer holds only the compressed data
+    const cv::Mat matBitmap = cv::imdecode(found->jpeg, cv::IMREAD_COLOR);
+    // a new bitmap, the previous one may still be displayed
+    wxBitmap      decodedBitmap;
+
+    if ( !matBitmap.empty() )
+        decodedBitmap.Create(matBitmap.cols, matBitmap.rows, 24);
+
+    if ( !decodedBitmap.IsOk() || !ConvertMatBitmapTowxBitmap(matBitmap, decodedBitmap) )
+    {
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "Could not decode replay frame %s for camera '%s'.",
+                   found->frameNumber.ToString(), m_metrics->cameraName);
+        return false;
+    }
+
+    frame  = found;
+    bitmap = decodedBitmap;
+
+    const wxInt64 seekTime = stopWatch.TimeInMicro().GetValue();
+
+    CameraMetrics::Set(m_metrics->replayLastSeekTimeUs, seekTime);
+    if ( seekTime > CameraMetrics::Get(m_metrics->replayMaxSeekTimeUs) )
+        CameraMetrics::Set(m_metrics->replayMaxSeekTimeUs, seekTime);
+
+    return true;
+}
+
+size_t ReplayBuffer::GetBytes() const
+{
+    wxCriticalSectionLocker locker(m_framesCS);
+
+    return m_bytes;
+}
+
+
+/***********************************************************************************************
+
+    ReplayEncoder
+
+***********************************************************************************************/
+
+ReplayEncoder::ReplayEncoder(FrameBus& frameBus, int cameraId, const wxString& cameraName,
+                             const ReplayBufferPtr& replayBuffer, const CameraMetricsPtr& metrics,
+                             int JPEGQuality)
+    : wxThread(wxTHREAD_JOINABLE),
+      m_frameBus(frameBus), m_cameraName(cameraName),
+      m_replayBuffer(replayBuffer), m_metrics(metrics),
+      m_JPEGQuality(JPEGQuality)
+{
+    wxASSERT(m_replayBuffer);
+    wxASSERT(m_metrics);
+
+    // when the encoder cannot keep up, it is better to have gaps
+    // in the replay than to fall behind the live frames
+    m_subscriber = m_frameBus.Subscribe(wxString::Format("replay %s", m_cameraName),
+                                        cameraId, 2, FrameSubscriber::DropOldest);
+}
+
+ReplayEncoder::~ReplayEncoder()
+{
+    RequestStop();
+}
+
+void ReplayEncoder::RequestStop()
+{
+    if ( m_subscriber && !m_subscriber->IsClosed() )
+        m_frameBus.Unsubscribe(m_subscriber);
+}
+
+wxThread::ExitCode ReplayEncoder::Entry()
+{
+#if wxCHECK_VERSION(3, 1, 6)
+    SetName(wxString::Format("ReplayEncoder %s", m_cameraName));
+#endif
+
+    static const long receiveTimeout = 250;
+
+    const std::vector<int> encodeParams{ cv::IMWRITE_JPEG_QUALITY, m_JPEGQuality };
+    CameraMetrics&         metrics = *m_metrics;
+    ThreadCPUStopWatch     cpuStopWatch;
+
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Entered ReplayEncoder for camera '%s'.", m_cameraName);
+
+    try
+    {
+        for ( ;; )
+        {
+            BusFramePtr frame;
+
+            CameraMetrics::Add(metrics.replayCpuUs, cpuStopWatch.Lap());
+
+            if ( !m_subscriber->Receive(frame, receiveTimeout) )
+            {
+                if ( m_subscriber->IsClosed() )
+                    break;
+                continue;
+            }
+
+            // do not waste time encoding frames no one will ever see
+            if ( m_subscriber->IsClosed() )
+                break;
+
+            if ( frame->encoded || frame->image.empty() )
+                continue;
+
+            std::shared_ptr<ReplayFrame> replayFrame(new ReplayFrame);
+            wxStopWatch                  stopWatch;
+
+            replayFrame->frameNumber  = frame->frameNumber;
+            replayFrame->capturedTime = frame->capturedTime;
+            if ( !cv::imencode(".jpg", frame->image, replayFrame->jpeg, encodeParams) )
+                continue;
+            replayFrame->jpeg.shrink_to_fit();
+
+            CameraMetrics::Add(metrics.replayEncodeTimeUs, stopWatch.TimeInMicro().GetValue());
+            CameraMetrics::Add(metrics.replayFramesEncoded);
+
+            m_replayBuffer->Add(replayFrame);
+        }
+    }
+    catch ( const std::exception& e )
+    {
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "Exception in ReplayEncoder for camera '%s': %s", m_cameraName, e.what());
+    }
+    catch ( ... )
+    {
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "Unknown exception in ReplayEncoder for camera '%s'.", m_cameraName);
+    }
+
+    RequestStop();
+
+    CameraMetrics::Add(metrics.replayCpuUs, cpuStopWatch.Lap());
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Exiting ReplayEncoder for camera '%s'...", m_cameraName);
+
+    return static_cast<wxThread::ExitCode>(nullptr);
+}
@@ -0,0 +1,113 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        replaybuffer.h
+// Purpose:     In-memory buffer of recent JPEG-compressed camera frames for replay
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef REPLAYBUFFER_H
+#define REPLAYBUFFER_H
+
+#include <wx/wx.h>
+#include <wx/thread.h>
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "framebus.h"
+#include "metrics.h"
+
+/***********************************************************************************************
+
+    ReplayBuffer: the last few seconds of frames of a single camera, compressed
+                  as JPEG, so that even tens of seconds of high resolution frames
+                  take only tens of megabytes. The oldest frames are discarded
+                  when the buffer is longer than its duration or larger than
+                  its memory budget. It is thread-safe: frames are added by
+                  ReplayEncoder and read by the GUI thread.
+
+***********************************************************************************************/
+
+struct ReplayFrame
+{
+    wxULongLong                frameNumber{0};
+    wxLongLong                 capturedTime{0}; // obtained with wxGetUTCTimeMillis()
+    std::vector<unsigned char> jpeg;
+};
+
+typedef std::shared_ptr<const ReplayFrame> ReplayFramePtr;
+
+class ReplayBuffer
+{
+public:
+    // duration in ms, maxBytes is the memory budget for JPEG data
+    ReplayBuffer(long duration, size_t maxBytes, const CameraMetricsPtr& metrics);
+
+    long   GetDuration() const { return m_duration; }
+    size_t GetMaxBytes() const { return m_maxBytes; }
+    const CameraMetricsPtr& GetMetrics() const { return m_metrics; }
+
+    // Returns false when the frame is larger than the whole budget.
+    bool Add(const ReplayFramePtr& frame);
+
+    // Capture times of the oldest and newest frame, returns false if empty.
+    bool GetTimeRange(wxLongLong& oldest, wxLongLong& newest) const;
+
+    // Returns the newest frame captured at or before time,
+    // the oldest frame if there is none, or nullptr if empty.
+    ReplayFramePtr GetFrameAt(const wxLongLong& time) const;
+
+    // Finds the frame at time and decodes it to bitmap, recording the time taken
+    // as the seek latency in CameraMetrics. Only the frames viewed are decoded.
+    // frame is not decoded again if it is the same as the one found.
+    bool Seek(const wxLongLong& time, ReplayFramePtr& frame, wxBitmap& bitmap);
+
+    size_t GetBytes() const;
+private:
+    const long                 m_duration;
+    const size_t               m_maxBytes;
+    CameraMetricsPtr           m_metrics;
+
+    mutable wxCriticalSection  m_framesCS;
+    std::deque<ReplayFramePtr> m_frames; // sorted by capturedTime
+    size_t                     m_bytes{0};
+};
+
+typedef std::shared_ptr<ReplayBuffer> ReplayBufferPtr;
+
+
+/***********************************************************************************************
+
+    ReplayEncoder: a worker wxThread which receives frames of a single camera from FrameBus,
+                   compresses them as JPEG and adds them to a ReplayBuffer, so that
+                   the camera thread does not spend any time on it. Compressed frames
+                   from cameras with CameraSetupData::passthrough are ignored.
+
+***********************************************************************************************/
+
+class ReplayEncoder : public wxThread
+{
+public:
+    ReplayEncoder(FrameBus& frameBus, int cameraId, const wxString& cameraName,
+                  const ReplayBufferPtr& replayBuffer, const CameraMetricsPtr& metrics,
+                  int JPEGQuality = 80);
+    ~ReplayEncoder();
+
+    // The thread exits after the frame being encoded, it must be joined with Wait().
+    void RequestStop();
+protected:
+    FrameBus&          m_frameBus;
+    const wxString     m_cameraName;
+    ReplayBufferPtr    m_replayBuffer;
+    CameraMetricsPtr   m_metrics;
+    const int          m_JPEGQuality;
+    FrameSubscriberPtr m_subscriber;
+
+    ExitCode Entry() override;
+};
+
+#endif // #ifndef REPLAYBUFFER_H
@@ -0,0 +1,281 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        schedulingbenchmark.cpp
+// Purpose:     Benchmark of thread priority classes and CPU affinity on frame latency
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+// Usage: wxOpenCVCamerasSchedulingBenchmark [background-cameras [seconds [priority-cpus]]]
+//
+// Simulates a priority camera (3840x2160 at 30 fps) and many background cameras
+// (1280x720 at 25 fps, by default twice as many as there are CPUs), each in its own
+// thread processing its frames like CameraThread converting them. The background
+// work is calibrated so that all the cameras together demand about 150 % of the CPUs,
+// i.e. the computer is overloaded, as with too many cameras in the application.
+//
+// The benchmark runs twice for the given number of seconds (default 10): first with
+// all threads scheduled equally, then with the priority camera thread in the high
+// priority class and the background threads in the low one, see threadscheduling.h.
+// When priority-cpus (e.g., "2-3") is given, in the second run the priority camera
+// thread is also pinned to these CPUs and the background threads to the others.
+//
+// For each run, the latency of the priority camera's frames is printed: the time
+// from when a frame became available to when it was processed. A frame not processed
+// before the next one became available is dropped, as a camera would drop it.
+// On Linux, the high priority class requires CAP_SYS_NICE (e.g., run as root),
+// otherwise only the background threads are deprioritized.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "threadscheduling.h"
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+struct CameraSimulation
+{
+    int             width{0};
+    int             height{0};
+    int             fps{0};
+    int             passes{1};   // over the frame, determines the CPU cost of processing it
+    int             priorityClass{ThreadPriorityNormal};
+    CPUAffinityMask cpuAffinityMask{0};
+};
+
+struct CameraResults
+{
+    std::vector<double> latenciesMs; // only for the priority camera
+    uint64_t            frames{0};
+    uint64_t            dropped{0};
+    std::string         schedulingError;
+};
+
+std::atomic<uint64_t> checksumSink{0}; // so that the processing is not optimized away
+
+// swaps the red and blue channels like converting BGR to RGB, passes times
+void ProcessFrame(const std::vector<uint8_t>& source, std::vector<uint8_t>& target, int passes)
+{
+    uint64_t checksum = 0;
+
+    for ( int pass = 0; pass < passes; ++pass )
+    {
+        const uint8_t* s = source.data();
+        uint8_t*       t = target.data();
+        const size_t   size = source.size();
+
+        for ( size_t i = 0; i + 2 < size; i += 3 )
+        {
+            t[i]     = s[i + 2];
+            t[i + 1] = static_cast<uint8_t>(s[i + 1] + pass);
+            t[i + 2] = s[i];
+        }
+        checksum += t[size / 2];
+    }
+
+    checksumSink += checksum;
+}
+
+void RunCamera(const CameraSimulation& camera, Clock::time_point startTime, Clock::time_point endTime,
+               bool recordLatencies, CameraResults& results)
+{
+    std::string errorMessage;
+
+    if ( !SetCurrentThreadPriorityClass(camera.priorityClass, errorMessage)
+         || !SetCurrentThreadAffinity(camera.cpuAffinityMask, errorMessage) )
+    {
+        results.schedulingError = errorMessage;
+    }
+
+    std::vector<uint8_t>       source(static_cast<size_t>(camera.width) * camera.height * 3, 128);
+    std::vector<uint8_t>       target(source.size());
+    const Clock::duration      period = std::chrono::microseconds(1000000 / camera.fps);
+    Clock::time_point          frameTime = startTime;
+
+    if ( recordLatencies )
+        results.latenciesMs.reserve(static_cast<size_t>((endTime - startTime) / period) + 1);
+
+    while ( frameTime < endTime )
+    {
+        std::this_thread::sleep_until(frameTime);
+
+        ProcessFrame(source, target, camera.passes);
+        results.frames++;
+
+        const Clock::time_point processedTime = Clock::now();
+
+        if ( recordLatencies )
+            results.latenciesMs.push_back(std::chrono::duration<double, std::milli>(processedTime - frameTime).count());
+
+        // the frames which became available meanwhile were replaced by the newer ones
+        frameTime += period;
+        while ( frameTime + period <= processedTime )
+        {
+            frameTime += period;
+            results.dropped++;
+        }
+    }
+}
+
+double Percentile(const std::vector<double>& sorted, double percentile)
+{
+    if ( sorted.empty() )
+        return 0;
+
+    const size_t index = static_cast<size_t>(percentile / 100. * (sorted.size() - 1) + 0.5);
+
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+// returns the CPU time in ms of processing a frame of the camera with one pass
+double MeasureFrameCostMs(const CameraSimulation& camera)
+{
+    std::vector<uint8_t>    source(static_cast<size_t>(camera.width) * camera.height * 3, 128);
+    std::vector<uint8_t>    target(source.size());
+    const int               frames = 20;
+
+    ProcessFrame(source, target, 1); // warm up
+
+    const Clock::time_point startTime = Clock::now();
+
+    for ( int i = 0; i < frames; ++i )
+        ProcessFrame(source, target, 1);
+
+    return std::chrono::duration<double, std::milli>(Clock::now() - startTime).count() / frames;
+}
+
+void RunBenchmark(const char* name, const CameraSimulation& priorityCamera,
+                  const std::vector<CameraSimulation>& backgroundCameras, int seconds)
+{
+    // give all threads time to start before the first frame
+    const Clock::time_point                     startTime = Clock::now() + std::chrono::milliseconds(200);
+    const Clock::time_point                     endTime = startTime + std::chrono::seconds(seconds);
+    CameraResults                               priorityResults;
+    std::vector<std::unique_ptr<CameraResults>> backgroundResults;
+    std::vector<std::thread>                    threads;
+
+    threads.emplace_back(RunCamera, std::cref(priorityCamera), startTime, endTime, true, std::ref(priorityResults));
+    for ( const auto& camera : backgroundCameras )
+    {
+        backgroundResults.emplace_back(new CameraResults);
+        threads.emplace_back(RunCamera, std::cref(camera), startTime, endTime, false, std::ref(*backgroundResults.back()));
+    }
+
+    for ( auto& thread : threads )
+        thread.join();
+
+    uint64_t    backgroundFrames = 0, backgroundDropped = 0;
+    std::string backgroundError;
+
+    for ( const auto& results : backgroundResults )
+    {
+        backgroundFrames += results->frames;
+        backgroundDropped += results->dropped;
+        if ( backgroundError.empty() )
+            backgroundError = results->schedulingError;
+    }
+
+    std::vector<double>& latencies = priorityResults.latenciesMs;
+
+    std::sort(latencies.begin(), latencies.end());
+
+    printf("%-18s %7llu %8llu %8.1f %8.1f %8.1f %8.1f %8.1f %12.1f %%\n", name,
+           static_cast<unsigned long long>(priorityResults.frames), static_cast<unsigned long long>(priorityResults.dropped),
+           Percentile(latencies, 50), Percentile(latencies, 90), Percentile(latencies, 99), Percentile(latencies, 99.9),
+           latencies.empty() ? 0. : latencies.back(),
+           backgroundFrames + backgroundDropped > 0 ? 100. * backgroundDropped / (backgroundFrames + backgroundDropped) : 0.);
+
+    if ( !priorityResults.schedulingError.empty() )
+        fprintf(stderr, "  Could not set the scheduling of the priority camera thread: %s\n", priorityResults.schedulingError.c_str());
+    if ( !backgroundError.empty() )
+        fprintf(stderr, "  Could not set the scheduling of the background camera threads: %s\n", backgroundError.c_str());
+}
+
+} // unnamed namespace
+
+int main(int argc, char* argv[])
+{
+    const int       cpuCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    const int       backgroundCount = argc > 1 ? atoi(argv[1]) : 2 * cpuCount;
+    const int       seconds = argc > 2 ? atoi(argv[2]) : 10;
+    CPUAffinityMask priorityCPUs = 0;
+
+    if ( backgroundCount <= 0 || seconds <= 0 || (argc > 3 && !ParseCPUList(argv[3], priorityCPUs)) )
+    {
+        fprintf(stderr, "Usage: %s [background-cameras [seconds [priority-cpus]]]\n", argv[0]);
+        return 1;
+    }
+
+    CameraSimulation priorityCamera;
+    CameraSimulation backgroundCamera;
+
+    priorityCamera.width  = 3840;
+    priorityCamera.height = 2160;
+    priorityCamera.fps    = 30;
+
+    backgroundCamera.width  = 1280;
+    backgroundCamera.height = 720;
+    backgroundCamera.fps    = 25;
+
+    // the background cameras demand 150 % of all CPUs minus what the priority camera needs
+    const double priorityLoad = MeasureFrameCostMs(priorityCamera) * priorityCamera.fps / 1000.;
+    const double backgroundFrameCostMs = MeasureFrameCostMs(backgroundCamera);
+    const double backgroundLoadPerCamera = (1.5 * cpuCount - priorityLoad) / backgroundCount;
+
+    backgroundCamera.passes = std::max(1, static_cast<int>(backgroundLoadPerCamera * 1000. / backgroundCamera.fps / backgroundFrameCostMs + 0.5));
+
+    printf("%d CPUs, priority camera %dx%d at %d fps (%.0f %% of a CPU), %d background cameras %dx%d at %d fps (%.0f %% of a CPU each)\n",
+           cpuCount, priorityCamera.width, priorityCamera.height, priorityCamera.fps, 100. * priorityLoad,
+           backgroundCount, backgroundCamera.width, backgroundCamera.height, backgroundCamera.fps,
+           backgroundCamera.passes * backgroundFrameCostMs * backgroundCamera.fps / 10.);
+
+    if ( priorityLoad >= 1. )
+    {
+        fprintf(stderr, "The priority camera alone needs more than a CPU, the results would be meaningless.\n");
+        return 1;
+    }
+
+    printf("\nLatency of the priority camera's frames in ms:\n");
+    printf("%-18s %7s %8s %8s %8s %8s %8s %8s %14s\n", "scheduling", "frames", "dropped", "p50", "p90", "p99", "p99.9", "max",
+           "bg dropped");
+
+    std::vector<CameraSimulation> backgroundCameras(backgroundCount, backgroundCamera);
+
+    RunBenchmark("equal", priorityCamera, backgroundCameras, seconds);
+
+    priorityCamera.priorityClass = ThreadPriorityHigh;
+    for ( auto& camera : backgroundCameras )
+        camera.priorityClass = ThreadPriorityLow;
+
+    if ( priorityCPUs != 0 )
+    {
+        const CPUAffinityMask allCPUs = cpuCount >= 64 ? ~CPUAffinityMask(0) : (CPUAffinityMask(1) << cpuCount) - 1;
+        const CPUAffinityMask otherCPUs = allCPUs & ~priorityCPUs;
+
+        if ( (priorityCPUs & ~allCPUs) != 0 || otherCPUs == 0 )
+        {
+            fprintf(stderr, "The priority CPUs must be some of CPUs 0-%d, leaving the others for the background cameras.\n", cpuCount - 1);
+            return 1;
+        }
+
+        priorityCamera.cpuAffinityMask = priorityCPUs;
+        for ( auto& camera : backgroundCameras )
+            camera.cpuAffinityMask = otherCPUs;
+    }
+
+    RunBenchmark(priorityCPUs != 0 ? "prioritized+pinned" : "prioritized", priorityCamera, backgroundCameras, seconds);
+
+    return 0;
+}
@@ -0,0 +1,137 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        sharedframering.h
+// Purpose:     Layout of the shared memory frame ring, see SharedMemoryExporter
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef SHAREDFRAMERING_H
+#define SHAREDFRAMERING_H
+
+// Only standard types are used here, so that the readers in other
+// processes do not depend on wxWidgets or OpenCV.
+
+#include <atomic>
+#include <cstdint>
+
+/***********************************************************************************************
+
+    The shared memory object (named "/wxopencvcameras_<camera id>_<camera>", see
+    SharedMemoryExporter::GetSharedMemoryName(), readable only by the exporter's
+    user on POSIX systems) starts with SharedFrameRingHeader,
+    followed at slotsOffset by slotCount slots of slotSize bytes. Frame n (counted
+    from 1) is written to slot (n - 1) % slotCount and header.lastSequence is set
+    to n after it was written. Each slot starts with SharedFrameSlotHeader, followed
+    at dataOffset by the frame's pixel rows stored contiguously.
+
+    Every slot is protected by a seqlock: the writer makes the slot's seq odd before
+    modifying the slot and even again after. A reader reads seq, the slot, and seq
+    again; the data is valid only if both values are equal and even, otherwise
+    the writer has overwritten the slot meanwhile and the frame must be discarded
+    (it is too slow to keep up with the ring size). The reader never blocks the writer,
+    the data can be processed in place, without copying, as long as seq
+    is checked afterwards. See SharedFrameRingReadFrame() below.
+
+***********************************************************************************************/
+
+#define SHAREDFRAMERING_MAGIC "WXOCVSM1"
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "Lock-free 64-bit atomics are required for sharing between processes");
+
+struct SharedFrameRingHeader
+{
+    char                  magic[8];       // SHAREDFRAMERING_MAGIC without the terminating zero
+    uint32_t              version;        // 1, set last: readers must wait until it is not 0
+    uint32_t              headerSize;     // sizeof(SharedFrameRingHeader)
+    uint64_t              totalSize;      // of the shared memory object
+    uint64_t              slotsOffset;
+    uint64_t              slotSize;
+    uint64_t              slotCount;
+    uint64_t              maxFrameBytes;  // larger frames are not exported
+    std::atomic<uint64_t> lastSequence;   // 0 = no frame written yet
+    std::atomic<uint32_t> closed;         // 1 when the exporter stopped, no more frames will come
+    uint32_t              ownerProcessId; // of the exporter, to detect a ring left by a crashed one
+    char                  cameraName[128]; // UTF-8, zero-terminated
+};
+
+struct SharedFrameSlotHeader
+{
+    std::atomic<uint64_t> seq;          // seqlock, odd while the slot is being written
+    uint64_t              sequence;     // n, see above
+    uint64_t              frameNumber;  // CameraFrameData::GetFrameNumber()
+    int64_t               capturedTime; // ms since the epoch (UTC)
+    int32_t               width;
+    int32_t               height;
+    int32_t               type;         // cv::Mat::type(), CV_8UC3 (BGR) for decoded frames
+    uint32_t              reserved;
+    uint64_t              rowBytes;     // rows are not padded
+    uint64_t              dataSize;     // rowBytes * height
+    uint64_t              dataOffset;   // from the start of the slot, 64-byte aligned
+};
+
+// Frame information and data read from a slot, data points to the shared memory.
+struct SharedFrame
+{
+    uint64_t             sequence{0};
+    uint64_t             frameNumber{0};
+    int64_t              capturedTime{0};
+    int32_t              width{0};
+    int32_t              height{0};
+    int32_t              type{0};
+    uint64_t             rowBytes{0};
+    uint64_t             dataSize{0};
+    const unsigned char* data{nullptr};
+};
+
+inline SharedFrameSlotHeader* SharedFrameRingGetSlot(SharedFrameRingHeader* ring, uint64_t sequence)
+{
+    unsigned char* base = reinterpret_cast<unsigned char*>(ring);
+
+    return reinterpret_cast<SharedFrameSlotHeader*>(base + ring->slotsOffset + ((sequence - 1) % ring->slotCount) * ring->slotSize);
+}
+
+// Starts reading frame sequence: fills frame and returns the slot's seq to be
+// passed to SharedFrameRingValidate() after processing frame.data, or 0 when
+// the frame is not available (being written or already overwritten).
+inline uint64_t SharedFrameRingReadFrame(SharedFrameRingHeader* ring, uint64_t sequence, SharedFrame& frame)
+{
+    SharedFrameSlotHeader* slot = SharedFrameRingGetSlot(ring, sequence);
+    const uint64_t         seq = slot->seq.load(std::memory_order_acquire);
+
+    if ( seq % 2 != 0 )
+        return 0;
+
+    frame.sequence     = slot->sequence;
+    frame.frameNumber  = slot->frameNumber;
+    frame.capturedTime = slot->capturedTime;
+    frame.width        = slot->width;
+    frame.height       = slot->height;
+    frame.type         = slot->type;
+    frame.rowBytes     = slot->rowBytes;
+    frame.dataSize     = slot->dataSize;
+    frame.data         = reinterpret_cast<const unsigned char*>(slot) + slot->dataOffset;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if ( slot->seq.load(std::memory_order_relaxed) != seq || frame.sequence != sequence
+         || frame.dataSize > ring->maxFrameBytes )
+    {
+        return 0;
+    }
+
+    return seq;
+}
+
+// Returns true if the slot of frame was not modified since SharedFrameRingReadFrame()
+// returned seq, i.e. the data read or copied from frame.data is consistent.
+inline bool SharedFrameRingValidate(SharedFrameRingHeader* ring, const SharedFrame& frame, uint64_t seq)
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    return SharedFrameRingGetSlot(ring, frame.sequence)->seq.load(std::memory_order_relaxed) == seq;
+}
+
+#endif // #ifndef SHAREDFRAMERING_H
@@ -0,0 +1,392 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        sharedmemoryexporter.cpp
+// Purpose:     Thread exporting frames from a camera to shared memory for other processes
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+#include <wx/wx.h>
+
+#ifdef __WXMSW__
+    #include <wx/msw/wrapwin.h>
+#else
+    #include <fcntl.h>
+    #include <signal.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #include <cerrno>
+#endif
+
+#include <cstring>
+
+#include "camerathread.h"
+#include "cputime.h"
+#include "sharedmemoryexporter.h"
+
+wxDEFINE_EVENT(EVT_SHARED_MEMORY_EXPORT_STARTED, wxThreadEvent);
+wxDEFINE_EVENT(EVT_SHARED_MEMORY_EXPORT_ERROR, wxThreadEvent);
+
+namespace
+{
+
+// the start of every slot and of its data
+const uint64_t sharedFrameRingAlignment = 64;
+
+uint64_t AlignUp(uint64_t size, uint64_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+#ifndef __WXMSW__
+
+// Returns true when the existing shared memory object can be removed: its exporter
+// has closed it or no longer runs (e.g., crashed). An object of another running
+// exporter (e.g., another instance of the application exporting a camera with the
+// same name), of another user, or one not initialized yet is not stale.
+bool IsSharedFrameRingStale(const char* name)
+{
+    const int fd = shm_open(name, O_RDONLY, 0);
+
+    if ( fd == -1 )
+        return errno == ENOENT; // removed meanwhile
+
+    struct stat fileStatus;
+    bool        stale = false;
+
+    if ( fstat(fd, &fileStatus) == 0 && static_cast<size_t>(fileStatus.st_size) >= sizeof(SharedFrameRingHeader) )
+    {
+        void* data = mmap(nullptr, sizeof(SharedFrameRingHeader), PROT_READ, MAP_SHARED, fd, 0);
+
+        if ( data != MAP_FAILED )
+        {
+            const SharedFrameRingHeader* ring = static_cast<const SharedFrameRingHeader*>(data);
+            const pid_t                  ownerProcessId = static_cast<pid_t>(ring->ownerProcessId);
+
+            stale = ring->closed.load(std::memory_order_acquire) != 0
+                    || (ownerProcessId != 0 && kill(ownerProcessId, 0) == -1 && errno == ESRCH);
+            munmap(data, sizeof(SharedFrameRingHeader));
+        }
+    }
+
+    close(fd);
+    return stale;
+}
+
+#endif // #ifndef __WXMSW__
+
+} // unnamed namespace
+
+
+SharedMemoryExporter::SharedMemoryExporter(FrameBus& frameBus, wxEvtHandler* eventSink, int cameraId, const wxString& cameraName,
+                                           const CameraMetricsPtr& metrics, size_t slotCount)
+    : wxThread(wxTHREAD_JOINABLE),
+      m_frameBus(frameBus), m_eventSink(eventSink), m_cameraId(cameraId), m_cameraName(cameraName),
+      m_sharedMemoryName(GetSharedMemoryName(cameraId, cameraName)),
+      m_metrics(metrics), m_slotCount(slotCount)
+{
+    wxASSERT(m_eventSink);
+    wxASSERT(m_metrics);
+    wxASSERT(m_slotCount > 0);
+
+    // the readers want the latest frame, not to fall behind
+    m_subscriber = m_frameBus.Subscribe(wxString::Format("shared memory %s", m_cameraName),
+                                        cameraId, 2, FrameSubscriber::DropOldest);
+}
+
+SharedMemoryExporter::~SharedMemoryExporter()
+{
+    RequestStop();
+}
+
+void SharedMemoryExporter::RequestStop()
+{
+    if ( m_subscriber && !m_subscriber->IsClosed() )
+        m_frameBus.Unsubscribe(m_subscriber);
+}
+
+wxString SharedMemoryExporter::GetSharedMemoryName(int cameraId, const wxString& cameraName)
+{
+    // the id keeps the names unique even when only the stripped characters differ
+    wxString name = wxString::Format("/wxopencvcameras_%d_", cameraId);
+
+    for ( const auto& c : cameraName.Lower() )
+    {
+        if ( wxIsalnum(c) )
+            name += c;
+    }
+
+    return name;
+}
+
+wxThread::ExitCode SharedMemoryExporter::Entry()
+{
+#if wxCHECK_VERSION(3, 1, 6)
+    SetName(wxString::Format("SharedMemoryExporter %s", m_cameraName));
+#endif
+
+    static const long receiveTimeout = 250;
+
+    CameraMetrics&     metrics = *m_metrics;
+    ThreadCPUStopWatch cpuStopWatch;
+
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Entered SharedMemoryExporter for camera '%s'.", m_cameraName);
+    CameraMetrics::Set(metrics.sharedMemoryExporting, 1);
+
+    try
+    {
+        for ( ;; )
+        {
+            BusFramePtr frame;
+
+            CameraMetrics::Add(metrics.sharedMemoryCpuUs, cpuStopWatch.Lap());
+
+            if ( !m_subscriber->Receive(frame, receiveTimeout) )
+            {
+                if ( m_subscriber->IsClosed() )
+                    break;
+                continue;
+            }
+
+            if ( frame->encoded || frame->image.empty() || frame->image.dims != 2 )
+                continue;
+
+            if ( !m_ring )
+            {
+                wxString errorMessage;
+
+                if ( !CreateRing(frame->image, errorMessage) )
+                {
+                    wxLogTrace(TRACE_WXOPENCVCAMERAS, "%s", errorMessage);
+                    SendEvent(EVT_SHARED_MEMORY_EXPORT_ERROR, errorMessage);
+                    break;
+                }
+                SendEvent(EVT_SHARED_MEMORY_EXPORT_STARTED, m_sharedMemoryName);
+            }
+
+            wxStopWatch stopWatch;
+
+            if ( WriteFrame(*frame) )
+            {
+                CameraMetrics::Add(metrics.sharedMemoryFramesExported);
+                CameraMetrics::Add(metrics.sharedMemoryWriteTimeUs, stopWatch.TimeInMicro().GetValue());
+            }
+            else
+            {
+                CameraMetrics::Add(metrics.sharedMemoryFramesSkipped);
+            }
+        }
+    }
+    catch ( const std::exception& e )
+    {
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "Exception in SharedMemoryExporter for camera '%s': %s", m_cameraName, e.what());
+        SendEvent(EVT_SHARED_MEMORY_EXPORT_ERROR, wxString::Format("Exception: %s", e.what()));
+    }
+    catch ( ... )
+    {
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "Unknown exception in SharedMemoryExporter for camera '%s'.", m_cameraName);
+        SendEvent(EVT_SHARED_MEMORY_EXPORT_ERROR, "Unknown exception.");
+    }
+
+    DestroyRing();
+    RequestStop();
+
+    CameraMetrics::Add(metrics.sharedMemoryCpuUs, cpuStopWatch.Lap());
+    CameraMetrics::Set(metrics.sharedMemoryExporting, 0);
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Exiting SharedMemoryExporter for camera '%s'...", m_cameraName);
+
+    return static_cast<wxThread::ExitCode>(nullptr);
+}
+
+bool SharedMemoryExporter::CreateRing(const cv::Mat& image, wxString& errorMessage)
+{
+    const uint64_t maxFrameBytes = static_cast<uint64_t>(image.cols) * image.elemSize() * image.rows;
+    const uint64_t slotsOffset   = AlignUp(sizeof(SharedFrameRingHeader), sharedFrameRingAlignment);
+    const uint64_t dataOffset    = AlignUp(sizeof(SharedFrameSlotHeader), sharedFrameRingAlignment);
+    const uint64_t slotSize      = AlignUp(dataOffset + maxFrameBytes, sharedFrameRingAlignment);
+    const uint64_t totalSize     = slotsOffset + slotSize * m_slotCount;
+    void*          data = nullptr;
+
+#ifdef __WXMSW__
+    // "Local\" namespace, so that no special privileges are needed, the leading '/' is dropped
+    const wxString mappingName = "Local\\" + m_sharedMemoryName.Mid(1);
+    HANDLE         mappingHandle = ::CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                                        static_cast<DWORD>(totalSize >> 32), static_cast<DWORD>(totalSize & 0xFFFFFFFF),
+                                                        mappingName.wc_str());
+
+    if ( !mappingHandle )
+    {
+        errorMessage.Printf("Could not create shared memory '%s' for camera '%s': %s",
+                            mappingName, m_cameraName, wxSysErrorMsgStr());
+        return false;
+    }
+
+    // the mapping is removed with the last handle, so it belongs to another running exporter
+    if ( ::GetLastError() == ERROR_ALREADY_EXISTS )
+    {
+        errorMessage.Printf("Could not create shared memory '%s' for camera '%s': it is used by another exporter.",
+                            mappingName, m_cameraName);
+        ::CloseHandle(mappingHandle);
+        return false;
+    }
+
+    data = ::MapViewOfFile(mappingHandle, FILE_MAP_WRITE, 0, 0, static_cast<SIZE_T>(totalSize));
+    if ( !data )
+    {
+        errorMessage.Printf("Could not map shared memory '%s' for camera '%s': %s",
+                            mappingName, m_cameraName, wxSysErrorMsgStr());
+        ::CloseHandle(mappingHandle);
+        return false;
+    }
+
+    m_mappingHandle = mappingHandle;
+#else
+    // readable only by the processes of the same user, the frames may be sensitive
+    const mode_t mode = S_IRUSR | S_IWUSR;
+    int          fd = shm_open(m_sharedMemoryName.mb_str(), O_RDWR | O_CREAT | O_EXCL, mode);
+
+    // a previous exporter may have crashed without removing it
+    if ( fd == -1 && errno == EEXIST && IsSharedFrameRingStale(m_sharedMemoryName.mb_str()) )
+    {
+        wxLogTrace(TRACE_WXOPENCVCAMERAS, "Removing stale shared memory '%s' for camera '%s'.",
+                   m_sharedMemoryName, m_cameraName);
+        shm_unlink(m_sharedMemoryName.mb_str());
+        fd = shm_open(m_sharedMemoryName.mb_str(), O_RDWR | O_CREAT | O_EXCL, mode);
+    }
+
+    if ( fd == -1 )
+    {
+        errorMessage.Printf("Could not create shared memory '%s' for camera '%s': %s",
+                            m_sharedMemoryName, m_cameraName,
+                            errno == EEXIST ? "it is used by another exporter" : strerror(errno));
+        return false;
+    }
+
+    if ( ftruncate(fd, static_cast<off_t>(totalSize)) != 0 )
+    {
+        errorMessage.Printf("Could not resize shared memory '%s' for camera '%s': %s",
+                            m_sharedMemoryName, m_cameraName, strerror(errno));
+        close(fd);
+        shm_unlink(m_sharedMemoryName.mb_str());
+        return false;
+    }
+
+    data = mmap(nullptr, static_cast<size_t>(totalSize), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if ( data == MAP_FAILED )
+    {
+        errorMessage.Printf("Could not map shared memory '%s' for camera '%s': %s",
+                            m_sharedMemoryName, m_cameraName, strerror(errno));
+        shm_unlink(m_sharedMemoryName.mb_str());
+        return false;
+    }
+#endif
+
+    m_ring     = static_cast<SharedFrameRingHeader*>(data);
+    m_ringSize = static_cast<size_t>(totalSize);
+
+    // first, so that the ring is not considered stale while being initialized
+#ifdef __WXMSW__
+    m_ring->ownerProcessId = static_cast<uint32_t>(::GetCurrentProcessId());
+#else
+    m_ring->ownerProcessId = static_cast<uint32_t>(getpid());
+#endif
+
+    // the memory is zero-initialized, so are the slots' seqlocks
+    memcpy(m_ring->magic, SHAREDFRAMERING_MAGIC, sizeof(m_ring->magic));
+    m_ring->headerSize    = sizeof(SharedFrameRingHeader);
+    m_ring->totalSize     = totalSize;
+    m_ring->slotsOffset   = slotsOffset;
+    m_ring->slotSize      = slotSize;
+    m_ring->slotCount     = m_slotCount;
+    m_ring->maxFrameBytes = maxFrameBytes;
+    strncpy(m_ring->cameraName, m_cameraName.utf8_str(), sizeof(m_ring->cameraName) - 1);
+
+    for ( uint64_t i = 1; i <= m_slotCount; ++i )
+        SharedFrameRingGetSlot(m_ring, i)->dataOffset = dataOffset;
+
+    // readers check the version last, so they do not use a partially initialized header
+    std::atomic_thread_fence(std::memory_order_release);
+    m_ring->version = 1;
+
+    wxLogTrace(TRACE_WXOPENCVCAMERAS, "Exporting camera '%s' to shared memory '%s', %lu slots of %dx%d.",
+               m_cameraName, m_sharedMemoryName, static_cast<unsigned long>(m_slotCount), image.cols, image.rows);
+    return true;
+}
+
+void SharedMemoryExporter::DestroyRing()
+{
+    if ( !m_ring )
+        return;
+
+    m_ring->closed.store(1, std::memory_order_release);
+
+    // the readers which have it mapped can keep using it
+#ifdef __WXMSW__
+    ::UnmapViewOfFile(m_ring);
+    ::CloseHandle(m_mappingHandle);
+    m_mappingHandle = nullptr;
+#else
+    munmap(m_ring, m_ringSize);
+    shm_unlink(m_sharedMemoryName.mb_str());
+#endif
+
+    m_ring = nullptr;
+    m_ringSize = 0;
+}
+
+bool SharedMemoryExporter::WriteFrame(const BusFrame& frame)
+{
+    const cv::Mat& image    = frame.image;
+    const uint64_t rowBytes = static_cast<uint64_t>(image.cols) * image.elemSize();
+    const uint64_t dataSize = rowBytes * image.rows;
+
+    if ( dataSize > m_ring->maxFrameBytes )
+        return false;
+
+    const uint64_t         sequence = m_ring->lastSequence.load(std::memory_order_relaxed) + 1;
+    SharedFrameSlotHeader* slot = SharedFrameRingGetSlot(m_ring, sequence);
+    unsigned char*         slotData = reinterpret_cast<unsigned char*>(slot) + slot->dataOffset;
+    const uint64_t         seq = slot->seq.load(std::memory_order_relaxed);
+
+    // odd: the readers must not trust the slot now
+    slot->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->sequence     = sequence;
+    slot->frameNumber  = frame.frameNumber.GetValue();
+    slot->capturedTime = frame.capturedTime.GetValue();
+    slot->width        = image.cols;
+    slot->height       = image.rows;
+    slot->type         = image.type();
+    slot->rowBytes     = rowBytes;
+    slot->dataSize     = dataSize;
+
+    if ( image.isContinuous() )
+    {
+        memcpy(slotData, image.data, dataSize);
+    }
+    else
+    {
+        for ( int row = 0; row < image.rows; ++row )
+            memcpy(slotData + row * rowBytes, image.ptr(row), rowBytes);
+    }
+
+    slot->seq.store(seq + 2, std::memory_order_release);
+    m_ring->lastSequence.store(sequence, std::memory_order_release);
+
+    return true;
+}
+
+void SharedMemoryExporter::SendEvent(wxEventType eventType, const wxString& string)
+{
+    wxThreadEvent* evt = new wxThreadEvent(eventType);
+
+    evt->SetInt(m_cameraId);
+    evt->SetString(string);
+    evt->SetPayload(this);
+    m_eventSink->QueueEvent(evt);
+}
@@ -0,0 +1,91 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        sharedmemoryexporter.h
+// Purpose:     Thread exporting frames from a camera to shared memory for other processes
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef SHAREDMEMORYEXPORTER_H
+#define SHAREDMEMORYEXPORTER_H
+
+#include <wx/wx.h>
+#include <wx/thread.h>
+
+#include "framebus.h"
+#include "metrics.h"
+#include "sharedframering.h"
+
+/***********************************************************************************************
+
+    SharedMemoryExporter: a worker wxThread which receives frames of a single camera
+                          from FrameBus and copies them to a ring of slots in a named
+                          shared memory object (shm_open() on Unix, a named file mapping
+                          on MS Windows), see sharedframering.h for its layout. Local
+                          processes can then read the frames already decoded by
+                          CameraThread, without opening the camera again; they read
+                          the frames in place, the exporter never waits for them.
+
+                          The ring is created when the first frame arrives, its slot
+                          size is given by that frame, so frames larger than that
+                          (e.g., after the camera changed resolution) are skipped.
+                          Then EVT_SHARED_MEMORY_EXPORT_STARTED is sent to the event
+                          sink, or EVT_SHARED_MEMORY_EXPORT_ERROR when the ring could
+                          not be created, e.g. when another instance exports a camera
+                          with the same id and name.
+                          Compressed frames from cameras with CameraSetupData::passthrough
+                          are not exported. When the exporter stops, the ring is marked
+                          as closed and the name is removed.
+
+                          It is owned by CameraGridFrame, see CameraView::sharedMemoryExporter.
+
+***********************************************************************************************/
+
+class SharedMemoryExporter : public wxThread
+{
+public:
+    SharedMemoryExporter(FrameBus& frameBus, wxEvtHandler* eventSink, int cameraId, const wxString& cameraName,
+                         const CameraMetricsPtr& metrics, size_t slotCount = 4);
+    ~SharedMemoryExporter();
+
+    // The thread exits after the frame being exported, it must be joined with Wait().
+    void RequestStop();
+
+    // e.g. "/wxopencvcameras_0_cam0" for camera "CAM #0" with id 0
+    static wxString GetSharedMemoryName(int cameraId, const wxString& cameraName);
+protected:
+    FrameBus&              m_frameBus;
+    wxEvtHandler*          m_eventSink;
+    const int              m_cameraId;
+    const wxString         m_cameraName;
+    const wxString         m_sharedMemoryName;
+    CameraMetricsPtr       m_metrics;
+    const size_t           m_slotCount;
+    FrameSubscriberPtr     m_subscriber;
+
+    // used only by the exporter thread
+    SharedFrameRingHeader* m_ring{nullptr};
+    size_t                 m_ringSize{0};
+#ifdef __WXMSW__
+    void*                  m_mappingHandle{nullptr};
+#endif
+
+    ExitCode Entry() override;
+
+    bool CreateRing(const cv::Mat& image, wxString& errorMessage);
+    void DestroyRing();
+    bool WriteFrame(const BusFrame& frame);
+
+    void SendEvent(wxEventType eventType, const wxString& string);
+};
+
+// Sent by SharedMemoryExporter after it created the shared memory, with its
+// name in GetString(), or failed to, with the error in GetString().
+// GetInt() is the camera id and the payload is the SharedMemoryExporter*.
+// After the error the thread exits on its own, it still must be joined.
+wxDECLARE_EVENT(EVT_SHARED_MEMORY_EXPORT_STARTED, wxThreadEvent);
+wxDECLARE_EVENT(EVT_SHARED_MEMORY_EXPORT_ERROR, wxThreadEvent);
+
+#endif // #ifndef SHAREDMEMORYEXPORTER_H
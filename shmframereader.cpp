@@ -0,0 +1,212 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        shmframereader.cpp
+// Purpose:     Sample reader of frames exported to shared memory
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+// Usage: wxOpenCVCamerasShmReader shared-memory-name [seconds] [--copy]
+//
+// Attaches to the frame ring of a camera exported by SharedMemoryExporter
+// (e.g., /wxopencvcameras_0_cam0) and reads the newest frames for the given
+// number of seconds (default 10), printing the throughput once a second.
+// The frames are processed in place (a checksum of their pixels is computed),
+// with --copy they are copied out of the shared memory first.
+// It also serves as a throughput test of the exporter: the frames read, missed
+// (overwritten before read) and torn (overwritten while being read) are counted,
+// together with the lag from capturing a frame to reading it.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "sharedframering.h"
+
+namespace
+{
+
+SharedFrameRingHeader* AttachRing(const std::string& name)
+{
+#ifdef _WIN32
+    const std::string mappingName = "Local\\" + (name[0] == '/' ? name.substr(1) : name);
+    HANDLE            mappingHandle = OpenFileMappingA(FILE_MAP_READ, FALSE, mappingName.c_str());
+
+    if ( !mappingHandle )
+        return nullptr;
+
+    // the size is not known before mapping, 0 maps the whole object;
+    // the handle is deliberately kept open while the process runs
+    return static_cast<SharedFrameRingHeader*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+    const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+
+    if ( fd == -1 )
+        return nullptr;
+
+    struct stat st;
+    void*       data = MAP_FAILED;
+
+    // read-only: the seqlock is only read, so the reader cannot disturb the writer
+    if ( fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(SharedFrameRingHeader) )
+        data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    return data != MAP_FAILED ? static_cast<SharedFrameRingHeader*>(data) : nullptr;
+#endif
+}
+
+int64_t NowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // unnamed namespace
+
+int main(int argc, char* argv[])
+{
+    if ( argc < 2 )
+    {
+        fprintf(stderr, "Usage: %s shared-memory-name [seconds] [--copy]\n", argv[0]);
+        return 1;
+    }
+
+    const std::string name(argv[1]);
+    int               seconds = 10;
+    bool              copy = false;
+
+    for ( int i = 2; i < argc; ++i )
+    {
+        if ( strcmp(argv[i], "--copy") == 0 )
+            copy = true;
+        else
+            seconds = atoi(argv[i]);
+    }
+
+    SharedFrameRingHeader* ring = AttachRing(name);
+
+    if ( !ring )
+    {
+        fprintf(stderr, "Could not open shared memory '%s'.\n", name.c_str());
+        return 1;
+    }
+
+    // the exporter sets the version after initializing the rest of the header
+    for ( int i = 0; i < 100 && reinterpret_cast<volatile uint32_t&>(ring->version) == 0; ++i )
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if ( memcmp(ring->magic, SHAREDFRAMERING_MAGIC, sizeof(ring->magic)) != 0 || ring->version != 1
+         || ring->headerSize != sizeof(SharedFrameRingHeader) )
+    {
+        fprintf(stderr, "'%s' is not a frame ring or has an unsupported version.\n", name.c_str());
+        return 1;
+    }
+
+    printf("Reading camera '%.*s', %llu slots, max frame size %llu bytes\n",
+           static_cast<int>(sizeof(ring->cameraName)), ring->cameraName,
+           static_cast<unsigned long long>(ring->slotCount), static_cast<unsigned long long>(ring->maxFrameBytes));
+
+    std::vector<unsigned char> buffer;
+    uint64_t                   lastRead = ring->lastSequence.load(std::memory_order_acquire);
+    uint64_t                   framesRead = 0, framesMissed = 0, framesTorn = 0, bytesRead = 0;
+    int64_t                    lagTotalMs = 0, lagMaxMs = 0;
+    uint64_t                   checksum = 0;
+    const auto                 startTime = std::chrono::steady_clock::now();
+    auto                       reportTime = startTime;
+
+    while ( std::chrono::steady_clock::now() - startTime < std::chrono::seconds(seconds) )
+    {
+        const uint64_t last = ring->lastSequence.load(std::memory_order_acquire);
+
+        if ( last == lastRead )
+        {
+            if ( ring->closed.load(std::memory_order_acquire) )
+            {
+                printf("The exporter stopped.\n");
+                break;
+            }
+
+            // there is no notification, a real consumer would rather
+            // process the frame it just read while waiting
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        // only the newest frame is of interest
+        framesMissed += last - lastRead - 1;
+        lastRead = last;
+
+        SharedFrame    frame;
+        const uint64_t seq = SharedFrameRingReadFrame(ring, last, frame);
+
+        if ( seq == 0 )
+        {
+            framesTorn++;
+            continue;
+        }
+
+        const unsigned char* data = frame.data;
+
+        if ( copy )
+        {
+            buffer.resize(static_cast<size_t>(frame.dataSize));
+            memcpy(buffer.data(), frame.data, buffer.size());
+            data = buffer.data();
+        }
+
+        // stands for the actual processing
+        for ( uint64_t i = 0; i < frame.dataSize; i += 64 )
+            checksum += data[i];
+
+        if ( !SharedFrameRingValidate(ring, frame, seq) )
+        {
+            framesTorn++;
+            continue;
+        }
+
+        const int64_t lagMs = NowMs() - frame.capturedTime;
+
+        framesRead++;
+        bytesRead += frame.dataSize;
+        lagTotalMs += lagMs;
+        if ( lagMs > lagMaxMs )
+            lagMaxMs = lagMs;
+
+        const auto now = std::chrono::steady_clock::now();
+
+        if ( now - reportTime >= std::chrono::seconds(1) )
+        {
+            const double elapsed = std::chrono::duration<double>(now - reportTime).count();
+
+            printf("%dx%d: %.1f frames/s, %.1f MB/s, missed %llu, torn %llu, lag avg %.1f ms max %lld ms\n",
+                   frame.width, frame.height, framesRead / elapsed, bytesRead / elapsed / (1024. * 1024.),
+                   static_cast<unsigned long long>(framesMissed), static_cast<unsigned long long>(framesTorn),
+                   framesRead ? static_cast<double>(lagTotalMs) / framesRead : 0., static_cast<long long>(lagMaxMs));
+
+            framesRead = framesMissed = framesTorn = bytesRead = 0;
+            lagTotalMs = lagMaxMs = 0;
+            reportTime = now;
+        }
+    }
+
+    // printed so that the processing is not optimized away
+    printf("Checksum %llu\n", static_cast<unsigned long long>(checksum));
+    return 0;
+}
@@ -0,0 +1,194 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        threadscheduling.cpp
+// Purpose:     Setting the priority and CPU affinity of the current thread
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+    #include <windows.h>
+#elif defined(__linux__)
+    #include <pthread.h>
+    #include <sched.h>
+    #include <sys/resource.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+#include "threadscheduling.h"
+
+bool SetCurrentThreadPriorityClass(int priorityClass, std::string& errorMessage)
+{
+    if ( priorityClass < ThreadPriorityLow || priorityClass > ThreadPriorityHigh )
+    {
+        errorMessage = "invalid priority class";
+        return false;
+    }
+
+#ifdef _WIN32
+    const int priorities[] = { THREAD_PRIORITY_BELOW_NORMAL, THREAD_PRIORITY_NORMAL, THREAD_PRIORITY_ABOVE_NORMAL };
+
+    if ( !::SetThreadPriority(::GetCurrentThread(), priorities[priorityClass - ThreadPriorityLow]) )
+    {
+        errorMessage = "SetThreadPriority() failed with error " + std::to_string(::GetLastError());
+        return false;
+    }
+
+    return true;
+#elif defined(__linux__)
+    // unlike POSIX, on Linux the nice value is a per-thread attribute
+    const int   niceValues[] = { 10, 0, -10 };
+    const pid_t threadId = static_cast<pid_t>(syscall(SYS_gettid));
+
+    if ( setpriority(PRIO_PROCESS, static_cast<id_t>(threadId), niceValues[priorityClass - ThreadPriorityLow]) != 0 )
+    {
+        const int error = errno;
+
+        errorMessage = std::string("setpriority() failed: ") + strerror(error);
+        if ( error == EACCES || error == EPERM )
+            errorMessage += " (lowering the nice value requires CAP_SYS_NICE)";
+        return false;
+    }
+
+    return true;
+#else
+    if ( priorityClass == ThreadPriorityNormal )
+        return true;
+
+    errorMessage = "setting the thread priority class is not implemented on this platform";
+    return false;
+#endif
+}
+
+bool SetCurrentThreadAffinity(CPUAffinityMask mask, std::string& errorMessage)
+{
+#ifdef _WIN32
+    DWORD_PTR threadMask = static_cast<DWORD_PTR>(mask);
+
+    // 0 is not a valid mask for SetThreadAffinityMask()
+    if ( threadMask == 0 )
+    {
+        DWORD_PTR systemMask = 0;
+
+        ::GetProcessAffinityMask(::GetCurrentProcess(), &threadMask, &systemMask);
+    }
+
+    if ( ::SetThreadAffinityMask(::GetCurrentThread(), threadMask) == 0 )
+    {
+        errorMessage = "SetThreadAffinityMask() failed with error " + std::to_string(::GetLastError());
+        return false;
+    }
+
+    return true;
+#elif defined(__linux__)
+    cpu_set_t cpuSet;
+
+    CPU_ZERO(&cpuSet);
+    for ( int cpu = 0; cpu < 64 && cpu < CPU_SETSIZE; ++cpu )
+    {
+        if ( mask == 0 || (mask & (CPUAffinityMask(1) << cpu)) != 0 )
+            CPU_SET(cpu, &cpuSet);
+    }
+
+    const int error = pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+
+    if ( error != 0 )
+    {
+        errorMessage = std::string("pthread_setaffinity_np() failed: ") + strerror(error);
+        return false;
+    }
+
+    return true;
+#else
+    if ( mask == 0 )
+        return true;
+
+    errorMessage = "setting the thread CPU affinity is not implemented on this platform";
+    return false;
+#endif
+}
+
+bool ParseCPUList(const std::string& list, CPUAffinityMask& mask)
+{
+    CPUAffinityMask result = 0;
+    const char*     s = list.c_str();
+
+    while ( *s )
+    {
+        char* end = nullptr;
+
+        while ( *s == ' ' || *s == ',' )
+            ++s;
+        if ( !*s )
+            break;
+
+        const long first = strtol(s, &end, 10);
+        long       last = first;
+
+        if ( end == s )
+            return false;
+        s = end;
+
+        if ( *s == '-' )
+        {
+            ++s;
+            last = strtol(s, &end, 10);
+            if ( end == s )
+                return false;
+            s = end;
+        }
+
+        if ( first < 0 || last < first || last > 63 )
+            return false;
+
+        for ( long cpu = first; cpu <= last; ++cpu )
+            result |= CPUAffinityMask(1) << cpu;
+
+        if ( *s && *s != ',' && *s != ' ' )
+            return false;
+    }
+
+    mask = result;
+    return true;
+}
+
+std::string FormatCPUList(CPUAffinityMask mask)
+{
+    std::string list;
+
+    for ( int cpu = 0; cpu < 64; ++cpu )
+    {
+        if ( (mask & (CPUAffinityMask(1) << cpu)) == 0 )
+            continue;
+
+        int last = cpu;
+
+        while ( last < 63 && (mask & (CPUAffinityMask(1) << (last + 1))) != 0 )
+            ++last;
+
+        if ( !list.empty() )
+            list += ",";
+        list += std::to_string(cpu);
+        if ( last > cpu )
+            list += "-" + std::to_string(last);
+
+        cpu = last;
+    }
+
+    return list;
+}
+
+const char* GetThreadPriorityClassName(int priorityClass)
+{
+    if ( priorityClass < ThreadPriorityNormal )
+        return "low";
+    if ( priorityClass > ThreadPriorityNormal )
+        return "high";
+    return "normal";
+}
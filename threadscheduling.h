@@ -0,0 +1,49 @@
+///////////////////////////////////////////////////////////////////////////////
+// Name:        threadscheduling.h
+// Purpose:     Setting the priority and CPU affinity of the current thread
+// Author:      PB
+// Created:     2021-11-18
+// Copyright:   (c) 2021 PB
+// Licence:     wxWindows licence
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef THREADSCHEDULING_H
+#define THREADSCHEDULING_H
+
+// Only standard types are used here, so that the scheduling
+// benchmark tool does not depend on wxWidgets.
+
+#include <cstdint>
+#include <string>
+
+// The classes map to nice values 10, 0 and -10 on Linux and to
+// THREAD_PRIORITY_BELOW_NORMAL, NORMAL and ABOVE_NORMAL on MS Windows.
+// On Linux, an unprivileged process cannot lower the nice value, i.e.,
+// it can set ThreadPriorityHigh only with CAP_SYS_NICE (or RLIMIT_NICE
+// allowing it) and likewise return a ThreadPriorityLow thread to normal.
+enum ThreadPriorityClass
+{
+    ThreadPriorityLow = -1,
+    ThreadPriorityNormal = 0,
+    ThreadPriorityHigh = 1,
+};
+
+// A CPU affinity mask: bit n set means the thread may run on CPU n,
+// 0 means it may run on any CPU. Only the first 64 CPUs can be used.
+typedef uint64_t CPUAffinityMask;
+
+// Set the scheduling of the calling thread. On failure, errorMessage
+// is set and false is returned. Implemented for Linux and MS Windows.
+bool SetCurrentThreadPriorityClass(int priorityClass, std::string& errorMessage);
+bool SetCurrentThreadAffinity(CPUAffinityMask mask, std::string& errorMessage);
+
+// Parses a CPU list such as "2-3,6" (empty = any CPU, i.e. mask 0), returns false if invalid.
+bool ParseCPUList(const std::string& list, CPUAffinityMask& mask);
+// The reverse of ParseCPUList(), returns an empty string for 0.
+std::string FormatCPUList(CPUAffinityMask mask);
+
+// returns "low", "normal" or "high"
+const char* GetThreadPriorityClassName(int priorityClass);
+
+#endif // #ifndef THREADSCHEDULING_H